@@ -152,6 +152,10 @@ int main(int argc, char *argv[]) {
   int dump_tasks = 0;
   int dump_cells = 0;
   int dump_threadpool = 0;
+  int trace_tasks = 0;
+  int dump_memuse_counters = 0;
+  int trace_tasks_steps = 1;
+  int trace_tasks_first_step = 0;
   int nsteps = -2;
   int restart = 0;
   int with_cosmology = 0;
@@ -313,6 +317,18 @@ int main(int argc, char *argv[]) {
                 "Fraction of the total step's time spent in a task to trigger "
                 "a dump of the task plot on this step",
                 NULL, 0, 0),
+      OPT_INTEGER(0, "memuse-counters", &dump_memuse_counters,
+                  "Time-step frequency at which the memory use of each "
+                  "allocation label is dumped.",
+                  NULL, 0, 0),
+      OPT_INTEGER(0, "task-trace", &trace_tasks,
+                  "Time-step frequency at which traces of the task execution "
+                  "are written in the Chrome/Perfetto JSON format.",
+                  NULL, 0, 0),
+      OPT_INTEGER(0, "task-trace-steps", &trace_tasks_steps,
+                  "Number of consecutive time-steps covered by each task "
+                  "trace (default: 1).",
+                  NULL, 0, 0),
       OPT_END(),
   };
   struct argparse argparse;
@@ -434,6 +450,15 @@ int main(int argc, char *argv[]) {
   }
 #endif
 
+  if (trace_tasks < 0 || trace_tasks_steps < 1 ||
+      (trace_tasks > 0 && trace_tasks_steps > trace_tasks)) {
+    printf(
+        "Error: the number of steps per task trace must be at least 1 and "
+        "at most the task trace frequency.\n");
+    return 1;
+  }
+  if (trace_tasks) task_trace_enable(task_trace_default_size);
+
 #ifndef SWIFT_DEBUG_THREADPOOL
   if (dump_threadpool) {
     printf(
@@ -1144,7 +1169,8 @@ int main(int argc, char *argv[]) {
                sparts, bparts, Ngas, Ngpart, Nsink, Nspart, Nbpart, periodic,
                replicate, remap_ids, generate_gas_in_ics, with_hydro,
                with_self_gravity, with_star_formation,
-               with_DM_background_particles, talking, dry_run, nr_nodes);
+               with_DM_background_particles, talking, dry_run, nr_nodes,
+               nr_threads);
 
     /* Initialise the line of sight properties. */
     if (with_line_of_sight) los_init(s.dim, &los_properties, params);
@@ -1433,6 +1459,9 @@ int main(int argc, char *argv[]) {
     /* Reset timers */
     timers_reset_all();
 
+    /* Are we recording a trace of the tasks for this step? */
+    if (trace_tasks) task_trace_active = (j % trace_tasks < trace_tasks_steps);
+
     /* Take a step. */
     engine_step(&e);
 
@@ -1472,6 +1501,20 @@ int main(int argc, char *argv[]) {
                       /* header = */ 0, /* allranks = */ 1);
     }
 
+    /* Write the task trace at the end of the range of traced steps. */
+    if (trace_tasks && j % trace_tasks == 0) trace_tasks_first_step = e.step;
+    if (trace_tasks && j % trace_tasks == trace_tasks_steps - 1) {
+      task_trace_active = 0;
+      char dumpfile[40];
+#ifdef WITH_MPI
+      snprintf(dumpfile, 40, "task_trace-rank%d-step%d.json", engine_rank,
+               e.step);
+#else
+      snprintf(dumpfile, 40, "task_trace-step%d.json", e.step);
+#endif  // WITH_MPI
+      task_trace_dump(dumpfile, &e, trace_tasks_first_step, e.step);
+    }
+
 #ifdef SWIFT_CELL_GRAPH
     /* Dump the cell data using the given frequency. */
     if (dump_cells && (dump_cells == 1 || j % dump_cells == 1)) {
@@ -1493,6 +1536,18 @@ int main(int argc, char *argv[]) {
     }
 #endif
 
+    /* Dump the memory counters if requested. */
+    if (dump_memuse_counters && j % dump_memuse_counters == 0) {
+      char dumpfile[40];
+#ifdef WITH_MPI
+      snprintf(dumpfile, 40, "memuse_counters-rank%d-step%d.dat", engine_rank,
+               e.step);
+#else
+      snprintf(dumpfile, 40, "memuse_counters-step%d.dat", e.step);
+#endif  // WITH_MPI
+      memuse_counters_dump(dumpfile);
+    }
+
       /* Dump MPI requests if collected. */
 #if defined(SWIFT_MPIUSE_REPORTS) && defined(WITH_MPI)
     {
@@ -1547,6 +1602,20 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  /* Write the task trace of a range of steps cut short by the end of the
+   * run. */
+  if (trace_tasks && task_trace_active) {
+    task_trace_active = 0;
+    char dumpfile[40];
+#ifdef WITH_MPI
+    snprintf(dumpfile, 40, "task_trace-rank%d-step%d.json", engine_rank,
+             e.step);
+#else
+    snprintf(dumpfile, 40, "task_trace-step%d.json", e.step);
+#endif  // WITH_MPI
+    task_trace_dump(dumpfile, &e, trace_tasks_first_step, e.step);
+  }
+
   /* Write final output. */
   if (!force_stop) {
 
@@ -1617,12 +1686,18 @@ int main(int argc, char *argv[]) {
     message("resubmission command completed.");
   }
 
+#ifdef SWIFT_HARDWARE_COUNTERS
+  /* Report the hardware counters of the tasks over the whole run. */
+  hardware_counters_report(&e);
+#endif
+
   /* Clean everything */
   if (with_verbose_timers) timers_close_file();
   if (with_cosmology) cosmology_clean(e.cosmology);
   if (with_self_gravity) pm_mesh_clean(e.mesh);
   if (with_cooling || with_temperature) cooling_clean(e.cooling_func);
   if (with_feedback) feedback_clean(e.feedback_props);
+  if (with_hydro) eos_clean(&eos);
   engine_clean(&e, /*fof=*/0, restart);
   free(params);
   free(output_options);
@@ -549,7 +549,7 @@ int main(int argc, char *argv[]) {
              periodic, replicate, /*remap_ids=*/0,
              /*generate_gas_in_ics=*/0, /*hydro=*/N_total[0] > 0, /*gravity=*/1,
              /*with_star_formation=*/0, with_DM_background_particles, talking,
-             /*dry_run=*/0, nr_nodes);
+             /*dry_run=*/0, nr_nodes, nr_threads);
 
   if (myrank == 0) {
     clocks_gettime(&toc);
@@ -2101,7 +2101,7 @@ void cell_split(struct cell *c, ptrdiff_t parts_offset, ptrdiff_t sparts_offset,
             j++;
             bucket_count[bid]++;
           }
-          memswap(&gparts[j], &gpart, sizeof(struct gpart));
+          memswap_gpart(&gparts[j], &gpart);
           memswap(&gbuff[j], &temp_buff, sizeof(struct cell_buff));
           if (gparts[j].type == swift_type_gas) {
             parts[-gparts[j].id_or_neg_offset - parts_offset].gpart =
@@ -6640,7 +6640,7 @@ void cell_reorder_extra_gparts(struct cell *c, struct part *parts,
 #endif
 
       /* Swap everything (including pointers) */
-      memswap(&gparts[i], &gparts[first_not_extra], sizeof(struct gpart));
+      memswap_gpart(&gparts[i], &gparts[first_not_extra]);
       if (gparts[i].type == swift_type_gas) {
         parts[-gparts[i].id_or_neg_offset].gpart = &gparts[i];
       } else if (gparts[i].type == swift_type_stars) {
@@ -40,6 +40,8 @@
 #include "hydro_io.h"
 #include "io_properties.h"
 #include "kernel_hydro.h"
+#include "memuse.h"
+#include "minmax.h"
 #include "part.h"
 #include "part_type.h"
 #include "sink_io.h"
@@ -53,6 +55,7 @@
 #include "version.h"
 
 /* Some standard headers. */
+#include <float.h>
 #include <math.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -893,6 +896,110 @@ void io_write_array(hid_t h_grp, const int n, const void* array,
   H5Sclose(h_space);
 }
 
+/**
+ * @brief Write the top-level cell index (centres, files, counts and offsets)
+ * to a hdf5 group.
+ *
+ * @param h_grp The open hdf5 group.
+ * @param cdim The number of top-level cells along each axis.
+ * @param nr_cells The total number of top-level cells.
+ * @param cell_width The width of a top-level cell in snapshot units.
+ * @param centres The (3 x nr_cells) array of cell centres.
+ * @param files The file in which each cell can be found.
+ * @param counts The (swift_type_count x nr_cells) particle counts.
+ * @param offsets The (swift_type_count x nr_cells) particle offsets.
+ * @param global_counts The total number of particles of each type.
+ * @param num_fields The number of fields written for each particle type.
+ */
+static void io_write_cell_index_group(
+    hid_t h_grp, const int cdim[3], const int nr_cells,
+    const double cell_width[3], const double* centres, const int* files,
+    const long long* counts, const long long* offsets,
+    const long long global_counts[swift_type_count],
+    const int num_fields[swift_type_count]) {
+
+  /* Write some meta-information first */
+  hid_t h_subgrp =
+      H5Gcreate(h_grp, "Meta-data", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  if (h_subgrp < 0) error("Error while creating meta-data sub-group");
+  io_write_attribute(h_subgrp, "nr_cells", INT, &nr_cells, 1);
+  io_write_attribute(h_subgrp, "size", DOUBLE, cell_width, 3);
+  io_write_attribute(h_subgrp, "dimension", INT, cdim, 3);
+  H5Gclose(h_subgrp);
+
+  /* Write the centres to the group */
+  hsize_t shape[2] = {(hsize_t)nr_cells, 3};
+  hid_t h_space = H5Screate(H5S_SIMPLE);
+  if (h_space < 0) error("Error while creating data space for cell centres");
+  hid_t h_err = H5Sset_extent_simple(h_space, 2, shape, shape);
+  if (h_err < 0) error("Error while changing shape of gas offsets data space.");
+  hid_t h_data = H5Dcreate(h_grp, "Centres", io_hdf5_type(DOUBLE), h_space,
+                           H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  if (h_data < 0) error("Error while creating dataspace for gas offsets.");
+  h_err = H5Dwrite(h_data, io_hdf5_type(DOUBLE), h_space, H5S_ALL, H5P_DEFAULT,
+                   centres);
+  if (h_err < 0) error("Error while writing centres.");
+  H5Dclose(h_data);
+  H5Sclose(h_space);
+
+  /* Group containing the offsets and counts for each particle type */
+  hid_t h_grp_offsets = H5Gcreate(h_grp, "OffsetsInFile", H5P_DEFAULT,
+                                  H5P_DEFAULT, H5P_DEFAULT);
+  if (h_grp_offsets < 0) error("Error while creating offsets sub-group");
+  hid_t h_grp_files =
+      H5Gcreate(h_grp, "Files", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  if (h_grp_files < 0) error("Error while creating filess sub-group");
+  hid_t h_grp_counts =
+      H5Gcreate(h_grp, "Counts", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  if (h_grp_counts < 0) error("Error while creating counts sub-group");
+
+  for (int ptype = 0; ptype < swift_type_count; ++ptype) {
+
+    if (global_counts[ptype] == 0 || num_fields[ptype] == 0) continue;
+
+    char name[32];
+    sprintf(name, "PartType%d", ptype);
+    io_write_array(h_grp_files, nr_cells, files, INT, name, "files");
+    io_write_array(h_grp_offsets, nr_cells, &offsets[ptype * nr_cells],
+                   LONGLONG, name, "offsets");
+    io_write_array(h_grp_counts, nr_cells, &counts[ptype * nr_cells], LONGLONG,
+                   name, "counts");
+  }
+
+  H5Gclose(h_grp_offsets);
+  H5Gclose(h_grp_files);
+  H5Gclose(h_grp_counts);
+}
+
+/**
+ * @brief Write the counts and offsets of the particles in each top-level
+ * cell.
+ *
+ * Every rank computes the offsets of its *local* cells itself, scanning its
+ * cells in index order from its global offsets (which the callers obtain
+ * from an MPI_Exscan of the particle counts), such that the prefix scan is
+ * done in parallel. The (cell, counts, offsets) records are packed into a
+ * single buffer which is only sent to the rank(s) writing the meta-data,
+ * where they are just scattered in place. The cell centres and files are
+ * known everywhere and are not communicated.
+ *
+ * @param h_grp The open hdf5 group (only used on the ranks writing).
+ * @param cdim The number of top-level cells along each axis.
+ * @param dim The dimensions of the simulation box.
+ * @param pos_dithering The dithering vector applied to the particles.
+ * @param cells_top The top-level cells.
+ * @param nr_cells The number of top-level cells.
+ * @param width The width of a top-level cell.
+ * @param nodeID This rank's ID.
+ * @param distributed Is every rank writing its own file?
+ * @param global_counts The total number of particles of each type.
+ * @param global_offsets The offset of this rank's particles in the file.
+ * @param num_fields The number of fields written for each particle type.
+ * @param internal_units The #unit_system used internally.
+ * @param snapshot_units The #unit_system used in the snapshots.
+ * @param index_fileName If not NULL, the name of a separate file in which to
+ * also write the cell index (on rank 0 only).
+ */
 void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
                            const double pos_dithering[3],
                            const struct cell* cells_top, const int nr_cells,
@@ -902,7 +1009,8 @@ void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
                            const long long global_offsets[swift_type_count],
                            const int num_fields[swift_type_count],
                            const struct unit_system* internal_units,
-                           const struct unit_system* snapshot_units) {
+                           const struct unit_system* snapshot_units,
+                           const char* index_fileName) {
 
 #ifdef SWIFT_DEBUG_CHECKS
   if (distributed) {
@@ -917,172 +1025,151 @@ void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
    */
   if (nr_cells == 0) return;
 
-  double cell_width[3] = {width[0], width[1], width[2]};
-
-  /* Temporary memory for the cell-by-cell information */
-  double* centres = NULL;
-  centres = (double*)malloc(3 * nr_cells * sizeof(double));
-
-  /* Temporary memory for the cell files ID */
-  int* files = NULL;
-  files = (int*)malloc(nr_cells * sizeof(int));
-
-  /* Count of particles in each cell */
-  long long *count_part = NULL, *count_gpart = NULL,
-            *count_background_gpart = NULL, *count_spart = NULL,
-            *count_bpart = NULL, *count_sink = NULL;
-  count_part = (long long*)malloc(nr_cells * sizeof(long long));
-  count_gpart = (long long*)malloc(nr_cells * sizeof(long long));
-  count_background_gpart = (long long*)malloc(nr_cells * sizeof(long long));
-  count_spart = (long long*)malloc(nr_cells * sizeof(long long));
-  count_bpart = (long long*)malloc(nr_cells * sizeof(long long));
-  count_sink = (long long*)malloc(nr_cells * sizeof(long long));
-
-  /* Global offsets of particles in each cell */
-  long long *offset_part = NULL, *offset_gpart = NULL,
-            *offset_background_gpart = NULL, *offset_spart = NULL,
-            *offset_bpart = NULL, *offset_sink = NULL;
-  offset_part = (long long*)malloc(nr_cells * sizeof(long long));
-  offset_gpart = (long long*)malloc(nr_cells * sizeof(long long));
-  offset_background_gpart = (long long*)malloc(nr_cells * sizeof(long long));
-  offset_spart = (long long*)malloc(nr_cells * sizeof(long long));
-  offset_bpart = (long long*)malloc(nr_cells * sizeof(long long));
-  offset_sink = (long long*)malloc(nr_cells * sizeof(long long));
-
-  /* Offsets of the 0^th element */
-  offset_part[0] = 0;
-  offset_gpart[0] = 0;
-  offset_background_gpart[0] = 0;
-  offset_spart[0] = 0;
-  offset_bpart[0] = 0;
-  offset_sink[0] = 0;
-
-  /* Collect the cell information of *local* cells */
-  long long local_offset_part = 0;
-  long long local_offset_gpart = 0;
-  long long local_offset_background_gpart = 0;
-  long long local_offset_spart = 0;
-  long long local_offset_bpart = 0;
-  long long local_offset_sink = 0;
-  for (int i = 0; i < nr_cells; ++i) {
+  /* Size of a record: the cell index followed by the counts and offsets of
+   * each type */
+  const int record_size = 2 * swift_type_count + 1;
 
-    /* Store in which file this cell will be found */
-    if (distributed) {
-      files[i] = cells_top[i].nodeID;
-    } else {
-      files[i] = 0;
-    }
+  /* When writing a single file, only rank 0 writes the meta-data */
+  const int is_writer = distributed || nodeID == 0;
 
-    /* Is the cell on this node (i.e. we have full information */
-    if (cells_top[i].nodeID == nodeID) {
-
-      /* Centre of each cell */
-      centres[i * 3 + 0] = cells_top[i].loc[0] + cell_width[0] * 0.5;
-      centres[i * 3 + 1] = cells_top[i].loc[1] + cell_width[1] * 0.5;
-      centres[i * 3 + 2] = cells_top[i].loc[2] + cell_width[2] * 0.5;
-
-      /* Undo the dithering since the particles will have this vector applied to
-       * them */
-      centres[i * 3 + 0] = centres[i * 3 + 0] - pos_dithering[0];
-      centres[i * 3 + 1] = centres[i * 3 + 1] - pos_dithering[1];
-      centres[i * 3 + 2] = centres[i * 3 + 2] - pos_dithering[2];
-
-      /* Finish by box wrapping to match what is done to the particles */
-      centres[i * 3 + 0] = box_wrap(centres[i * 3 + 0], 0.0, dim[0]);
-      centres[i * 3 + 1] = box_wrap(centres[i * 3 + 1], 0.0, dim[1]);
-      centres[i * 3 + 2] = box_wrap(centres[i * 3 + 2], 0.0, dim[2]);
-
-      /* Count real particles that will be written */
-      count_part[i] = cell_count_non_inhibited_gas(&cells_top[i]);
-      count_gpart[i] = cell_count_non_inhibited_dark_matter(&cells_top[i]);
-      count_background_gpart[i] =
-          cell_count_non_inhibited_background_dark_matter(&cells_top[i]);
-      count_spart[i] = cell_count_non_inhibited_stars(&cells_top[i]);
-      count_bpart[i] = cell_count_non_inhibited_black_holes(&cells_top[i]);
-      count_sink[i] = cell_count_non_inhibited_sinks(&cells_top[i]);
-
-      /* Offsets including the global offset of all particles on this MPI rank
-       * Note that in the distributed case, the global offsets are 0 such that
-       * we actually compute the offset in the file written by this rank. */
-      offset_part[i] = local_offset_part + global_offsets[swift_type_gas];
-      offset_gpart[i] =
-          local_offset_gpart + global_offsets[swift_type_dark_matter];
-      offset_background_gpart[i] =
-          local_offset_background_gpart +
-          global_offsets[swift_type_dark_matter_background];
-      offset_spart[i] = local_offset_spart + global_offsets[swift_type_stars];
-      offset_bpart[i] =
-          local_offset_bpart + global_offsets[swift_type_black_hole];
-      offset_sink[i] = local_offset_sink + global_offsets[swift_type_sink];
-
-      local_offset_part += count_part[i];
-      local_offset_gpart += count_gpart[i];
-      local_offset_background_gpart += count_background_gpart[i];
-      local_offset_spart += count_spart[i];
-      local_offset_bpart += count_bpart[i];
-      local_offset_sink += count_sink[i];
+  int nr_local_cells = 0;
+  for (int i = 0; i < nr_cells; ++i)
+    if (cells_top[i].nodeID == nodeID) ++nr_local_cells;
 
-    } else {
+  /* Pack the records of the *local* cells. The first record only carries the
+   * number of local cells. */
+  const int send_size = (nr_local_cells + 1) * record_size;
+  long long* send_buf = (long long*)calloc(send_size, sizeof(long long));
+  if (send_buf == NULL) error("Failed to allocate cell offsets send buffer");
+
+  send_buf[0] = nr_local_cells;
+
+  /* Our part of the prefix scan. The offsets include the global offset of
+   * all particles on this rank. Note that in the distributed case, the
+   * global offsets are 0 such that we actually compute the offset in the
+   * file written by this rank. */
+  long long offset[swift_type_count];
+  for (int ptype = 0; ptype < swift_type_count; ++ptype)
+    offset[ptype] = global_offsets[ptype];
+
+  long long* record = &send_buf[record_size];
+  for (int i = 0; i < nr_cells; ++i) {
 
-      /* Just zero everything for the foregin cells */
-
-      centres[i * 3 + 0] = 0.;
-      centres[i * 3 + 1] = 0.;
-      centres[i * 3 + 2] = 0.;
-
-      count_part[i] = 0;
-      count_gpart[i] = 0;
-      count_background_gpart[i] = 0;
-      count_spart[i] = 0;
-      count_bpart[i] = 0;
-      count_sink[i] = 0;
-
-      offset_part[i] = 0;
-      offset_gpart[i] = 0;
-      offset_background_gpart[i] = 0;
-      offset_spart[i] = 0;
-      offset_bpart[i] = 0;
-      offset_sink[i] = 0;
+    /* Is the cell on this node (i.e. we have full information */
+    if (cells_top[i].nodeID != nodeID) continue;
+
+    /* Count real particles that will be written */
+    const struct cell* c = &cells_top[i];
+    record[0] = i;
+    record[1 + swift_type_gas] = cell_count_non_inhibited_gas(c);
+    record[1 + swift_type_dark_matter] =
+        cell_count_non_inhibited_dark_matter(c);
+    record[1 + swift_type_dark_matter_background] =
+        cell_count_non_inhibited_background_dark_matter(c);
+    record[1 + swift_type_sink] = cell_count_non_inhibited_sinks(c);
+    record[1 + swift_type_stars] = cell_count_non_inhibited_stars(c);
+    record[1 + swift_type_black_hole] = cell_count_non_inhibited_black_holes(c);
+    for (int ptype = 0; ptype < swift_type_count; ++ptype) {
+      record[1 + swift_type_count + ptype] = offset[ptype];
+      offset[ptype] += record[1 + ptype];
     }
+    record += record_size;
   }
 
 #ifdef WITH_MPI
-  /* Now, reduce all the arrays. Note that we use a bit-wise OR here. This
-     is safe as we made sure only local cells have non-zero values. */
-  MPI_Allreduce(MPI_IN_PLACE, count_part, nr_cells, MPI_LONG_LONG_INT, MPI_BOR,
-                MPI_COMM_WORLD);
-  MPI_Allreduce(MPI_IN_PLACE, count_gpart, nr_cells, MPI_LONG_LONG_INT, MPI_BOR,
-                MPI_COMM_WORLD);
-  MPI_Allreduce(MPI_IN_PLACE, count_background_gpart, nr_cells,
-                MPI_LONG_LONG_INT, MPI_BOR, MPI_COMM_WORLD);
-  MPI_Allreduce(MPI_IN_PLACE, count_sink, nr_cells, MPI_LONG_LONG_INT, MPI_BOR,
-                MPI_COMM_WORLD);
-  MPI_Allreduce(MPI_IN_PLACE, count_spart, nr_cells, MPI_LONG_LONG_INT, MPI_BOR,
-                MPI_COMM_WORLD);
-  MPI_Allreduce(MPI_IN_PLACE, count_bpart, nr_cells, MPI_LONG_LONG_INT, MPI_BOR,
-                MPI_COMM_WORLD);
-
-  MPI_Allreduce(MPI_IN_PLACE, offset_part, nr_cells, MPI_LONG_LONG_INT, MPI_BOR,
-                MPI_COMM_WORLD);
-  MPI_Allreduce(MPI_IN_PLACE, offset_gpart, nr_cells, MPI_LONG_LONG_INT,
-                MPI_BOR, MPI_COMM_WORLD);
-  MPI_Allreduce(MPI_IN_PLACE, offset_background_gpart, nr_cells,
-                MPI_LONG_LONG_INT, MPI_BOR, MPI_COMM_WORLD);
-  MPI_Allreduce(MPI_IN_PLACE, offset_sink, nr_cells, MPI_LONG_LONG_INT, MPI_BOR,
-                MPI_COMM_WORLD);
-  MPI_Allreduce(MPI_IN_PLACE, offset_spart, nr_cells, MPI_LONG_LONG_INT,
-                MPI_BOR, MPI_COMM_WORLD);
-  MPI_Allreduce(MPI_IN_PLACE, offset_bpart, nr_cells, MPI_LONG_LONG_INT,
-                MPI_BOR, MPI_COMM_WORLD);
-
-  /* For the centres we use a sum as MPI does not like bit-wise operations
-     on floating point numbers */
-  MPI_Allreduce(MPI_IN_PLACE, centres, 3 * nr_cells, MPI_DOUBLE, MPI_SUM,
-                MPI_COMM_WORLD);
+  int nr_nodes = 1;
+  MPI_Comm_size(MPI_COMM_WORLD, &nr_nodes);
+
+  /* Gather the size of every rank's buffer on the writers */
+  int* recv_sizes = NULL;
+  int* recv_displs = NULL;
+  if (is_writer) {
+    recv_sizes = (int*)malloc(nr_nodes * sizeof(int));
+    recv_displs = (int*)malloc(nr_nodes * sizeof(int));
+    if (recv_sizes == NULL || recv_displs == NULL)
+      error("Failed to allocate cell offsets receive counts");
+  }
+  if (distributed)
+    MPI_Allgather(&send_size, 1, MPI_INT, recv_sizes, 1, MPI_INT,
+                  MPI_COMM_WORLD);
+  else
+    MPI_Gather(&send_size, 1, MPI_INT, recv_sizes, 1, MPI_INT, 0,
+               MPI_COMM_WORLD);
+
+  long long* recv_buf = NULL;
+  if (is_writer) {
+    size_t recv_total = 0;
+    for (int r = 0; r < nr_nodes; ++r) {
+      recv_displs[r] = recv_total;
+      recv_total += recv_sizes[r];
+    }
+    recv_buf = (long long*)malloc(recv_total * sizeof(long long));
+    if (recv_buf == NULL)
+      error("Failed to allocate cell offsets receive buffer");
+  }
+
+  /* Now send all the records in one go */
+  if (distributed)
+    MPI_Allgatherv(send_buf, send_size, MPI_LONG_LONG_INT, recv_buf,
+                   recv_sizes, recv_displs, MPI_LONG_LONG_INT, MPI_COMM_WORLD);
+  else
+    MPI_Gatherv(send_buf, send_size, MPI_LONG_LONG_INT, recv_buf, recv_sizes,
+                recv_displs, MPI_LONG_LONG_INT, 0, MPI_COMM_WORLD);
+
+  free(send_buf);
+  free(recv_sizes);
+  free(recv_displs);
+#else
+  const int nr_nodes = 1;
+  long long* recv_buf = send_buf;
 #endif
 
-  /* When writing a single file, only rank 0 writes the meta-data */
-  if ((distributed) || (!distributed && nodeID == 0)) {
+  if (is_writer) {
+
+    double cell_width[3] = {width[0], width[1], width[2]};
+
+    /* Temporary memory for the cell-by-cell information */
+    double* centres = (double*)malloc(3 * nr_cells * sizeof(double));
+    int* files = (int*)malloc(nr_cells * sizeof(int));
+    long long* counts = (long long*)calloc(swift_type_count * (size_t)nr_cells,
+                                           sizeof(long long));
+    long long* offsets = (long long*)calloc(swift_type_count * (size_t)nr_cells,
+                                            sizeof(long long));
+    if (centres == NULL || files == NULL || counts == NULL || offsets == NULL)
+      error("Failed to allocate cell offsets arrays");
+
+    for (int i = 0; i < nr_cells; ++i) {
+
+      /* Store in which file this cell will be found */
+      files[i] = distributed ? cells_top[i].nodeID : 0;
+
+      /* Centre of each cell, undoing the dithering since the particles will
+       * have this vector applied to them */
+      for (int k = 0; k < 3; ++k) {
+        const double centre =
+            cells_top[i].loc[k] + cell_width[k] * 0.5 - pos_dithering[k];
+
+        /* Finish by box wrapping to match what is done to the particles */
+        centres[i * 3 + k] = box_wrap(centre, 0.0, dim[k]);
+      }
+    }
+
+    /* Scatter the records of each rank in place */
+    const long long* rec = recv_buf;
+    for (int r = 0; r < nr_nodes; ++r) {
+
+      const long long count = rec[0];
+      rec += record_size;
+
+      for (long long j = 0; j < count; ++j) {
+        const size_t cid = rec[0];
+        for (int ptype = 0; ptype < swift_type_count; ++ptype) {
+          counts[ptype * nr_cells + cid] = rec[1 + ptype];
+          offsets[ptype * nr_cells + cid] = rec[1 + swift_type_count + ptype];
+        }
+        rec += record_size;
+      }
+    }
 
     /* Unit conversion if necessary */
     const double factor = units_conversion_factor(
@@ -1090,11 +1177,7 @@ void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
     if (factor != 1.) {
 
       /* Convert the cell centres */
-      for (int i = 0; i < nr_cells; ++i) {
-        centres[i * 3 + 0] *= factor;
-        centres[i * 3 + 1] *= factor;
-        centres[i * 3 + 2] *= factor;
-      }
+      for (int i = 0; i < 3 * nr_cells; ++i) centres[i] *= factor;
 
       /* Convert the cell widths */
       cell_width[0] *= factor;
@@ -1102,114 +1185,37 @@ void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
       cell_width[2] *= factor;
     }
 
-    /* Write some meta-information first */
-    hid_t h_subgrp =
-        H5Gcreate(h_grp, "Meta-data", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    if (h_subgrp < 0) error("Error while creating meta-data sub-group");
-    io_write_attribute(h_subgrp, "nr_cells", INT, &nr_cells, 1);
-    io_write_attribute(h_subgrp, "size", DOUBLE, cell_width, 3);
-    io_write_attribute(h_subgrp, "dimension", INT, cdim, 3);
-    H5Gclose(h_subgrp);
-
-    /* Write the centres to the group */
-    hsize_t shape[2] = {(hsize_t)nr_cells, 3};
-    hid_t h_space = H5Screate(H5S_SIMPLE);
-    if (h_space < 0) error("Error while creating data space for cell centres");
-    hid_t h_err = H5Sset_extent_simple(h_space, 2, shape, shape);
-    if (h_err < 0)
-      error("Error while changing shape of gas offsets data space.");
-    hid_t h_data = H5Dcreate(h_grp, "Centres", io_hdf5_type(DOUBLE), h_space,
-                             H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    if (h_data < 0) error("Error while creating dataspace for gas offsets.");
-    h_err = H5Dwrite(h_data, io_hdf5_type(DOUBLE), h_space, H5S_ALL,
-                     H5P_DEFAULT, centres);
-    if (h_err < 0) error("Error while writing centres.");
-    H5Dclose(h_data);
-    H5Sclose(h_space);
-
-    /* Group containing the offsets and counts for each particle type */
-    hid_t h_grp_offsets = H5Gcreate(h_grp, "OffsetsInFile", H5P_DEFAULT,
-                                    H5P_DEFAULT, H5P_DEFAULT);
-    if (h_grp_offsets < 0) error("Error while creating offsets sub-group");
-    hid_t h_grp_files =
-        H5Gcreate(h_grp, "Files", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    if (h_grp_files < 0) error("Error while creating filess sub-group");
-    hid_t h_grp_counts =
-        H5Gcreate(h_grp, "Counts", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    if (h_grp_counts < 0) error("Error while creating counts sub-group");
-
-    if (global_counts[swift_type_gas] > 0 && num_fields[swift_type_gas] > 0) {
-      io_write_array(h_grp_files, nr_cells, files, INT, "PartType0", "files");
-      io_write_array(h_grp_offsets, nr_cells, offset_part, LONGLONG,
-                     "PartType0", "offsets");
-      io_write_array(h_grp_counts, nr_cells, count_part, LONGLONG, "PartType0",
-                     "counts");
-    }
-
-    if (global_counts[swift_type_dark_matter] > 0 &&
-        num_fields[swift_type_dark_matter] > 0) {
-      io_write_array(h_grp_files, nr_cells, files, INT, "PartType1", "files");
-      io_write_array(h_grp_offsets, nr_cells, offset_gpart, LONGLONG,
-                     "PartType1", "offsets");
-      io_write_array(h_grp_counts, nr_cells, count_gpart, LONGLONG, "PartType1",
-                     "counts");
-    }
-
-    if (global_counts[swift_type_dark_matter_background] > 0 &&
-        num_fields[swift_type_dark_matter_background] > 0) {
-      io_write_array(h_grp_files, nr_cells, files, INT, "PartType2", "files");
-      io_write_array(h_grp_offsets, nr_cells, offset_background_gpart, LONGLONG,
-                     "PartType2", "offsets");
-      io_write_array(h_grp_counts, nr_cells, count_background_gpart, LONGLONG,
-                     "PartType2", "counts");
-    }
-
-    if (global_counts[swift_type_sink] > 0 && num_fields[swift_type_sink] > 0) {
-      io_write_array(h_grp_files, nr_cells, files, INT, "PartType3", "files");
-      io_write_array(h_grp_offsets, nr_cells, offset_sink, LONGLONG,
-                     "PartType3", "offsets");
-      io_write_array(h_grp_counts, nr_cells, count_sink, LONGLONG, "PartType3",
-                     "counts");
-    }
-
-    if (global_counts[swift_type_stars] > 0 &&
-        num_fields[swift_type_stars] > 0) {
-      io_write_array(h_grp_files, nr_cells, files, INT, "PartType4", "files");
-      io_write_array(h_grp_offsets, nr_cells, offset_spart, LONGLONG,
-                     "PartType4", "offsets");
-      io_write_array(h_grp_counts, nr_cells, count_spart, LONGLONG, "PartType4",
-                     "counts");
-    }
-
-    if (global_counts[swift_type_black_hole] > 0 &&
-        num_fields[swift_type_black_hole] > 0) {
-      io_write_array(h_grp_files, nr_cells, files, INT, "PartType5", "files");
-      io_write_array(h_grp_offsets, nr_cells, offset_bpart, LONGLONG,
-                     "PartType5", "offsets");
-      io_write_array(h_grp_counts, nr_cells, count_bpart, LONGLONG, "PartType5",
-                     "counts");
+    io_write_cell_index_group(h_grp, cdim, nr_cells, cell_width, centres,
+                              files, counts, offsets, global_counts,
+                              num_fields);
+
+    /* Also write the index on its own so that it can be read without
+     * opening the snapshot */
+    if (index_fileName != NULL && nodeID == 0) {
+
+      hid_t h_file =
+          H5Fcreate(index_fileName, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+      if (h_file < 0)
+        error("Error while opening file '%s'.", index_fileName);
+
+      hid_t h_grp_index =
+          H5Gcreate(h_file, "/Cells", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      if (h_grp_index < 0) error("Error while creating cells group");
+      io_write_cell_index_group(h_grp_index, cdim, nr_cells, cell_width,
+                                centres, files, counts, offsets, global_counts,
+                                num_fields);
+      H5Gclose(h_grp_index);
+      H5Fclose(h_file);
     }
 
-    H5Gclose(h_grp_offsets);
-    H5Gclose(h_grp_files);
-    H5Gclose(h_grp_counts);
+    /* Free everything we allocated */
+    free(centres);
+    free(files);
+    free(counts);
+    free(offsets);
   }
 
-  /* Free everything we allocated */
-  free(centres);
-  free(files);
-  free(count_part);
-  free(count_gpart);
-  free(count_background_gpart);
-  free(count_spart);
-  free(count_bpart);
-  free(count_sink);
-  free(offset_part);
-  free(offset_gpart);
-  free(offset_background_gpart);
-  free(offset_spart);
-  free(offset_bpart);
-  free(offset_sink);
+  free(recv_buf);
 }
 
 #endif /* HAVE_HDF5 */
@@ -1972,6 +1978,390 @@ void io_copy_temp_buffer(void* temp, const struct engine* e,
   }
 }
 
+/**
+ * @brief Convert the particle data of a field and write it to an HDF5
+ * dataset.
+ *
+ * The data are normally converted in a single temporary buffer holding the
+ * whole field. If that buffer would not fit in the memory budget, the field
+ * is instead converted and written in slabs of particles, using a smaller
+ * buffer.
+ *
+ * @param e The #engine.
+ * @param h_data The HDF5 dataset to write to.
+ * @param h_space The data space of the whole dataset.
+ * @param props The #io_props of the field to write.
+ * @param N The number of particles to write.
+ * @param lossy_level The #compression_levels to apply to the data.
+ * @param internal_units The system of units used internally.
+ * @param snapshot_units The system of units used for the snapshots.
+ */
+void io_write_array_buffered(const struct engine* e, hid_t h_data,
+                             hid_t h_space, struct io_props props, size_t N,
+                             const enum compression_levels lossy_level,
+                             const struct unit_system* internal_units,
+                             const struct unit_system* snapshot_units) {
+
+  const size_t copySize = io_sizeof_type(props.type) * props.dimension;
+  const hid_t h_type = io_hdf5_type(props.type);
+
+  /* How many particles can we afford to convert at once? */
+  size_t slab_size = N;
+  if (!memuse_budget_allows(N * copySize)) {
+    slab_size = max(memuse_budget_available() / copySize,
+                    (size_t)IO_BUFFER_MIN_SLAB_SIZE);
+    slab_size = min(slab_size, N);
+  }
+
+  /* Allocate temporary buffer */
+  void* temp = NULL;
+  if (swift_memalign("writebuff", (void**)&temp, IO_BUFFER_ALIGNMENT,
+                     slab_size * copySize) != 0)
+    error("Unable to allocate temporary i/o buffer");
+
+  if (slab_size == N) {
+
+    /* Copy the particle data to the temporary buffer */
+    io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
+    io_compression_apply(e->output_options, temp, &props, N, lossy_level);
+
+    /* Write temporary buffer to HDF5 dataspace */
+    if (H5Dwrite(h_data, h_type, h_space, H5S_ALL, H5P_DEFAULT, temp) < 0)
+      error("Error while writing data array '%s'.", props.name);
+
+  } else {
+
+    if (e->verbose)
+      message("Writing '%s' in slabs of %zu particles to fit in the memory "
+              "budget.",
+              props.name, slab_size);
+
+    const int rank = (props.dimension > 1) ? 2 : 1;
+    for (size_t offset = 0; offset < N; offset += slab_size) {
+
+      const size_t count = min(slab_size, N - offset);
+      io_copy_temp_buffer(temp, e, props, count, internal_units,
+                          snapshot_units);
+      io_compression_apply(e->output_options, temp, &props, count, lossy_level);
+
+      /* Select the part of the file this slab goes to */
+      const hsize_t slab_start[2] = {offset, 0};
+      const hsize_t slab_shape[2] = {count, (hsize_t)props.dimension};
+      const hid_t h_memspace = H5Screate_simple(rank, slab_shape, NULL);
+      if (h_memspace < 0)
+        error("Error while creating memory space for field '%s'.",
+              props.name);
+      if (H5Sselect_hyperslab(h_space, H5S_SELECT_SET, slab_start, NULL,
+                              slab_shape, NULL) < 0)
+        error("Error while selecting slab of field '%s'.", props.name);
+
+      if (H5Dwrite(h_data, h_type, h_memspace, h_space, H5P_DEFAULT, temp) <
+          0)
+        error("Error while writing data array '%s'.", props.name);
+      H5Sclose(h_memspace);
+
+      /* Move on to the next slab of particles */
+      props.field += count * props.partSize;
+      props.parts += count;
+      props.xparts += count;
+      props.gparts += count;
+      props.sparts += count;
+      props.bparts += count;
+      props.sinks += count;
+    }
+
+    /* Leave the data space as we found it */
+    H5Sselect_all(h_space);
+  }
+
+  swift_free("writebuff", temp);
+}
+
+/**
+ * @brief Data needed to convert a buffer of values read from the ICs and
+ * scatter it into the particles.
+ */
+struct io_read_convert_data {
+
+  /*! The field we read, pointing at the first particle of the buffer */
+  struct io_props props;
+
+  /*! The buffer of values read from the file */
+  const char* temp;
+
+  /*! Size of the values of one particle in the buffer */
+  size_t copySize;
+
+  /*! Unit conversion factor */
+  double factor;
+
+  /*! h-factor clean-up */
+  double h_factor;
+
+  /*! sqrt(a) clean-up of the Gadget velocities */
+  double a_factor;
+};
+
+/**
+ * @brief Prepare the conversion of a buffer of values read from the ICs.
+ *
+ * @param data The #io_read_convert_data to fill.
+ * @param temp The buffer of values read from the file.
+ * @param props The #io_props of the field, pointing at the first particle of
+ * the buffer.
+ * @param internal_units The #unit_system used internally.
+ * @param ic_units The #unit_system used in the ICs.
+ * @param cleanup_h Are we removing h-factors from the ICs?
+ * @param cleanup_sqrt_a Are we cleaning-up the sqrt(a) factors in the Gadget
+ * IC velocities?
+ * @param h The value of the reduced Hubble constant to use for cleaning.
+ * @param a The current value of the scale-factor.
+ */
+static void io_prepare_read_conversion(
+    struct io_read_convert_data* data, const void* temp,
+    const struct io_props props, const struct unit_system* internal_units,
+    const struct unit_system* ic_units, int cleanup_h, int cleanup_sqrt_a,
+    double h, double a) {
+
+  data->props = props;
+  data->temp = (const char*)temp;
+  data->copySize = io_sizeof_type(props.type) * props.dimension;
+
+  data->factor = units_conversion_factor(ic_units, internal_units, props.units);
+
+  const float h_factor_exp = units_h_factor(internal_units, props.units);
+  if (cleanup_h && h_factor_exp != 0.f)
+    data->h_factor = pow(h, h_factor_exp);
+  else
+    data->h_factor = 1.;
+
+  if (cleanup_sqrt_a && a != 1. && (strcmp(props.name, "Velocities") == 0))
+    data->a_factor = sqrt(a);
+  else
+    data->a_factor = 1.;
+}
+
+/**
+ * @brief Mapper function converting the values read from the ICs and copying
+ * them into the particles.
+ *
+ * @param map_data The chunk of the buffer of values read.
+ * @param N The number of particles in the chunk.
+ * @param extra_data The #io_read_convert_data.
+ */
+void io_read_convert_mapper(void* map_data, int N, void* extra_data) {
+
+  const struct io_read_convert_data* data =
+      (const struct io_read_convert_data*)extra_data;
+  const struct io_props* props = &data->props;
+  const size_t copySize = data->copySize;
+  const size_t num_elements = (size_t)N * props->dimension;
+  const size_t offset = ((char*)map_data - data->temp) / copySize;
+
+  /* Unit conversion if necessary */
+  const double factor = data->factor;
+  if (factor != 1.) {
+
+    if (io_is_double_precision(props->type)) {
+      double* temp_d = (double*)map_data;
+      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= factor;
+    } else {
+      float* temp_f = (float*)map_data;
+
+#ifdef SWIFT_DEBUG_CHECKS
+      float maximum = 0.f;
+      float minimum = FLT_MAX;
+#endif
+
+      /* Loop that converts the Units */
+      for (size_t i = 0; i < num_elements; ++i) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+        /* Find the absolute minimum and maximum values */
+        const float abstemp_f = fabsf(temp_f[i]);
+        if (abstemp_f != 0.f) {
+          maximum = max(maximum, abstemp_f);
+          minimum = min(minimum, abstemp_f);
+        }
+#endif
+
+        /* Convert the float units */
+        temp_f[i] *= factor;
+      }
+
+#ifdef SWIFT_DEBUG_CHECKS
+      /* The two possible errors: larger than float or smaller
+       * than float precision. */
+      if (factor * maximum > FLT_MAX) {
+        error("Unit conversion results in numbers larger than floats");
+      } else if (factor * minimum < FLT_MIN) {
+        error("Numbers smaller than float precision");
+      }
+#endif
+    }
+  }
+
+  /* Clean-up h if necessary */
+  if (data->h_factor != 1.) {
+
+    if (io_is_double_precision(props->type)) {
+      double* temp_d = (double*)map_data;
+      const double h_factor = data->h_factor;
+      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= h_factor;
+    } else {
+      float* temp_f = (float*)map_data;
+      const float h_factor = data->h_factor;
+      for (size_t i = 0; i < num_elements; ++i) temp_f[i] *= h_factor;
+    }
+  }
+
+  /* Clean-up a if necessary */
+  if (data->a_factor != 1.) {
+
+    if (io_is_double_precision(props->type)) {
+      double* temp_d = (double*)map_data;
+      const double vel_factor = data->a_factor;
+      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= vel_factor;
+    } else {
+      float* temp_f = (float*)map_data;
+      const float vel_factor = data->a_factor;
+      for (size_t i = 0; i < num_elements; ++i) temp_f[i] *= vel_factor;
+    }
+  }
+
+  /* Copy temporary buffer to particle data */
+  const char* temp_c = (const char*)map_data;
+  for (int i = 0; i < N; ++i)
+    memcpy(props->field + (offset + i) * props->partSize, &temp_c[i * copySize],
+           copySize);
+}
+
+/**
+ * @brief Convert a buffer of values read from the ICs and copy them into the
+ * particles using the threads of a #threadpool.
+ *
+ * The content of the buffer is converted in place.
+ *
+ * @param tp The #threadpool to use.
+ * @param temp The buffer of values read from the file.
+ * @param props The #io_props of the field to read.
+ * @param N The number of particles in the buffer.
+ * @param internal_units The #unit_system used internally.
+ * @param ic_units The #unit_system used in the ICs.
+ * @param cleanup_h Are we removing h-factors from the ICs?
+ * @param cleanup_sqrt_a Are we cleaning-up the sqrt(a) factors in the Gadget
+ * IC velocities?
+ * @param h The value of the reduced Hubble constant to use for cleaning.
+ * @param a The current value of the scale-factor.
+ */
+void io_convert_read_buffer(struct threadpool* tp, void* temp,
+                            const struct io_props props, size_t N,
+                            const struct unit_system* internal_units,
+                            const struct unit_system* ic_units, int cleanup_h,
+                            int cleanup_sqrt_a, double h, double a) {
+
+  struct io_read_convert_data data;
+  io_prepare_read_conversion(&data, temp, props, internal_units, ic_units,
+                             cleanup_h, cleanup_sqrt_a, h, a);
+
+  threadpool_map(tp, io_read_convert_mapper, temp, N, data.copySize,
+                 threadpool_auto_chunk_size, &data);
+}
+
+/**
+ * @brief Read a range of particles of a dataset in slabs, converting and
+ * copying each slab into the particles while the next one is being read.
+ *
+ * The slabs are read (and decompressed) by the calling thread, while the
+ * other threads of the #threadpool convert the units of the previous slab
+ * and scatter it into the particle structures. Only two buffers of at most
+ * #IO_READ_SLAB_BYTES are needed, whatever the size of the dataset.
+ *
+ * @param tp The #threadpool to use.
+ * @param h_data The HDF5 dataset to read from.
+ * @param props The #io_props of the field to read.
+ * @param N The number of particles to read.
+ * @param offset The index in the dataset of the first particle to read.
+ * @param internal_units The #unit_system used internally.
+ * @param ic_units The #unit_system used in the ICs.
+ * @param cleanup_h Are we removing h-factors from the ICs?
+ * @param cleanup_sqrt_a Are we cleaning-up the sqrt(a) factors in the Gadget
+ * IC velocities?
+ * @param h The value of the reduced Hubble constant to use for cleaning.
+ * @param a The current value of the scale-factor.
+ */
+void io_read_array_slabs(struct threadpool* tp, hid_t h_data,
+                         struct io_props props, size_t N, long long offset,
+                         const struct unit_system* internal_units,
+                         const struct unit_system* ic_units, int cleanup_h,
+                         int cleanup_sqrt_a, double h, double a) {
+
+  if (N == 0) return;
+
+  const size_t copySize = io_sizeof_type(props.type) * props.dimension;
+  const hid_t h_type = io_hdf5_type(props.type);
+  const int rank = (props.dimension > 1) ? 2 : 1;
+
+  /* How many particles do we read at once? */
+  size_t slab_size = max((size_t)IO_READ_SLAB_BYTES / copySize, (size_t)1);
+  slab_size = min(slab_size, N);
+
+  /* Allocate the two buffers we alternate between */
+  void* temp[2] = {NULL, NULL};
+  for (int i = 0; i < 2; i++)
+    if (swift_memalign("readbuff", (void**)&temp[i], IO_BUFFER_ALIGNMENT,
+                       slab_size * copySize) != 0)
+      error("Unable to allocate temporary i/o buffer");
+
+  struct io_read_convert_data convert_data[2];
+
+  const hid_t h_filespace = H5Dget_space(h_data);
+  if (h_filespace < 0)
+    error("Error while getting data space of field '%s'.", props.name);
+
+  int k = 0;
+  for (size_t done = 0; done < N; done += slab_size, k = !k) {
+
+    const size_t count = min(slab_size, N - done);
+
+    /* Select the part of the file this slab comes from */
+    const hsize_t slab_start[2] = {offset + done, 0};
+    const hsize_t slab_shape[2] = {count, (hsize_t)props.dimension};
+    const hid_t h_memspace = H5Screate_simple(rank, slab_shape, NULL);
+    if (h_memspace < 0)
+      error("Error while creating memory space for field '%s'.", props.name);
+    if (H5Sselect_hyperslab(h_filespace, H5S_SELECT_SET, slab_start, NULL,
+                            slab_shape, NULL) < 0)
+      error("Error while selecting slab of field '%s'.", props.name);
+
+    /* Read this slab whilst the previous one is being converted */
+    if (H5Dread(h_data, h_type, h_memspace, h_filespace, H5P_DEFAULT,
+                temp[k]) < 0)
+      error("Error while reading data array '%s'.", props.name);
+    H5Sclose(h_memspace);
+
+    /* The previous slab must be done before its buffer gets read into */
+    threadpool_wait(tp, NULL);
+
+    /* Convert this slab and scatter it into the particles */
+    io_prepare_read_conversion(&convert_data[k], temp[k], props,
+                               internal_units, ic_units, cleanup_h,
+                               cleanup_sqrt_a, h, a);
+    threadpool_map_async(tp, io_read_convert_mapper, temp[k], count, copySize,
+                         threadpool_auto_chunk_size, &convert_data[k],
+                         /*after=*/NULL);
+
+    /* Move on to the next slab of particles */
+    props.field += count * props.partSize;
+  }
+
+  /* Wait for the last slab */
+  threadpool_wait(tp, NULL);
+
+  H5Sclose(h_filespace);
+  for (int i = 0; i < 2; i++) swift_free("readbuff", temp[i]);
+}
+
 void io_prepare_dm_gparts_mapper(void* restrict data, int Ndm, void* dummy) {
 
   struct gpart* restrict gparts = (struct gpart*)data;
@@ -2828,6 +3218,27 @@ void io_get_snapshot_filename(char filename[1024], char xmf_filename[1024],
   }
 }
 
+/**
+ * @brief Return the name of the file holding the top-level cell index of a
+ * snapshot.
+ *
+ * The ".hdf5" extension of the snapshot name (if any) is replaced by
+ * ".cells.hdf5".
+ *
+ * @param filename (return) The name of the cell index file.
+ * @param snapshot_name The name of the snapshot file or directory.
+ */
+void io_get_cell_index_filename(char filename[1024],
+                                const char* snapshot_name) {
+
+  size_t len = strlen(snapshot_name);
+  const size_t ext_len = strlen(".hdf5");
+  if (len >= ext_len && strcmp(snapshot_name + len - ext_len, ".hdf5") == 0)
+    len -= ext_len;
+
+  snprintf(filename, 1024, "%.*s.cells.hdf5", (int)len, snapshot_name);
+}
+
 /**
  * @brief Return the number and names of all output fields of a given ptype.
  *
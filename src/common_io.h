@@ -24,6 +24,7 @@
 #include "config.h"
 
 /* Local includes. */
+#include "io_compression.h"
 #include "part_type.h"
 
 #define FIELD_BUFFER_SIZE 64
@@ -32,6 +33,13 @@
 #define FILENAME_BUFFER_SIZE 150
 #define IO_BUFFER_ALIGNMENT 1024
 
+/* Smallest number of particles converted at once when writing a field in
+ * slabs to stay within the memory budget */
+#define IO_BUFFER_MIN_SLAB_SIZE (1 << 16)
+
+/* Size in bytes of the slabs of a field read at once from the ICs */
+#define IO_READ_SLAB_BYTES (1 << 25)
+
 /* Avoid cyclic inclusion problems */
 struct cell;
 struct part;
@@ -111,7 +119,8 @@ void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
                            const long long global_offsets[swift_type_count],
                            const int num_fields[swift_type_count],
                            const struct unit_system* internal_units,
-                           const struct unit_system* snapshot_units);
+                           const struct unit_system* snapshot_units,
+                           const char* index_fileName);
 
 void io_read_unit_system(hid_t h_file, struct unit_system* ic_units,
                          const struct unit_system* internal_units,
@@ -123,6 +132,21 @@ void io_copy_temp_buffer(void* temp, const struct engine* e,
                          const struct io_props props, size_t N,
                          const struct unit_system* internal_units,
                          const struct unit_system* snapshot_units);
+void io_write_array_buffered(const struct engine* e, hid_t h_data,
+                             hid_t h_space, struct io_props props, size_t N,
+                             const enum compression_levels lossy_level,
+                             const struct unit_system* internal_units,
+                             const struct unit_system* snapshot_units);
+void io_convert_read_buffer(struct threadpool* tp, void* temp,
+                            const struct io_props props, size_t N,
+                            const struct unit_system* internal_units,
+                            const struct unit_system* ic_units, int cleanup_h,
+                            int cleanup_sqrt_a, double h, double a);
+void io_read_array_slabs(struct threadpool* tp, hid_t h_data,
+                         struct io_props props, size_t N, long long offset,
+                         const struct unit_system* internal_units,
+                         const struct unit_system* ic_units, int cleanup_h,
+                         int cleanup_sqrt_a, double h, double a);
 
 #endif /* HAVE_HDF5 */
 
@@ -193,6 +217,8 @@ void io_get_snapshot_filename(char filename[1024], char xmf_filename[1024],
                               const int snapshots_invoke_stf, const double time,
                               const int stf_count, const int snap_count,
                               const char* subdir, const char* basename);
+void io_get_cell_index_filename(char filename[1024],
+                                const char* snapshot_name);
 
 int get_ptype_fields(const int ptype, struct io_props* list,
                      const int with_cosmology, const int with_fof,
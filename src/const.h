@@ -46,6 +46,14 @@
 /* Use the total energy instead of the thermal energy as conserved variable. */
 //#define GIZMO_TOTAL_ENERGY
 
+/* Queue the Riemann problems of the flux exchanges in a per-runner buffer and
+   solve them in batches (vectorized for the HLLC solver). */
+//#define GIZMO_BATCHED_RIEMANN
+#if defined(GIZMO_BATCHED_RIEMANN) && !defined(GIZMO_MFV_SPH) && \
+    !defined(GIZMO_MFM_SPH)
+#undef GIZMO_BATCHED_RIEMANN
+#endif
+
 /* Options to control handling of unphysical values (GIZMO_SPH only). */
 /* In GIZMO, mass and energy (and hence density and pressure) can in principle
    become negative, which will cause unwanted behaviour that can make the code
@@ -27,6 +27,7 @@
 
 /* Some standard headers */
 #include <math.h>
+#include <string.h>
 
 /* Local headers */
 #include "adiabatic_index.h"
@@ -155,6 +156,62 @@ double cosmology_get_time_since_big_bang(const struct cosmology *c, double a) {
   return c->time_interp_table_offset + delta_t;
 }
 
+/**
+ * @brief Tabulate the kick factors of the half-steps starting or ending at
+ * the current time for all the time-bins.
+ *
+ * All the particles of a given time-bin kicked at a given time share the same
+ * factors. The kick tasks can hence look them up instead of interpolating
+ * the integrals for every particle.
+ *
+ * Bins that cannot start (end) a step at this time get zero factors.
+ *
+ * @param c The #cosmology structure.
+ * @param ti_current The current point on the integer time-line.
+ */
+static void cosmology_update_kick_factors(struct cosmology *c,
+                                          const integertime_t ti_current) {
+
+  bzero(c->kick1_factors, sizeof(c->kick1_factors));
+  bzero(c->kick2_factors, sizeof(c->kick2_factors));
+  c->ti_kick_factors = ti_current;
+
+  for (timebin_t bin = 1; bin < num_time_bins; ++bin) {
+
+    const integertime_t ti_step = get_integer_timestep(bin);
+    const integertime_t ti_half = ti_step / 2;
+
+    /* Is the current time the boundary of a step of this bin? */
+    if (ti_current % ti_step != 0) continue;
+
+    /* First half of a step starting now */
+    if (ti_current + ti_step <= max_nr_timesteps) {
+      struct cosmology_kick_factors *k = &c->kick1_factors[bin];
+      k->hydro = cosmology_get_hydro_kick_factor(c, ti_current,
+                                                 ti_current + ti_half);
+      k->grav =
+          cosmology_get_grav_kick_factor(c, ti_current, ti_current + ti_half);
+      k->therm = cosmology_get_therm_kick_factor(c, ti_current,
+                                                 ti_current + ti_half);
+      k->corr =
+          cosmology_get_corr_kick_factor(c, ti_current, ti_current + ti_half);
+    }
+
+    /* Second half of a step ending now */
+    if (ti_current >= ti_step) {
+      struct cosmology_kick_factors *k = &c->kick2_factors[bin];
+      k->hydro = cosmology_get_hydro_kick_factor(c, ti_current - ti_half,
+                                                 ti_current);
+      k->grav =
+          cosmology_get_grav_kick_factor(c, ti_current - ti_half, ti_current);
+      k->therm = cosmology_get_therm_kick_factor(c, ti_current - ti_half,
+                                                 ti_current);
+      k->corr =
+          cosmology_get_corr_kick_factor(c, ti_current - ti_half, ti_current);
+    }
+  }
+}
+
 /**
  * @brief Update the cosmological parameters to the current simulation time.
  *
@@ -226,6 +283,9 @@ void cosmology_update(struct cosmology *c, const struct phys_const *phys_const,
   /* Time */
   c->time = cosmology_get_time_since_big_bang(c, a);
   c->lookback_time = c->universe_age_at_present_day - c->time;
+
+  /* Kick factors of the particles starting or ending a step now */
+  cosmology_update_kick_factors(c, ti_current);
 }
 
 /**
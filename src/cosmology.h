@@ -27,6 +27,24 @@
 #include "timeline.h"
 #include "units.h"
 
+/**
+ * @brief The factors entering the kick operators over a half time-step.
+ */
+struct cosmology_kick_factors {
+
+  /*! Factor of the hydro kick */
+  double hydro;
+
+  /*! Factor of the gravity kick */
+  double grav;
+
+  /*! Factor of the thermal kick */
+  double therm;
+
+  /*! Factor of the correction kick */
+  double corr;
+};
+
 /**
  * @brief Cosmological parameters
  */
@@ -107,6 +125,17 @@ struct cosmology {
   /*! Redshit at the previous time-step */
   double z_old;
 
+  /*! Kick factors of the first half-kick of the particles of each time-bin
+   * starting their step at the current time */
+  struct cosmology_kick_factors kick1_factors[num_time_bins];
+
+  /*! Kick factors of the second half-kick of the particles of each time-bin
+   * ending their step at the current time */
+  struct cosmology_kick_factors kick2_factors[num_time_bins];
+
+  /*! Integer time at which the kick factors were tabulated */
+  integertime_t ti_kick_factors;
+
   /*------------------------------------------------------------------ */
 
   /*! Starting expansion factor */
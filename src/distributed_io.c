@@ -73,6 +73,7 @@
  * the HDF5 file.
  * @param props The #io_props of the field to read
  * @param N The number of particles to write.
+ * @param lossy_level The #compression_levels to apply to this field.
  * @param internal_units The #unit_system used internally
  * @param snapshot_units The #unit_system used in the snapshots
  *
@@ -83,23 +84,12 @@ void write_distributed_array(const struct engine* e, hid_t grp,
                              const char* fileName,
                              const char* partTypeGroupName,
                              const struct io_props props, const size_t N,
+                             const enum compression_levels lossy_level,
                              const struct unit_system* internal_units,
                              const struct unit_system* snapshot_units) {
 
-  const size_t typeSize = io_sizeof_type(props.type);
-  const size_t num_elements = N * props.dimension;
-
   /* message("Writing '%s' array...", props.name); */
 
-  /* Allocate temporary buffer */
-  void* temp = NULL;
-  if (swift_memalign("writebuff", (void**)&temp, IO_BUFFER_ALIGNMENT,
-                     num_elements * typeSize) != 0)
-    error("Unable to allocate temporary i/o buffer");
-
-  /* Copy the particle data to the temporary buffer */
-  io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
-
   /* Create data space */
   hid_t h_space;
   if (N > 0)
@@ -110,8 +100,12 @@ void write_distributed_array(const struct engine* e, hid_t grp,
   if (h_space < 0)
     error("Error while creating data space for field '%s'.", props.name);
 
+  /* Lossy fields are always compressed */
+  const int deflate_level = io_compression_deflate_level(
+      e->output_options, &props, lossy_level, e->snapshot_compression);
+
   /* Decide what chunk size to use based on compression */
-  int log2_chunk_size = e->snapshot_compression > 0 ? 12 : 18;
+  int log2_chunk_size = deflate_level > 0 ? 12 : 18;
 
   int rank;
   hsize_t shape[2];
@@ -157,13 +151,13 @@ void write_distributed_array(const struct engine* e, hid_t grp,
       error("Error while setting checksum options for field '%s'.", props.name);
 
     /* Impose data compression */
-    if (e->snapshot_compression > 0) {
+    if (deflate_level > 0) {
       h_err = H5Pset_shuffle(h_prop);
       if (h_err < 0)
         error("Error while setting shuffling options for field '%s'.",
               props.name);
 
-      h_err = H5Pset_deflate(h_prop, e->snapshot_compression);
+      h_err = H5Pset_deflate(h_prop, deflate_level);
       if (h_err < 0)
         error("Error while setting compression options for field '%s'.",
               props.name);
@@ -175,10 +169,9 @@ void write_distributed_array(const struct engine* e, hid_t grp,
                                  h_space, H5P_DEFAULT, h_prop, H5P_DEFAULT);
   if (h_data < 0) error("Error while creating dataspace '%s'.", props.name);
 
-  /* Write temporary buffer to HDF5 dataspace */
-  h_err = H5Dwrite(h_data, io_hdf5_type(props.type), h_space, H5S_ALL,
-                   H5P_DEFAULT, temp);
-  if (h_err < 0) error("Error while writing data array '%s'.", props.name);
+  /* Convert the particle data and write them to the dataset */
+  io_write_array_buffered(e, h_data, h_space, props, N, lossy_level,
+                          internal_units, snapshot_units);
 
   /* Write unit conversion factors for this data set */
   char buffer[FIELD_BUFFER_SIZE] = {0};
@@ -215,8 +208,11 @@ void write_distributed_array(const struct engine* e, hid_t grp,
   /* Write the full description */
   io_write_attribute_s(h_data, "Description", props.description);
 
+  /* Write the lossy compression applied, if any */
+  io_compression_write_attributes(e->output_options, h_data, &props,
+                                  lossy_level);
+
   /* Free and close everything */
-  swift_free("writebuff", temp);
   H5Pclose(h_prop);
   H5Dclose(h_data);
   H5Sclose(h_space);
@@ -435,11 +431,17 @@ void write_output_distributed(struct engine* e,
   h_grp = H5Gcreate(h_file, "/Cells", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
   if (h_grp < 0) error("Error while creating cells group");
 
+  /* Name of the stand-alone cell index file, if requested */
+  char indexFileName[1024];
+  if (e->snapshot_cell_index_file)
+    io_get_cell_index_filename(indexFileName, dirName);
+
   /* Write the location of the particles in the arrays */
   io_write_cell_offsets(h_grp, e->s->cdim, e->s->dim, e->s->pos_dithering,
                         e->s->cells_top, e->s->nr_cells, e->s->width, mpi_rank,
                         /*distributed=*/1, N_total, global_offsets, numFields,
-                        internal_units, snapshot_units);
+                        internal_units, snapshot_units,
+                        e->snapshot_cell_index_file ? indexFileName : NULL);
   H5Gclose(h_grp);
 
   /* Loop over all particle types */
@@ -773,13 +775,15 @@ void write_output_distributed(struct engine* e,
     for (int i = 0; i < num_fields; ++i) {
 
       /* Did the user cancel this field? */
-      const int should_write = output_options_should_write_field(
-          output_options, current_selection_name, list[i].name,
-          (enum part_type)ptype, compression_level_current_default);
+      const enum compression_levels compression_level =
+          output_options_should_write_field(
+              output_options, current_selection_name, list[i].name,
+              (enum part_type)ptype, compression_level_current_default);
 
-      if (should_write) {
+      if (compression_level != compression_do_not_write) {
         write_distributed_array(e, h_grp, fileName, partTypeGroupName, list[i],
-                                Nparticles, internal_units, snapshot_units);
+                                Nparticles, compression_level, internal_units,
+                                snapshot_units);
         num_fields_written++;
       }
     }
@@ -69,6 +69,7 @@
 #include "fof.h"
 #include "gravity.h"
 #include "gravity_cache.h"
+#include "hashmap.h"
 #include "hydro.h"
 #include "line_of_sight.h"
 #include "logger.h"
@@ -1045,16 +1046,49 @@ void engine_exchange_top_multipoles(struct engine *e) {
   /* Each node (space) has constructed its own top-level multipoles.
    * We now need to make sure every other node has a copy of everything.
    *
-   * We use our home-made reduction operation that simply performs a XOR
-   * operation on the multipoles. Since only local multipoles are non-zero and
-   * each multipole is only present once, the bit-by-bit XOR will
-   * create the desired result.
+   * All the nodes know who owns which top-level cell, so each of them only
+   * needs to contribute the multipoles of its own cells, in the order of the
+   * cells array. We gather these sections and scatter them back into the
+   * top-level array. This sends (nr_nodes - 1) / nr_nodes less data than
+   * reducing the whole array, which is mostly made of zeros on each node.
    */
-  int err = MPI_Allreduce(MPI_IN_PLACE, e->s->multipoles_top, e->s->nr_cells,
-                          multipole_mpi_type, multipole_mpi_reduce_op,
-                          MPI_COMM_WORLD);
+  struct space *s = e->s;
+  const int nr_nodes = e->nr_nodes;
+  const int nr_cells = s->nr_cells;
+
+  /* How many cells does each node own? */
+  int *counts = NULL;
+  if ((counts = (int *)calloc(3 * nr_nodes, sizeof(int))) == NULL)
+    error("Failed to allocate the multipole exchange counts.");
+  int *displs = counts + nr_nodes;
+  int *cursor = counts + 2 * nr_nodes;
+  for (int i = 0; i < nr_cells; ++i) counts[s->cells_top[i].nodeID]++;
+  for (int k = 1; k < nr_nodes; ++k) displs[k] = displs[k - 1] + counts[k - 1];
+
+  struct gravity_tensors *buffer = NULL;
+  if (swift_memalign("multipoles_top_exchange", (void **)&buffer,
+                     SWIFT_CACHE_ALIGNMENT,
+                     nr_cells * sizeof(struct gravity_tensors)) != 0)
+    error("Failed to allocate the top-level multipole exchange buffer.");
+
+  /* Pack our own multipoles in our section of the buffer */
+  struct gravity_tensors *local = &buffer[displs[e->nodeID]];
+  for (int i = 0, j = 0; i < nr_cells; ++i)
+    if (s->cells_top[i].nodeID == e->nodeID) local[j++] = s->multipoles_top[i];
+
+  int err = MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, buffer, counts,
+                           displs, multipole_mpi_type, MPI_COMM_WORLD);
   if (err != MPI_SUCCESS)
-    mpi_error(err, "Failed to all-reduce the top-level multipoles.");
+    mpi_error(err, "Failed to all-gather the top-level multipoles.");
+
+  /* And unpack everything in cell order */
+  for (int i = 0; i < nr_cells; ++i) {
+    const int nodeID = s->cells_top[i].nodeID;
+    s->multipoles_top[i] = buffer[displs[nodeID] + cursor[nodeID]++];
+  }
+
+  swift_free("multipoles_top_exchange", buffer);
+  free(counts);
 
 #ifdef SWIFT_DEBUG_CHECKS
   long long counter = 0;
@@ -1670,6 +1704,15 @@ void engine_rebuild(struct engine *e, const int repartitioned,
   if (e->verbose && !repartitioned)
     scheduler_report_task_times(&e->sched, e->nr_threads);
 
+  /* Update the task cost model with the timings of the tasks we are about to
+   * discard. */
+  if (e->sched.adaptive_weights && e->sched.nr_tasks > 0) {
+    scheduler_fit_cost_model(&e->sched, e->verbose);
+    if (e->nodeID == 0 && strcmp(e->task_cost_model_file,
+                                 engine_default_task_cost_model_file))
+      scheduler_write_cost_model(&e->sched, e->task_cost_model_file);
+  }
+
   /* Give some breathing space */
   scheduler_free_tasks(&e->sched);
 
@@ -1790,7 +1833,15 @@ void engine_rebuild(struct engine *e, const int repartitioned,
 #endif
 
   /* Re-build the tasks. */
+  const ticks tic3 = getticks();
   engine_maketasks(e);
+  const ticks maketasks_ticks = getticks() - tic3;
+
+  if (e->verbose)
+    message("Making tasks took %.3f %s (last rebuild: %.3f %s).",
+            clocks_from_ticks(maketasks_ticks), clocks_getunit(),
+            clocks_from_ticks(e->maketasks_ticks_last), clocks_getunit());
+  e->maketasks_ticks_last = maketasks_ticks;
 
   /* Make the list of top-level cells that have tasks */
   space_list_useful_top_level_cells(e->s);
@@ -1907,6 +1958,13 @@ void engine_prepare(struct engine *e) {
     engine_rebuild(e, repartitioned, 0);
   }
 
+  /* Otherwise, update the task cost model with the timings of the last step
+   * and re-weight the tasks accordingly. */
+  else if (e->sched.adaptive_weights) {
+    scheduler_fit_cost_model(&e->sched, e->verbose);
+    scheduler_reweight(&e->sched, e->verbose);
+  }
+
 #ifdef SWIFT_DEBUG_CHECKS
   if (e->forcerepart || e->forcerebuild) {
     /* Check that all cells have been drifted to the current time.
@@ -1931,20 +1989,6 @@ void engine_prepare(struct engine *e) {
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 }
 
-/**
- * @brief Implements a barrier for the #runner threads.
- *
- * @param e The #engine.
- */
-void engine_barrier(struct engine *e) {
-
-  /* Wait at the wait barrier. */
-  swift_barrier_wait(&e->wait_barrier);
-
-  /* Wait at the run barrier. */
-  swift_barrier_wait(&e->run_barrier);
-}
-
 /**
  * @brief Print the conserved quantities statistics to a log file
  *
@@ -2111,12 +2155,13 @@ void engine_launch(struct engine *e, const char *call) {
   /* Prepare the scheduler. */
   atomic_inc(&e->sched.waiting);
 
-  /* Cry havoc and let loose the dogs of war. */
-  swift_barrier_wait(&e->run_barrier);
-
-  /* Load the tasks. */
+  /* Load the tasks. The runners are still serving the threadpool so they
+   * help with this. */
   scheduler_start(&e->sched);
 
+  /* Cry havoc and let loose the dogs of war. */
+  threadpool_release_threads(&e->threadpool);
+
   /* Remove the safeguard. */
   pthread_mutex_lock(&e->sched.sleep_mutex);
   atomic_dec(&e->sched.waiting);
@@ -2124,7 +2169,7 @@ void engine_launch(struct engine *e, const char *call) {
   pthread_mutex_unlock(&e->sched.sleep_mutex);
 
   /* Sit back and wait for the runners to come home. */
-  swift_barrier_wait(&e->wait_barrier);
+  threadpool_gather_threads(&e->threadpool);
 
   /* Store the wallclock time */
   e->sched.total_ticks += getticks() - tic;
@@ -2465,6 +2510,9 @@ void engine_step(struct engine *e) {
 #endif
   e->tic_step = getticks();
 
+  /* Start following the peak memory use of this step. */
+  memuse_counters_new_step();
+
   if (e->nodeID == 0) {
 
     const ticks tic_files = getticks();
@@ -2677,6 +2725,11 @@ void engine_step(struct engine *e) {
   engine_launch(e, "tasks");
   TIMER_TOC(timer_runners);
 
+#ifdef SWIFT_HARDWARE_COUNTERS
+  /* Record the hardware counters of the tasks of this step. */
+  hardware_counters_report_step(e);
+#endif
+
   /* Now record the CPU times used by the tasks. */
 #ifdef WITH_MPI
   double end_usertime = 0.0;
@@ -2761,6 +2814,14 @@ void engine_step(struct engine *e) {
 
   /* Time in ticks at the end of this step. */
   e->toc_step = getticks();
+
+  if (e->verbose) {
+    char label[64];
+    size_t label_peak;
+    const size_t peak = memuse_counters_step_peak(label, &label_peak);
+    message("Peak memory use of this step: %.3f MB (largest: '%s' %.3f MB).",
+            peak / (1024. * 1024.), label, label_peak / (1024. * 1024.));
+  }
 }
 
 /**
@@ -3516,71 +3577,136 @@ void engine_split(struct engine *e, struct partition *initial_partition) {
 #ifdef DEBUG_INTERACTIONS_STARS
 /**
  * @brief Exchange the feedback counters between stars
+ *
+ * The counters accumulated by our copies of the foreign stars are sent back
+ * to the nodes owning them. Only the proxies are contacted and each of them
+ * only receives the (ID, counter) pairs of the stars in the cells it sent us
+ * with a hydro connection, the only ones the stars are exchanged for.
+ *
  * @param e The #engine.
  */
 void engine_collect_stars_counter(struct engine *e) {
 
 #ifdef WITH_MPI
-  if (e->total_nr_sparts > 1e5) {
-    message("WARNING: too many sparts, skipping exchange of counters");
-    return;
-  }
+  const int nr_proxies = e->nr_proxies;
 
-  /* Get number of sparticles for each rank */
-  size_t *n_sparts = (size_t *)malloc(e->nr_nodes * sizeof(size_t));
+  /* Use a private communicator to stay clear of any other message */
+  MPI_Comm comm;
+  MPI_Comm_dup(MPI_COMM_WORLD, &comm);
 
-  int err = MPI_Allgather(&e->s->nr_sparts_foreign, 1, MPI_UNSIGNED_LONG,
-                          n_sparts, 1, MPI_UNSIGNED_LONG, MPI_COMM_WORLD);
-  if (err != MPI_SUCCESS) error("Communication failed");
+  MPI_Request *reqs = NULL;
+  if ((reqs = (MPI_Request *)malloc(sizeof(MPI_Request) * 2 * nr_proxies)) ==
+      NULL)
+    error("Failed to allocate MPI request list.");
 
-  /* Compute derivated quantities */
-  int total = 0;
-  int *n_sparts_int = (int *)malloc(e->nr_nodes * sizeof(int));
-  int *displs = (int *)malloc(e->nr_nodes * sizeof(int));
-  for (int i = 0; i < e->nr_nodes; i++) {
-    displs[i] = total;
-    total += n_sparts[i];
-    n_sparts_int[i] = n_sparts[i];
-  }
+  /* Count the foreign stars we got from each proxy */
+  int *send_counts = (int *)malloc(nr_proxies * sizeof(int));
+  int *recv_counts = (int *)malloc(nr_proxies * sizeof(int));
+  if (send_counts == NULL || recv_counts == NULL)
+    error("Failed to allocate the star counter counts.");
 
-  /* Get all sparticles */
-  struct spart *sparts =
-      (struct spart *)swift_malloc("sparts", total * sizeof(struct spart));
-  err = MPI_Allgatherv(e->s->sparts_foreign, e->s->nr_sparts_foreign,
-                       spart_mpi_type, sparts, n_sparts_int, displs,
-                       spart_mpi_type, MPI_COMM_WORLD);
-  if (err != MPI_SUCCESS) error("Communication failed");
+  /* Only the cells with a hydro connection have foreign stars */
+  for (int k = 0; k < nr_proxies; k++) {
+    send_counts[k] = 0;
+    for (int j = 0; j < e->proxies[k].nr_cells_in; j++)
+      if (e->proxies[k].cells_in_type[j] & proxy_cell_type_hydro)
+        send_counts[k] += e->proxies[k].cells_in[j]->stars.count;
+  }
 
-  /* Reset counters */
-  for (size_t i = 0; i < e->s->nr_sparts_foreign; i++) {
-    e->s->sparts_foreign[i].num_ngb_feedback = 0;
+  /* Exchange the number of counters with each proxy */
+  for (int k = 0; k < nr_proxies; k++) {
+    const int node = e->proxies[k].nodeID;
+    int err = MPI_Irecv(&recv_counts[k], 1, MPI_INT, node, 0, comm, &reqs[k]);
+    if (err != MPI_SUCCESS) mpi_error(err, "Failed to post the count recv.");
+    err = MPI_Isend(&send_counts[k], 1, MPI_INT, node, 0, comm,
+                    &reqs[nr_proxies + k]);
+    if (err != MPI_SUCCESS) mpi_error(err, "Failed to send the count.");
+  }
+  if (MPI_Waitall(2 * nr_proxies, reqs, MPI_STATUSES_IGNORE) != MPI_SUCCESS)
+    error("Communication failed");
+
+  /* Offsets of the (ID, counter) pairs of each proxy in the buffers */
+  size_t total_send = 0, total_recv = 0;
+  for (int k = 0; k < nr_proxies; k++) {
+    total_send += send_counts[k];
+    total_recv += recv_counts[k];
   }
 
-  /* Update counters */
-  struct spart *local_sparts = e->s->sparts;
-  for (size_t i = 0; i < e->s->nr_sparts; i++) {
-    const long long id_i = local_sparts[i].id;
+  long long *send_buff = NULL, *recv_buff = NULL;
+  if ((send_buff = (long long *)malloc(2 * total_send * sizeof(long long))) ==
+          NULL ||
+      (recv_buff = (long long *)malloc(2 * total_recv * sizeof(long long))) ==
+          NULL)
+    error("Failed to allocate the star counter buffers.");
 
-    for (int j = 0; j < total; j++) {
-      const long long id_j = sparts[j].id;
+  /* Pack the counters of the foreign stars and reset them */
+  size_t offset_send = 0, offset_recv = 0;
+  for (int k = 0; k < nr_proxies; k++) {
+    const int node = e->proxies[k].nodeID;
 
-      if (id_j == id_i) {
-        if (j >= displs[engine_rank] &&
-            j < displs[engine_rank] + n_sparts_int[engine_rank]) {
-          error(
-              "Found a local spart in foreign cell ID=%lli: j=%i, displs=%i, "
-              "n_sparts=%i",
-              id_j, j, displs[engine_rank], n_sparts_int[engine_rank]);
-        }
+    long long *buff = &send_buff[2 * offset_send];
+    size_t count = 0;
+    for (int j = 0; j < e->proxies[k].nr_cells_in; j++) {
+      if (!(e->proxies[k].cells_in_type[j] & proxy_cell_type_hydro)) continue;
+      const struct cell *c = e->proxies[k].cells_in[j];
+      for (int i = 0; i < c->stars.count; i++) {
+        buff[2 * count] = c->stars.parts[i].id;
+        buff[2 * count + 1] = c->stars.parts[i].num_ngb_feedback;
+        c->stars.parts[i].num_ngb_feedback = 0;
+        count++;
+      }
+    }
+
+    int err = MPI_Irecv(&recv_buff[2 * offset_recv], 2 * recv_counts[k],
+                        MPI_LONG_LONG_INT, node, 0, comm, &reqs[k]);
+    if (err != MPI_SUCCESS) mpi_error(err, "Failed to post the counter recv.");
+    err = MPI_Isend(buff, 2 * send_counts[k], MPI_LONG_LONG_INT, node, 0, comm,
+                    &reqs[nr_proxies + k]);
+    if (err != MPI_SUCCESS) mpi_error(err, "Failed to send the counters.");
+
+    offset_send += send_counts[k];
+    offset_recv += recv_counts[k];
+  }
 
-        local_sparts[i].num_ngb_feedback += sparts[j].num_ngb_feedback;
+  /* Index the local stars the proxies may have counters for by ID whilst
+   * the messages fly, i.e. the ones in the cells sent with a hydro
+   * connection */
+  struct spart *local_sparts = e->s->sparts;
+  hashmap_t map;
+  hashmap_init(&map);
+  for (int k = 0; k < nr_proxies; k++) {
+    for (int j = 0; j < e->proxies[k].nr_cells_out; j++) {
+      if (!(e->proxies[k].cells_out_type[j] & proxy_cell_type_hydro)) continue;
+      const struct cell *c = e->proxies[k].cells_out[j];
+      for (int i = 0; i < c->stars.count; i++) {
+        hashmap_value_t value;
+        value.value_st = (c->stars.parts - local_sparts) + i;
+        hashmap_put(&map, (hashmap_key_t)c->stars.parts[i].id, value);
       }
     }
   }
 
-  free(n_sparts);
-  free(n_sparts_int);
-  swift_free("sparts", sparts);
+  if (MPI_Waitall(2 * nr_proxies, reqs, MPI_STATUSES_IGNORE) != MPI_SUCCESS)
+    error("Communication failed");
+
+  /* Update counters */
+  for (size_t i = 0; i < total_recv; i++) {
+    const long long id = recv_buff[2 * i];
+    const hashmap_value_t *value = hashmap_lookup(&map, (hashmap_key_t)id);
+    if (value == NULL)
+      error("Received a star counter for a spart not sent to the proxy ID=%lli",
+            id);
+
+    local_sparts[value->value_st].num_ngb_feedback += recv_buff[2 * i + 1];
+  }
+
+  hashmap_free(&map);
+  free(send_buff);
+  free(recv_buff);
+  free(send_counts);
+  free(recv_counts);
+  free(reqs);
+  MPI_Comm_free(&comm);
 #endif
 }
 
@@ -3915,6 +4041,8 @@ void engine_init(struct engine *e, struct space *s, struct swift_params *params,
       parser_get_opt_param_int(params, "Snapshots:int_time_label_on", 0);
   e->snapshot_invoke_stf =
       parser_get_opt_param_int(params, "Snapshots:invoke_stf", 0);
+  e->snapshot_cell_index_file =
+      parser_get_opt_param_int(params, "Snapshots:cell_index_file", 0);
   e->snapshot_units = (struct unit_system *)malloc(sizeof(struct unit_system));
   units_init_default(e->snapshot_units, params, "Snapshots", internal_units);
   e->snapshot_output_count = 0;
@@ -4027,6 +4155,13 @@ void engine_init(struct engine *e, struct space *s, struct swift_params *params,
         params, "StructureFinding:scale_factor_first", 0.1);
     e->delta_time_stf =
         parser_get_opt_param_double(params, "StructureFinding:delta_time", -1.);
+    e->stf_only_fof_groups = parser_get_opt_param_int(
+        params, "StructureFinding:only_fof_groups", 0);
+
+    if (e->stf_only_fof_groups && !(e->policy & engine_policy_fof))
+      error(
+          "Handing only the particles in FOF groups to VELOCIraptor requires "
+          "running with FOF (--fof).");
   }
 
   /* Initialise line of sight output. */
@@ -4099,6 +4234,7 @@ void engine_config(int restart, int fof, struct engine *e,
   e->step_props = engine_step_prop_none;
   e->links = NULL;
   e->nr_links = 0;
+  e->maketasks_ticks_last = 0;
   e->file_stats = NULL;
   e->file_timesteps = NULL;
   e->sfh_logger = NULL;
@@ -4600,13 +4736,9 @@ void engine_config(int restart, int fof, struct engine *e,
     collectgroup_init();
   }
 
-  /* Initialize the threadpool. */
-  threadpool_init(&e->threadpool, e->nr_threads);
-
-  /* First of all, init the barrier and lock it. */
-  if (swift_barrier_init(&e->wait_barrier, NULL, e->nr_threads + 1) != 0 ||
-      swift_barrier_init(&e->run_barrier, NULL, e->nr_threads + 1) != 0)
-    error("Failed to initialize barrier.");
+  /* Initialize the threadpool. Its threads are the runners, which serve the
+   * mappers when they are not running tasks. */
+  threadpool_init_shared(&e->threadpool, e->nr_threads);
 
   /* Expected average for tasks per cell. If set to zero we use a heuristic
    * guess based on the numbers of cells and how many tasks per cell we expect.
@@ -4630,6 +4762,20 @@ void engine_config(int restart, int fof, struct engine *e,
   scheduler_init(&e->sched, e->s, maxtasks, nr_queues,
                  (e->policy & scheduler_flag_steal), e->nodeID, &e->threadpool);
 
+  /* Are we correcting the analytic task costs using the measured run times?
+   * Can be changed on restart. */
+  e->sched.adaptive_weights =
+      parser_get_opt_param_int(params, "Scheduler:adaptive_task_weights", 0);
+  parser_get_opt_param_string(params, "Scheduler:task_cost_model_file",
+                              e->task_cost_model_file,
+                              engine_default_task_cost_model_file);
+
+  /* Seed the cost model with the one fitted in a previous run? */
+  if (e->sched.adaptive_weights &&
+      strcmp(e->task_cost_model_file, engine_default_task_cost_model_file) &&
+      access(e->task_cost_model_file, R_OK) == 0)
+    scheduler_read_cost_model(&e->sched, e->task_cost_model_file);
+
   /* Maximum size of MPI task messages, in KB, that should not be buffered,
    * that is sent using MPI_Issend, not MPI_Isend. 4Mb by default. Can be
    * changed on restart.
@@ -4637,6 +4783,22 @@ void engine_config(int restart, int fof, struct engine *e,
   e->sched.mpi_message_limit =
       parser_get_opt_param_int(params, "Scheduler:mpi_message_limit", 4) * 1024;
 
+#ifdef WITH_MPI
+  /* Drive the progress of the communications from a dedicated thread rather
+   * than from the runners? Can be changed on restart. */
+  if (e->nr_nodes > 1) {
+    e->sched.mpi_progress_thread =
+        parser_get_opt_param_int(params, "Scheduler:mpi_progress_thread", 0);
+    scheduler_start_mpi_progress(&e->sched);
+  }
+#endif
+
+  /* Budget, in MB, for the memory allocated by the code. 0 for none. Can be
+   * changed on restart. */
+  memuse_budget_set(
+      parser_get_opt_param_double(params, "Scheduler:memory_budget", 0.) *
+      1024. * 1024.);
+
   if (restart) {
 
     /* Overwrite the constants for the scheduler */
@@ -4730,6 +4892,12 @@ void engine_config(int restart, int fof, struct engine *e,
     cache_init(&e->runners[k].ci_cache, CACHE_SIZE);
     cache_init(&e->runners[k].cj_cache, CACHE_SIZE);
 #endif
+#ifdef GIZMO_BATCHED_RIEMANN
+    e->runners[k].flux_batch.riemann.count = 0;
+#endif
+
+    /* Allocate the task trace buffer, if tracing. */
+    task_trace_init(&e->runners[k].trace);
 
     if (verbose) {
       if (with_aff)
@@ -4767,7 +4935,7 @@ void engine_config(int restart, int fof, struct engine *e,
 #endif
 
   /* Wait for the runner threads to be in place. */
-  swift_barrier_wait(&e->wait_barrier);
+  threadpool_gather_threads(&e->threadpool);
 }
 
 /**
@@ -5332,7 +5500,7 @@ void engine_recompute_displacement_constraint(struct engine *e) {
 void engine_clean(struct engine *e, const int fof, const int restart) {
   /* Start by telling the runners to stop. */
   e->step_props = engine_step_prop_done;
-  swift_barrier_wait(&e->run_barrier);
+  threadpool_release_threads(&e->threadpool);
 
   /* Wait for each runner to come home. */
   for (int k = 0; k < e->nr_threads; k++) {
@@ -5344,6 +5512,10 @@ void engine_clean(struct engine *e, const int fof, const int restart) {
 #endif
     gravity_cache_clean(&e->runners[k].ci_gravity_cache);
     gravity_cache_clean(&e->runners[k].cj_gravity_cache);
+    task_trace_clean(&e->runners[k].trace);
+#ifdef SWIFT_HARDWARE_COUNTERS
+    hardware_counters_clean(&e->runners[k].hw_counters);
+#endif
   }
   swift_free("runners", e->runners);
   free(e->snapshot_units);
@@ -120,6 +120,7 @@ enum engine_step_properties {
 #define engine_tasks_per_cell_margin 1.2
 #define engine_default_stf_subdir_per_output "."
 #define engine_default_snapshot_subdir "."
+#define engine_default_task_cost_model_file "none"
 
 /**
  * @brief The rank of the engine as a global variable (for messages).
@@ -302,6 +303,7 @@ struct engine {
   int snapshot_compression;
   int snapshot_int_time_label_on;
   int snapshot_invoke_stf;
+  int snapshot_cell_index_file;
   struct unit_system *snapshot_units;
   int snapshot_output_count;
 
@@ -321,6 +323,9 @@ struct engine {
   char stf_subdir_per_output[PARSER_MAX_LINE_SIZE];
   int stf_output_count;
 
+  /* Only hand the particles in FOF groups over to VELOCIraptor? */
+  int stf_only_fof_groups;
+
   /* FoF black holes seeding information */
   double a_first_fof_call;
   double time_first_fof_call;
@@ -355,10 +360,6 @@ struct engine {
   /* The current step number. */
   int step;
 
-  /* Data for the threads' barrier. */
-  swift_barrier_t wait_barrier;
-  swift_barrier_t run_barrier;
-
   /* ID of the node this engine lives on. */
   int nr_nodes, nodeID;
 
@@ -405,6 +406,9 @@ struct engine {
   struct link *links;
   size_t nr_links, size_links;
 
+  /* File used to seed and store the task cost model. */
+  char task_cost_model_file[PARSER_MAX_LINE_SIZE];
+
   /* Average number of tasks per cell. Used to estimate the sizes
    * of the various task arrays. Also the maximum from all ranks. */
   float tasks_per_cell;
@@ -414,6 +418,9 @@ struct engine {
      the creation of communication tasks so needs to be large enough. */
   float links_per_tasks;
 
+  /* Time spent making the tasks at the last rebuild. */
+  ticks maketasks_ticks_last;
+
   /* Are we talkative ? */
   int verbose;
 
@@ -530,7 +537,6 @@ struct engine {
 
 /* Function prototypes, engine.c. */
 void engine_addlink(struct engine *e, struct link **l, struct task *t);
-void engine_barrier(struct engine *e);
 void engine_compute_next_snapshot_time(struct engine *e);
 void engine_compute_next_stf_time(struct engine *e);
 void engine_compute_next_fof_time(struct engine *e);
@@ -286,35 +286,40 @@ void engine_drift_all(struct engine *e, const int drift_mpoles) {
   }
 #endif
 
+  /* The particle drifts of a top-level cell only touch that cell's
+   * particles, so the drifts of the different types can be fused into a
+   * single pass over the cells. We keep the part, gpart, spart, bpart order
+   * within each cell. */
+  threadpool_map_function drift_mappers[4];
+  void *drift_extra_data[4] = {e, e, e, e};
+  int num_drift_mappers = 0;
+
   if (!e->restarting) {
 
     /* Normal case: We have a list of local cells with tasks to play with */
 
-    if (e->s->nr_parts > 0) {
-      threadpool_map(&e->threadpool, engine_do_drift_all_part_mapper,
-                     e->s->local_cells_top, e->s->nr_local_cells, sizeof(int),
-                     threadpool_auto_chunk_size, e);
-    }
-    if (e->s->nr_gparts > 0) {
-      threadpool_map(&e->threadpool, engine_do_drift_all_gpart_mapper,
-                     e->s->local_cells_top, e->s->nr_local_cells, sizeof(int),
-                     threadpool_auto_chunk_size, e);
-    }
-    if (e->s->nr_sparts > 0) {
-      threadpool_map(&e->threadpool, engine_do_drift_all_spart_mapper,
-                     e->s->local_cells_top, e->s->nr_local_cells, sizeof(int),
-                     threadpool_auto_chunk_size, e);
-    }
-    if (e->s->nr_bparts > 0) {
-      threadpool_map(&e->threadpool, engine_do_drift_all_bpart_mapper,
-                     e->s->local_cells_top, e->s->nr_local_cells, sizeof(int),
-                     threadpool_auto_chunk_size, e);
-    }
+    if (e->s->nr_parts > 0)
+      drift_mappers[num_drift_mappers++] = engine_do_drift_all_part_mapper;
+    if (e->s->nr_gparts > 0)
+      drift_mappers[num_drift_mappers++] = engine_do_drift_all_gpart_mapper;
+    if (e->s->nr_sparts > 0)
+      drift_mappers[num_drift_mappers++] = engine_do_drift_all_spart_mapper;
+    if (e->s->nr_bparts > 0)
+      drift_mappers[num_drift_mappers++] = engine_do_drift_all_bpart_mapper;
+
+    if (num_drift_mappers > 0)
+      threadpool_map_fused_async(&e->threadpool, drift_mappers,
+                                 drift_extra_data, num_drift_mappers,
+                                 e->s->local_cells_top, e->s->nr_local_cells,
+                                 sizeof(int), threadpool_auto_chunk_size,
+                                 /*after=*/NULL);
+
+    /* The multipoles are independent of the particles */
     if (drift_mpoles && (e->policy & engine_policy_self_gravity)) {
-      threadpool_map(&e->threadpool, engine_do_drift_all_multipole_mapper,
-                     e->s->local_cells_with_tasks_top,
-                     e->s->nr_local_cells_with_tasks, sizeof(int),
-                     threadpool_auto_chunk_size, e);
+      threadpool_map_async(&e->threadpool, engine_do_drift_all_multipole_mapper,
+                           e->s->local_cells_with_tasks_top,
+                           e->s->nr_local_cells_with_tasks, sizeof(int),
+                           threadpool_auto_chunk_size, e, /*after=*/NULL);
     }
 
   } else {
@@ -322,33 +327,33 @@ void engine_drift_all(struct engine *e, const int drift_mpoles) {
     /* When restarting, the list of local cells with tasks does not yet
        exist. We use the raw list of top-level cells instead */
 
-    if (e->s->nr_parts > 0) {
-      threadpool_map(&e->threadpool, engine_do_drift_all_part_mapper,
-                     e->s->cells_top, e->s->nr_cells, sizeof(struct cell),
-                     threadpool_auto_chunk_size, e);
-    }
-    if (e->s->nr_sparts > 0) {
-      threadpool_map(&e->threadpool, engine_do_drift_all_spart_mapper,
-                     e->s->cells_top, e->s->nr_cells, sizeof(struct cell),
-                     threadpool_auto_chunk_size, e);
-    }
-    if (e->s->nr_bparts > 0) {
-      threadpool_map(&e->threadpool, engine_do_drift_all_bpart_mapper,
-                     e->s->cells_top, e->s->nr_cells, sizeof(struct cell),
-                     threadpool_auto_chunk_size, e);
-    }
-    if (e->s->nr_gparts > 0) {
-      threadpool_map(&e->threadpool, engine_do_drift_all_gpart_mapper,
-                     e->s->cells_top, e->s->nr_cells, sizeof(struct cell),
-                     threadpool_auto_chunk_size, e);
-    }
+    if (e->s->nr_parts > 0)
+      drift_mappers[num_drift_mappers++] = engine_do_drift_all_part_mapper;
+    if (e->s->nr_gparts > 0)
+      drift_mappers[num_drift_mappers++] = engine_do_drift_all_gpart_mapper;
+    if (e->s->nr_sparts > 0)
+      drift_mappers[num_drift_mappers++] = engine_do_drift_all_spart_mapper;
+    if (e->s->nr_bparts > 0)
+      drift_mappers[num_drift_mappers++] = engine_do_drift_all_bpart_mapper;
+
+    if (num_drift_mappers > 0)
+      threadpool_map_fused_async(&e->threadpool, drift_mappers,
+                                 drift_extra_data, num_drift_mappers,
+                                 e->s->cells_top, e->s->nr_cells,
+                                 sizeof(struct cell),
+                                 threadpool_auto_chunk_size, /*after=*/NULL);
+
     if (e->policy & engine_policy_self_gravity) {
-      threadpool_map(&e->threadpool, engine_do_drift_all_multipole_mapper,
-                     e->s->cells_top, e->s->nr_cells, sizeof(struct cell),
-                     threadpool_auto_chunk_size, e);
+      threadpool_map_async(&e->threadpool, engine_do_drift_all_multipole_mapper,
+                           e->s->cells_top, e->s->nr_cells,
+                           sizeof(struct cell), threadpool_auto_chunk_size, e,
+                           /*after=*/NULL);
     }
   }
 
+  /* Wait for all the drifts to complete */
+  threadpool_wait(&e->threadpool, NULL);
+
   /* Synchronize particle positions */
   space_synchronize_particle_positions(e->s);
 
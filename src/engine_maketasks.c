@@ -829,13 +829,23 @@ void engine_make_hierarchical_tasks_common(struct engine *e, struct cell *c) {
 
   struct scheduler *s = &e->sched;
   const int with_star_formation = (e->policy & engine_policy_star_formation);
+  const int with_feedback = (e->policy & engine_policy_feedback);
+  const int with_black_holes = (e->policy & engine_policy_black_holes);
   const int with_timestep_limiter =
       (e->policy & engine_policy_timestep_limiter);
   const int with_timestep_sync = (e->policy & engine_policy_timestep_sync);
 #ifdef WITH_LOGGER
   const int with_logger = e->policy & engine_policy_logger;
+#else
+  const int with_logger = 0;
 #endif
 
+  /* Can the second kick and the time-step calculation be done in one pass?
+   * Only if no task needs to act on the particles in-between. */
+  const int fuse_kick2_timestep =
+      !with_star_formation && !with_feedback && !with_black_holes &&
+      !with_logger;
+
   /* Are we at the top-level? */
   if (c->top == c && c->nodeID == e->nodeID) {
 
@@ -877,11 +887,17 @@ void engine_make_hierarchical_tasks_common(struct engine *e, struct cell *c) {
       struct task *kick2_or_logger = c->kick2;
 #endif
 
-      /* Add the time-step calculation task and its dependency */
-      c->timestep = scheduler_addtask(s, task_type_timestep, task_subtype_none,
-                                      0, 0, c, NULL);
+      /* Add the time-step calculation task and its dependency. When nothing
+       * happens in-between, the second kick computes the time-steps itself
+       * and also plays the role of the time-step task. */
+      if (fuse_kick2_timestep) {
+        c->timestep = c->kick2;
+      } else {
+        c->timestep = scheduler_addtask(s, task_type_timestep,
+                                        task_subtype_none, 0, 0, c, NULL);
 
-      scheduler_addunlock(s, kick2_or_logger, c->timestep);
+        scheduler_addunlock(s, kick2_or_logger, c->timestep);
+      }
       scheduler_addunlock(s, c->timestep, c->kick1);
 
       /* Subgrid tasks: star formation */
@@ -888,6 +888,14 @@ void engine_marktasks_mapper(void *map_data, int num_elements,
     /* Kick ? */
     else if (t_type == task_type_kick1 || t_type == task_type_kick2) {
 
+      /* Second kick also computing the time-steps? */
+      if (t == t->ci->timestep) {
+        t->ci->hydro.updated = 0;
+        t->ci->grav.updated = 0;
+        t->ci->stars.updated = 0;
+        t->ci->black_holes.updated = 0;
+      }
+
       if (cell_is_active_hydro(t->ci, e) || cell_is_active_gravity(t->ci, e) ||
           cell_is_active_stars(t->ci, e) ||
           cell_is_active_black_holes(t->ci, e))
@@ -28,14 +28,113 @@
 /* Local headers. */
 #include "memswap.h"
 
+/* Number of particle types whose counts are exchanged (part, gpart, spart and
+ * bpart; the xparts follow the parts). */
+#define engine_redistribute_nr_types 4
+
+/* Tag of the particle counts messages. The particle messages use the chunk
+ * indices as tags, so this must be larger than any possible number of chunks.
+ * 32767 is the smallest upper bound on the tags guaranteed by MPI. */
+#define engine_redistribute_counts_tag 32767
+
 #ifdef WITH_MPI
 /**
- * Do the exchange of one type of particles with all the other nodes.
+ * Find out how many particles of each type this node will receive from the
+ * other nodes.
+ *
+ * Only the nodes we actually send particles to are contacted, using a
+ * non-blocking consensus: synchronous sends of the counts are emitted to the
+ * nodes of interest and we then listen for incoming counts until a
+ * non-blocking barrier, entered once all our sends have been matched,
+ * completes on all the nodes. This avoids any communication or storage
+ * proportional to nr_nodes * nr_nodes.
+ *
+ * @param send_counts the number of particles of each of the
+ *                    #engine_redistribute_nr_types types to send to each node
+ *                    (nr_nodes * engine_redistribute_nr_types).
+ * @param recv_counts on exit the number of particles of each type to receive
+ *                    from each node (same layout).
+ * @param nr_nodes the number of nodes.
+ * @param nodeID the id of this node.
+ * @param comm the communicator of the redistribution. Nodes that left the
+ *             barrier may already be sending us particles on it while we are
+ *             still probing, hence the dedicated tag of the counts.
+ */
+static void engine_redistribute_exchange_counts(const int *send_counts,
+                                                int *recv_counts, int nr_nodes,
+                                                int nodeID, MPI_Comm comm) {
+
+  const int nr_types = engine_redistribute_nr_types;
+  const int tag = engine_redistribute_counts_tag;
+
+  /* Nothing to receive unless told otherwise, apart from what we keep. */
+  bzero(recv_counts, nr_nodes * nr_types * sizeof(int));
+  memcpy(&recv_counts[nodeID * nr_types], &send_counts[nodeID * nr_types],
+         nr_types * sizeof(int));
+
+  /* Tell the nodes we send particles to how many they will get. */
+  MPI_Request *reqs = NULL;
+  if ((reqs = (MPI_Request *)malloc(sizeof(MPI_Request) * nr_nodes)) == NULL)
+    error("Failed to allocate MPI request list.");
+
+  int nr_reqs = 0;
+  for (int k = 0; k < nr_nodes; k++) {
+    if (k == nodeID) continue;
+    int sending = 0;
+    for (int t = 0; t < nr_types; t++) sending += send_counts[k * nr_types + t];
+    if (sending == 0) continue;
+
+    int res = MPI_Issend(&send_counts[k * nr_types], nr_types, MPI_INT, k, tag,
+                         comm, &reqs[nr_reqs++]);
+    if (res != MPI_SUCCESS)
+      mpi_error(res, "Failed to issend particle counts to node %i.", k);
+  }
+
+  /* Listen for incoming counts until everybody is done sending. */
+  MPI_Request barrier = MPI_REQUEST_NULL;
+  int barrier_active = 0;
+  int done = 0;
+  while (!done) {
+
+    int incoming = 0;
+    MPI_Status status;
+    MPI_Iprobe(MPI_ANY_SOURCE, tag, comm, &incoming, &status);
+    if (incoming) {
+      int res = MPI_Recv(&recv_counts[status.MPI_SOURCE * nr_types], nr_types,
+                         MPI_INT, status.MPI_SOURCE, tag, comm,
+                         MPI_STATUS_IGNORE);
+      if (res != MPI_SUCCESS)
+        mpi_error(res, "Failed to receive particle counts from node %i.",
+                  status.MPI_SOURCE);
+    }
+
+    if (barrier_active) {
+      MPI_Test(&barrier, &done, MPI_STATUS_IGNORE);
+    } else {
+      int sent = 0;
+      MPI_Testall(nr_reqs, reqs, &sent, MPI_STATUSES_IGNORE);
+      if (sent) {
+        MPI_Ibarrier(comm, &barrier);
+        barrier_active = 1;
+      }
+    }
+  }
+
+  free(reqs);
+}
+
+/**
+ * Do the exchange of one type of particles with the other nodes.
+ *
+ * Only the nodes we send particles to or receive particles from are
+ * involved. Messages are limited to 2GB, so larger exchanges are split in
+ * chunks which are all posted at once.
  *
  * @param label a label for the memory allocations of this particle type.
- * @param counts 2D array with the counts of particles to exchange with
- *               each other node.
- * @param parts the particle data to exchange
+ * @param counts the number of particles of this type to send to each node.
+ * @param recv_counts the number of particles of this type to receive from
+ *                    each node.
+ * @param parts the particle data to exchange, sorted by destination node.
  * @param new_nr_parts the number of particles this node will have after all
  *                     exchanges have completed.
  * @param sizeofparts sizeof the particle struct.
@@ -45,14 +144,20 @@
  * @param nodeID the id of this node.
  * @param syncredist whether to use slower more memory friendly synchronous
  *                   exchanges.
+ * @param comm the communicator to use for the exchange.
+ * @param recv_done optional function called as soon as all the particles
+ *                  coming from a given node have arrived, with the node, the
+ *                  new particle data and recv_data as arguments.
+ * @param recv_data extra data passed to recv_done.
  *
  * @result new particle data constructed from all the exchanges with the
  *         given alignment.
  */
-static void *engine_do_redistribute(const char *label, int *counts, char *parts,
-                                    size_t new_nr_parts, size_t sizeofparts,
-                                    size_t alignsize, MPI_Datatype mpi_type,
-                                    int nr_nodes, int nodeID, int syncredist) {
+static void *engine_do_redistribute(
+    const char *label, const int *counts, const int *recv_counts, char *parts,
+    size_t new_nr_parts, size_t sizeofparts, size_t alignsize,
+    MPI_Datatype mpi_type, int nr_nodes, int nodeID, int syncredist,
+    MPI_Comm comm, void (*recv_done)(int, char *, void *), void *recv_data) {
 
   /* Allocate a new particle array with some extra margin */
   char *parts_new = NULL;
@@ -61,178 +166,174 @@ static void *engine_do_redistribute(const char *label, int *counts, char *parts,
           sizeofparts * new_nr_parts * engine_redistribute_alloc_margin) != 0)
     error("Failed to allocate new particle data.");
 
-  if (syncredist) {
+  /* Offsets of the particles to send to and receive from each node. */
+  size_t *offset_send = NULL, *offset_recv = NULL;
+  if ((offset_send = (size_t *)malloc(sizeof(size_t) * nr_nodes)) == NULL ||
+      (offset_recv = (size_t *)malloc(sizeof(size_t) * nr_nodes)) == NULL)
+    error("Failed to allocate offset buffers.");
+  offset_send[0] = 0;
+  offset_recv[0] = 0;
+  for (int k = 1; k < nr_nodes; k++) {
+    offset_send[k] = offset_send[k - 1] + counts[k - 1];
+    offset_recv[k] = offset_recv[k - 1] + recv_counts[k - 1];
+  }
 
-    /* Slow synchronous redistribute,. */
-    size_t offset_send = 0, offset_recv = 0;
+  /* Only send and receive only "chunk" particles per request.
+   * Fixing the message size to 2GB. */
+  const int chunk = INT_MAX / sizeofparts;
 
-    /* Only send and receive only "chunk" particles per request.
-     * Fixing the message size to 2GB. */
-    const int chunk = INT_MAX / sizeofparts;
-    int res = 0;
+  if (syncredist) {
+
+    /* Slow synchronous redistribute. The nodes send their particles one after
+     * the other, so that only one of them has messages in flight at a time. */
     for (int k = 0; k < nr_nodes; k++) {
       int kk = k;
 
       /* Rank 0 decides the index of sending node */
-      MPI_Bcast(&kk, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-      int ind_recv = kk * nr_nodes + nodeID;
+      MPI_Bcast(&kk, 1, MPI_INT, 0, comm);
 
-      if (nodeID == kk) {
+      if (kk == nodeID) {
 
         /*  Send out our particles. */
-        offset_send = 0;
         for (int j = 0; j < nr_nodes; j++) {
 
-          int ind_send = kk * nr_nodes + j;
+          if (counts[j] == 0) continue;
 
           /*  Just copy our own parts */
-          if (counts[ind_send] > 0) {
-            if (j == nodeID) {
-              memcpy(&parts_new[offset_recv * sizeofparts],
-                     &parts[offset_send * sizeofparts],
-                     sizeofparts * counts[ind_recv]);
-              offset_send += counts[ind_send];
-              offset_recv += counts[ind_recv];
-            } else {
-              for (int i = 0, n = 0; i < counts[ind_send]; n++) {
-
-                /* Count and index, with chunk parts at most. */
-                size_t sendc = min(chunk, counts[ind_send] - i);
-                size_t sendo = offset_send + i;
-
-                res = MPI_Send(&parts[sendo * sizeofparts], sendc, mpi_type, j,
-                               n, MPI_COMM_WORLD);
-                if (res != MPI_SUCCESS) {
-                  mpi_error(res, "Failed to send parts to node %i from %i.", j,
-                            nodeID);
-                }
-                i += sendc;
-              }
-              offset_send += counts[ind_send];
-            }
+          if (j == nodeID) {
+            memcpy(&parts_new[offset_recv[j] * sizeofparts],
+                   &parts[offset_send[j] * sizeofparts],
+                   sizeofparts * counts[j]);
+            if (recv_done != NULL) recv_done(nodeID, parts_new, recv_data);
+            continue;
           }
-        }
-      } else {
-        /*  Listen for sends from kk. */
-        if (counts[ind_recv] > 0) {
-          for (int i = 0, n = 0; i < counts[ind_recv]; n++) {
-            /* Count and index, with +chunk parts at most. */
-            size_t recvc = min(chunk, counts[ind_recv] - i);
-            size_t recvo = offset_recv + i;
-
-            MPI_Status status;
-            res = MPI_Recv(&parts_new[recvo * sizeofparts], recvc, mpi_type, kk,
-                           n, MPI_COMM_WORLD, &status);
-            if (res != MPI_SUCCESS) {
-              mpi_error(res, "Failed to recv of parts from node %i to %i.", kk,
+
+          for (int i = 0, n = 0; i < counts[j]; n++) {
+
+            /* Count and index, with chunk parts at most. */
+            const int sendc = min(chunk, counts[j] - i);
+            const size_t sendo = offset_send[j] + i;
+
+            int res = MPI_Send(&parts[sendo * sizeofparts], sendc, mpi_type, j,
+                               n, comm);
+            if (res != MPI_SUCCESS)
+              mpi_error(res, "Failed to send parts to node %i from %i.", j,
                         nodeID);
-            }
-            i += recvc;
+            i += sendc;
           }
-          offset_recv += counts[ind_recv];
         }
+
+      } else if (recv_counts[kk] > 0) {
+
+        /*  Listen for sends from kk. */
+        for (int i = 0, n = 0; i < recv_counts[kk]; n++) {
+
+          /* Count and index, with chunk parts at most. */
+          const int recvc = min(chunk, recv_counts[kk] - i);
+          const size_t recvo = offset_recv[kk] + i;
+
+          int res = MPI_Recv(&parts_new[recvo * sizeofparts], recvc, mpi_type,
+                             kk, n, comm, MPI_STATUS_IGNORE);
+          if (res != MPI_SUCCESS)
+            mpi_error(res, "Failed to recv of parts from node %i to %i.", kk,
+                      nodeID);
+          i += recvc;
+        }
+        if (recv_done != NULL) recv_done(kk, parts_new, recv_data);
       }
     }
 
   } else {
     /* Asynchronous redistribute, can take a lot of memory. */
 
-    /* Prepare MPI requests for the asynchronous communications */
-    MPI_Request *reqs;
-    if ((reqs = (MPI_Request *)malloc(sizeof(MPI_Request) * 2 * nr_nodes)) ==
-        NULL)
-      error("Failed to allocate MPI request list.");
-
-    /* Only send and receive only "chunk" particles per request. So we need to
-     * loop as many times as necessary here. Make 2Gb/sizeofparts so we only
-     * send 2Gb packets. */
-    const int chunk = INT_MAX / sizeofparts;
-    int sent = 0;
-    int recvd = 0;
-
-    int activenodes = 1;
-    while (activenodes) {
-
-      for (int k = 0; k < 2 * nr_nodes; k++) reqs[k] = MPI_REQUEST_NULL;
-
-      /* Emit the sends and recvs for the data. */
-      size_t offset_send = sent;
-      size_t offset_recv = recvd;
-      activenodes = 0;
-
-      for (int k = 0; k < nr_nodes; k++) {
-
-        /* Indices in the count arrays of the node of interest */
-        const int ind_send = nodeID * nr_nodes + k;
-        const int ind_recv = k * nr_nodes + nodeID;
-
-        /* Are we sending any data this loop? */
-        int sending = counts[ind_send] - sent;
-        if (sending > 0) {
-          activenodes++;
-          if (sending > chunk) sending = chunk;
-
-          /* If the send and receive is local then just copy. */
-          if (k == nodeID) {
-            int receiving = counts[ind_recv] - recvd;
-            if (receiving > chunk) receiving = chunk;
-            memcpy(&parts_new[offset_recv * sizeofparts],
-                   &parts[offset_send * sizeofparts], sizeofparts * receiving);
-          } else {
-            /* Otherwise send it. */
-            int res =
-                MPI_Isend(&parts[offset_send * sizeofparts], sending, mpi_type,
-                          k, ind_send, MPI_COMM_WORLD, &reqs[2 * k + 0]);
-            if (res != MPI_SUCCESS)
-              mpi_error(res, "Failed to isend parts to node %i.", k);
-          }
-        }
+    /* Count the requests we need, only for the nodes we talk to. */
+    int nr_reqs = 0;
+    for (int k = 0; k < nr_nodes; k++) {
+      if (k == nodeID) continue;
+      nr_reqs += (counts[k] + chunk - 1) / chunk;
+      nr_reqs += (recv_counts[k] + chunk - 1) / chunk;
+    }
 
-        /* If we're sending to this node, then move past it to next. */
-        if (counts[ind_send] > 0) offset_send += counts[ind_send];
-
-        /* Are we receiving any data from this node? Note already done if coming
-         * from this node. */
-        if (k != nodeID) {
-          int receiving = counts[ind_recv] - recvd;
-          if (receiving > 0) {
-            activenodes++;
-            if (receiving > chunk) receiving = chunk;
-            int res = MPI_Irecv(&parts_new[offset_recv * sizeofparts],
-                                receiving, mpi_type, k, ind_recv,
-                                MPI_COMM_WORLD, &reqs[2 * k + 1]);
-            if (res != MPI_SUCCESS)
-              mpi_error(res, "Failed to emit irecv of parts from node %i.", k);
-          }
-        }
+    /* Prepare MPI requests for the asynchronous communications, recording
+     * which node each receive is coming from (-1 for sends). */
+    MPI_Request *reqs = NULL;
+    int *req_nodes = NULL, *req_indices = NULL, *pending = NULL;
+    if ((reqs = (MPI_Request *)malloc(sizeof(MPI_Request) *
+                                      max(nr_reqs, 1))) == NULL ||
+        (req_nodes = (int *)malloc(sizeof(int) * max(nr_reqs, 1))) == NULL ||
+        (req_indices = (int *)malloc(sizeof(int) * max(nr_reqs, 1))) ==
+            NULL ||
+        (pending = (int *)calloc(nr_nodes, sizeof(int))) == NULL)
+      error("Failed to allocate MPI request list.");
 
-        /* If we're receiving from this node, then move past it to next. */
-        if (counts[ind_recv] > 0) offset_recv += counts[ind_recv];
+    /* Emit the receives first, all chunks at once. */
+    int r = 0;
+    for (int k = 0; k < nr_nodes; k++) {
+      if (k == nodeID) continue;
+      for (int i = 0, n = 0; i < recv_counts[k]; n++) {
+        const int recvc = min(chunk, recv_counts[k] - i);
+        const size_t recvo = offset_recv[k] + i;
+        int res = MPI_Irecv(&parts_new[recvo * sizeofparts], recvc, mpi_type,
+                            k, n, comm, &reqs[r]);
+        if (res != MPI_SUCCESS)
+          mpi_error(res, "Failed to emit irecv of parts from node %i.", k);
+        req_nodes[r++] = k;
+        pending[k]++;
+        i += recvc;
       }
+    }
 
-      /* Wait for all the sends and recvs to tumble in. */
-      MPI_Status stats[2 * nr_nodes];
-      int res;
-      if ((res = MPI_Waitall(2 * nr_nodes, reqs, stats)) != MPI_SUCCESS) {
-        for (int k = 0; k < 2 * nr_nodes; k++) {
-          char buff[MPI_MAX_ERROR_STRING];
-          MPI_Error_string(stats[k].MPI_ERROR, buff, &res);
-          message("request from source %i, tag %i has error '%s'.",
-                  stats[k].MPI_SOURCE, stats[k].MPI_TAG, buff);
-        }
-        error("Failed during waitall for part data.");
+    /* Then the sends. */
+    for (int k = 0; k < nr_nodes; k++) {
+      if (k == nodeID) continue;
+      for (int i = 0, n = 0; i < counts[k]; n++) {
+        const int sendc = min(chunk, counts[k] - i);
+        const size_t sendo = offset_send[k] + i;
+        int res = MPI_Isend(&parts[sendo * sizeofparts], sendc, mpi_type, k, n,
+                            comm, &reqs[r]);
+        if (res != MPI_SUCCESS)
+          mpi_error(res, "Failed to isend parts to node %i.", k);
+        req_nodes[r++] = -1;
+        i += sendc;
       }
+    }
 
-      /* Move to next chunks. */
-      sent += chunk;
-      recvd += chunk;
+    /* Copy our own particles while the messages are in flight. */
+    if (counts[nodeID] > 0) {
+      memcpy(&parts_new[offset_recv[nodeID] * sizeofparts],
+             &parts[offset_send[nodeID] * sizeofparts],
+             sizeofparts * counts[nodeID]);
+      if (recv_done != NULL) recv_done(nodeID, parts_new, recv_data);
+    }
+
+    /* Process the messages as they tumble in. */
+    int remaining = nr_reqs;
+    while (remaining > 0) {
+      int nr_done = 0;
+      int res = MPI_Waitsome(nr_reqs, reqs, &nr_done, req_indices,
+                             MPI_STATUSES_IGNORE);
+      if (res != MPI_SUCCESS)
+        mpi_error(res, "Failed during waitsome for %s data.", label);
+      if (nr_done == MPI_UNDEFINED) break;
+
+      for (int i = 0; i < nr_done; i++) {
+        const int k = req_nodes[req_indices[i]];
+        if (k >= 0 && --pending[k] == 0 && recv_done != NULL)
+          recv_done(k, parts_new, recv_data);
+      }
+      remaining -= nr_done;
     }
 
     /* Free temps. */
     free(reqs);
+    free(req_nodes);
+    free(req_indices);
+    free(pending);
   }
 
+  free(offset_send);
+  free(offset_recv);
+
   /* And return new memory. */
   return parts_new;
 }
@@ -264,8 +365,7 @@ struct redist_mapper_data {
     int *dest =                                                            \
         mydata->dest + (ptrdiff_t)(parts - (struct TYPE *)mydata->base);   \
     int *lcounts = NULL;                                                   \
-    if ((lcounts = (int *)calloc(                                          \
-             sizeof(int), mydata->nr_nodes * mydata->nr_nodes)) == NULL)   \
+    if ((lcounts = (int *)calloc(sizeof(int), mydata->nr_nodes)) == NULL) \
       error("Failed to allocate counts thread-specific buffer");           \
     for (int k = 0; k < num_elements; k++) {                               \
       for (int j = 0; j < 3; j++) {                                        \
@@ -278,10 +378,9 @@ struct redist_mapper_data {
                                  parts[k].x[1] * s->iwidth[1],             \
                                  parts[k].x[2] * s->iwidth[2]);            \
       dest[k] = s->cells_top[cid].nodeID;                                  \
-      size_t ind = mydata->nodeID * mydata->nr_nodes + dest[k];            \
-      lcounts[ind] += 1;                                                   \
+      lcounts[dest[k]] += 1;                                               \
     }                                                                      \
-    for (int k = 0; k < (mydata->nr_nodes * mydata->nr_nodes); k++)        \
+    for (int k = 0; k < mydata->nr_nodes; k++)                             \
       atomic_add(&mydata->counts[k], lcounts[k]);                          \
     free(lcounts);                                                         \
   }
@@ -324,10 +423,8 @@ static void ENGINE_REDISTRIBUTE_DEST_MAPPER(bpart);
 
 /* Support for saving the linkage between gparts and parts/sparts. */
 struct savelink_mapper_data {
-  int nr_nodes;
   int *counts;
   void *parts;
-  int nodeID;
 };
 
 /**
@@ -345,8 +442,6 @@ struct savelink_mapper_data {
     int *nodes = (int *)map_data;                                              \
     struct savelink_mapper_data *mydata =                                      \
         (struct savelink_mapper_data *)extra_data;                             \
-    int nodeID = mydata->nodeID;                                               \
-    int nr_nodes = mydata->nr_nodes;                                           \
     int *counts = mydata->counts;                                              \
     struct TYPE *parts = (struct TYPE *)mydata->parts;                         \
                                                                                \
@@ -354,9 +449,9 @@ struct savelink_mapper_data {
       int node = nodes[j];                                                     \
       int count = 0;                                                           \
       size_t offset = 0;                                                       \
-      for (int i = 0; i < node; i++) offset += counts[nodeID * nr_nodes + i];  \
+      for (int i = 0; i < node; i++) offset += counts[i];                      \
                                                                                \
-      for (int k = 0; k < counts[nodeID * nr_nodes + node]; k++) {             \
+      for (int k = 0; k < counts[node]; k++) {                                 \
         if (parts[k + offset].gpart != NULL) {                                 \
           if (CHECKS)                                                          \
             if (parts[k + offset].gpart->id_or_neg_offset > 0)                 \
@@ -400,103 +495,97 @@ static void ENGINE_REDISTRIBUTE_SAVELINK_MAPPER(bpart, 0);
 
 #endif /* savelink_mapper_data */
 
-#ifdef WITH_MPI /* relink_mapper_data */
+#ifdef WITH_MPI /* relink_data */
 
 /* Support for relinking parts, gparts, sparts and bparts after moving between
  * nodes. */
-struct relink_mapper_data {
-  int nodeID;
-  int nr_nodes;
-  int *counts;
-  int *s_counts;
+struct relink_data {
+  size_t *offset_parts;
+  size_t *offset_gparts;
+  size_t *offset_sparts;
+  size_t *offset_bparts;
   int *g_counts;
-  int *b_counts;
+  int node;
   struct space *s;
+  struct threadpool *tp;
 };
 
 /**
- * @brief Restore the part/gpart and spart/gpart links for a list of nodes.
+ * @brief Restore the part/gpart, spart/gpart and bpart/gpart links of a
+ * chunk of the gparts received from one node.
  *
- * @param map_data address of nodes to process.
- * @param num_elements the number nodes to process.
- * @param extra_data additional data defining the context (a
- * relink_mapper_data).
+ * @param map_data the chunk of #gpart to relink.
+ * @param num_elements the number of #gpart in the chunk.
+ * @param extra_data additional data defining the context (a relink_data).
  */
 static void engine_redistribute_relink_mapper(void *map_data, int num_elements,
                                               void *extra_data) {
 
-  int *nodes = (int *)map_data;
-  struct relink_mapper_data *mydata = (struct relink_mapper_data *)extra_data;
-
-  int nodeID = mydata->nodeID;
-  int nr_nodes = mydata->nr_nodes;
-  int *counts = mydata->counts;
-  int *g_counts = mydata->g_counts;
-  int *s_counts = mydata->s_counts;
-  int *b_counts = mydata->b_counts;
+  struct gpart *gparts = (struct gpart *)map_data;
+  struct relink_data *mydata = (struct relink_data *)extra_data;
   struct space *s = mydata->s;
+  const int node = mydata->node;
 
   for (int i = 0; i < num_elements; i++) {
 
-    int node = nodes[i];
-
-    /* Get offsets to correct parts of the counts arrays for this node. */
-    size_t offset_parts = 0;
-    size_t offset_gparts = 0;
-    size_t offset_sparts = 0;
-    size_t offset_bparts = 0;
-    for (int n = 0; n < node; n++) {
-      int ind_recv = n * nr_nodes + nodeID;
-      offset_parts += counts[ind_recv];
-      offset_gparts += g_counts[ind_recv];
-      offset_sparts += s_counts[ind_recv];
-      offset_bparts += b_counts[ind_recv];
-    }
+    /* Does this gpart have a gas partner ? */
+    if (gparts[i].type == swift_type_gas) {
 
-    /* Number of gparts sent from this node. */
-    int ind_recv = node * nr_nodes + nodeID;
-    const size_t count_gparts = g_counts[ind_recv];
+      const ptrdiff_t partner_index =
+          mydata->offset_parts[node] - gparts[i].id_or_neg_offset;
 
-    /* Loop over the gparts received from this node */
-    for (size_t k = offset_gparts; k < offset_gparts + count_gparts; k++) {
+      /* Re-link */
+      gparts[i].id_or_neg_offset = -partner_index;
+      s->parts[partner_index].gpart = &gparts[i];
+    }
 
-      /* Does this gpart have a gas partner ? */
-      if (s->gparts[k].type == swift_type_gas) {
+    /* Does this gpart have a star partner ? */
+    else if (gparts[i].type == swift_type_stars) {
 
-        const ptrdiff_t partner_index =
-            offset_parts - s->gparts[k].id_or_neg_offset;
+      const ptrdiff_t partner_index =
+          mydata->offset_sparts[node] - gparts[i].id_or_neg_offset;
 
-        /* Re-link */
-        s->gparts[k].id_or_neg_offset = -partner_index;
-        s->parts[partner_index].gpart = &s->gparts[k];
-      }
+      /* Re-link */
+      gparts[i].id_or_neg_offset = -partner_index;
+      s->sparts[partner_index].gpart = &gparts[i];
+    }
 
-      /* Does this gpart have a star partner ? */
-      else if (s->gparts[k].type == swift_type_stars) {
+    /* Does this gpart have a black hole partner ? */
+    else if (gparts[i].type == swift_type_black_hole) {
 
-        const ptrdiff_t partner_index =
-            offset_sparts - s->gparts[k].id_or_neg_offset;
+      const ptrdiff_t partner_index =
+          mydata->offset_bparts[node] - gparts[i].id_or_neg_offset;
 
-        /* Re-link */
-        s->gparts[k].id_or_neg_offset = -partner_index;
-        s->sparts[partner_index].gpart = &s->gparts[k];
-      }
+      /* Re-link */
+      gparts[i].id_or_neg_offset = -partner_index;
+      s->bparts[partner_index].gpart = &gparts[i];
+    }
+  }
+}
 
-      /* Does this gpart have a black hole partner ? */
-      else if (s->gparts[k].type == swift_type_black_hole) {
+/**
+ * @brief Restore the links of the gparts received from one node.
+ *
+ * Called by engine_do_redistribute() as soon as the gparts of that node have
+ * arrived, so that the relinking overlaps with the remaining communications.
+ *
+ * @param node the node the gparts were received from.
+ * @param parts_new the new #gpart array being filled.
+ * @param extra_data additional data defining the context (a relink_data).
+ */
+static void engine_redistribute_relink(int node, char *parts_new,
+                                       void *extra_data) {
 
-        const ptrdiff_t partner_index =
-            offset_bparts - s->gparts[k].id_or_neg_offset;
+  struct relink_data *mydata = (struct relink_data *)extra_data;
+  struct gpart *gparts = (struct gpart *)parts_new;
 
-        /* Re-link */
-        s->gparts[k].id_or_neg_offset = -partner_index;
-        s->bparts[partner_index].gpart = &s->gparts[k];
-      }
-    }
-  }
+  mydata->node = node;
+  threadpool_map(mydata->tp, engine_redistribute_relink_mapper,
+                 &gparts[mydata->offset_gparts[node]], mydata->g_counts[node],
+                 sizeof(struct gpart), threadpool_auto_chunk_size, mydata);
 }
 
-#endif /* relink_mapper_data */
+#endif /* relink_data */
 
 /**
  * @brief Redistribute the particles amongst the nodes according
@@ -505,12 +594,14 @@ static void engine_redistribute_relink_mapper(void *map_data, int num_elements,
  * The strategy here is as follows:
  * 1) Each node counts the number of particles it has to send to each other
  * node.
- * 2) The number of particles of each type is then exchanged.
+ * 2) The number of particles of each type is then sent to the nodes that
+ * will receive some, without any global count matrix.
  * 3) The particles to send are placed in a temporary buffer in which the
  * part-gpart links are preserved.
  * 4) Each node allocates enough space for the new particles.
  * 5) Asynchronous or synchronous communications are issued to transfer the
- * data.
+ * data, only between the nodes that exchange particles. The gpart links are
+ * restored as the data from each node arrives.
  *
  *
  * @param e The #engine.
@@ -615,7 +706,7 @@ void engine_redistribute(struct engine *e) {
       nr_gparts -= 1;
 
       /* Swap the particle */
-      memswap(&s->gparts[k], &s->gparts[nr_gparts], sizeof(struct gpart));
+      memswap_gpart(&s->gparts[k], &s->gparts[nr_gparts]);
 
       /* Swap the link with part/spart */
       if (s->gparts[k].type == swift_type_gas) {
@@ -644,9 +735,9 @@ void engine_redistribute(struct engine *e) {
   /* Now we are ready to deal with real particles and can start the exchange. */
 
   /* Allocate temporary arrays to store the counts of particles to be sent
-   * and the destination of each particle */
+   * to each node and the destination of each particle */
   int *counts;
-  if ((counts = (int *)calloc(sizeof(int), nr_nodes * nr_nodes)) == NULL)
+  if ((counts = (int *)calloc(sizeof(int), nr_nodes)) == NULL)
     error("Failed to allocate counts temporary buffer.");
 
   int *dest;
@@ -675,7 +766,7 @@ void engine_redistribute(struct engine *e) {
 
   /* Sort the particles according to their cell index. */
   if (nr_parts > 0)
-    space_parts_sort(s->parts, s->xparts, dest, &counts[nodeID * nr_nodes],
+    space_parts_sort(s->parts, s->xparts, dest, counts,
                      nr_nodes, 0);
 
 #ifdef SWIFT_DEBUG_CHECKS
@@ -713,10 +804,8 @@ void engine_redistribute(struct engine *e) {
   if (nr_parts > 0 && nr_gparts > 0) {
 
     struct savelink_mapper_data savelink_data;
-    savelink_data.nr_nodes = nr_nodes;
     savelink_data.counts = counts;
     savelink_data.parts = (void *)parts;
-    savelink_data.nodeID = nodeID;
     threadpool_map(&e->threadpool, engine_redistribute_savelink_mapper_part,
                    nodes, nr_nodes, sizeof(int), threadpool_auto_chunk_size,
                    &savelink_data);
@@ -725,7 +814,7 @@ void engine_redistribute(struct engine *e) {
 
   /* Get destination of each s-particle */
   int *s_counts;
-  if ((s_counts = (int *)calloc(sizeof(int), nr_nodes * nr_nodes)) == NULL)
+  if ((s_counts = (int *)calloc(sizeof(int), nr_nodes)) == NULL)
     error("Failed to allocate s_counts temporary buffer.");
 
   int *s_dest;
@@ -742,7 +831,7 @@ void engine_redistribute(struct engine *e) {
 
   /* Sort the particles according to their cell index. */
   if (nr_sparts > 0)
-    space_sparts_sort(s->sparts, s_dest, &s_counts[nodeID * nr_nodes], nr_nodes,
+    space_sparts_sort(s->sparts, s_dest, s_counts, nr_nodes,
                       0);
 
 #ifdef SWIFT_DEBUG_CHECKS
@@ -779,10 +868,8 @@ void engine_redistribute(struct engine *e) {
   if (nr_sparts > 0) {
 
     struct savelink_mapper_data savelink_data;
-    savelink_data.nr_nodes = nr_nodes;
     savelink_data.counts = s_counts;
     savelink_data.parts = (void *)sparts;
-    savelink_data.nodeID = nodeID;
     threadpool_map(&e->threadpool, engine_redistribute_savelink_mapper_spart,
                    nodes, nr_nodes, sizeof(int), threadpool_auto_chunk_size,
                    &savelink_data);
@@ -791,7 +878,7 @@ void engine_redistribute(struct engine *e) {
 
   /* Get destination of each b-particle */
   int *b_counts;
-  if ((b_counts = (int *)calloc(sizeof(int), nr_nodes * nr_nodes)) == NULL)
+  if ((b_counts = (int *)calloc(sizeof(int), nr_nodes)) == NULL)
     error("Failed to allocate b_counts temporary buffer.");
 
   int *b_dest;
@@ -808,7 +895,7 @@ void engine_redistribute(struct engine *e) {
 
   /* Sort the particles according to their cell index. */
   if (nr_bparts > 0)
-    space_bparts_sort(s->bparts, b_dest, &b_counts[nodeID * nr_nodes], nr_nodes,
+    space_bparts_sort(s->bparts, b_dest, b_counts, nr_nodes,
                       0);
 
 #ifdef SWIFT_DEBUG_CHECKS
@@ -845,10 +932,8 @@ void engine_redistribute(struct engine *e) {
   if (nr_bparts > 0) {
 
     struct savelink_mapper_data savelink_data;
-    savelink_data.nr_nodes = nr_nodes;
     savelink_data.counts = b_counts;
     savelink_data.parts = (void *)bparts;
-    savelink_data.nodeID = nodeID;
     threadpool_map(&e->threadpool, engine_redistribute_savelink_mapper_bpart,
                    nodes, nr_nodes, sizeof(int), threadpool_auto_chunk_size,
                    &savelink_data);
@@ -857,7 +942,7 @@ void engine_redistribute(struct engine *e) {
 
   /* Get destination of each g-particle */
   int *g_counts;
-  if ((g_counts = (int *)calloc(sizeof(int), nr_nodes * nr_nodes)) == NULL)
+  if ((g_counts = (int *)calloc(sizeof(int), nr_nodes)) == NULL)
     error("Failed to allocate g_gcount temporary buffer.");
 
   int *g_dest;
@@ -875,7 +960,7 @@ void engine_redistribute(struct engine *e) {
   /* Sort the gparticles according to their cell index. */
   if (nr_gparts > 0)
     space_gparts_sort(s->gparts, s->parts, s->sinks, s->sparts, s->bparts,
-                      g_dest, &g_counts[nodeID * nr_nodes], nr_nodes);
+                      g_dest, g_counts, nr_nodes);
 
 #ifdef SWIFT_DEBUG_CHECKS
   /* Verify that the gpart have been sorted correctly. */
@@ -910,77 +995,89 @@ void engine_redistribute(struct engine *e) {
 
   swift_free("g_dest", g_dest);
 
-  /* Get all the counts from all the nodes. */
-  if (MPI_Allreduce(MPI_IN_PLACE, counts, nr_nodes * nr_nodes, MPI_INT, MPI_SUM,
-                    MPI_COMM_WORLD) != MPI_SUCCESS)
-    error("Failed to allreduce particle transfer counts.");
-
-  /* Get all the g_counts from all the nodes. */
-  if (MPI_Allreduce(MPI_IN_PLACE, g_counts, nr_nodes * nr_nodes, MPI_INT,
-                    MPI_SUM, MPI_COMM_WORLD) != MPI_SUCCESS)
-    error("Failed to allreduce gparticle transfer counts.");
+  /* Private communicator for the exchanges of this redistribution. */
+  MPI_Comm comm;
+  MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+
+  /* Find out how many particles of each type we will get from the nodes that
+   * send us some. */
+  const int nr_types = engine_redistribute_nr_types;
+  int *send_counts = NULL, *all_recv_counts = NULL;
+  if ((send_counts = (int *)malloc(sizeof(int) * nr_types * nr_nodes)) ==
+          NULL ||
+      (all_recv_counts = (int *)malloc(sizeof(int) * nr_types * nr_nodes)) ==
+          NULL)
+    error("Failed to allocate counts exchange buffers.");
+  for (int k = 0; k < nr_nodes; k++) {
+    send_counts[k * nr_types + 0] = counts[k];
+    send_counts[k * nr_types + 1] = g_counts[k];
+    send_counts[k * nr_types + 2] = s_counts[k];
+    send_counts[k * nr_types + 3] = b_counts[k];
+  }
 
-  /* Get all the s_counts from all the nodes. */
-  if (MPI_Allreduce(MPI_IN_PLACE, s_counts, nr_nodes * nr_nodes, MPI_INT,
-                    MPI_SUM, MPI_COMM_WORLD) != MPI_SUCCESS)
-    error("Failed to allreduce sparticle transfer counts.");
+  engine_redistribute_exchange_counts(send_counts, all_recv_counts, nr_nodes,
+                                      nodeID, comm);
+
+  int *recv_counts = NULL, *g_recv_counts = NULL, *s_recv_counts = NULL,
+      *b_recv_counts = NULL;
+  if ((recv_counts = (int *)malloc(sizeof(int) * nr_nodes)) == NULL ||
+      (g_recv_counts = (int *)malloc(sizeof(int) * nr_nodes)) == NULL ||
+      (s_recv_counts = (int *)malloc(sizeof(int) * nr_nodes)) == NULL ||
+      (b_recv_counts = (int *)malloc(sizeof(int) * nr_nodes)) == NULL)
+    error("Failed to allocate receive counts buffers.");
+  for (int k = 0; k < nr_nodes; k++) {
+    recv_counts[k] = all_recv_counts[k * nr_types + 0];
+    g_recv_counts[k] = all_recv_counts[k * nr_types + 1];
+    s_recv_counts[k] = all_recv_counts[k * nr_types + 2];
+    b_recv_counts[k] = all_recv_counts[k * nr_types + 3];
+  }
+  free(send_counts);
+  free(all_recv_counts);
+
+  /* Report how many particles will be moved. Note that the reduction must
+   * happen on all the nodes as e->verbose may only be set on node 0. */
+  long long moved[2 * engine_redistribute_nr_types] = {0};
+  for (int k = 0; k < nr_nodes; k++) {
+    moved[0] += counts[k];
+    moved[1] += g_counts[k];
+    moved[2] += s_counts[k];
+    moved[3] += b_counts[k];
+  }
+  moved[4] = moved[0] - counts[nodeID];
+  moved[5] = moved[1] - g_counts[nodeID];
+  moved[6] = moved[2] - s_counts[nodeID];
+  moved[7] = moved[3] - b_counts[nodeID];
 
-  /* Get all the b_counts from all the nodes. */
-  if (MPI_Allreduce(MPI_IN_PLACE, b_counts, nr_nodes * nr_nodes, MPI_INT,
-                    MPI_SUM, MPI_COMM_WORLD) != MPI_SUCCESS)
-    error("Failed to allreduce bparticle transfer counts.");
+  MPI_Reduce((nodeID == 0) ? MPI_IN_PLACE : moved, moved,
+             2 * engine_redistribute_nr_types, MPI_LONG_LONG_INT, MPI_SUM, 0,
+             comm);
 
-  /* Report how many particles will be moved. */
   if (e->verbose) {
     if (e->nodeID == 0) {
-      size_t total = 0, g_total = 0, s_total = 0, b_total = 0;
-      size_t unmoved = 0, g_unmoved = 0, s_unmoved = 0, b_unmoved = 0;
-      for (int p = 0, r = 0; p < nr_nodes; p++) {
-        for (int n = 0; n < nr_nodes; n++) {
-          total += counts[r];
-          g_total += g_counts[r];
-          s_total += s_counts[r];
-          b_total += b_counts[r];
-          if (p == n) {
-            unmoved += counts[r];
-            g_unmoved += g_counts[r];
-            s_unmoved += s_counts[r];
-            b_unmoved += b_counts[r];
-          }
-          r++;
-        }
-      }
-      if (total > 0)
-        message("%zu of %zu (%.2f%%) of particles moved", total - unmoved,
-                total, 100.0 * (double)(total - unmoved) / (double)total);
-      if (g_total > 0)
-        message("%zu of %zu (%.2f%%) of g-particles moved", g_total - g_unmoved,
-                g_total,
-                100.0 * (double)(g_total - g_unmoved) / (double)g_total);
-      if (s_total > 0)
-        message("%zu of %zu (%.2f%%) of s-particles moved", s_total - s_unmoved,
-                s_total,
-                100.0 * (double)(s_total - s_unmoved) / (double)s_total);
-      if (b_total > 0)
-        message("%ld of %ld (%.2f%%) of b-particles moved", b_total - b_unmoved,
-                b_total,
-                100.0 * (double)(b_total - b_unmoved) / (double)b_total);
+      if (moved[0] > 0)
+        message("%lld of %lld (%.2f%%) of particles moved", moved[4], moved[0],
+                100.0 * (double)moved[4] / (double)moved[0]);
+      if (moved[1] > 0)
+        message("%lld of %lld (%.2f%%) of g-particles moved", moved[5],
+                moved[1], 100.0 * (double)moved[5] / (double)moved[1]);
+      if (moved[2] > 0)
+        message("%lld of %lld (%.2f%%) of s-particles moved", moved[6],
+                moved[2], 100.0 * (double)moved[6] / (double)moved[2]);
+      if (moved[3] > 0)
+        message("%lld of %lld (%.2f%%) of b-particles moved", moved[7],
+                moved[3], 100.0 * (double)moved[7] / (double)moved[3]);
     }
   }
 
-  /* Now each node knows how many parts, sparts, bparts, and gparts will be
-   * transferred to every other node. Get the new numbers of particles for this
+  /* Now each node knows how many parts, sparts, bparts, and gparts it will
+   * receive from every other node. Get the new numbers of particles for this
    * node. */
   size_t nr_parts_new = 0, nr_gparts_new = 0, nr_sparts_new = 0,
          nr_bparts_new = 0;
-  for (int k = 0; k < nr_nodes; k++)
-    nr_parts_new += counts[k * nr_nodes + nodeID];
-  for (int k = 0; k < nr_nodes; k++)
-    nr_gparts_new += g_counts[k * nr_nodes + nodeID];
-  for (int k = 0; k < nr_nodes; k++)
-    nr_sparts_new += s_counts[k * nr_nodes + nodeID];
-  for (int k = 0; k < nr_nodes; k++)
-    nr_bparts_new += b_counts[k * nr_nodes + nodeID];
+  for (int k = 0; k < nr_nodes; k++) nr_parts_new += recv_counts[k];
+  for (int k = 0; k < nr_nodes; k++) nr_gparts_new += g_recv_counts[k];
+  for (int k = 0; k < nr_nodes; k++) nr_sparts_new += s_recv_counts[k];
+  for (int k = 0; k < nr_nodes; k++) nr_bparts_new += b_recv_counts[k];
 
 #ifdef WITH_LOGGER
   if (e->policy & engine_policy_logger) {
@@ -991,51 +1088,52 @@ void engine_redistribute(struct engine *e) {
     size_t bpart_offset = 0;
 
     for (int i = 0; i < nr_nodes; i++) {
-      const size_t c_ind = engine_rank * nr_nodes + i;
 
       /* No need to log the local particles. */
       if (i == engine_rank) {
-        part_offset += counts[c_ind];
-        spart_offset += s_counts[c_ind];
-        gpart_offset += g_counts[c_ind];
-        bpart_offset += b_counts[c_ind];
+        part_offset += counts[i];
+        spart_offset += s_counts[i];
+        gpart_offset += g_counts[i];
+        bpart_offset += b_counts[i];
         continue;
       }
       const uint32_t flag = logger_pack_flags_and_data(logger_flag_mpi_exit, i);
 
       /* Log the hydro parts. */
       logger_log_parts(e->logger, &parts[part_offset], &xparts[part_offset],
-                       counts[c_ind], e, /* log_all_fields */ 1, flag);
+                       counts[i], e, /* log_all_fields */ 1, flag);
 
       /* Log the stellar parts. */
-      logger_log_sparts(e->logger, &sparts[spart_offset], s_counts[c_ind], e,
+      logger_log_sparts(e->logger, &sparts[spart_offset], s_counts[i], e,
                         /* log_all_fields */ 1, flag);
 
       /* Log the gparts */
-      logger_log_gparts(e->logger, &gparts[gpart_offset], g_counts[c_ind], e,
+      logger_log_gparts(e->logger, &gparts[gpart_offset], g_counts[i], e,
                         /* log_all_fields */ 1, flag);
 
       /* Log the bparts */
-      if (b_counts[c_ind] > 0) {
+      if (b_counts[i] > 0) {
         error("TODO");
       }
 
       /* Update the counters */
-      part_offset += counts[c_ind];
-      spart_offset += s_counts[c_ind];
-      gpart_offset += g_counts[c_ind];
-      bpart_offset += b_counts[c_ind];
+      part_offset += counts[i];
+      spart_offset += s_counts[i];
+      gpart_offset += g_counts[i];
+      bpart_offset += b_counts[i];
     }
   }
 #endif
 
   /* Now exchange the particles, type by type to keep the memory required
-   * under control. */
+   * under control. The gparts go last so that their links to the other
+   * particles can be restored as soon as they arrive from each node. */
 
   /* SPH particles. */
   void *new_parts = engine_do_redistribute(
-      "parts", counts, (char *)s->parts, nr_parts_new, sizeof(struct part),
-      part_align, part_mpi_type, nr_nodes, nodeID, e->syncredist);
+      "parts", counts, recv_counts, (char *)s->parts, nr_parts_new,
+      sizeof(struct part), part_align, part_mpi_type, nr_nodes, nodeID,
+      e->syncredist, comm, NULL, NULL);
   swift_free("parts", s->parts);
   s->parts = (struct part *)new_parts;
   s->nr_parts = nr_parts_new;
@@ -1043,41 +1141,78 @@ void engine_redistribute(struct engine *e) {
 
   /* Extra SPH particle properties. */
   new_parts = engine_do_redistribute(
-      "xparts", counts, (char *)s->xparts, nr_parts_new, sizeof(struct xpart),
-      xpart_align, xpart_mpi_type, nr_nodes, nodeID, e->syncredist);
+      "xparts", counts, recv_counts, (char *)s->xparts, nr_parts_new,
+      sizeof(struct xpart), xpart_align, xpart_mpi_type, nr_nodes, nodeID,
+      e->syncredist, comm, NULL, NULL);
   swift_free("xparts", s->xparts);
   s->xparts = (struct xpart *)new_parts;
 
-  /* Gravity particles. */
-  new_parts =
-      engine_do_redistribute("gparts", g_counts, (char *)s->gparts,
-                             nr_gparts_new, sizeof(struct gpart), gpart_align,
-                             gpart_mpi_type, nr_nodes, nodeID, e->syncredist);
-  swift_free("gparts", s->gparts);
-  s->gparts = (struct gpart *)new_parts;
-  s->nr_gparts = nr_gparts_new;
-  s->size_gparts = engine_redistribute_alloc_margin * nr_gparts_new;
-
   /* Star particles. */
-  new_parts =
-      engine_do_redistribute("sparts", s_counts, (char *)s->sparts,
-                             nr_sparts_new, sizeof(struct spart), spart_align,
-                             spart_mpi_type, nr_nodes, nodeID, e->syncredist);
+  new_parts = engine_do_redistribute(
+      "sparts", s_counts, s_recv_counts, (char *)s->sparts, nr_sparts_new,
+      sizeof(struct spart), spart_align, spart_mpi_type, nr_nodes, nodeID,
+      e->syncredist, comm, NULL, NULL);
   swift_free("sparts", s->sparts);
   s->sparts = (struct spart *)new_parts;
   s->nr_sparts = nr_sparts_new;
   s->size_sparts = engine_redistribute_alloc_margin * nr_sparts_new;
 
   /* Black holes particles. */
-  new_parts =
-      engine_do_redistribute("bparts", b_counts, (char *)s->bparts,
-                             nr_bparts_new, sizeof(struct bpart), bpart_align,
-                             bpart_mpi_type, nr_nodes, nodeID, e->syncredist);
+  new_parts = engine_do_redistribute(
+      "bparts", b_counts, b_recv_counts, (char *)s->bparts, nr_bparts_new,
+      sizeof(struct bpart), bpart_align, bpart_mpi_type, nr_nodes, nodeID,
+      e->syncredist, comm, NULL, NULL);
   swift_free("bparts", s->bparts);
   s->bparts = (struct bpart *)new_parts;
   s->nr_bparts = nr_bparts_new;
   s->size_bparts = engine_redistribute_alloc_margin * nr_bparts_new;
 
+  /* Gravity particles. We restore the part<->gpart, spart<->gpart and
+   * bpart<->gpart links of the gparts coming from each node as soon as they
+   * have arrived. */
+  struct relink_data relink_data;
+  relink_data.s = s;
+  relink_data.tp = &e->threadpool;
+  relink_data.g_counts = g_recv_counts;
+  if ((relink_data.offset_parts = (size_t *)malloc(sizeof(size_t) *
+                                                   nr_nodes)) == NULL ||
+      (relink_data.offset_gparts = (size_t *)malloc(sizeof(size_t) *
+                                                    nr_nodes)) == NULL ||
+      (relink_data.offset_sparts = (size_t *)malloc(sizeof(size_t) *
+                                                    nr_nodes)) == NULL ||
+      (relink_data.offset_bparts = (size_t *)malloc(sizeof(size_t) *
+                                                    nr_nodes)) == NULL)
+    error("Failed to allocate relink offsets buffers.");
+  relink_data.offset_parts[0] = 0;
+  relink_data.offset_gparts[0] = 0;
+  relink_data.offset_sparts[0] = 0;
+  relink_data.offset_bparts[0] = 0;
+  for (int k = 1; k < nr_nodes; k++) {
+    relink_data.offset_parts[k] =
+        relink_data.offset_parts[k - 1] + recv_counts[k - 1];
+    relink_data.offset_gparts[k] =
+        relink_data.offset_gparts[k - 1] + g_recv_counts[k - 1];
+    relink_data.offset_sparts[k] =
+        relink_data.offset_sparts[k - 1] + s_recv_counts[k - 1];
+    relink_data.offset_bparts[k] =
+        relink_data.offset_bparts[k - 1] + b_recv_counts[k - 1];
+  }
+
+  new_parts = engine_do_redistribute(
+      "gparts", g_counts, g_recv_counts, (char *)s->gparts, nr_gparts_new,
+      sizeof(struct gpart), gpart_align, gpart_mpi_type, nr_nodes, nodeID,
+      e->syncredist, comm, engine_redistribute_relink, &relink_data);
+  swift_free("gparts", s->gparts);
+  s->gparts = (struct gpart *)new_parts;
+  s->nr_gparts = nr_gparts_new;
+  s->size_gparts = engine_redistribute_alloc_margin * nr_gparts_new;
+
+  free(relink_data.offset_parts);
+  free(relink_data.offset_gparts);
+  free(relink_data.offset_sparts);
+  free(relink_data.offset_bparts);
+  MPI_Comm_free(&comm);
+
   /* All particles have now arrived. Time for some final operations on the
      stuff we just received */
 
@@ -1089,14 +1224,13 @@ void engine_redistribute(struct engine *e) {
     size_t bpart_offset = 0;
 
     for (int i = 0; i < nr_nodes; i++) {
-      const size_t c_ind = i * nr_nodes + engine_rank;
 
       /* No need to log the local particles. */
       if (i == engine_rank) {
-        part_offset += counts[c_ind];
-        spart_offset += s_counts[c_ind];
-        gpart_offset += g_counts[c_ind];
-        bpart_offset += b_counts[c_ind];
+        part_offset += recv_counts[i];
+        spart_offset += s_recv_counts[i];
+        gpart_offset += g_recv_counts[i];
+        bpart_offset += b_recv_counts[i];
         continue;
       }
 
@@ -1105,45 +1239,31 @@ void engine_redistribute(struct engine *e) {
 
       /* Log the hydro parts. */
       logger_log_parts(e->logger, &s->parts[part_offset],
-                       &s->xparts[part_offset], counts[c_ind], e,
+                       &s->xparts[part_offset], recv_counts[i], e,
                        /* log_all_fields */ 1, flag);
 
       /* Log the stellar parts. */
-      logger_log_sparts(e->logger, &s->sparts[spart_offset], s_counts[c_ind], e,
-                        /* log_all_fields */ 1, flag);
+      logger_log_sparts(e->logger, &s->sparts[spart_offset], s_recv_counts[i],
+                        e, /* log_all_fields */ 1, flag);
 
       /* Log the gparts */
-      logger_log_gparts(e->logger, &s->gparts[gpart_offset], g_counts[c_ind], e,
-                        /* log_all_fields */ 1, flag);
+      logger_log_gparts(e->logger, &s->gparts[gpart_offset], g_recv_counts[i],
+                        e, /* log_all_fields */ 1, flag);
 
       /* Log the bparts */
-      if (b_counts[c_ind] > 0) {
+      if (b_recv_counts[i] > 0) {
         error("TODO");
       }
 
       /* Update the counters */
-      part_offset += counts[c_ind];
-      spart_offset += s_counts[c_ind];
-      gpart_offset += g_counts[c_ind];
-      bpart_offset += b_counts[c_ind];
+      part_offset += recv_counts[i];
+      spart_offset += s_recv_counts[i];
+      gpart_offset += g_recv_counts[i];
+      bpart_offset += b_recv_counts[i];
     }
   }
 #endif
 
-  /* Restore the part<->gpart and spart<->gpart links.
-   * Generate indices and counts for threadpool tasks. Note we process a node
-   * at a time. */
-  struct relink_mapper_data relink_data;
-  relink_data.s = s;
-  relink_data.counts = counts;
-  relink_data.g_counts = g_counts;
-  relink_data.s_counts = s_counts;
-  relink_data.b_counts = b_counts;
-  relink_data.nodeID = nodeID;
-  relink_data.nr_nodes = nr_nodes;
-
-  threadpool_map(&e->threadpool, engine_redistribute_relink_mapper, nodes,
-                 nr_nodes, sizeof(int), 1, &relink_data);
   free(nodes);
 
   /* Clean up the counts now we are done. */
@@ -1151,6 +1271,10 @@ void engine_redistribute(struct engine *e) {
   free(g_counts);
   free(s_counts);
   free(b_counts);
+  free(recv_counts);
+  free(g_recv_counts);
+  free(s_recv_counts);
+  free(b_recv_counts);
 
 #ifdef SWIFT_DEBUG_CHECKS
   /* Verify that all parts are in the right place. */
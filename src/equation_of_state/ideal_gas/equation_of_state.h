@@ -180,6 +180,16 @@ INLINE static void eos_init(struct eos_parameters *e,
                             const struct phys_const *phys_const,
                             const struct unit_system *us,
                             struct swift_params *params) {}
+
+/**
+ * @brief Free the memory allocated by the eos.
+ *
+ * Nothing to do here since this EoS is parameter-free.
+ *
+ * @param e The #eos_parameters.
+ */
+INLINE static void eos_clean(struct eos_parameters *e) {}
+
 /**
  * @brief Print the equation of state
  *
@@ -201,6 +201,16 @@ __attribute__((always_inline)) INLINE static void eos_init(
       parser_get_param_float(params, "EoS:isothermal_internal_energy");
 }
 
+/**
+ * @brief Free the memory allocated by the eos.
+ *
+ * Nothing to do here since this EoS only has parameters.
+ *
+ * @param e The #eos_parameters.
+ */
+__attribute__((always_inline)) INLINE static void eos_clean(
+    struct eos_parameters *e) {}
+
 /**
  * @brief Print the equation of state
  *
@@ -1338,6 +1338,10 @@ __attribute__((always_inline)) INLINE static void eos_init(
   char ANEOS_iron_table_file[PARSER_MAX_LINE_SIZE];
   char ANEOS_Fe85Si15_table_file[PARSER_MAX_LINE_SIZE];
 
+  // Write binary versions of the SESAME-style tables to be mapped next time?
+  const int write_binary_tables =
+      parser_get_opt_param_int(params, "EoS:planetary_write_binary_tables", 0);
+
   // Set the parameters and material IDs, load tables, etc. for each material
   // and convert to internal units
   // Tillotson
@@ -1395,20 +1399,11 @@ __attribute__((always_inline)) INLINE static void eos_init(
     parser_get_param_string(params, "EoS:planetary_SS08_water_table_file",
                             SS08_water_table_file);
 
-    load_table_SESAME(&e->SESAME_iron, SESAME_iron_table_file);
-    load_table_SESAME(&e->SESAME_basalt, SESAME_basalt_table_file);
-    load_table_SESAME(&e->SESAME_water, SESAME_water_table_file);
-    load_table_SESAME(&e->SS08_water, SS08_water_table_file);
-
-    prepare_table_SESAME(&e->SESAME_iron);
-    prepare_table_SESAME(&e->SESAME_basalt);
-    prepare_table_SESAME(&e->SESAME_water);
-    prepare_table_SESAME(&e->SS08_water);
-
-    convert_units_SESAME(&e->SESAME_iron, us);
-    convert_units_SESAME(&e->SESAME_basalt, us);
-    convert_units_SESAME(&e->SESAME_water, us);
-    convert_units_SESAME(&e->SS08_water, us);
+    struct SESAME_params *mats[4] = {&e->SESAME_iron, &e->SESAME_basalt,
+                                     &e->SESAME_water, &e->SS08_water};
+    char *table_files[4] = {SESAME_iron_table_file, SESAME_basalt_table_file,
+                            SESAME_water_table_file, SS08_water_table_file};
+    init_tables_SESAME(mats, table_files, 4, us, write_binary_tables);
   }
 
   // ANEOS -- using SESAME-style tables
@@ -1425,20 +1420,31 @@ __attribute__((always_inline)) INLINE static void eos_init(
     parser_get_param_string(params, "EoS:planetary_ANEOS_Fe85Si15_table_file",
                             ANEOS_Fe85Si15_table_file);
 
-    load_table_SESAME(&e->ANEOS_forsterite, ANEOS_forsterite_table_file);
-    load_table_SESAME(&e->ANEOS_iron, ANEOS_iron_table_file);
-    load_table_SESAME(&e->ANEOS_Fe85Si15, ANEOS_Fe85Si15_table_file);
-
-    prepare_table_SESAME(&e->ANEOS_forsterite);
-    prepare_table_SESAME(&e->ANEOS_iron);
-    prepare_table_SESAME(&e->ANEOS_Fe85Si15);
-
-    convert_units_SESAME(&e->ANEOS_forsterite, us);
-    convert_units_SESAME(&e->ANEOS_iron, us);
-    convert_units_SESAME(&e->ANEOS_Fe85Si15, us);
+    struct SESAME_params *mats[3] = {&e->ANEOS_forsterite, &e->ANEOS_iron,
+                                     &e->ANEOS_Fe85Si15};
+    char *table_files[3] = {ANEOS_forsterite_table_file, ANEOS_iron_table_file,
+                            ANEOS_Fe85Si15_table_file};
+    init_tables_SESAME(mats, table_files, 3, us, write_binary_tables);
   }
 }
 
+/**
+ * @brief Free the tables of the equation of state
+ *
+ * @param e The #eos_parameters
+ */
+__attribute__((always_inline)) INLINE static void eos_clean(
+    struct eos_parameters *e) {
+
+  clean_table_SESAME(&e->SESAME_iron);
+  clean_table_SESAME(&e->SESAME_basalt);
+  clean_table_SESAME(&e->SESAME_water);
+  clean_table_SESAME(&e->SS08_water);
+  clean_table_SESAME(&e->ANEOS_forsterite);
+  clean_table_SESAME(&e->ANEOS_iron);
+  clean_table_SESAME(&e->ANEOS_Fe85Si15);
+}
+
 /**
  * @brief Print the equation of state
  *
@@ -29,20 +29,33 @@
  */
 
 /* Some standard headers. */
+#include <fcntl.h>
 #include <float.h>
 #include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
 
 /* Local headers. */
 #include "adiabatic_index.h"
 #include "common_io.h"
 #include "equation_of_state.h"
 #include "inline.h"
+#include "minmax.h"
+#include "parser.h"
 #include "physical_constants.h"
 #include "units.h"
 #include "utilities.h"
 
 // SESAME parameters
 struct SESAME_params {
+  // Tables, in SI units
   float *table_log_rho;
   float *table_log_u_rho_T;
   float *table_P_rho_T;
@@ -50,9 +63,32 @@ struct SESAME_params {
   float *table_s_rho_T;
   int num_rho, num_T;
   float P_tiny, c_tiny;
+  // Uniform grids in log(rho), and in log(u) at each density, giving the
+  // table index at the start of each grid cell to begin the searches from
+  int *grid_idx_rho, *grid_idx_u_rho;
+  float grid_log_rho_min, grid_inv_dlog_rho;
+  float *grid_log_u_min, *grid_inv_dlog_u;
+  // Conversions between internal units and the units of the tables
+  float log_rho_to_SI, log_u_to_SI, P_from_SI, c_from_SI;
+  // Size of the memory-mapped binary table (0 if read from a text file)
+  size_t mapped_size;
   enum eos_planetary_material_id mat_id;
 };
 
+// Binary SESAME tables, as written by write_table_binary_SESAME()
+#define SESAME_binary_magic "SWIFTEoS"
+#define SESAME_binary_version 1
+
+// Header of the binary tables. It is followed by the prepared log(rho),
+// log(u), P, c, and s tables in SI units, in that order.
+struct SESAME_binary_header {
+  char magic[8];
+  int version;
+  int num_rho, num_T;
+  float P_tiny, c_tiny;
+  int padding;
+};
+
 // Parameter values for each material (cgs units)
 INLINE static void set_SESAME_iron(struct SESAME_params *mat,
                                    enum eos_planetary_material_id mat_id) {
@@ -90,10 +126,64 @@ INLINE static void set_ANEOS_Fe85Si15(struct SESAME_params *mat,
   mat->mat_id = mat_id;
 }
 
+// Map the tables from a binary file, returns 0 if not a binary table file
+INLINE static int load_table_binary_SESAME(struct SESAME_params *mat,
+                                           const char *table_file) {
+
+  const int fd = open(table_file, O_RDONLY);
+  if (fd < 0) error("Failed to open the SESAME EoS file '%s'", table_file);
+
+  // Check whether this is a binary table at all
+  struct SESAME_binary_header header;
+  if (read(fd, &header, sizeof(header)) != sizeof(header) ||
+      memcmp(header.magic, SESAME_binary_magic, sizeof(header.magic)) != 0) {
+    close(fd);
+    return 0;
+  }
+  if (header.version != SESAME_binary_version)
+    error("Unsupported version %d of the binary SESAME EoS table %s",
+          header.version, table_file);
+
+  const size_t num_values =
+      header.num_rho + 4 * (size_t)header.num_rho * header.num_T;
+  const size_t size = sizeof(header) + num_values * sizeof(float);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size != size)
+    error("Wrong size for the binary SESAME EoS table %s", table_file);
+
+  // The tables are never written to, so all the ranks on a node can share
+  // the same pages
+  void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
+    error("Failed to map the binary SESAME EoS table %s", table_file);
+  close(fd);
+
+  mat->num_rho = header.num_rho;
+  mat->num_T = header.num_T;
+  mat->P_tiny = header.P_tiny;
+  mat->c_tiny = header.c_tiny;
+
+  float *data = (float *)((char *)map + sizeof(header));
+  const size_t num_rho_T = (size_t)mat->num_rho * mat->num_T;
+  mat->table_log_rho = data;
+  mat->table_log_u_rho_T = data + mat->num_rho;
+  mat->table_P_rho_T = mat->table_log_u_rho_T + num_rho_T;
+  mat->table_c_rho_T = mat->table_P_rho_T + num_rho_T;
+  mat->table_s_rho_T = mat->table_c_rho_T + num_rho_T;
+  mat->mapped_size = size;
+
+  return 1;
+}
+
 // Read the tables from file
 INLINE static void load_table_SESAME(struct SESAME_params *mat,
                                      char *table_file) {
 
+  // Binary tables are already prepared, nothing to parse
+  mat->mapped_size = 0;
+  if (load_table_binary_SESAME(mat, table_file)) return;
+
   // Load table contents from file
   FILE *f = fopen(table_file, "r");
   if (f == NULL) error("Failed to open the SESAME EoS file '%s'", table_file);
@@ -164,9 +254,55 @@ INLINE static void load_table_SESAME(struct SESAME_params *mat,
   fclose(f);
 }
 
+// Uniform grid over a monotonically increasing array, giving for each of its
+// n cells the last index with array[index] <= the start of the cell
+INLINE static void init_grid_SESAME(const float *array, const int n,
+                                    int *grid_idx, float *grid_min,
+                                    float *grid_inv_dx) {
+
+  const float dx = (array[n - 1] - array[0]) / n;
+  *grid_min = array[0];
+  *grid_inv_dx = (dx > 0.f) ? 1.f / dx : 0.f;
+
+  int idx = 0;
+  for (int k = 0; k < n; k++) {
+    const float x = array[0] + k * dx;
+    while ((idx < n - 2) && (array[idx + 1] <= x)) idx++;
+    grid_idx[k] = idx;
+  }
+}
+
+// Set up the uniform grids to search the tables
+INLINE static void init_grids_SESAME(struct SESAME_params *mat) {
+
+  mat->grid_idx_rho = (int *)malloc(mat->num_rho * sizeof(int));
+  mat->grid_idx_u_rho = (int *)malloc(mat->num_rho * mat->num_T * sizeof(int));
+  mat->grid_log_u_min = (float *)malloc(mat->num_rho * sizeof(float));
+  mat->grid_inv_dlog_u = (float *)malloc(mat->num_rho * sizeof(float));
+  if (mat->grid_idx_rho == NULL || mat->grid_idx_u_rho == NULL ||
+      mat->grid_log_u_min == NULL || mat->grid_inv_dlog_u == NULL)
+    error("Failed to allocate the SESAME EoS grids");
+
+  init_grid_SESAME(mat->table_log_rho, mat->num_rho, mat->grid_idx_rho,
+                   &mat->grid_log_rho_min, &mat->grid_inv_dlog_rho);
+
+  for (int i_rho = 0; i_rho < mat->num_rho; i_rho++) {
+    init_grid_SESAME(mat->table_log_u_rho_T + i_rho * mat->num_T, mat->num_T,
+                     mat->grid_idx_u_rho + i_rho * mat->num_T,
+                     &mat->grid_log_u_min[i_rho],
+                     &mat->grid_inv_dlog_u[i_rho]);
+  }
+}
+
 // Misc. modifications
 INLINE static void prepare_table_SESAME(struct SESAME_params *mat) {
 
+  // Binary tables were prepared before being written
+  if (mat->mapped_size > 0) {
+    init_grids_SESAME(mat);
+    return;
+  }
+
   // Convert densities to log(density)
   for (int i_rho = 0; i_rho < mat->num_rho; i_rho++) {
     mat->table_log_rho[i_rho] = logf(mat->table_log_rho[i_rho]);
@@ -222,6 +358,90 @@ INLINE static void prepare_table_SESAME(struct SESAME_params *mat) {
   // Tiny pressure to allow interpolation near non-positive values
   mat->P_tiny *= 1e-3f;
   mat->c_tiny *= 1e-3f;
+
+  init_grids_SESAME(mat);
+}
+
+// Write the prepared tables to a binary file (the text file name + ".bin")
+// that can be memory-mapped instead of parsed in later runs
+INLINE static void write_table_binary_SESAME(const struct SESAME_params *mat,
+                                             const char *table_file) {
+
+  // Nothing to do if the tables were read from a binary file already
+  if (mat->mapped_size > 0) return;
+
+  char filename[PARSER_MAX_LINE_SIZE + 8];
+  char tmp_filename[PARSER_MAX_LINE_SIZE + 16];
+  sprintf(filename, "%s.bin", table_file);
+  sprintf(tmp_filename, "%s.XXXXXX", filename);
+
+  // Write to a temporary file and atomically replace the final one, so that
+  // other runs never map a partially written table
+  const int fd = mkstemp(tmp_filename);
+  if (fd < 0) error("Failed to create the file '%s'", tmp_filename);
+  if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) != 0)
+    error("Failed to set the permissions of '%s'", tmp_filename);
+  FILE *f = fdopen(fd, "wb");
+  if (f == NULL) error("Failed to open the file '%s'", tmp_filename);
+
+  struct SESAME_binary_header header;
+  bzero(&header, sizeof(header));
+  memcpy(header.magic, SESAME_binary_magic, sizeof(header.magic));
+  header.version = SESAME_binary_version;
+  header.num_rho = mat->num_rho;
+  header.num_T = mat->num_T;
+  header.P_tiny = mat->P_tiny;
+  header.c_tiny = mat->c_tiny;
+
+  const size_t num_rho_T = (size_t)mat->num_rho * mat->num_T;
+  if (fwrite(&header, sizeof(header), 1, f) != 1 ||
+      fwrite(mat->table_log_rho, sizeof(float), mat->num_rho, f) !=
+          (size_t)mat->num_rho ||
+      fwrite(mat->table_log_u_rho_T, sizeof(float), num_rho_T, f) !=
+          num_rho_T ||
+      fwrite(mat->table_P_rho_T, sizeof(float), num_rho_T, f) != num_rho_T ||
+      fwrite(mat->table_c_rho_T, sizeof(float), num_rho_T, f) != num_rho_T ||
+      fwrite(mat->table_s_rho_T, sizeof(float), num_rho_T, f) != num_rho_T)
+    error("Failed to write the binary SESAME EoS table '%s'", tmp_filename);
+  if (fclose(f) != 0)
+    error("Failed to close the file '%s'", tmp_filename);
+
+  if (rename(tmp_filename, filename) != 0)
+    error("Failed to rename '%s' to '%s'", tmp_filename, filename);
+
+  message("Wrote the binary SESAME EoS table '%s'", filename);
+}
+
+// Free the tables and the grids
+INLINE static void clean_table_SESAME(struct SESAME_params *mat) {
+
+  if (mat->mapped_size > 0) {
+    void *map =
+        (char *)mat->table_log_rho - sizeof(struct SESAME_binary_header);
+    if (munmap(map, mat->mapped_size) != 0)
+      error("Failed to unmap the binary SESAME EoS table");
+  } else {
+    free(mat->table_log_rho);
+    free(mat->table_log_u_rho_T);
+    free(mat->table_P_rho_T);
+    free(mat->table_c_rho_T);
+    free(mat->table_s_rho_T);
+  }
+  free(mat->grid_idx_rho);
+  free(mat->grid_idx_u_rho);
+  free(mat->grid_log_u_min);
+  free(mat->grid_inv_dlog_u);
+
+  mat->table_log_rho = NULL;
+  mat->table_log_u_rho_T = NULL;
+  mat->table_P_rho_T = NULL;
+  mat->table_c_rho_T = NULL;
+  mat->table_s_rho_T = NULL;
+  mat->grid_idx_rho = NULL;
+  mat->grid_idx_u_rho = NULL;
+  mat->grid_log_u_min = NULL;
+  mat->grid_inv_dlog_u = NULL;
+  mat->mapped_size = 0;
 }
 
 // Convert to internal units
@@ -231,37 +451,137 @@ INLINE static void convert_units_SESAME(struct SESAME_params *mat,
   struct unit_system si;
   units_init_si(&si);
 
-  // All table values in SI
-  // Densities (log)
-  for (int i_rho = 0; i_rho < mat->num_rho; i_rho++) {
-    mat->table_log_rho[i_rho] +=
-        logf(units_cgs_conversion_factor(&si, UNIT_CONV_DENSITY) /
-             units_cgs_conversion_factor(us, UNIT_CONV_DENSITY));
+  // The tables are left in SI (so that binary tables can be shared) and the
+  // inputs and outputs of the look-ups are converted instead
+  mat->log_rho_to_SI =
+      logf(units_cgs_conversion_factor(us, UNIT_CONV_DENSITY) /
+           units_cgs_conversion_factor(&si, UNIT_CONV_DENSITY));
+  mat->log_u_to_SI =
+      logf(units_cgs_conversion_factor(us, UNIT_CONV_ENERGY_PER_UNIT_MASS) /
+           units_cgs_conversion_factor(&si, UNIT_CONV_ENERGY_PER_UNIT_MASS));
+  mat->P_from_SI = units_cgs_conversion_factor(&si, UNIT_CONV_PRESSURE) /
+                   units_cgs_conversion_factor(us, UNIT_CONV_PRESSURE);
+  mat->c_from_SI = units_cgs_conversion_factor(&si, UNIT_CONV_SPEED) /
+                   units_cgs_conversion_factor(us, UNIT_CONV_SPEED);
+}
+
+// Load, prepare and convert a set of SESAME-style tables. When writing the
+// binary tables, only rank 0 parses the text tables and writes them, and the
+// other ranks then map the binary tables once they are complete
+INLINE static void init_tables_SESAME(struct SESAME_params *mats[],
+                                      char *table_files[], const int num_mats,
+                                      const struct unit_system *us,
+                                      const int write_binary_tables) {
+
+  int rank = 0;
+#ifdef WITH_MPI
+  if (write_binary_tables) MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#endif
+
+  // Tables that rank 0 read from a text file and wrote to a binary one
+  int written[num_mats];
+  for (int k = 0; k < num_mats; k++) written[k] = 0;
+
+  if (rank == 0 || !write_binary_tables) {
+    for (int k = 0; k < num_mats; k++) {
+      load_table_SESAME(mats[k], table_files[k]);
+      prepare_table_SESAME(mats[k]);
+      convert_units_SESAME(mats[k], us);
+      if (write_binary_tables) {
+        written[k] = (mats[k]->mapped_size == 0);
+        write_table_binary_SESAME(mats[k], table_files[k]);
+      }
+    }
   }
 
-  // Sp. Int. Energies (log), pressures, and sound speeds
-  for (int i_rho = 0; i_rho < mat->num_rho; i_rho++) {
-    for (int i_T = 0; i_T < mat->num_T; i_T++) {
-      mat->table_log_u_rho_T[i_rho * mat->num_T + i_T] += logf(
-          units_cgs_conversion_factor(&si, UNIT_CONV_ENERGY_PER_UNIT_MASS) /
-          units_cgs_conversion_factor(us, UNIT_CONV_ENERGY_PER_UNIT_MASS));
-      mat->table_P_rho_T[i_rho * mat->num_T + i_T] *=
-          units_cgs_conversion_factor(&si, UNIT_CONV_PRESSURE) /
-          units_cgs_conversion_factor(us, UNIT_CONV_PRESSURE);
-      mat->table_c_rho_T[i_rho * mat->num_T + i_T] *=
-          units_cgs_conversion_factor(&si, UNIT_CONV_SPEED) /
-          units_cgs_conversion_factor(us, UNIT_CONV_SPEED);
-      mat->table_s_rho_T[i_rho * mat->num_T + i_T] *=
-          units_cgs_conversion_factor(&si, UNIT_CONV_ENERGY_PER_UNIT_MASS) /
-          units_cgs_conversion_factor(us, UNIT_CONV_ENTROPY);
+#ifdef WITH_MPI
+  if (write_binary_tables) {
+
+    // Wait for the binary tables to be complete
+    MPI_Bcast(written, num_mats, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (rank != 0) {
+      for (int k = 0; k < num_mats; k++) {
+        char filename[PARSER_MAX_LINE_SIZE + 8];
+        if (written[k])
+          sprintf(filename, "%s.bin", table_files[k]);
+        else
+          sprintf(filename, "%s", table_files[k]);
+        load_table_SESAME(mats[k], filename);
+        prepare_table_SESAME(mats[k]);
+        convert_units_SESAME(mats[k], us);
+      }
     }
   }
+#endif
+}
+
+// Same as find_value_in_monot_incr_array() but starting from the index given
+// by a uniform grid, rather than bisecting the whole array
+INLINE static int find_value_in_grid_SESAME(const float x, const float *array,
+                                            const int n, const int *grid_idx,
+                                            const float grid_min,
+                                            const float grid_inv_dx) {
+
+  // Outside the array
+  if (x < array[0]) return -1;
+  if (array[n - 1] <= x) return n;
+
+  // Until array[idx] <= x < array[idx + 1]
+  const int k = max((int)((x - grid_min) * grid_inv_dx), 0);
+  int idx = grid_idx[min(k, n - 1)];
+  while (array[idx + 1] <= x) idx++;
+  while (array[idx] > x) idx--;
+
+  return idx;
+}
+
+// Table indices of the density and, at this and the next density, of the
+// sp. int. energy
+INLINE static void find_indices_SESAME(const float log_rho, const float log_u,
+                                       const struct SESAME_params *mat,
+                                       int *idx_rho, int *idx_u_1,
+                                       int *idx_u_2) {
+
+  const int num_rho = mat->num_rho;
+  const int num_T = mat->num_T;
+
+  // Density index
+  int i_rho = find_value_in_grid_SESAME(
+      log_rho, mat->table_log_rho, num_rho, mat->grid_idx_rho,
+      mat->grid_log_rho_min, mat->grid_inv_dlog_rho);
+
+  // If outside the table then extrapolate from the edge and edge-but-one values
+  if (i_rho <= -1) {
+    i_rho = 0;
+  } else if (i_rho >= num_rho) {
+    i_rho = num_rho - 2;
+  }
+
+  // Sp. int. energy at this and the next density (in relevant slice of u array)
+  int i_u_1 = find_value_in_grid_SESAME(
+      log_u, mat->table_log_u_rho_T + i_rho * num_T, num_T,
+      mat->grid_idx_u_rho + i_rho * num_T, mat->grid_log_u_min[i_rho],
+      mat->grid_inv_dlog_u[i_rho]);
+  int i_u_2 = find_value_in_grid_SESAME(
+      log_u, mat->table_log_u_rho_T + (i_rho + 1) * num_T, num_T,
+      mat->grid_idx_u_rho + (i_rho + 1) * num_T,
+      mat->grid_log_u_min[i_rho + 1], mat->grid_inv_dlog_u[i_rho + 1]);
+
+  if (i_u_1 <= -1) {
+    i_u_1 = 0;
+  } else if (i_u_1 >= num_T) {
+    i_u_1 = num_T - 2;
+  }
+  if (i_u_2 <= -1) {
+    i_u_2 = 0;
+  } else if (i_u_2 >= num_T) {
+    i_u_2 = num_T - 2;
+  }
 
-  // Tiny pressure and sound speed
-  mat->P_tiny *= units_cgs_conversion_factor(&si, UNIT_CONV_PRESSURE) /
-                 units_cgs_conversion_factor(us, UNIT_CONV_PRESSURE);
-  mat->c_tiny *= units_cgs_conversion_factor(&si, UNIT_CONV_SPEED) /
-                 units_cgs_conversion_factor(us, UNIT_CONV_SPEED);
+  *idx_rho = i_rho;
+  *idx_u_1 = i_u_1;
+  *idx_u_2 = i_u_2;
 }
 
 // gas_internal_energy_from_entropy
@@ -319,36 +639,11 @@ INLINE static float SESAME_pressure_from_internal_energy(
 
   int idx_rho, idx_u_1, idx_u_2;
   float intp_rho, intp_u_1, intp_u_2;
-  const float log_rho = logf(density);
-  const float log_u = logf(u);
+  const float log_rho = logf(density) + mat->log_rho_to_SI;
+  const float log_u = logf(u) + mat->log_u_to_SI;
 
   // 2D interpolation (bilinear with log(rho), log(u)) to find P(rho, u)
-  // Density index
-  idx_rho =
-      find_value_in_monot_incr_array(log_rho, mat->table_log_rho, mat->num_rho);
-
-  // Sp. int. energy at this and the next density (in relevant slice of u array)
-  idx_u_1 = find_value_in_monot_incr_array(
-      log_u, mat->table_log_u_rho_T + idx_rho * mat->num_T, mat->num_T);
-  idx_u_2 = find_value_in_monot_incr_array(
-      log_u, mat->table_log_u_rho_T + (idx_rho + 1) * mat->num_T, mat->num_T);
-
-  // If outside the table then extrapolate from the edge and edge-but-one values
-  if (idx_rho <= -1) {
-    idx_rho = 0;
-  } else if (idx_rho >= mat->num_rho) {
-    idx_rho = mat->num_rho - 2;
-  }
-  if (idx_u_1 <= -1) {
-    idx_u_1 = 0;
-  } else if (idx_u_1 >= mat->num_T) {
-    idx_u_1 = mat->num_T - 2;
-  }
-  if (idx_u_2 <= -1) {
-    idx_u_2 = 0;
-  } else if (idx_u_2 >= mat->num_T) {
-    idx_u_2 = mat->num_T - 2;
-  }
+  find_indices_SESAME(log_rho, log_u, mat, &idx_rho, &idx_u_1, &idx_u_2);
 
   // Check for duplicates in SESAME tables before interpolation
   if (mat->table_log_rho[idx_rho + 1] != mat->table_log_rho[idx_rho]) {
@@ -421,8 +716,8 @@ INLINE static float SESAME_pressure_from_internal_energy(
   P = (1.f - intp_rho) * ((1.f - intp_u_1) * P_1 + intp_u_1 * P_2) +
       intp_rho * ((1.f - intp_u_2) * P_3 + intp_u_2 * P_4);
 
-  // Convert back from log
-  P = expf(P);
+  // Convert back from log, and to internal units
+  P = expf(P) * mat->P_from_SI;
 
   return P;
 }
@@ -448,36 +743,11 @@ INLINE static float SESAME_soundspeed_from_internal_energy(
 
   int idx_rho, idx_u_1, idx_u_2;
   float intp_rho, intp_u_1, intp_u_2;
-  const float log_rho = logf(density);
-  const float log_u = logf(u);
+  const float log_rho = logf(density) + mat->log_rho_to_SI;
+  const float log_u = logf(u) + mat->log_u_to_SI;
 
   // 2D interpolation (bilinear with log(rho), log(u)) to find c(rho, u)
-  // Density index
-  idx_rho =
-      find_value_in_monot_incr_array(log_rho, mat->table_log_rho, mat->num_rho);
-
-  // Sp. int. energy at this and the next density (in relevant slice of u array)
-  idx_u_1 = find_value_in_monot_incr_array(
-      log_u, mat->table_log_u_rho_T + idx_rho * mat->num_T, mat->num_T);
-  idx_u_2 = find_value_in_monot_incr_array(
-      log_u, mat->table_log_u_rho_T + (idx_rho + 1) * mat->num_T, mat->num_T);
-
-  // If outside the table then extrapolate from the edge and edge-but-one values
-  if (idx_rho <= -1) {
-    idx_rho = 0;
-  } else if (idx_rho >= mat->num_rho) {
-    idx_rho = mat->num_rho - 2;
-  }
-  if (idx_u_1 <= -1) {
-    idx_u_1 = 0;
-  } else if (idx_u_1 >= mat->num_T) {
-    idx_u_1 = mat->num_T - 2;
-  }
-  if (idx_u_2 <= -1) {
-    idx_u_2 = 0;
-  } else if (idx_u_2 >= mat->num_T) {
-    idx_u_2 = mat->num_T - 2;
-  }
+  find_indices_SESAME(log_rho, log_u, mat, &idx_rho, &idx_u_1, &idx_u_2);
 
   // Check for duplicates in SESAME tables before interpolation
   if (mat->table_log_rho[idx_rho + 1] != mat->table_log_rho[idx_rho]) {
@@ -522,13 +792,13 @@ INLINE static float SESAME_soundspeed_from_internal_energy(
   if (c_3 <= 0.f) num_non_pos++;
   if (c_4 <= 0.f) num_non_pos++;
   if (num_non_pos > 2) {
-    return mat->c_tiny;
+    return mat->c_tiny * mat->c_from_SI;
   }
   // If just one or two are non-positive then replace them with a tiny value
   else if (num_non_pos > 0) {
     // Unless already trying to extrapolate in which case return zero
     if ((intp_rho < 0.f) || (intp_u_1 < 0.f) || (intp_u_2 < 0.f)) {
-      return mat->c_tiny;
+      return mat->c_tiny * mat->c_from_SI;
     }
     if (c_1 <= 0.f) c_1 = mat->c_tiny;
     if (c_2 <= 0.f) c_2 = mat->c_tiny;
@@ -545,8 +815,8 @@ INLINE static float SESAME_soundspeed_from_internal_energy(
   c = (1.f - intp_rho) * ((1.f - intp_u_1) * c_1 + intp_u_1 * c_2) +
       intp_rho * ((1.f - intp_u_2) * c_3 + intp_u_2 * c_4);
 
-  // Convert back from log
-  c = expf(c);
+  // Convert back from log, and to internal units
+  c = expf(c) * mat->c_from_SI;
 
   return c;
 }
@@ -152,9 +152,12 @@ double eagle_feedback_number_of_sampled_SNII(const struct spart* sp,
 
   /* Calculate how many supernovae have exploded in this timestep
    * by integrating the IMF between the bounds we chose */
-  const double num_SNII_per_msun =
-      integrate_imf(log10_min_mass_Msun, log10_max_mass_Msun,
-                    eagle_imf_integration_no_weight, NULL, props);
+  struct eagle_imf_position pos_min, pos_max;
+  determine_imf_position(log10_min_mass_Msun, &pos_min, props);
+  determine_imf_position(log10_max_mass_Msun, &pos_max, props);
+  const double num_SNII_per_msun = integrate_imf_cumulative(
+      props->imf_cumulative, /*stellar_yields=*/NULL, &pos_min, &pos_max,
+      props);
 
   return num_SNII_per_msun * sp->mass_init * props->mass_to_solar_mass;
 }
@@ -479,6 +482,125 @@ INLINE static void evolve_SNIa(
   }
 }
 
+/**
+ * @brief Integrate the IMF weighted by the yields of an enrichment channel
+ * between two masses.
+ *
+ * The yields are interpolated linearly in metallicity between two bins of the
+ * tables. As the integral is linear in the yields, we can equivalently
+ * interpolate the integrals of the two bins, which are obtained from the
+ * cumulative tables at a cost independent of the mass range.
+ *
+ * @param table The #yield_table of the enrichment channel.
+ * @param N_metals The number of metallicity bins of the table.
+ * @param index_Z_lo Lower index along the metallicity dimension.
+ * @param index_Z_hi Higher index along the metallicity dimension.
+ * @param dZ Offset between the metallicity bin and Z.
+ * @param log10_min_mass log10 mass at the end of step
+ * @param log10_max_mass log10 mass at the beginning of step
+ * @param Z The total metallicity of the star (metal mass fraction).
+ * @param abundances The individual metal abundances (mass fractions) of the
+ * star.
+ * @param props Properties of the feedback model.
+ * @param metal_mass_released (return) The mass of each element released per
+ * unit initial mass.
+ * @param metal_mass_released_total (return) The metal mass released per unit
+ * initial mass.
+ * @param mass_ejected (return) The mass ejected per unit initial mass.
+ */
+INLINE static void integrate_yields(
+    const struct yield_table* table, const int N_metals, const int index_Z_lo,
+    const int index_Z_hi, const float dZ, const double log10_min_mass,
+    const double log10_max_mass, const double Z,
+    const float* const abundances, const struct feedback_props* props,
+    double metal_mass_released[chemistry_element_count],
+    double* metal_mass_released_total, double* mass_ejected) {
+
+  const int N_bins = eagle_feedback_N_imf_bins;
+
+  /* Position of the integration bounds along the IMF mass bins */
+  struct eagle_imf_position pos_min, pos_max;
+  determine_imf_position(log10_min_mass, &pos_min, props);
+  determine_imf_position(log10_max_mass, &pos_max, props);
+
+  /* Elements already in the stars that are ejected */
+  const int lo_index_2d =
+      row_major_index_2d(index_Z_lo, 0, N_metals, N_bins);
+  const int hi_index_2d =
+      row_major_index_2d(index_Z_hi, 0, N_metals, N_bins);
+
+  const double ejecta_lo = integrate_imf_cumulative(
+      &table->ejecta_IMF_cumulative[lo_index_2d],
+      &table->ejecta_IMF_resampled[lo_index_2d], &pos_min, &pos_max, props);
+  const double ejecta_hi = integrate_imf_cumulative(
+      &table->ejecta_IMF_cumulative[hi_index_2d],
+      &table->ejecta_IMF_resampled[hi_index_2d], &pos_min, &pos_max, props);
+
+  /*******************************
+   * Compute metal mass produced *
+   *******************************/
+  for (int elem = 0; elem < chemistry_element_count; elem++) {
+
+    const int lo_index_3d = row_major_index_3d(
+        index_Z_lo, elem, 0, N_metals, chemistry_element_count, N_bins);
+    const int hi_index_3d = row_major_index_3d(
+        index_Z_hi, elem, 0, N_metals, chemistry_element_count, N_bins);
+
+    const double yield_lo = integrate_imf_cumulative(
+        &table->yield_IMF_cumulative[lo_index_3d],
+        &table->yield_IMF_resampled[lo_index_3d], &pos_min, &pos_max, props);
+    const double yield_hi = integrate_imf_cumulative(
+        &table->yield_IMF_cumulative[hi_index_3d],
+        &table->yield_IMF_resampled[hi_index_3d], &pos_min, &pos_max, props);
+
+    metal_mass_released[elem] =
+        (1.f - dZ) * (yield_lo + abundances[elem] * ejecta_lo) +
+        (0.f + dZ) * (yield_hi + abundances[elem] * ejecta_hi);
+  }
+
+  /*************************************
+   * Compute total metal mass produced *
+   *************************************/
+  const double total_lo = integrate_imf_cumulative(
+      &table->total_metals_IMF_cumulative[lo_index_2d],
+      &table->total_metals_IMF_resampled[lo_index_2d], &pos_min, &pos_max,
+      props);
+  const double total_hi = integrate_imf_cumulative(
+      &table->total_metals_IMF_cumulative[hi_index_2d],
+      &table->total_metals_IMF_resampled[hi_index_2d], &pos_min, &pos_max,
+      props);
+
+  *metal_mass_released_total = (1.f - dZ) * (total_lo + Z * ejecta_lo) +
+                               (0.f + dZ) * (total_hi + Z * ejecta_hi);
+
+  /************************************************
+   * Compute the total mass ejected from the star *
+   ************************************************/
+  *mass_ejected = (1.f - dZ) * ejecta_lo + dZ * ejecta_hi;
+
+#ifdef SWIFT_DEBUG_CHECKS
+  /* Verify the look-up against the direct integration of the IMF */
+  double stellar_yields[eagle_feedback_N_imf_bins];
+  for (int k = 0; k < N_bins; k++)
+    stellar_yields[k] =
+        (1.f - dZ) * table->ejecta_IMF_resampled[lo_index_2d + k] +
+        dZ * table->ejecta_IMF_resampled[hi_index_2d + k];
+  const double mass_ejected_direct =
+      integrate_imf(log10_min_mass, log10_max_mass,
+                    eagle_imf_integration_yield_weight, stellar_yields, props);
+
+  /* Rounding errors scale with the integral over the whole IMF */
+  const double mass_ejected_all =
+      (1.f - dZ) * table->ejecta_IMF_cumulative[lo_index_2d + N_bins - 1] +
+      dZ * table->ejecta_IMF_cumulative[hi_index_2d + N_bins - 1];
+
+  if (fabs(*mass_ejected - mass_ejected_direct) >
+      1e-6 * fabs(mass_ejected_direct) + 1e-12 * fabs(mass_ejected_all))
+    error("Tabulated IMF integral does not match the direct one (%e vs. %e)",
+          *mass_ejected, mass_ejected_direct);
+#endif
+}
+
 /**
  * @brief compute enrichment and feedback due to SNII. To do this, integrate the
  * IMF weighted by the yields read from tables for each of the quantities of
@@ -500,18 +622,6 @@ INLINE static void evolve_SNII(
     const struct feedback_props* props,
     struct feedback_spart_data* const feedback_data) {
 
-  /* Pull out common arrays */
-
-  /* Metal mass produced by the star */
-  const double* const total_yields =
-      props->yield_SNII.total_metals_IMF_resampled;
-
-  /* Individual elements produced by the star */
-  const double* const metal_yields = props->yield_SNII.yield_IMF_resampled;
-
-  /* Elements already in the stars that are ejected */
-  const double* const ejecta = props->yield_SNII.ejecta_IMF_resampled;
-
   /* If mass at beginning of step is less than tabulated lower bound for IMF,
    * limit it.*/
   if (log10_min_mass < props->log10_SNII_min_mass_msun)
@@ -526,11 +636,6 @@ INLINE static void evolve_SNII(
    * step */
   if (log10_min_mass >= log10_max_mass) return;
 
-  /* determine which IMF mass bins contribute to the integral */
-  int low_imf_mass_bin_index, high_imf_mass_bin_index;
-  determine_imf_bins(log10_min_mass, log10_max_mass, &low_imf_mass_bin_index,
-                     &high_imf_mass_bin_index, props);
-
   /* determine which metallicity bin and offset this star belongs to */
   int index_Z_lo = 0, index_Z_hi = 0;
   float dZ = 0.;
@@ -538,85 +643,13 @@ INLINE static void evolve_SNII(
                        props->yield_SNII.metallicity,
                        eagle_feedback_SNII_N_metals);
 
-  /* Allocate temporary array for calculating imf weights */
-  double stellar_yields[eagle_feedback_N_imf_bins];
-
-  /*******************************
-   * Compute metal mass produced *
-   *******************************/
+  /* Integrate the IMF weighted by the yields */
   double metal_mass_released[chemistry_element_count];
-
-  /* Loop over all the elements */
-  for (int elem = 0; elem < chemistry_element_count; elem++) {
-
-    /* Loop over all the relevent IMF mass bins */
-    for (int mass_bin_index = low_imf_mass_bin_index;
-         mass_bin_index < high_imf_mass_bin_index + 1; mass_bin_index++) {
-
-      const int lo_index_3d = row_major_index_3d(
-          index_Z_lo, elem, mass_bin_index, eagle_feedback_SNII_N_metals,
-          chemistry_element_count, eagle_feedback_N_imf_bins);
-      const int hi_index_3d = row_major_index_3d(
-          index_Z_hi, elem, mass_bin_index, eagle_feedback_SNII_N_metals,
-          chemistry_element_count, eagle_feedback_N_imf_bins);
-
-      const int lo_index_2d = row_major_index_2d(index_Z_lo, mass_bin_index,
-                                                 eagle_feedback_SNII_N_metals,
-                                                 eagle_feedback_N_imf_bins);
-      const int hi_index_2d = row_major_index_2d(index_Z_hi, mass_bin_index,
-                                                 eagle_feedback_SNII_N_metals,
-                                                 eagle_feedback_N_imf_bins);
-      stellar_yields[mass_bin_index] =
-          (1.f - dZ) * (metal_yields[lo_index_3d] +
-                        abundances[elem] * ejecta[lo_index_2d]) +
-          (0.f + dZ) * (metal_yields[hi_index_3d] +
-                        abundances[elem] * ejecta[hi_index_2d]);
-    }
-    metal_mass_released[elem] = integrate_imf(
-        log10_min_mass, log10_max_mass, eagle_imf_integration_yield_weight,
-        stellar_yields, props);
-  }
-
-  /*************************************
-   * Compute total metal mass produced *
-   *************************************/
-  for (int mass_bin_index = low_imf_mass_bin_index;
-       mass_bin_index < high_imf_mass_bin_index + 1; mass_bin_index++) {
-
-    const int lo_index_2d = row_major_index_2d(index_Z_lo, mass_bin_index,
-                                               eagle_feedback_SNII_N_metals,
-                                               eagle_feedback_N_imf_bins);
-    const int hi_index_2d = row_major_index_2d(index_Z_hi, mass_bin_index,
-                                               eagle_feedback_SNII_N_metals,
-                                               eagle_feedback_N_imf_bins);
-
-    stellar_yields[mass_bin_index] =
-        (1.f - dZ) * (total_yields[lo_index_2d] + Z * ejecta[lo_index_2d]) +
-        (0.f + dZ) * (total_yields[hi_index_2d] + Z * ejecta[hi_index_2d]);
-  }
-  double metal_mass_released_total =
-      integrate_imf(log10_min_mass, log10_max_mass,
-                    eagle_imf_integration_yield_weight, stellar_yields, props);
-
-  /************************************************
-   * Compute the total mass ejected from the star *
-   ************************************************/
-  for (int mass_bin_index = low_imf_mass_bin_index;
-       mass_bin_index < high_imf_mass_bin_index + 1; mass_bin_index++) {
-
-    const int lo_index_2d = row_major_index_2d(index_Z_lo, mass_bin_index,
-                                               eagle_feedback_SNII_N_metals,
-                                               eagle_feedback_N_imf_bins);
-    const int hi_index_2d = row_major_index_2d(index_Z_hi, mass_bin_index,
-                                               eagle_feedback_SNII_N_metals,
-                                               eagle_feedback_N_imf_bins);
-
-    stellar_yields[mass_bin_index] =
-        (1 - dZ) * ejecta[lo_index_2d] + dZ * ejecta[hi_index_2d];
-  }
-  const double mass_ejected =
-      integrate_imf(log10_min_mass, log10_max_mass,
-                    eagle_imf_integration_yield_weight, stellar_yields, props);
+  double metal_mass_released_total, mass_ejected;
+  integrate_yields(&props->yield_SNII, eagle_feedback_SNII_N_metals,
+                   index_Z_lo, index_Z_hi, dZ, log10_min_mass, log10_max_mass,
+                   Z, abundances, props, metal_mass_released,
+                   &metal_mass_released_total, &mass_ejected);
 
   /* Zero all negative values */
   for (int i = 0; i < chemistry_element_count; i++)
@@ -672,18 +705,6 @@ INLINE static void evolve_AGB(const double log10_min_mass,
                               const struct feedback_props* props,
                               struct feedback_spart_data* const feedback_data) {
 
-  /* Pull out common arrays */
-
-  /* Metal mass produced by the star */
-  const double* const total_yields =
-      props->yield_AGB.total_metals_IMF_resampled;
-
-  /* Individual elements produced by the star */
-  const double* const metal_yields = props->yield_AGB.yield_IMF_resampled;
-
-  /* Elements already in the stars that are ejected */
-  const double* const ejecta = props->yield_AGB.ejecta_IMF_resampled;
-
   /* If mass at end of step is greater than tabulated lower bound for IMF, limit
    * it.*/
   if (log10_max_mass > props->log10_SNII_min_mass_msun)
@@ -693,11 +714,6 @@ INLINE static void evolve_AGB(const double log10_min_mass,
    * step */
   if (log10_min_mass >= log10_max_mass) return;
 
-  /* determine which IMF mass bins contribute to the integral */
-  int low_imf_mass_bin_index, high_imf_mass_bin_index;
-  determine_imf_bins(log10_min_mass, log10_max_mass, &low_imf_mass_bin_index,
-                     &high_imf_mass_bin_index, props);
-
   /* determine which metallicity bin and offset this star belongs to */
   int index_Z_lo = 0, index_Z_hi = 0;
   float dZ = 0.f;
@@ -705,88 +721,13 @@ INLINE static void evolve_AGB(const double log10_min_mass,
                        props->yield_AGB.metallicity,
                        eagle_feedback_AGB_N_metals);
 
-  /* Allocate temporary array for calculating imf weights */
-  double stellar_yields[eagle_feedback_N_imf_bins];
-
-  /*******************************
-   * Compute metal mass produced *
-   *******************************/
+  /* Integrate the IMF weighted by the yields */
   double metal_mass_released[chemistry_element_count];
-
-  /* Loop over all the elements */
-  for (int elem = 0; elem < chemistry_element_count; elem++) {
-
-    /* Loop over all the relevent IMF mass bins */
-    for (int mass_bin_index = low_imf_mass_bin_index;
-         mass_bin_index < high_imf_mass_bin_index + 1; mass_bin_index++) {
-
-      const int lo_index_3d = row_major_index_3d(
-          index_Z_lo, elem, mass_bin_index, eagle_feedback_AGB_N_metals,
-          chemistry_element_count, eagle_feedback_N_imf_bins);
-      const int hi_index_3d = row_major_index_3d(
-          index_Z_hi, elem, mass_bin_index, eagle_feedback_AGB_N_metals,
-          chemistry_element_count, eagle_feedback_N_imf_bins);
-
-      const int lo_index_2d = row_major_index_2d(index_Z_lo, mass_bin_index,
-                                                 eagle_feedback_AGB_N_metals,
-                                                 eagle_feedback_N_imf_bins);
-      const int hi_index_2d = row_major_index_2d(index_Z_hi, mass_bin_index,
-                                                 eagle_feedback_AGB_N_metals,
-                                                 eagle_feedback_N_imf_bins);
-      stellar_yields[mass_bin_index] =
-          (1.f - dZ) * (metal_yields[lo_index_3d] +
-                        abundances[elem] * ejecta[lo_index_2d]) +
-          (0.f + dZ) * (metal_yields[hi_index_3d] +
-                        abundances[elem] * ejecta[hi_index_2d]);
-    }
-
-    metal_mass_released[elem] = integrate_imf(
-        log10_min_mass, log10_max_mass, eagle_imf_integration_yield_weight,
-        stellar_yields, props);
-  }
-
-  /*************************************
-   * Compute total metal mass produced *
-   *************************************/
-  for (int mass_bin_index = low_imf_mass_bin_index;
-       mass_bin_index < high_imf_mass_bin_index + 1; mass_bin_index++) {
-
-    const int lo_index_2d = row_major_index_2d(index_Z_lo, mass_bin_index,
-                                               eagle_feedback_AGB_N_metals,
-                                               eagle_feedback_N_imf_bins);
-    const int hi_index_2d = row_major_index_2d(index_Z_hi, mass_bin_index,
-                                               eagle_feedback_AGB_N_metals,
-                                               eagle_feedback_N_imf_bins);
-
-    stellar_yields[mass_bin_index] =
-        (1.f - dZ) * (total_yields[lo_index_2d] + Z * ejecta[lo_index_2d]) +
-        (0.f + dZ) * (total_yields[hi_index_2d] + Z * ejecta[hi_index_2d]);
-  }
-
-  double metal_mass_released_total =
-      integrate_imf(log10_min_mass, log10_max_mass,
-                    eagle_imf_integration_yield_weight, stellar_yields, props);
-
-  /************************************************
-   * Compute the total mass ejected from the star *
-   ************************************************/
-
-  for (int mass_bin_index = low_imf_mass_bin_index;
-       mass_bin_index < high_imf_mass_bin_index + 1; mass_bin_index++) {
-
-    const int lo_index_2d = row_major_index_2d(index_Z_lo, mass_bin_index,
-                                               eagle_feedback_AGB_N_metals,
-                                               eagle_feedback_N_imf_bins);
-    const int hi_index_2d = row_major_index_2d(index_Z_hi, mass_bin_index,
-                                               eagle_feedback_AGB_N_metals,
-                                               eagle_feedback_N_imf_bins);
-
-    stellar_yields[mass_bin_index] =
-        (1.f - dZ) * ejecta[lo_index_2d] + dZ * ejecta[hi_index_2d];
-  }
-  const double mass_ejected =
-      integrate_imf(log10_min_mass, log10_max_mass,
-                    eagle_imf_integration_yield_weight, stellar_yields, props);
+  double metal_mass_released_total, mass_ejected;
+  integrate_yields(&props->yield_AGB, eagle_feedback_AGB_N_metals, index_Z_lo,
+                   index_Z_hi, dZ, log10_min_mass, log10_max_mass, Z,
+                   abundances, props, metal_mass_released,
+                   &metal_mass_released_total, &mass_ejected);
 
   /* Zero all negative values */
   for (int i = 0; i < chemistry_element_count; i++)
@@ -967,6 +908,77 @@ void compute_stellar_evolution(const struct feedback_props* feedback_props,
   TIMER_TOC(timer_do_star_evol);
 }
 
+/**
+ * @brief Tabulate the cumulative IMF integrals of one of the yield tables.
+ *
+ * @param table The #yield_table with its IMF resampled arrays ready.
+ * @param N_metals The number of metallicity bins of the table.
+ * @param fp The #feedback_props.
+ */
+static void compute_cumulative_yield_table(struct yield_table* table,
+                                           const int N_metals,
+                                           const struct feedback_props* fp) {
+
+  const int N_bins = eagle_feedback_N_imf_bins;
+
+  if (swift_memalign("feedback-tables", (void**)&table->yield_IMF_cumulative,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     N_metals * chemistry_element_count * N_bins *
+                         sizeof(double)) != 0)
+    error("Failed to allocate cumulative yields array");
+
+  if (swift_memalign("feedback-tables", (void**)&table->ejecta_IMF_cumulative,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     N_metals * N_bins * sizeof(double)) != 0)
+    error("Failed to allocate cumulative ejecta array");
+
+  if (swift_memalign("feedback-tables",
+                     (void**)&table->total_metals_IMF_cumulative,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     N_metals * N_bins * sizeof(double)) != 0)
+    error("Failed to allocate cumulative total metals array");
+
+  for (int i = 0; i < N_metals; i++) {
+
+    for (int elem = 0; elem < chemistry_element_count; elem++) {
+      const int index_3d = row_major_index_3d(
+          i, elem, 0, N_metals, chemistry_element_count, N_bins);
+      compute_cumulative_imf(&table->yield_IMF_resampled[index_3d],
+                             &table->yield_IMF_cumulative[index_3d], fp);
+    }
+
+    const int index_2d = row_major_index_2d(i, 0, N_metals, N_bins);
+    compute_cumulative_imf(&table->ejecta_IMF_resampled[index_2d],
+                           &table->ejecta_IMF_cumulative[index_2d], fp);
+    compute_cumulative_imf(&table->total_metals_IMF_resampled[index_2d],
+                           &table->total_metals_IMF_cumulative[index_2d], fp);
+  }
+}
+
+/**
+ * @brief Tabulate the integrals of the IMF, on its own and weighted by the
+ * SNII and AGB yields, up to each IMF mass bin.
+ *
+ * The mass and metals released by a star over a step are then obtained from
+ * the difference of two look-ups instead of a full integration of the IMF.
+ *
+ * @param fp The #feedback_props.
+ */
+static void compute_cumulative_yields(struct feedback_props* fp) {
+
+  if (swift_memalign("imf-tables", (void**)&fp->imf_cumulative,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     eagle_feedback_N_imf_bins * sizeof(double)) != 0)
+    error("Failed to allocate cumulative IMF table");
+
+  compute_cumulative_imf(/*stellar_yields=*/NULL, fp->imf_cumulative, fp);
+
+  compute_cumulative_yield_table(&fp->yield_SNII, eagle_feedback_SNII_N_metals,
+                                 fp);
+  compute_cumulative_yield_table(&fp->yield_AGB, eagle_feedback_AGB_N_metals,
+                                 fp);
+}
+
 /**
  * @brief Initialize the global properties of the feedback scheme.
  *
@@ -1236,6 +1248,9 @@ void feedback_props_init(struct feedback_props* fp,
    * mass bins used in IMF  */
   compute_ejecta(fp);
 
+  /* Tabulate the integrals of the IMF weighted by the yields */
+  compute_cumulative_yields(fp);
+
   message("initialized stellar feedback");
 }
 
@@ -1255,6 +1270,9 @@ void zero_yield_table_pointers(struct yield_table* table) {
   table->ejecta = NULL;
   table->total_metals_IMF_resampled = NULL;
   table->total_metals = NULL;
+  table->yield_IMF_cumulative = NULL;
+  table->ejecta_IMF_cumulative = NULL;
+  table->total_metals_IMF_cumulative = NULL;
 }
 
 /**
@@ -1288,6 +1306,9 @@ void feedback_restore_tables(struct feedback_props* fp) {
   /* Resample ejecta contribution to enrichment from mass bins used in tables to
    * mass bins used in IMF  */
   compute_ejecta(fp);
+
+  /* Tabulate the integrals of the IMF weighted by the yields */
+  compute_cumulative_yields(fp);
 }
 
 /**
@@ -1302,6 +1323,7 @@ void feedback_clean(struct feedback_props* fp) {
   swift_free("imf-tables", fp->imf);
   swift_free("imf-tables", fp->imf_mass_bin);
   swift_free("imf-tables", fp->imf_mass_bin_log10);
+  swift_free("imf-tables", fp->imf_cumulative);
   swift_free("feedback-tables", fp->yields_SNIa);
   swift_free("feedback-tables", fp->yield_SNIa_IMF_resampled);
   swift_free("feedback-tables", fp->yield_AGB.mass);
@@ -1312,6 +1334,9 @@ void feedback_clean(struct feedback_props* fp) {
   swift_free("feedback-tables", fp->yield_AGB.ejecta_IMF_resampled);
   swift_free("feedback-tables", fp->yield_AGB.total_metals);
   swift_free("feedback-tables", fp->yield_AGB.total_metals_IMF_resampled);
+  swift_free("feedback-tables", fp->yield_AGB.yield_IMF_cumulative);
+  swift_free("feedback-tables", fp->yield_AGB.ejecta_IMF_cumulative);
+  swift_free("feedback-tables", fp->yield_AGB.total_metals_IMF_cumulative);
   swift_free("feedback-tables", fp->yield_SNII.mass);
   swift_free("feedback-tables", fp->yield_SNII.metallicity);
   swift_free("feedback-tables", fp->yield_SNII.yield);
@@ -1320,6 +1345,9 @@ void feedback_clean(struct feedback_props* fp) {
   swift_free("feedback-tables", fp->yield_SNII.ejecta_IMF_resampled);
   swift_free("feedback-tables", fp->yield_SNII.total_metals);
   swift_free("feedback-tables", fp->yield_SNII.total_metals_IMF_resampled);
+  swift_free("feedback-tables", fp->yield_SNII.yield_IMF_cumulative);
+  swift_free("feedback-tables", fp->yield_SNII.ejecta_IMF_cumulative);
+  swift_free("feedback-tables", fp->yield_SNII.total_metals_IMF_cumulative);
   swift_free("feedback-tables", fp->lifetimes.mass);
   swift_free("feedback-tables", fp->lifetimes.metallicity);
   swift_free("feedback-tables", fp->yield_mass_bins);
@@ -1380,6 +1408,7 @@ void feedback_struct_dump(const struct feedback_props* feedback, FILE* stream) {
   feedback_copy.imf = NULL;
   feedback_copy.imf_mass_bin = NULL;
   feedback_copy.imf_mass_bin_log10 = NULL;
+  feedback_copy.imf_cumulative = NULL;
 
   restart_write_blocks((void*)&feedback_copy, sizeof(struct feedback_props), 1,
                        stream, "feedback", "feedback function");
@@ -53,6 +53,18 @@ struct yield_table {
 
   /* Array to store table of total mass released being read in */
   double *total_metals;
+
+  /*! Integral of the IMF weighted by yield_IMF_resampled up to each IMF mass
+   * bin */
+  double *yield_IMF_cumulative;
+
+  /*! Integral of the IMF weighted by ejecta_IMF_resampled up to each IMF mass
+   * bin */
+  double *ejecta_IMF_cumulative;
+
+  /*! Integral of the IMF weighted by total_metals_IMF_resampled up to each
+   * IMF mass bin */
+  double *total_metals_IMF_cumulative;
 };
 
 /**
@@ -196,6 +208,9 @@ struct feedback_props {
   /*! Arrays to store IMF mass bins (log10)*/
   double *imf_mass_bin_log10;
 
+  /*! Integral of the IMF up to each IMF mass bin */
+  double *imf_cumulative;
+
   /*! Minimal stellar mass considered by the IMF (in solar masses) */
   double imf_min_mass_msun;
 
@@ -190,6 +190,148 @@ INLINE static double integrate_imf(
   return result * imf_log10_mass_bin_size * M_LN10;
 }
 
+/**
+ * @brief Position of a mass along the IMF mass bins.
+ */
+struct eagle_imf_position {
+
+  /*! Index of the IMF mass bin at or below the mass */
+  int index;
+
+  /*! Distance to that bin in units of the bin size */
+  double offset;
+};
+
+/**
+ * @brief Find the position of a mass along the IMF mass bins.
+ *
+ * Masses outside the range of the IMF get offsets outside [0, 1] with respect
+ * to the first or last bin, exactly as in integrate_imf().
+ *
+ * @param log10_mass log10 of the mass of interest
+ * @param pos (return) The #eagle_imf_position.
+ * @param feedback_props the #feedback_props data structure
+ */
+INLINE static void determine_imf_position(
+    const double log10_mass, struct eagle_imf_position *pos,
+    const struct feedback_props *feedback_props) {
+
+  const int N_bins = eagle_feedback_N_imf_bins;
+  const double *const imf_bins_log10 = feedback_props->imf_mass_bin_log10;
+  const double imf_log10_mass_bin_size = imf_bins_log10[1] - imf_bins_log10[0];
+
+  int i = (int)floor((log10_mass - imf_bins_log10[0]) / imf_log10_mass_bin_size);
+  i = max(i, 0);
+  i = min(i, N_bins - 2);
+
+  pos->index = i;
+  pos->offset = (log10_mass - imf_bins_log10[i]) / imf_log10_mass_bin_size;
+}
+
+/**
+ * @brief Tabulate the integral of the IMF from the lowest IMF mass bin to
+ * each of the other bins, optionally weighted by yields.
+ *
+ * The integral is computed with the same trapezoidal rule as integrate_imf()
+ * such that integrals between any two masses can be obtained from the
+ * difference of two values of the table (see integrate_imf_cumulative()).
+ *
+ * @param stellar_yields Array of weights based on yields. NULL for no
+ * weighting.
+ * @param cumulative (return) The integral up to each IMF mass bin.
+ * @param feedback_props the #feedback_props data structure
+ */
+INLINE static void compute_cumulative_imf(
+    const double *const stellar_yields,
+    double cumulative[eagle_feedback_N_imf_bins],
+    const struct feedback_props *feedback_props) {
+
+  const double *imf = feedback_props->imf;
+  const double *imf_mass_bin = feedback_props->imf_mass_bin;
+  const double *imf_mass_bin_log10 = feedback_props->imf_mass_bin_log10;
+  const double imf_log10_mass_bin_size =
+      imf_mass_bin_log10[1] - imf_mass_bin_log10[0];
+
+  double integrand_prev = imf[0] * imf_mass_bin[0];
+  if (stellar_yields != NULL) integrand_prev *= stellar_yields[0];
+
+  cumulative[0] = 0.;
+  for (int i = 1; i < eagle_feedback_N_imf_bins; i++) {
+
+    double integrand = imf[i] * imf_mass_bin[i];
+    if (stellar_yields != NULL) integrand *= stellar_yields[i];
+
+    cumulative[i] = cumulative[i - 1] + 0.5 * (integrand_prev + integrand) *
+                                            imf_log10_mass_bin_size * M_LN10;
+    integrand_prev = integrand;
+  }
+}
+
+/**
+ * @brief Evaluate a table built by compute_cumulative_imf() at an arbitrary
+ * mass.
+ *
+ * integrate_imf() attributes the half bin on either side of each IMF mass bin
+ * to that bin, which we reproduce here.
+ *
+ * @param cumulative The cumulative integral of the IMF.
+ * @param stellar_yields The weights used to build the table. NULL for no
+ * weighting.
+ * @param pos The #eagle_imf_position of the mass of interest.
+ * @param feedback_props the #feedback_props data structure
+ */
+INLINE static double cumulative_imf_at(
+    const double *const cumulative, const double *const stellar_yields,
+    const struct eagle_imf_position *pos,
+    const struct feedback_props *feedback_props) {
+
+  const double *imf = feedback_props->imf;
+  const double *imf_mass_bin = feedback_props->imf_mass_bin;
+  const double *imf_mass_bin_log10 = feedback_props->imf_mass_bin_log10;
+  const double imf_log10_mass_bin_size =
+      imf_mass_bin_log10[1] - imf_mass_bin_log10[0];
+
+  const int i = pos->index;
+  const double offset = pos->offset;
+
+  if (offset < 0.5) {
+    double integrand = imf[i] * imf_mass_bin[i];
+    if (stellar_yields != NULL) integrand *= stellar_yields[i];
+    return cumulative[i] +
+           offset * integrand * imf_log10_mass_bin_size * M_LN10;
+  } else {
+    double integrand = imf[i + 1] * imf_mass_bin[i + 1];
+    if (stellar_yields != NULL) integrand *= stellar_yields[i + 1];
+    return cumulative[i + 1] -
+           (1. - offset) * integrand * imf_log10_mass_bin_size * M_LN10;
+  }
+}
+
+/**
+ * @brief Integrate the IMF between two masses using a table built by
+ * compute_cumulative_imf().
+ *
+ * This gives the same result as integrate_imf() (up to rounding) for a cost
+ * independent of the number of IMF mass bins between the two masses.
+ *
+ * @param cumulative The cumulative integral of the IMF.
+ * @param stellar_yields The weights used to build the table. NULL for no
+ * weighting.
+ * @param pos_min The #eagle_imf_position of the lower integration bound.
+ * @param pos_max The #eagle_imf_position of the upper integration bound.
+ * @param feedback_props the #feedback_props data structure
+ */
+INLINE static double integrate_imf_cumulative(
+    const double *const cumulative, const double *const stellar_yields,
+    const struct eagle_imf_position *pos_min,
+    const struct eagle_imf_position *pos_max,
+    const struct feedback_props *feedback_props) {
+
+  return cumulative_imf_at(cumulative, stellar_yields, pos_max,
+                           feedback_props) -
+         cumulative_imf_at(cumulative, stellar_yields, pos_min, feedback_props);
+}
+
 /**
  * @brief Allocate space for IMF table and compute values to populate this
  * table.
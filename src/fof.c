@@ -71,6 +71,7 @@ MPI_Datatype fof_mpi_type;
 MPI_Datatype group_length_mpi_type;
 MPI_Datatype fof_final_index_type;
 MPI_Datatype fof_final_mass_type;
+MPI_Datatype fof_label_type;
 
 /*! Offset between the first particle on this MPI rank and the first particle in
  * the global order */
@@ -180,6 +181,12 @@ void fof_create_mpi_types() {
       MPI_Type_commit(&fof_final_mass_type) != MPI_SUCCESS) {
     error("Failed to create MPI type for fof_final_mass.");
   }
+  /* Define type for sending fof_label struct */
+  if (MPI_Type_contiguous(sizeof(struct fof_label), MPI_BYTE,
+                          &fof_label_type) != MPI_SUCCESS ||
+      MPI_Type_commit(&fof_label_type) != MPI_SUCCESS) {
+    error("Failed to create MPI type for fof_label.");
+  }
 #else
   error("Calling an MPI function in non-MPI code.");
 #endif
@@ -713,24 +720,6 @@ __attribute__((always_inline)) INLINE static double cell_min_dist(
 
 #ifdef WITH_MPI
 
-/* Add a group to the hash table. */
-__attribute__((always_inline)) INLINE static void hashmap_add_group(
-    const size_t group_id, const size_t group_offset, hashmap_t *map) {
-
-  int created_new_element = 0;
-  hashmap_value_t *offset =
-      hashmap_get_new(map, group_id, &created_new_element);
-
-  if (offset != NULL) {
-
-    /* If the element is a new entry set its value. */
-    if (created_new_element) {
-      (*offset).value_st = group_offset;
-    }
-  } else
-    error("Couldn't find key (%zu) or create new one.", group_id);
-}
-
 /* Find a group in the hash table. */
 __attribute__((always_inline)) INLINE static size_t hashmap_find_group_offset(
     const size_t group_id, hashmap_t *map) {
@@ -770,6 +759,67 @@ __attribute__((always_inline)) INLINE static void fof_compute_send_recv_offsets(
   for (int i = 0; i < nr_nodes; i++) (*nrecv) += (*recvcount)[i];
 }
 
+/* Find the MPI rank holding a given global particle index. */
+__attribute__((always_inline)) INLINE static int fof_node_of_index(
+    const size_t index, const size_t *first_on_node, const int nr_nodes) {
+
+  /* Last rank starting at or before the index (skips empty ranks) */
+  int lo = 0, hi = nr_nodes - 1;
+  while (lo < hi) {
+    const int mid = (lo + hi + 1) / 2;
+    if (first_on_node[mid] <= index)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+/* Is the root candidate (size_a, id_a) preferred over (size_b, id_b)? */
+__attribute__((always_inline)) INLINE static int fof_label_is_better(
+    const size_t size_a, const size_t id_a, const size_t size_b,
+    const size_t id_b) {
+
+#ifdef UNION_BY_SIZE_OVER_MPI
+  if (size_a != size_b) return size_a > size_b;
+#endif
+  return id_a < id_b;
+}
+
+/**
+ * @brief Exchange some #fof_label with the other ranks.
+ *
+ * @param send The messages to send, grouped by destination rank.
+ * @param sendcount The number of messages for each rank.
+ * @param nr_nodes The number of ranks.
+ * @param nrecv (return) The number of messages received.
+ * @param recvcount (return) The number of messages received from each rank,
+ * can be NULL.
+ *
+ * @return The received messages, grouped by sending rank.
+ */
+static struct fof_label *fof_exchange_labels(const struct fof_label *send,
+                                             int *sendcount, const int nr_nodes,
+                                             size_t *nrecv, int *recvcount) {
+
+  int *counts = NULL, *sendoffset = NULL, *recvoffset = NULL;
+  fof_compute_send_recv_offsets(nr_nodes, sendcount, &counts, &sendoffset,
+                                &recvoffset, nrecv);
+
+  struct fof_label *recv = (struct fof_label *)swift_malloc(
+      "fof_label_recv", max(*nrecv, 1) * sizeof(struct fof_label));
+  if (recv == NULL) error("Failed to allocate FOF label receive buffer.");
+
+  MPI_Alltoallv(send, sendcount, sendoffset, fof_label_type, recv, counts,
+                recvoffset, fof_label_type, MPI_COMM_WORLD);
+
+  if (recvcount != NULL) memcpy(recvcount, counts, nr_nodes * sizeof(int));
+  free(counts);
+  free(sendoffset);
+  free(recvoffset);
+  return recv;
+}
+
 #endif /* WITH_MPI */
 
 /**
@@ -2348,227 +2398,346 @@ void fof_search_foreign_cells(struct fof_props *props, const struct space *s) {
 
   tic = getticks();
 
-  struct fof_mpi *global_group_links = NULL;
-  int *displ = NULL, *group_link_counts = NULL;
-  int global_group_link_count = 0;
-
-  ticks comms_tic = getticks();
+  const int nr_nodes = e->nr_nodes;
 
-  MPI_Barrier(MPI_COMM_WORLD);
+  /* Get the range of global group IDs held by each rank. */
+  size_t *first_on_node = (size_t *)malloc(nr_nodes * sizeof(size_t));
+  if (first_on_node == NULL)
+    error("Error while allocating memory for the rank offsets");
+  MPI_Allgather(&node_offset, sizeof(size_t), MPI_BYTE, first_on_node,
+                sizeof(size_t), MPI_BYTE, MPI_COMM_WORLD);
 
-  if (verbose)
-    message("Imbalance took: %.3f %s.",
-            clocks_from_ticks(getticks() - comms_tic), clocks_getunit());
+  /* Each link was only found by one of the two ranks involved. Send a copy of
+   * it to the rank owning the foreign group so that both ends know about it.
+   * Note that group_i is always a local group. */
+  int *sendcount = (int *)calloc(nr_nodes, sizeof(int));
+  int *link_dest = (int *)malloc(max(group_link_count, 1) * sizeof(int));
+  if (sendcount == NULL || link_dest == NULL)
+    error("Error while allocating memory for the FOF link exchange");
 
-  comms_tic = getticks();
+  for (int i = 0; i < group_link_count; i++) {
+    link_dest[i] = fof_node_of_index(props->group_links[i].group_j,
+                                     first_on_node, nr_nodes);
+    sendcount[link_dest[i]]++;
+  }
 
-  /* Sum the total number of links across MPI domains over each MPI rank. */
-  MPI_Allreduce(&group_link_count, &global_group_link_count, 1, MPI_INT,
-                MPI_SUM, MPI_COMM_WORLD);
+  int *sendoffset = NULL, *recvcount = NULL, *recvoffset = NULL;
+  size_t nrecv = 0;
+  fof_compute_send_recv_offsets(nr_nodes, sendcount, &recvcount, &sendoffset,
+                                &recvoffset, &nrecv);
 
-  /* Unique set of links is half of all group links as each link is found twice
-   * by opposing MPI ranks. */
-  if (swift_memalign("fof_global_group_links", (void **)&global_group_links,
+  struct fof_mpi *links_send = NULL, *links_recv = NULL;
+  if (swift_memalign("fof_links_send", (void **)&links_send,
                      SWIFT_STRUCT_ALIGNMENT,
-                     global_group_link_count * sizeof(struct fof_mpi)) != 0)
-    error("Error while allocating memory for the global list of group links");
-
-  if (posix_memalign((void **)&group_link_counts, SWIFT_STRUCT_ALIGNMENT,
-                     e->nr_nodes * sizeof(int)) != 0)
-    error(
-        "Error while allocating memory for the number of group links on each "
-        "MPI rank");
-
-  if (posix_memalign((void **)&displ, SWIFT_STRUCT_ALIGNMENT,
-                     e->nr_nodes * sizeof(int)) != 0)
-    error(
-        "Error while allocating memory for the displacement in memory for the "
-        "global group link list");
-
-  /* Gather the total number of links on each rank. */
-  MPI_Allgather(&group_link_count, 1, MPI_INT, group_link_counts, 1, MPI_INT,
-                MPI_COMM_WORLD);
-
-  /* Set the displacements into the global link list using the link counts from
-   * each rank */
-  displ[0] = 0;
-  for (int i = 1; i < e->nr_nodes; i++)
-    displ[i] = displ[i - 1] + group_link_counts[i - 1];
-
-  /* Gather the global link list on all ranks. */
-  MPI_Allgatherv(props->group_links, group_link_count, fof_mpi_type,
-                 global_group_links, group_link_counts, displ, fof_mpi_type,
-                 MPI_COMM_WORLD);
-
-  /* Clean up memory. */
-  free(displ);
-  swift_free("fof_group_links", props->group_links);
-  props->group_links = NULL;
-
-  if (verbose) {
-    message("Communication took: %.3f %s.",
-            clocks_from_ticks(getticks() - comms_tic), clocks_getunit());
+                     max(group_link_count, 1) * sizeof(struct fof_mpi)) != 0 ||
+      swift_memalign("fof_links_recv", (void **)&links_recv,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     max(nrecv, 1) * sizeof(struct fof_mpi)) != 0)
+    error("Error while allocating memory for the FOF link exchange");
 
-    message("Global comms took: %.3f %s.", clocks_from_ticks(getticks() - tic),
-            clocks_getunit());
+  /* Pack the mirrored links by destination rank. */
+  int *pack_offset = (int *)malloc(nr_nodes * sizeof(int));
+  memcpy(pack_offset, sendoffset, nr_nodes * sizeof(int));
+  for (int i = 0; i < group_link_count; i++) {
+    struct fof_mpi *l = &links_send[pack_offset[link_dest[i]]++];
+    l->group_i = props->group_links[i].group_j;
+    l->group_i_size = props->group_links[i].group_j_size;
+    l->group_j = props->group_links[i].group_i;
+    l->group_j_size = props->group_links[i].group_i_size;
   }
 
-  tic = getticks();
-
-  /* Transform the group IDs to a local list going from 0-group_count so a
-   * union-find can be performed. */
-  size_t *global_group_index = NULL, *global_group_id = NULL,
-         *global_group_size = NULL;
-  const int global_group_list_size = 2 * global_group_link_count;
-  int group_count = 0;
+  MPI_Alltoallv(links_send, sendcount, sendoffset, fof_mpi_type, links_recv,
+                recvcount, recvoffset, fof_mpi_type, MPI_COMM_WORLD);
 
-  if (swift_memalign("fof_global_group_index", (void **)&global_group_index,
+  free(recvcount);
+  free(recvoffset);
+  free(sendoffset);
+  swift_free("fof_links_send", links_send);
+
+  /* Collect all the edges (local group -> foreign group) seen by this rank,
+   * sorted by the rank owning the foreign group. */
+  const size_t num_edges = group_link_count + nrecv;
+  size_t *edge_node = NULL, *edge_foreign = NULL;
+  int *edge_offset = (int *)calloc(nr_nodes + 1, sizeof(int));
+  if (swift_memalign("fof_edge_node", (void **)&edge_node,
                      SWIFT_STRUCT_ALIGNMENT,
-                     global_group_list_size * sizeof(size_t)) != 0)
-    error(
-        "Error while allocating memory for the displacement in memory for the "
-        "global group link list");
-
-  if (swift_memalign("fof_global_group_id", (void **)&global_group_id,
+                     max(num_edges, 1) * sizeof(size_t)) != 0 ||
+      swift_memalign("fof_edge_foreign", (void **)&edge_foreign,
                      SWIFT_STRUCT_ALIGNMENT,
-                     global_group_list_size * sizeof(size_t)) != 0)
-    error(
-        "Error while allocating memory for the displacement in memory for the "
-        "global group link list");
+                     max(num_edges, 1) * sizeof(size_t)) != 0 ||
+      edge_offset == NULL)
+    error("Error while allocating memory for the FOF edges");
 
-  if (swift_memalign("fof_global_group_size", (void **)&global_group_size,
+  int *recv_dest = (int *)malloc(max(nrecv, 1) * sizeof(int));
+  for (size_t i = 0; i < nrecv; i++) {
+    recv_dest[i] =
+        fof_node_of_index(links_recv[i].group_j, first_on_node, nr_nodes);
+    edge_offset[recv_dest[i] + 1]++;
+  }
+  for (int i = 0; i < group_link_count; i++) edge_offset[link_dest[i] + 1]++;
+  for (int i = 0; i < nr_nodes; i++) edge_offset[i + 1] += edge_offset[i];
+
+  /* Create the list of local groups taking part in the links, together with
+   * a hash table to find them from their global ID. */
+  size_t *node_id = NULL, *node_size = NULL, *node_label = NULL,
+         *node_label_size = NULL;
+  char *node_changed = NULL, *node_changed_next = NULL;
+  if (swift_memalign("fof_node_id", (void **)&node_id, SWIFT_STRUCT_ALIGNMENT,
+                     max(num_edges, 1) * sizeof(size_t)) != 0 ||
+      swift_memalign("fof_node_size", (void **)&node_size,
                      SWIFT_STRUCT_ALIGNMENT,
-                     global_group_list_size * sizeof(size_t)) != 0)
-    error(
-        "Error while allocating memory for the displacement in memory for the "
-        "global group link list");
-
-  bzero(global_group_size, global_group_list_size * sizeof(size_t));
+                     max(num_edges, 1) * sizeof(size_t)) != 0 ||
+      swift_memalign("fof_node_label", (void **)&node_label,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     max(num_edges, 1) * sizeof(size_t)) != 0 ||
+      swift_memalign("fof_node_label_size", (void **)&node_label_size,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     max(num_edges, 1) * sizeof(size_t)) != 0)
+    error("Error while allocating memory for the FOF link nodes");
+  node_changed = (char *)malloc(max(num_edges, 1) * sizeof(char));
+  node_changed_next = (char *)malloc(max(num_edges, 1) * sizeof(char));
+  if (node_changed == NULL || node_changed_next == NULL)
+    error("Error while allocating memory for the FOF link nodes");
 
-  /* Create hash table. */
   hashmap_t map;
   hashmap_init(&map);
+  size_t num_nodes = 0;
+
+  memcpy(pack_offset, edge_offset, nr_nodes * sizeof(int));
+  for (size_t i = 0; i < num_edges; i++) {
+
+    const int from_link = i < (size_t)group_link_count;
+    const size_t group_id = from_link
+                                ? props->group_links[i].group_i
+                                : links_recv[i - group_link_count].group_i;
+    const size_t foreign_id = from_link
+                                  ? props->group_links[i].group_j
+                                  : links_recv[i - group_link_count].group_j;
+    const int dest = from_link ? link_dest[i] : recv_dest[i - group_link_count];
+
+    int created = 0;
+    hashmap_value_t *value = hashmap_get_new(&map, group_id, &created);
+    if (value == NULL)
+      error("Couldn't find key (%zu) or create new one.", group_id);
+
+    if (created) {
+      node_id[num_nodes] = group_id;
+      node_size[num_nodes] = group_size[group_id - node_offset];
+      node_label[num_nodes] = group_id;
+      node_label_size[num_nodes] = node_size[num_nodes];
+      node_changed[num_nodes] = 1;
+      value->value_st = num_nodes++;
+    }
 
-  /* Store each group ID and its properties. */
-  for (int i = 0; i < global_group_link_count; i++) {
-
-    size_t group_i = global_group_links[i].group_i;
-    size_t group_j = global_group_links[i].group_j;
-
-    global_group_size[group_count] += global_group_links[i].group_i_size;
-    global_group_id[group_count] = group_i;
-    hashmap_add_group(group_i, group_count++, &map);
-
-    global_group_size[group_count] += global_group_links[i].group_j_size;
-    global_group_id[group_count] = group_j;
-    hashmap_add_group(group_j, group_count++, &map);
+    const int k = pack_offset[dest]++;
+    edge_node[k] = value->value_st;
+    edge_foreign[k] = foreign_id;
   }
 
+  free(link_dest);
+  free(recv_dest);
+  swift_free("fof_links_recv", links_recv);
+  swift_free("fof_group_links", props->group_links);
+  props->group_links = NULL;
+
   if (verbose)
-    message("Global list compression took: %.3f %s.",
+    message("Exchanging the links took: %.3f %s.",
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
   tic = getticks();
 
-  /* Create a global_group_index list of groups across MPI domains so that you
-   * can perform a union-find locally on each node. */
-  /* The value of which is an offset into global_group_id, which is the actual
-   * root. */
-  for (int i = 0; i < group_count; i++) global_group_index[i] = i;
-
-  /* Store the original group size before incrementing in the Union-Find. */
-  size_t *orig_global_group_size = NULL;
-
-  if (swift_memalign("fof_orig_global_group_size",
-                     (void **)&orig_global_group_size, SWIFT_STRUCT_ALIGNMENT,
-                     group_count * sizeof(size_t)) != 0)
-    error(
-        "Error while allocating memory for the displacement in memory for the "
-        "global group link list");
+  /* Each group now iteratively adopts the best label (largest group, then
+   * smallest ID) of its neighbours, and jumps to the label of its label, until
+   * all the groups of a connected component agree on their root. */
+  struct fof_label *label_send = NULL;
+  size_t *request_node = NULL;
+  if (swift_memalign("fof_label_send", (void **)&label_send,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     max(num_edges, 1) * sizeof(struct fof_label)) != 0 ||
+      swift_memalign("fof_request_node", (void **)&request_node,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     max(num_nodes, 1) * sizeof(size_t)) != 0)
+    error("Error while allocating memory for the FOF label exchange");
+
+  int *label_count = (int *)malloc(nr_nodes * sizeof(int));
+  int *reply_count = (int *)malloc(nr_nodes * sizeof(int));
+
+  int num_rounds = 0;
+  int active = 1;
+  while (active) {
+
+    int changed = 0;
+    bzero(node_changed_next, num_nodes * sizeof(char));
+
+    /* Propagate the labels which changed during the last round along the
+     * edges. */
+    size_t num_send = 0;
+    for (int r = 0; r < nr_nodes; r++) {
+      label_count[r] = 0;
+      for (int k = edge_offset[r]; k < edge_offset[r + 1]; k++) {
+        const size_t n = edge_node[k];
+        if (!node_changed[n]) continue;
+        label_send[num_send].group_id = edge_foreign[k];
+        label_send[num_send].label = node_label[n];
+        label_send[num_send++].label_size = node_label_size[n];
+        label_count[r]++;
+      }
+    }
 
-  for (int i = 0; i < group_count; i++)
-    orig_global_group_size[i] = global_group_size[i];
+    size_t num_labels = 0;
+    struct fof_label *labels = fof_exchange_labels(label_send, label_count,
+                                                   nr_nodes, &num_labels, NULL);
+
+    for (size_t i = 0; i < num_labels; i++) {
+      const size_t n = hashmap_find_group_offset(labels[i].group_id, &map);
+      if (fof_label_is_better(labels[i].label_size, labels[i].label,
+                              node_label_size[n], node_label[n])) {
+        node_label[n] = labels[i].label;
+        node_label_size[n] = labels[i].label_size;
+        node_changed_next[n] = 1;
+        changed = 1;
+      }
+    }
+    swift_free("fof_label_recv", labels);
+
+    /* Pointer jumping: ask the owner of each label for the label it has
+     * itself adopted. The labels owned by this rank are resolved directly. */
+    bzero(label_count, nr_nodes * sizeof(int));
+    for (size_t n = 0; n < num_nodes; n++) {
+      if (node_label[n] == node_id[n]) continue;
+      const int dest =
+          fof_node_of_index(node_label[n], first_on_node, nr_nodes);
+      if (dest == engine_rank) {
+        const size_t m = hashmap_find_group_offset(node_label[n], &map);
+        if (fof_label_is_better(node_label_size[m], node_label[m],
+                                node_label_size[n], node_label[n])) {
+          node_label[n] = node_label[m];
+          node_label_size[n] = node_label_size[m];
+          node_changed_next[n] = 1;
+          changed = 1;
+        }
+      } else
+        label_count[dest]++;
+    }
 
-  /* Perform a union-find on the group links. */
-  for (int i = 0; i < global_group_link_count; i++) {
+    int *request_offset = (int *)malloc(nr_nodes * sizeof(int));
+    request_offset[0] = 0;
+    for (int r = 1; r < nr_nodes; r++)
+      request_offset[r] = request_offset[r - 1] + label_count[r - 1];
+    for (size_t n = 0; n < num_nodes; n++) {
+      if (node_label[n] == node_id[n]) continue;
+      const int dest =
+          fof_node_of_index(node_label[n], first_on_node, nr_nodes);
+      if (dest == engine_rank) continue;
+      const int k = request_offset[dest]++;
+      label_send[k].group_id = node_label[n];
+      request_node[k] = n;
+    }
+    free(request_offset);
 
-    /* Use the hash table to find the group offsets in the index array. */
-    size_t find_i =
-        hashmap_find_group_offset(global_group_links[i].group_i, &map);
-    size_t find_j =
-        hashmap_find_group_offset(global_group_links[i].group_j, &map);
+    size_t num_requests = 0;
+    struct fof_label *requests = fof_exchange_labels(
+        label_send, label_count, nr_nodes, &num_requests, reply_count);
 
-    /* Use the offset to find the group's root. */
-    size_t root_i = fof_find(find_i, global_group_index);
-    size_t root_j = fof_find(find_j, global_group_index);
+    /* Answer the requests in the order they were received. */
+    for (size_t i = 0; i < num_requests; i++) {
+      const size_t m = hashmap_find_group_offset(requests[i].group_id, &map);
+      requests[i].label = node_label[m];
+      requests[i].label_size = node_label_size[m];
+    }
 
-    size_t group_i = global_group_id[root_i];
-    size_t group_j = global_group_id[root_j];
+    size_t num_replies = 0;
+    struct fof_label *replies = fof_exchange_labels(
+        requests, reply_count, nr_nodes, &num_replies, NULL);
+    swift_free("fof_label_recv", requests);
+
+    for (size_t i = 0; i < num_replies; i++) {
+      const size_t n = request_node[i];
+      if (fof_label_is_better(replies[i].label_size, replies[i].label,
+                              node_label_size[n], node_label[n])) {
+        node_label[n] = replies[i].label;
+        node_label_size[n] = replies[i].label_size;
+        node_changed_next[n] = 1;
+        changed = 1;
+      }
+    }
+    swift_free("fof_label_recv", replies);
 
-    if (group_i == group_j) continue;
+    /* Swap the flags for the next round */
+    char *temp = node_changed;
+    node_changed = node_changed_next;
+    node_changed_next = temp;
 
-    /* Update roots accordingly. */
-    size_t size_i = global_group_size[root_i];
-    size_t size_j = global_group_size[root_j];
-#ifdef UNION_BY_SIZE_OVER_MPI
-    if (size_i < size_j) {
-      global_group_index[root_i] = root_j;
-      global_group_size[root_j] += size_i;
-    } else {
-      global_group_index[root_j] = root_i;
-      global_group_size[root_i] += size_j;
-    }
-#else
-    if (group_j < group_i) {
-      global_group_index[root_i] = root_j;
-      global_group_size[root_j] += size_i;
-    } else {
-      global_group_index[root_j] = root_i;
-      global_group_size[root_i] += size_j;
-    }
-#endif
+    MPI_Allreduce(&changed, &active, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    num_rounds++;
   }
 
-  hashmap_free(&map);
-
   if (verbose)
-    message("global_group_index construction took: %.3f %s.",
+    message("Resolving the links over %d rounds took: %.3f %s.", num_rounds,
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
   tic = getticks();
 
-  /* Update each group locally with new root information. */
-  for (int i = 0; i < group_count; i++) {
-
-    size_t group_id = global_group_id[i];
-    size_t offset = fof_find(global_group_index[i], global_group_index);
-    size_t new_root = global_group_id[offset];
-
-    /* If the group is local update its root and size. */
-    if (is_local(group_id, nr_gparts) && new_root != group_id) {
-      group_index[group_id - node_offset] = new_root;
+  /* Attach each local group to its new root and move its size over. */
+  bzero(label_count, nr_nodes * sizeof(int));
+  for (size_t n = 0; n < num_nodes; n++) {
 
-      group_size[group_id - node_offset] -= orig_global_group_size[i];
-    }
+    if (node_label[n] == node_id[n]) continue;
 
-    /* If the group linked to a local root update its size. */
-    if (is_local(new_root, nr_gparts) && new_root != group_id) {
+    group_index[node_id[n] - node_offset] = node_label[n];
+    group_size[node_id[n] - node_offset] -= node_size[n];
 
-      /* Use group sizes before Union-Find */
-      group_size[new_root - node_offset] += orig_global_group_size[i];
-    }
-  }
+    const int dest = fof_node_of_index(node_label[n], first_on_node, nr_nodes);
+    if (dest == engine_rank)
+      group_size[node_label[n] - node_offset] += node_size[n];
+    else
+      label_count[dest]++;
+  }
+
+  int *size_offset = (int *)malloc(nr_nodes * sizeof(int));
+  size_offset[0] = 0;
+  for (int r = 1; r < nr_nodes; r++)
+    size_offset[r] = size_offset[r - 1] + label_count[r - 1];
+  for (size_t n = 0; n < num_nodes; n++) {
+    if (node_label[n] == node_id[n]) continue;
+    const int dest = fof_node_of_index(node_label[n], first_on_node, nr_nodes);
+    if (dest == engine_rank) continue;
+    const int k = size_offset[dest]++;
+    label_send[k].group_id = node_label[n];
+    label_send[k].label = node_id[n];
+    label_send[k].label_size = node_size[n];
+  }
+  free(size_offset);
+
+  size_t num_sizes = 0;
+  struct fof_label *sizes = fof_exchange_labels(label_send, label_count,
+                                                nr_nodes, &num_sizes, NULL);
+  for (size_t i = 0; i < num_sizes; i++)
+    group_size[sizes[i].group_id - node_offset] += sizes[i].label_size;
+  swift_free("fof_label_recv", sizes);
 
   if (verbose)
     message("Updating groups locally took: %.3f %s.",
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
   /* Clean up memory. */
-  swift_free("fof_global_group_links", global_group_links);
-  swift_free("fof_global_group_index", global_group_index);
-  swift_free("fof_global_group_size", global_group_size);
-  swift_free("fof_global_group_id", global_group_id);
-  swift_free("fof_orig_global_group_size", orig_global_group_size);
+  hashmap_free(&map);
+  free(first_on_node);
+  free(sendcount);
+  free(pack_offset);
+  free(edge_offset);
+  free(label_count);
+  free(reply_count);
+  free(node_changed);
+  free(node_changed_next);
+  swift_free("fof_edge_node", edge_node);
+  swift_free("fof_edge_foreign", edge_foreign);
+  swift_free("fof_node_id", node_id);
+  swift_free("fof_node_size", node_size);
+  swift_free("fof_node_label", node_label);
+  swift_free("fof_node_label_size", node_label_size);
+  swift_free("fof_label_send", label_send);
+  swift_free("fof_request_node", request_node);
 
 #endif /* WITH_MPI */
 }
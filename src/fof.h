@@ -134,6 +134,14 @@ struct fof_final_index {
   size_t global_root;
 } SWIFT_STRUCT_ALIGN;
 
+/* Struct used to propagate the root of the groups spanning several MPI
+ * ranks */
+struct fof_label {
+  size_t group_id;
+  size_t label;
+  size_t label_size;
+} SWIFT_STRUCT_ALIGN;
+
 /* Struct used to find the total mass of a group when using MPI */
 struct fof_final_mass {
   size_t global_root;
@@ -42,12 +42,20 @@ struct gpart {
   /*! Particle mass. */
   float mass;
 
+#ifndef GRAVITY_UNPADDED_GPARTS
   /*! Norm of the acceleration at the previous step. */
   float old_a_grav_norm;
+#endif
 
   /*! Particle FoF properties (group ID, group size, ...) */
   struct fof_gpart_data fof_data;
 
+#ifdef GRAVITY_UNPADDED_GPARTS
+  /*! Norm of the acceleration at the previous step (upper 16 bits of the
+   * float). */
+  uint16_t old_a_grav_norm_bits;
+#endif
+
   /*! Time-step length */
   timebin_t time_bin;
 
@@ -102,6 +110,6 @@ struct gpart {
   long long num_interacted_pm;
 #endif
 
-} SWIFT_STRUCT_ALIGN;
+} SWIFT_GPART_ALIGN;
 
 #endif /* SWIFT_DEFAULT_GRAVITY_PART_H */
@@ -39,6 +39,51 @@ __attribute__((always_inline)) INLINE static float gravity_get_mass(
   return gp->mass;
 }
 
+/**
+ * @brief Returns the norm of the acceleration of a particle at its previous
+ * step
+ *
+ * @param gp The particle of interest
+ */
+__attribute__((always_inline)) INLINE static float gravity_get_old_a_grav_norm(
+    const struct gpart* restrict gp) {
+
+#ifdef GRAVITY_UNPADDED_GPARTS
+  union {
+    float f;
+    uint32_t i;
+  } norm;
+  norm.i = ((uint32_t)gp->old_a_grav_norm_bits) << 16;
+  return norm.f;
+#else
+  return gp->old_a_grav_norm;
+#endif
+}
+
+/**
+ * @brief Sets the norm of the acceleration of a particle at its previous step
+ *
+ * With unpadded #gpart, only the upper 16 bits of the float are kept. Rounding
+ * towards zero gives a slightly tighter tolerance in the opening criterion.
+ *
+ * @param gp The particle of interest
+ * @param a_grav_norm The norm of the acceleration.
+ */
+__attribute__((always_inline)) INLINE static void gravity_set_old_a_grav_norm(
+    struct gpart* restrict gp, const float a_grav_norm) {
+
+#ifdef GRAVITY_UNPADDED_GPARTS
+  union {
+    float f;
+    uint32_t i;
+  } norm;
+  norm.f = a_grav_norm;
+  gp->old_a_grav_norm_bits = (uint16_t)(norm.i >> 16);
+#else
+  gp->old_a_grav_norm = a_grav_norm;
+#endif
+}
+
 /**
  * @brief Returns the current co-moving softening of a particle
  *
@@ -179,14 +224,14 @@ __attribute__((always_inline)) INLINE static void gravity_end_force(
 
   /* Record the norm of the acceleration for the adaptive opening criteria.
    * Will always be an (active) timestep behind. */
-  gp->old_a_grav_norm = gp->a_grav[0] * gp->a_grav[0] +
-                        gp->a_grav[1] * gp->a_grav[1] +
-                        gp->a_grav[2] * gp->a_grav[2];
+  const float a_grav_norm2 = gp->a_grav[0] * gp->a_grav[0] +
+                            gp->a_grav[1] * gp->a_grav[1] +
+                            gp->a_grav[2] * gp->a_grav[2];
 
-  gp->old_a_grav_norm = sqrtf(gp->old_a_grav_norm);
+  gravity_set_old_a_grav_norm(gp, sqrtf(a_grav_norm2));
 
 #ifdef SWIFT_DEBUG_CHECKS
-  if (with_self_gravity && gp->old_a_grav_norm == 0.f)
+  if (with_self_gravity && gravity_get_old_a_grav_norm(gp) == 0.f)
     error("Old acceleration is 0!");
 #endif
 
@@ -250,7 +295,7 @@ __attribute__((always_inline)) INLINE static void gravity_first_init_gpart(
     struct gpart* gp, const struct gravity_props* grav_props) {
 
   gp->time_bin = 0;
-  gp->old_a_grav_norm = 0.f;
+  gravity_set_old_a_grav_norm(gp, 0.f);
 
   gravity_init_gpart(gp);
 }
@@ -45,12 +45,20 @@ struct gpart {
   /*! Particle mass. */
   float mass;
 
+#ifndef GRAVITY_UNPADDED_GPARTS
   /*! Norm of the acceleration at the previous step. */
   float old_a_grav_norm;
+#endif
 
   /*! Particle FoF properties (group ID, group size, ...) */
   struct fof_gpart_data fof_data;
 
+#ifdef GRAVITY_UNPADDED_GPARTS
+  /*! Norm of the acceleration at the previous step (upper 16 bits of the
+   * float). */
+  uint16_t old_a_grav_norm_bits;
+#endif
+
   /*! Time-step length */
   timebin_t time_bin;
 
@@ -88,6 +96,6 @@ struct gpart {
   double potential_exact;
 #endif
 
-} SWIFT_STRUCT_ALIGN;
+} SWIFT_GPART_ALIGN;
 
 #endif /* SWIFT_POTENTIAL_GRAVITY_PART_H */
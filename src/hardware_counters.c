@@ -0,0 +1,370 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2020 The SWIFT collaboration
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file hardware_counters.c
+ *  @brief Measurement of the CPU hardware counters of each task type and
+ *  sub-type using the Linux perf_event_open interface.
+ */
+
+/* Config parameters. */
+#include "../config.h"
+
+#ifdef SWIFT_HARDWARE_COUNTERS
+
+/* Standard headers. */
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+/* This object's header. */
+#include "hardware_counters.h"
+
+/* Local headers. */
+#include "atomic.h"
+#include "engine.h"
+#include "error.h"
+#include "memuse.h"
+#include "task.h"
+
+/* Raw event counting the retired floating-point arithmetic instructions of
+ * all widths on Intel CPUs since Skylake (FP_ARITH_INST_RETIRED, all umasks).
+ * There is no generic perf event for this, so it is only used on Intel. */
+#define hardware_counters_intel_fp_event 0xffc7
+
+/* Names of the counted events. */
+const char *hardware_counter_names[hardware_counter_count] = {
+    "cycles", "instructions", "llc_misses", "fp_ops"};
+
+/* The file the per-step counts are written to. */
+static FILE *hardware_counters_file = NULL;
+
+/* Has the failure to open the counters already been reported? */
+static volatile int hardware_counters_warned = 0;
+
+/* Which events could be opened by the runners of this rank. */
+static int hardware_counters_available[hardware_counter_count] = {0};
+
+/* Number of type/sub-type combinations. */
+#define hardware_counters_nr_entries (task_type_count * task_subtype_count)
+
+/**
+ * @brief Open a perf event counting the user-space activity of the calling
+ * thread.
+ *
+ * @param type The perf type of the event.
+ * @param config The perf configuration of the event.
+ * @param group_fd The group leader, -1 to create a new group.
+ *
+ * @return The file descriptor of the event or -1 on failure.
+ */
+static int hardware_counters_open(const uint32_t type, const uint64_t config,
+                                  const int group_fd) {
+
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(struct perf_event_attr));
+  attr.size = sizeof(struct perf_event_attr);
+  attr.type = type;
+  attr.config = config;
+  attr.read_format = PERF_FORMAT_GROUP;
+  attr.disabled = (group_fd == -1);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return syscall(__NR_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1, group_fd,
+                 /*flags=*/0);
+}
+
+/**
+ * @brief Read the current values of all the events of a runner's group.
+ *
+ * @param hc The #hardware_counters.
+ * @param values (return) The counts, 0 for unavailable events.
+ */
+static void hardware_counters_read(const struct hardware_counters *hc,
+                                   uint64_t values[hardware_counter_count]) {
+
+  uint64_t buffer[hardware_counter_count + 1];
+  const size_t size = (hc->nr_events + 1) * sizeof(uint64_t);
+  if (read(hc->fd[hardware_counter_cycles], buffer, size) != (ssize_t)size)
+    error("Failed to read the hardware counters.");
+
+  /* buffer[0] is the number of events in the group. */
+  for (int k = 0; k < hardware_counter_count; k++)
+    values[k] = (hc->index[k] >= 0) ? buffer[hc->index[k] + 1] : 0;
+}
+
+/**
+ * @brief Open the hardware counters of a runner.
+ *
+ * Must be called by the runner's thread as the events count the activity of
+ * the thread that opened them. If the counters cannot be opened (e.g. because
+ * of the value of /proc/sys/kernel/perf_event_paranoid) the runner runs
+ * without them.
+ *
+ * @param hc The #hardware_counters to initialise.
+ */
+void hardware_counters_init(struct hardware_counters *hc) {
+
+  for (int k = 0; k < hardware_counter_count; k++) {
+    hc->fd[k] = -1;
+    hc->index[k] = -1;
+    hc->start[k] = 0;
+  }
+  hc->nr_events = 0;
+
+  const size_t size =
+      hardware_counters_nr_entries * sizeof(struct hardware_counters_entry);
+  if (swift_memalign("hardware_counters", (void **)&hc->entries,
+                     SWIFT_STRUCT_ALIGNMENT, size) != 0 ||
+      swift_memalign("hardware_counters", (void **)&hc->totals,
+                     SWIFT_STRUCT_ALIGNMENT, size) != 0)
+    error("Failed to allocate the hardware counters.");
+  bzero(hc->entries, size);
+  bzero(hc->totals, size);
+
+  /* The cycle counter leads the group. Without it we have nothing. */
+  const int leader =
+      hardware_counters_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+  if (leader < 0) {
+    if (atomic_cas(&hardware_counters_warned, 0, 1) == 0)
+      message("WARNING: Could not open the hardware counters (%s).",
+              strerror(errno));
+    return;
+  }
+  hc->fd[hardware_counter_cycles] = leader;
+  hc->index[hardware_counter_cycles] = hc->nr_events++;
+
+  hc->fd[hardware_counter_instructions] = hardware_counters_open(
+      PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, leader);
+  hc->fd[hardware_counter_llc_misses] = hardware_counters_open(
+      PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, leader);
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_is("intel"))
+    hc->fd[hardware_counter_fp_ops] = hardware_counters_open(
+        PERF_TYPE_RAW, hardware_counters_intel_fp_event, leader);
+#endif
+
+  /* Record where each available event sits in the group. */
+  for (int k = hardware_counter_cycles + 1; k < hardware_counter_count; k++)
+    if (hc->fd[k] >= 0) hc->index[k] = hc->nr_events++;
+
+  for (int k = 0; k < hardware_counter_count; k++)
+    if (hc->fd[k] >= 0) hardware_counters_available[k] = 1;
+
+  /* Start counting. */
+  ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+/**
+ * @brief Record the counters at the start of a task.
+ *
+ * @param hc The #hardware_counters of the runner.
+ */
+void hardware_counters_start(struct hardware_counters *hc) {
+  if (hc->nr_events == 0) return;
+  hardware_counters_read(hc, hc->start);
+}
+
+/**
+ * @brief Accumulate the counts since the last call to
+ * hardware_counters_start() for a given task type and sub-type.
+ *
+ * @param hc The #hardware_counters of the runner.
+ * @param type The type of the task that ran.
+ * @param subtype The sub-type of the task that ran.
+ */
+void hardware_counters_stop(struct hardware_counters *hc, const int type,
+                            const int subtype) {
+  if (hc->nr_events == 0) return;
+
+  uint64_t values[hardware_counter_count];
+  hardware_counters_read(hc, values);
+
+  struct hardware_counters_entry *entry =
+      &hc->entries[type * task_subtype_count + subtype];
+  entry->nr_tasks++;
+  for (int k = 0; k < hardware_counter_count; k++)
+    entry->values[k] += values[k] - hc->start[k];
+}
+
+/**
+ * @brief Close the counters of a runner and free its memory.
+ *
+ * @param hc The #hardware_counters.
+ */
+void hardware_counters_clean(struct hardware_counters *hc) {
+  for (int k = 0; k < hardware_counter_count; k++) {
+    if (hc->fd[k] >= 0) close(hc->fd[k]);
+    hc->fd[k] = -1;
+  }
+  hc->nr_events = 0;
+  swift_free("hardware_counters", hc->entries);
+  swift_free("hardware_counters", hc->totals);
+  hc->entries = NULL;
+  hc->totals = NULL;
+}
+
+/**
+ * @brief Append the counts of each runner since the last call to this rank's
+ * hardware counters file and add them to the runner's totals.
+ *
+ * @param e The #engine.
+ */
+void hardware_counters_report_step(struct engine *e) {
+
+  if (hardware_counters_file == NULL) {
+    char filename[64];
+#ifdef WITH_MPI
+    snprintf(filename, sizeof(filename), "hardware_counters_rank%d.txt",
+             e->nodeID);
+#else
+    snprintf(filename, sizeof(filename), "hardware_counters.txt");
+#endif
+    hardware_counters_file = fopen(filename, "w");
+    if (hardware_counters_file == NULL)
+      error("Could not create hardware counters file '%s'.", filename);
+    fprintf(hardware_counters_file,
+            "# step runner type subtype nr_tasks cycles instructions "
+            "llc_misses fp_ops\n");
+  }
+
+  for (int k = 0; k < e->nr_threads; k++) {
+    struct hardware_counters *hc = &e->runners[k].hw_counters;
+
+    for (int i = 0; i < hardware_counters_nr_entries; i++) {
+      struct hardware_counters_entry *entry = &hc->entries[i];
+      if (entry->nr_tasks == 0) continue;
+
+      fprintf(hardware_counters_file, "%d %d %s %s %llu", e->step, k,
+              taskID_names[i / task_subtype_count],
+              subtaskID_names[i % task_subtype_count],
+              (unsigned long long)entry->nr_tasks);
+      for (int j = 0; j < hardware_counter_count; j++)
+        fprintf(hardware_counters_file, " %llu",
+                (unsigned long long)entry->values[j]);
+      fprintf(hardware_counters_file, "\n");
+
+      /* Move the counts of this step to the runner's totals. */
+      hc->totals[i].nr_tasks += entry->nr_tasks;
+      for (int j = 0; j < hardware_counter_count; j++)
+        hc->totals[i].values[j] += entry->values[j];
+      bzero(entry, sizeof(struct hardware_counters_entry));
+    }
+  }
+  fflush(hardware_counters_file);
+}
+
+/**
+ * @brief Print the counts accumulated over the whole run by all the ranks.
+ *
+ * Reports the instructions per cycle (IPC), the last-level cache misses per
+ * thousand instructions (MPKI) and the floating-point instructions per cycle
+ * of each task type and sub-type. A low IPC with a high MPKI is the sign of a
+ * memory-bound task.
+ *
+ * Must be called by all ranks.
+ *
+ * @param e The #engine.
+ */
+void hardware_counters_report(struct engine *e) {
+
+  /* Collect what has not been reported yet. */
+  hardware_counters_report_step(e);
+
+  /* Sum the totals of the runners. */
+  struct hardware_counters_entry *total =
+      (struct hardware_counters_entry *)calloc(
+          hardware_counters_nr_entries, sizeof(struct hardware_counters_entry));
+  if (total == NULL) error("Failed to allocate the hardware counters totals.");
+  for (int k = 0; k < e->nr_threads; k++) {
+    const struct hardware_counters *hc = &e->runners[k].hw_counters;
+    for (int i = 0; i < hardware_counters_nr_entries; i++) {
+      total[i].nr_tasks += hc->totals[i].nr_tasks;
+      for (int j = 0; j < hardware_counter_count; j++)
+        total[i].values[j] += hc->totals[i].values[j];
+    }
+  }
+
+  int available[hardware_counter_count];
+  memcpy(available, hardware_counters_available, sizeof(available));
+
+#ifdef WITH_MPI
+  /* The entries are only made of 64-bit counters. */
+  const int count = hardware_counters_nr_entries * (1 + hardware_counter_count);
+  if (e->nodeID == 0) {
+    MPI_Reduce(MPI_IN_PLACE, total, count, MPI_UINT64_T, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+    MPI_Reduce(MPI_IN_PLACE, available, hardware_counter_count, MPI_INT,
+               MPI_MIN, 0, MPI_COMM_WORLD);
+  } else {
+    MPI_Reduce(total, NULL, count, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(available, NULL, hardware_counter_count, MPI_INT, MPI_MIN, 0,
+               MPI_COMM_WORLD);
+  }
+#endif
+
+  if (e->nodeID == 0) {
+    message("*** Hardware counters of the tasks over the whole run:");
+    message("*** %35s %10s %12s %6s %8s %8s", "task", "count", "Mcycles",
+            "IPC", "LLC MPKI", "FP/cycle");
+    for (int i = 0; i < hardware_counters_nr_entries; i++) {
+      if (total[i].nr_tasks == 0) continue;
+
+      char name[64];
+      snprintf(name, sizeof(name), "%s/%s",
+               taskID_names[i / task_subtype_count],
+               subtaskID_names[i % task_subtype_count]);
+
+      const double cycles = total[i].values[hardware_counter_cycles];
+      const double instr = total[i].values[hardware_counter_instructions];
+      const double misses = total[i].values[hardware_counter_llc_misses];
+      const double fp = total[i].values[hardware_counter_fp_ops];
+
+      char ipc[16] = "n/a", mpki[16] = "n/a", flops[16] = "n/a";
+      if (available[hardware_counter_instructions] && cycles > 0.)
+        snprintf(ipc, sizeof(ipc), "%6.2f", instr / cycles);
+      if (available[hardware_counter_llc_misses] && instr > 0.)
+        snprintf(mpki, sizeof(mpki), "%8.3f", 1000. * misses / instr);
+      if (available[hardware_counter_fp_ops] && cycles > 0.)
+        snprintf(flops, sizeof(flops), "%8.3f", fp / cycles);
+
+      message("*** %35s %10llu %12.1f %6s %8s %8s", name,
+              (unsigned long long)total[i].nr_tasks, cycles * 1e-6, ipc, mpki,
+              flops);
+    }
+  }
+
+  if (hardware_counters_file != NULL) fclose(hardware_counters_file);
+  hardware_counters_file = NULL;
+  free(total);
+}
+
+#endif /* SWIFT_HARDWARE_COUNTERS */
@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2020 The SWIFT collaboration
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_HARDWARE_COUNTERS_H
+#define SWIFT_HARDWARE_COUNTERS_H
+
+/* Config parameters. */
+#include "../config.h"
+
+#ifdef SWIFT_HARDWARE_COUNTERS
+
+/* Standard headers. */
+#include <stdint.h>
+
+struct engine;
+
+/**
+ * @brief The hardware events counted for each task.
+ */
+enum hardware_counter_types {
+  hardware_counter_cycles,       /* CPU cycles. */
+  hardware_counter_instructions, /* Retired instructions. */
+  hardware_counter_llc_misses,   /* Last-level cache misses. */
+  hardware_counter_fp_ops,       /* Retired floating-point instructions. */
+  hardware_counter_count
+};
+
+extern const char *hardware_counter_names[hardware_counter_count];
+
+/**
+ * @brief The counts accumulated by all the tasks of a given type/sub-type.
+ */
+struct hardware_counters_entry {
+
+  /*! Number of tasks measured. */
+  uint64_t nr_tasks;
+
+  /*! The accumulated counts (see #hardware_counter_types). */
+  uint64_t values[hardware_counter_count];
+};
+
+/**
+ * @brief The hardware counters of a single runner.
+ *
+ * The events are opened as a single perf group led by the cycle counter such
+ * that they can be read in a single system call and are scheduled together
+ * on the PMU.
+ */
+struct hardware_counters {
+
+  /*! File descriptors of the events, -1 if not available. */
+  int fd[hardware_counter_count];
+
+  /*! Position of each event in the group read, -1 if not available. */
+  int index[hardware_counter_count];
+
+  /*! Number of events in the group. */
+  int nr_events;
+
+  /*! The counts read at the start of the current task. */
+  uint64_t start[hardware_counter_count];
+
+  /*! The counts accumulated since the last report, per type and sub-type. */
+  struct hardware_counters_entry *entries;
+
+  /*! The counts accumulated over the whole run, per type and sub-type. */
+  struct hardware_counters_entry *totals;
+};
+
+/* Function prototypes. */
+void hardware_counters_init(struct hardware_counters *hc);
+void hardware_counters_start(struct hardware_counters *hc);
+void hardware_counters_stop(struct hardware_counters *hc, int type,
+                            int subtype);
+void hardware_counters_clean(struct hardware_counters *hc);
+void hardware_counters_report_step(struct engine *e);
+void hardware_counters_report(struct engine *e);
+
+#endif /* SWIFT_HARDWARE_COUNTERS */
+
+#endif /* SWIFT_HARDWARE_COUNTERS_H */
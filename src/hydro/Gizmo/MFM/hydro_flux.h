@@ -73,6 +73,28 @@ __attribute__((always_inline)) INLINE static void hydro_compute_flux(
   fluxes[4] *= Anorm;
 }
 
+/**
+ * @brief Compute the fluxes for a batch of Riemann problems.
+ *
+ * Batched version of hydro_compute_flux(), the fluxes are stored in the
+ * batch.
+ *
+ * @param b The #riemann_batch.
+ * @param Anorm Surface areas of the interfaces.
+ */
+__attribute__((always_inline)) INLINE static void hydro_compute_flux_batch(
+    struct riemann_batch* restrict b, const float* restrict Anorm) {
+
+  riemann_solve_for_middle_state_flux_batch(b);
+
+  for (int i = 0; i < b->count; i++) {
+    b->flux[1][i] *= Anorm[i];
+    b->flux[2][i] *= Anorm[i];
+    b->flux[3][i] *= Anorm[i];
+    b->flux[4][i] *= Anorm[i];
+  }
+}
+
 /**
  * @brief Update the fluxes for the particle with the given contributions,
  * assuming the particle is to the left of the interparticle interface.
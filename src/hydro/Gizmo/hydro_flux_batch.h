@@ -0,0 +1,57 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2020 The SWIFT collaboration
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_GIZMO_HYDRO_FLUX_BATCH_H
+#define SWIFT_GIZMO_HYDRO_FLUX_BATCH_H
+
+/* Local headers. */
+#include "align.h"
+#include "riemann/riemann_batch.h"
+
+/* Avoid cyclic inclusions */
+struct part;
+
+/**
+ * @brief Flux exchanges of the force loop that still need their Riemann
+ * problem solved (GIZMO_BATCHED_RIEMANN only).
+ *
+ * Every #runner owns one of these. The interactions queue the problems here
+ * and runner_iact_force_batch_flush() solves them and applies the fluxes to
+ * the particles. The batch must be flushed before the task that filled it
+ * releases its cells.
+ */
+struct hydro_flux_batch {
+
+  /*! The Riemann problems, in the frame of the interfaces */
+  struct riemann_batch riemann;
+
+  /*! Surface areas of the interfaces */
+  float Anorm[RIEMANN_BATCH_SIZE] SWIFT_CACHE_ALIGN;
+
+  /*! Distance vectors between the particles (pi->x - pj->x) */
+  float dx[RIEMANN_BATCH_SIZE][3];
+
+  /*! Particles to the left of the interfaces */
+  struct part *pi[RIEMANN_BATCH_SIZE];
+
+  /*! Particles to the right of the interfaces (NULL for non-symmetric
+   * interactions) */
+  struct part *pj[RIEMANN_BATCH_SIZE];
+};
+
+#endif /* SWIFT_GIZMO_HYDRO_FLUX_BATCH_H */
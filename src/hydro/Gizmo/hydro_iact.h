@@ -20,6 +20,7 @@
 #define SWIFT_GIZMO_HYDRO_IACT_H
 
 #include "hydro_flux.h"
+#include "hydro_flux_batch.h"
 #include "hydro_getters.h"
 #include "hydro_gradients.h"
 #include "hydro_setters.h"
@@ -182,19 +183,12 @@ __attribute__((always_inline)) INLINE static void runner_iact_nonsym_gradient(
 }
 
 /**
- * @brief Common part of the flux calculation between particle i and j
- *
- * Since the only difference between the symmetric and non-symmetric version
- * of the flux calculation  is in the update of the conserved variables at the
- * very end (which is not done for particle j if mode is 0), both
- * runner_iact_force and runner_iact_nonsym_force call this method, with an
- * appropriate mode.
+ * @brief Set up the Riemann problem between particle i and j
  *
  * This method calculates the surface area of the interface between particle i
  * and particle j, as well as the interface position and velocity. These are
- * then used to reconstruct and predict the primitive variables, which are then
- * fed to a Riemann solver that calculates a flux. This flux is used to update
- * the conserved variables of particle i or both particles.
+ * then used to reconstruct and predict the primitive variables, which are
+ * boosted to the frame of the interface to form the Riemann problem.
  *
  * This method also calculates the maximal velocity used to calculate the time
  * step.
@@ -206,12 +200,22 @@ __attribute__((always_inline)) INLINE static void runner_iact_nonsym_gradient(
  * @param hj Comoving smoothing-length of particle j.
  * @param pi Particle i.
  * @param pj Particle j.
+ * @param mode 0 if non-symmetric interaction, 1 if symmetric.
  * @param a Current scale factor.
  * @param H Current Hubble parameter.
+ * @param Wi (return) Left state of the Riemann problem.
+ * @param Wj (return) Right state of the Riemann problem.
+ * @param n_unit (return) Unit vector of the interface.
+ * @param vij (return) Velocity of the interface.
+ * @param area (return) Surface area of the interface.
+ * @return 0 if the interface has no area (and there is no flux), 1 otherwise.
  */
-__attribute__((always_inline)) INLINE static void runner_iact_fluxes_common(
-    float r2, const float *dx, float hi, float hj, struct part *restrict pi,
-    struct part *restrict pj, int mode, float a, float H) {
+__attribute__((always_inline)) INLINE static int
+runner_iact_fluxes_riemann_problem(float r2, const float *dx, float hi,
+                                   float hj, struct part *restrict pi,
+                                   struct part *restrict pj, int mode, float a,
+                                   float H, float *Wi, float *Wj, float *n_unit,
+                                   float *vij, float *area) {
 
   const float r_inv = 1.0f / sqrtf(r2);
   const float r = r2 * r_inv;
@@ -230,7 +234,6 @@ __attribute__((always_inline)) INLINE static void runner_iact_fluxes_common(
   }
   const float Vi = pi->geometry.volume;
   const float Vj = pj->geometry.volume;
-  float Wi[5], Wj[5];
   hydro_part_get_primitive_variables(pi, Wi);
   hydro_part_get_primitive_variables(pj, Wj);
 
@@ -333,12 +336,13 @@ __attribute__((always_inline)) INLINE static void runner_iact_fluxes_common(
   /* if the interface has no area, nothing happens and we return */
   /* continuing results in dividing by zero and NaN's... */
   if (Anorm2 == 0.0f) {
-    return;
+    return 0;
   }
 
   /* Compute the area */
   const float Anorm_inv = 1.0f / sqrtf(Anorm2);
   const float Anorm = Anorm2 * Anorm_inv;
+  *area = Anorm;
 
 #ifdef SWIFT_DEBUG_CHECKS
   /* For stability reasons, we do require A and dx to have opposite
@@ -357,8 +361,9 @@ __attribute__((always_inline)) INLINE static void runner_iact_fluxes_common(
 #endif
 
   /* compute the normal vector of the interface */
-  const float n_unit[3] = {A[0] * Anorm_inv, A[1] * Anorm_inv,
-                           A[2] * Anorm_inv};
+  n_unit[0] = A[0] * Anorm_inv;
+  n_unit[1] = A[1] * Anorm_inv;
+  n_unit[2] = A[2] * Anorm_inv;
 
   /* Compute interface position (relative to pi, since we don't need the actual
    * position) eqn. (8) */
@@ -367,9 +372,9 @@ __attribute__((always_inline)) INLINE static void runner_iact_fluxes_common(
 
   /* Compute interface velocity */
   /* eqn. (9) */
-  const float vij[3] = {vi[0] + (vi[0] - vj[0]) * xfac,
-                        vi[1] + (vi[1] - vj[1]) * xfac,
-                        vi[2] + (vi[2] - vj[2]) * xfac};
+  vij[0] = vi[0] + (vi[0] - vj[0]) * xfac;
+  vij[1] = vi[1] + (vi[1] - vj[1]) * xfac;
+  vij[2] = vi[2] + (vi[2] - vj[2]) * xfac;
 
   /* complete calculation of position of interface */
   /* NOTE: dx is not necessarily just pi->x - pj->x but can also contain
@@ -395,6 +400,43 @@ __attribute__((always_inline)) INLINE static void runner_iact_fluxes_common(
   /* we don't need to rotate, we can use the unit vector in the Riemann problem
    * itself (see GIZMO) */
 
+  return 1;
+}
+
+/**
+ * @brief Common part of the flux calculation between particle i and j
+ *
+ * Since the only difference between the symmetric and non-symmetric version
+ * of the flux calculation  is in the update of the conserved variables at the
+ * very end (which is not done for particle j if mode is 0), both
+ * runner_iact_force and runner_iact_nonsym_force call this method, with an
+ * appropriate mode.
+ *
+ * The Riemann problem on the interface is set up by
+ * runner_iact_fluxes_riemann_problem() and fed to a Riemann solver that
+ * calculates a flux. This flux is used to update the conserved variables of
+ * particle i or both particles.
+ *
+ * @param r2 Comoving squared distance between particle i and particle j.
+ * @param dx Comoving distance vector between the particles (dx = pi->x -
+ * pj->x).
+ * @param hi Comoving smoothing-length of particle i.
+ * @param hj Comoving smoothing-length of particle j.
+ * @param pi Particle i.
+ * @param pj Particle j.
+ * @param a Current scale factor.
+ * @param H Current Hubble parameter.
+ */
+__attribute__((always_inline)) INLINE static void runner_iact_fluxes_common(
+    float r2, const float *dx, float hi, float hj, struct part *restrict pi,
+    struct part *restrict pj, int mode, float a, float H) {
+
+  float Wi[5], Wj[5], n_unit[3], vij[3], Anorm;
+  if (!runner_iact_fluxes_riemann_problem(r2, dx, hi, hj, pi, pj, mode, a, H,
+                                          Wi, Wj, n_unit, vij, &Anorm)) {
+    return;
+  }
+
   float totflux[5];
   hydro_compute_flux(Wi, Wj, n_unit, vij, Anorm, totflux);
 
@@ -455,4 +497,124 @@ __attribute__((always_inline)) INLINE static void runner_iact_nonsym_force(
   runner_iact_fluxes_common(r2, dx, hi, hj, pi, pj, 0, a, H);
 }
 
+/**
+ * @brief Solve the queued Riemann problems of a #hydro_flux_batch and apply
+ * the fluxes to the particles.
+ *
+ * @param batch The #hydro_flux_batch, empty on return.
+ */
+__attribute__((always_inline)) INLINE static void
+runner_iact_force_batch_flush(struct hydro_flux_batch *restrict batch) {
+
+  struct riemann_batch *restrict b = &batch->riemann;
+  if (b->count == 0) return;
+
+  hydro_compute_flux_batch(b, batch->Anorm);
+
+  for (int i = 0; i < b->count; i++) {
+    const float totflux[5] = {b->flux[0][i], b->flux[1][i], b->flux[2][i],
+                              b->flux[3][i], b->flux[4][i]};
+    hydro_part_update_fluxes_left(batch->pi[i], totflux, batch->dx[i]);
+    if (batch->pj[i] != NULL)
+      hydro_part_update_fluxes_right(batch->pj[i], totflux, batch->dx[i]);
+  }
+
+  b->count = 0;
+}
+
+/**
+ * @brief Common part of the batched flux calculation between particle i and
+ * j
+ *
+ * Same as runner_iact_fluxes_common(), but the Riemann problem is queued in
+ * the batch rather than solved. The flux is only applied to the particles
+ * when the batch is flushed.
+ *
+ * @param r2 Comoving squared distance between particle i and particle j.
+ * @param dx Comoving distance vector between the particles (dx = pi->x -
+ * pj->x).
+ * @param hi Comoving smoothing-length of particle i.
+ * @param hj Comoving smoothing-length of particle j.
+ * @param pi Particle i.
+ * @param pj Particle j.
+ * @param mode 0 if non-symmetric interaction, 1 if symmetric.
+ * @param a Current scale factor.
+ * @param H Current Hubble parameter.
+ * @param batch The #hydro_flux_batch of the runner.
+ */
+__attribute__((always_inline)) INLINE static void
+runner_iact_fluxes_common_batched(float r2, const float *dx, float hi,
+                                  float hj, struct part *restrict pi,
+                                  struct part *restrict pj, int mode, float a,
+                                  float H,
+                                  struct hydro_flux_batch *restrict batch) {
+
+  float Wi[5], Wj[5], n_unit[3], vij[3], Anorm;
+  if (!runner_iact_fluxes_riemann_problem(r2, dx, hi, hj, pi, pj, mode, a, H,
+                                          Wi, Wj, n_unit, vij, &Anorm)) {
+    return;
+  }
+
+  const int i = riemann_batch_add(&batch->riemann, Wi, Wj, n_unit, vij);
+  batch->Anorm[i] = Anorm;
+  batch->dx[i][0] = dx[0];
+  batch->dx[i][1] = dx[1];
+  batch->dx[i][2] = dx[2];
+  batch->pi[i] = pi;
+  batch->pj[i] = (mode == 1) ? pj : NULL;
+
+  if (batch->riemann.count == RIEMANN_BATCH_SIZE)
+    runner_iact_force_batch_flush(batch);
+}
+
+/**
+ * @brief Batched flux calculation between particle i and particle j
+ *
+ * This method calls runner_iact_fluxes_common_batched with mode 1.
+ *
+ * @param r2 Comoving squared distance between particle i and particle j.
+ * @param dx Comoving distance vector between the particles (dx = pi->x -
+ * pj->x).
+ * @param hi Comoving smoothing-length of particle i.
+ * @param hj Comoving smoothing-length of particle j.
+ * @param pi Particle i.
+ * @param pj Particle j.
+ * @param a Current scale factor.
+ * @param H Current Hubble parameter.
+ * @param batch The #hydro_flux_batch of the runner.
+ */
+__attribute__((always_inline)) INLINE static void runner_iact_force_batched(
+    float r2, const float *dx, float hi, float hj, struct part *restrict pi,
+    struct part *restrict pj, float a, float H,
+    struct hydro_flux_batch *restrict batch) {
+
+  runner_iact_fluxes_common_batched(r2, dx, hi, hj, pi, pj, 1, a, H, batch);
+}
+
+/**
+ * @brief Batched flux calculation between particle i and particle j:
+ * non-symmetric version
+ *
+ * This method calls runner_iact_fluxes_common_batched with mode 0.
+ *
+ * @param r2 Comoving squared distance between particle i and particle j.
+ * @param dx Comoving distance vector between the particles (dx = pi->x -
+ * pj->x).
+ * @param hi Comoving smoothing-length of particle i.
+ * @param hj Comoving smoothing-length of particle j.
+ * @param pi Particle i.
+ * @param pj Particle j.
+ * @param a Current scale factor.
+ * @param H Current Hubble parameter.
+ * @param batch The #hydro_flux_batch of the runner.
+ */
+__attribute__((always_inline)) INLINE static void
+runner_iact_nonsym_force_batched(float r2, const float *dx, float hi, float hj,
+                                 struct part *restrict pi,
+                                 struct part *restrict pj, float a, float H,
+                                 struct hydro_flux_batch *restrict batch) {
+
+  runner_iact_fluxes_common_batched(r2, dx, hi, hj, pi, pj, 0, a, H, batch);
+}
+
 #endif /* SWIFT_GIZMO_HYDRO_IACT_H */
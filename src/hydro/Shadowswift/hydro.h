@@ -136,6 +136,9 @@ __attribute__((always_inline)) INLINE static void hydro_first_init_part(
   p->v[2] = p->primitives.v[2];
 #endif
 
+  /* the Voronoi cell has not been constructed yet */
+  voronoi_cell_reset(&p->cell);
+
   /* set the initial velocity of the cells */
   xp->v_full[0] = p->v[0];
   xp->v_full[1] = p->v[1];
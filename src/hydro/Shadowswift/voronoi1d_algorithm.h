@@ -35,6 +35,17 @@
 __attribute__((always_inline)) INLINE static void voronoi_set_box(
     const float *anchor, const float *side) {}
 
+/**
+ * @brief Reset a 1D Voronoi cell that has never been constructed.
+ *
+ * Nothing is kept from one construction of a 1D cell to the next, so there is
+ * nothing to reset.
+ *
+ * @param cell 1D Voronoi cell to reset.
+ */
+__attribute__((always_inline)) INLINE void voronoi_cell_reset(
+    struct voronoi_cell *cell) {}
+
 /**
  * @brief Initialize a 1D Voronoi cell.
  *
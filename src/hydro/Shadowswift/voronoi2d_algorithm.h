@@ -45,6 +45,17 @@
 
 #define VORONOI2D_TOLERANCE 1.e-6f
 
+/**
+ * @brief Reset a 2D Voronoi cell that has never been constructed.
+ *
+ * Nothing is kept from one construction of a 2D cell to the next, so there is
+ * nothing to reset.
+ *
+ * @param cell 2D Voronoi cell to reset.
+ */
+__attribute__((always_inline)) INLINE void voronoi_cell_reset(
+    struct voronoi_cell *cell) {}
+
 /**
  * @brief Initialize a 2D Voronoi cell.
  *
@@ -27,6 +27,7 @@
 #include <string.h>
 #include "error.h"
 #include "inline.h"
+#include "minmax.h"
 #include "voronoi3d_cell.h"
 
 /* For debugging purposes */
@@ -80,6 +81,10 @@ __attribute__((always_inline)) INLINE int check_counter(int *counter,
    criteria */
 #define VORONOI3D_TOLERANCE 1.e-6f
 
+/* Number of waiting neighbours that are tested against the cell vertices at
+   once */
+#define VORONOI3D_CAND_BATCH 8
+
 /* Box boundary flags used to signal cells neighbouring the box boundary
    These values correspond to the top range of possible 64-bit integers, and
    we make the strong assumption that there will never be a particle that has
@@ -1761,10 +1766,10 @@ __attribute__((always_inline)) INLINE void voronoi_intersect(
     }
   }
 
-  /* remove deleted vertices from all arrays */
+  /* remove deleted vertices from all arrays
+     Every element of new_cell that is read below has been set before, so we
+     do not need to copy the (large) old cell into it first. */
   struct voronoi_cell new_cell;
-  /* make sure the contents of the new cell are the same as for the old cell */
-  memcpy(&new_cell, c, sizeof(struct voronoi_cell));
   int m, n;
   for (vindex = 0; vindex < c->nvert; ++vindex) {
     j = vindex;
@@ -2098,6 +2103,197 @@ __attribute__((always_inline)) INLINE void voronoi_calculate_faces(
  * the 1D and 2D algorithm!
  ******************************************************************************/
 
+/**
+ * @brief Get the squared distance between the generator and the vertex of the
+ * cell that lies furthest away from it.
+ *
+ * @param c 3D Voronoi cell.
+ * @return Squared radius of the sphere around the generator that contains the
+ * entire cell.
+ */
+__attribute__((always_inline)) INLINE float voronoi_get_max_radius2(
+    const struct voronoi_cell *c) {
+
+  float max_radius2 = 0.0f;
+  for (int i = 0; i < c->nvert; ++i) {
+    const float v2 = c->vertices[3 * i] * c->vertices[3 * i] +
+                     c->vertices[3 * i + 1] * c->vertices[3 * i + 1] +
+                     c->vertices[3 * i + 2] * c->vertices[3 * i + 2];
+    max_radius2 = fmaxf(max_radius2, v2);
+  }
+  return max_radius2;
+}
+
+/**
+ * @brief Sort a list of waiting neighbours on increasing distance.
+ *
+ * The lists are short, so a simple insertion sort does the job.
+ *
+ * @param c 3D Voronoi cell.
+ * @param order Indices of the neighbours in the waiting list.
+ * @param n Number of neighbours in the list.
+ */
+__attribute__((always_inline)) INLINE void voronoi_sort_candidates(
+    const struct voronoi_cell *c, int *order, int n) {
+
+  for (int i = 1; i < n; ++i) {
+    const int index = order[i];
+    const float r2 = c->cand_r2[index];
+    int j = i - 1;
+    while (j >= 0 && c->cand_r2[order[j]] > r2) {
+      order[j + 1] = order[j];
+      --j;
+    }
+    order[j + 1] = index;
+  }
+}
+
+/**
+ * @brief Test a batch of waiting neighbours against all vertices of the cell.
+ *
+ * A neighbour can only cut the cell if at least one vertex lies above (or too
+ * close to call) its midplane. The neighbours are in the inner loop, so that
+ * the tests of a batch are done simultaneously using SIMD instructions.
+ * Since cuts only ever make the cell smaller, a neighbour that does not cut
+ * the cell now will never cut it later on.
+ *
+ * @param c 3D Voronoi cell.
+ * @param order Indices of the neighbours of the batch in the waiting list.
+ * @param n Number of neighbours in the batch (at most VORONOI3D_CAND_BATCH).
+ * @param cut Array to store the result in: 1 if the corresponding neighbour
+ * might cut the cell, 0 if it certainly does not.
+ */
+__attribute__((always_inline)) INLINE void voronoi_test_candidates(
+    const struct voronoi_cell *c, const int *order, int n, int *cut) {
+
+  /* midplane vectors and their squared norms (see voronoi_intersect()) */
+  float dx[3][VORONOI3D_CAND_BATCH], r2[VORONOI3D_CAND_BATCH];
+  /* maximal test result over all vertices */
+  float test[VORONOI3D_CAND_BATCH];
+
+  for (int k = 0; k < VORONOI3D_CAND_BATCH; ++k) {
+    if (k < n) {
+      dx[0][k] = -0.5f * c->cand_dx[0][order[k]];
+      dx[1][k] = -0.5f * c->cand_dx[1][order[k]];
+      dx[2][k] = -0.5f * c->cand_dx[2][order[k]];
+    } else {
+      /* padding: a plane at distance 1 that never reaches the result */
+      dx[0][k] = 1.0f;
+      dx[1][k] = 0.0f;
+      dx[2][k] = 0.0f;
+    }
+    r2[k] = dx[0][k] * dx[0][k] + dx[1][k] * dx[1][k] + dx[2][k] * dx[2][k];
+    test[k] = -FLT_MAX;
+  }
+
+  for (int i = 0; i < c->nvert; ++i) {
+    const float vx = c->vertices[3 * i];
+    const float vy = c->vertices[3 * i + 1];
+    const float vz = c->vertices[3 * i + 2];
+    for (int k = 0; k < VORONOI3D_CAND_BATCH; ++k) {
+      const float t = vx * dx[0][k] + vy * dx[1][k] + vz * dx[2][k] - r2[k];
+      test[k] = fmaxf(test[k], t);
+    }
+  }
+
+  for (int k = 0; k < n; ++k) {
+    cut[k] = (test[k] >= -VORONOI3D_TOLERANCE);
+  }
+}
+
+/**
+ * @brief Cut all waiting neighbours from the cell.
+ *
+ * The face neighbours of the previous construction are cut first: they are
+ * very likely to be neighbours again and quickly bring the cell close to its
+ * final shape. The other neighbours are cut in order of increasing distance,
+ * which means we can stop as soon as a midplane lies outside the sphere that
+ * contains all vertices of the cell (the security radius). Neighbours are
+ * tested against the vertices in batches before we attempt the (expensive)
+ * intersection.
+ *
+ * @param c 3D Voronoi cell.
+ */
+__attribute__((always_inline)) INLINE void voronoi_cut_candidates(
+    struct voronoi_cell *c) {
+
+  const int ncand = c->ncand;
+  if (ncand == 0) return;
+
+  /* Put the previous face neighbours in front of the others */
+  int order[VORONOI3D_MAXNUMCAND];
+  int is_prev[VORONOI3D_MAXNUMCAND];
+  for (int i = 0; i < ncand; ++i) {
+    is_prev[i] = 0;
+    for (int j = 0; j < c->nprev; ++j) {
+      is_prev[i] |= (c->cand_ids[i] == c->prev_ngbs[j]);
+    }
+  }
+  int nwarm = 0;
+  for (int i = 0; i < ncand; ++i) {
+    if (is_prev[i]) order[nwarm++] = i;
+  }
+  int nrest = nwarm;
+  for (int i = 0; i < ncand; ++i) {
+    if (!is_prev[i]) order[nrest++] = i;
+  }
+  voronoi_sort_candidates(c, order, nwarm);
+  voronoi_sort_candidates(c, &order[nwarm], ncand - nwarm);
+
+  float max_radius = sqrtf(voronoi_get_max_radius2(c));
+  int cut[VORONOI3D_CAND_BATCH];
+  int done = 0;
+  for (int start = 0; start < ncand && !done; start += VORONOI3D_CAND_BATCH) {
+
+    int n = min(VORONOI3D_CAND_BATCH, ncand - start);
+
+    /* Stop at the first sorted neighbour whose midplane lies outside the
+       security radius: none of the remaining ones can cut the cell */
+    for (int k = 0; k < n; ++k) {
+      if (start + k < nwarm) continue;
+      const float d = 0.5f * sqrtf(c->cand_r2[order[start + k]]);
+      if (d * (d - max_radius) > VORONOI3D_TOLERANCE) {
+        n = k;
+        done = 1;
+        break;
+      }
+    }
+
+    voronoi_test_candidates(c, &order[start], n, cut);
+
+    int changed = 0;
+    for (int k = 0; k < n; ++k) {
+      if (cut[k]) {
+        const int index = order[start + k];
+        const float odx[3] = {c->cand_dx[0][index], c->cand_dx[1][index],
+                              c->cand_dx[2][index]};
+        voronoi_intersect(c, odx, c->cand_ids[index]);
+        changed = 1;
+      }
+    }
+    if (changed) max_radius = sqrtf(voronoi_get_max_radius2(c));
+  }
+
+  c->ncand = 0;
+}
+
+/**
+ * @brief Reset a 3D Voronoi cell that has never been constructed.
+ *
+ * Empties the list of neighbours waiting to be cut and forgets the faces of
+ * the previous construction, so that the first construction does not use a
+ * warm start. Must be called once before the first voronoi_cell_init().
+ *
+ * @param cell 3D Voronoi cell to reset.
+ */
+__attribute__((always_inline)) INLINE void voronoi_cell_reset(
+    struct voronoi_cell *cell) {
+
+  cell->nface = 0;
+  cell->ncand = 0;
+  cell->nprev = 0;
+}
+
 /**
  * @brief Initialize a 3D Voronoi cell.
  *
@@ -2110,6 +2306,14 @@ __attribute__((always_inline)) INLINE void voronoi_cell_init(
     struct voronoi_cell *cell, const double *x, const double *anchor,
     const double *side) {
 
+  /* Remember the faces of the previous construction (if any) to warm start
+     this one. Note that this relies on voronoi_cell_reset() having been
+     called before the first construction. */
+  cell->nprev = min(cell->nface, VORONOI3D_MAXNUMPREV);
+  for (int i = 0; i < cell->nprev; ++i) {
+    cell->prev_ngbs[i] = cell->ngbs[i];
+  }
+
   cell->x[0] = x[0];
   cell->x[1] = x[1];
   cell->x[2] = x[2];
@@ -2121,12 +2325,17 @@ __attribute__((always_inline)) INLINE void voronoi_cell_init(
   cell->centroid[1] = 0.0f;
   cell->centroid[2] = 0.0f;
   cell->nface = 0;
+  cell->ncand = 0;
 }
 
 /**
  * @brief Interact a 3D Voronoi cell with a particle with given relative
  * position and ID.
  *
+ * The neighbour is only added to the list of neighbours waiting to be cut
+ * from the cell. The list is processed when it is full and when the cell is
+ * finalized, see voronoi_cut_candidates().
+ *
  * @param cell 3D Voronoi cell.
  * @param dx Relative position of the interacting generator w.r.t. the cell
  * generator (in fact: dx = generator - neighbour).
@@ -2135,7 +2344,16 @@ __attribute__((always_inline)) INLINE void voronoi_cell_init(
 __attribute__((always_inline)) INLINE void voronoi_cell_interact(
     struct voronoi_cell *cell, const float *dx, unsigned long long id) {
 
-  voronoi_intersect(cell, dx, id);
+  /* Make room if the waiting list is full */
+  if (cell->ncand == VORONOI3D_MAXNUMCAND) voronoi_cut_candidates(cell);
+
+  const int i = cell->ncand;
+  cell->cand_dx[0][i] = dx[0];
+  cell->cand_dx[1][i] = dx[1];
+  cell->cand_dx[2][i] = dx[2];
+  cell->cand_r2[i] = dx[0] * dx[0] + dx[1] * dx[1] + dx[2] * dx[2];
+  cell->cand_ids[i] = id;
+  ++cell->ncand;
 }
 
 /**
@@ -2147,24 +2365,16 @@ __attribute__((always_inline)) INLINE void voronoi_cell_interact(
 __attribute__((always_inline)) INLINE float voronoi_cell_finalize(
     struct voronoi_cell *cell) {
 
-  int i;
-  float max_radius, v[3], v2;
+  /* Cut the neighbours that are still waiting. */
+  voronoi_cut_candidates(cell);
 
   /* Calculate the volume and centroid of the cell. */
   voronoi_calculate_cell(cell);
   /* Calculate the faces. */
   voronoi_calculate_faces(cell);
 
-  /* Loop over the vertices and calculate the maximum radius. */
-  max_radius = 0.0f;
-  for (i = 0; i < cell->nvert; ++i) {
-    v[0] = cell->vertices[3 * i];
-    v[1] = cell->vertices[3 * i + 1];
-    v[2] = cell->vertices[3 * i + 2];
-    v2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
-    max_radius = fmaxf(max_radius, v2);
-  }
-  max_radius = sqrtf(max_radius);
+  /* Calculate the maximum radius. */
+  const float max_radius = sqrtf(voronoi_get_max_radius2(cell));
 
   return 2.0f * max_radius;
 }
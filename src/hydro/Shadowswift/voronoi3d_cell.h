@@ -28,6 +28,12 @@
 #define VORONOI3D_MAXNUMEDGE 1500
 /* Maximal number of faces that can be stored in a voronoi_cell struct */
 #define VORONOI3D_MAXFACE 100
+/* Maximal number of neighbours that can wait to be cut from a voronoi_cell
+   struct */
+#define VORONOI3D_MAXNUMCAND 128
+/* Maximal number of face neighbours of the previous construction that are
+   remembered in a voronoi_cell struct */
+#define VORONOI3D_MAXNUMPREV 32
 
 /* 3D Voronoi cell */
 struct voronoi_cell {
@@ -77,6 +83,27 @@ struct voronoi_cell {
 
   /* Midpoints of the cell faces. */
   float face_midpoints[VORONOI3D_MAXFACE][3];
+
+  /* Number of neighbours that still need to be cut from the cell. */
+  int ncand;
+
+  /* Relative positions (generator - neighbour) of the neighbours that still
+     need to be cut. Every coordinate has its own array so that the neighbours
+     can be tested against the cell vertices in batches. */
+  float cand_dx[3][VORONOI3D_MAXNUMCAND];
+
+  /* Squared norms of the relative positions above. */
+  float cand_r2[VORONOI3D_MAXNUMCAND];
+
+  /* IDs of the neighbours that still need to be cut. */
+  unsigned long long cand_ids[VORONOI3D_MAXNUMCAND];
+
+  /* Number of face neighbours remembered from the previous construction. */
+  int nprev;
+
+  /* Face neighbours of the previous construction of the cell. These are cut
+     first during the next construction. */
+  unsigned long long prev_ngbs[VORONOI3D_MAXNUMPREV];
 };
 
 /**
@@ -121,21 +148,25 @@ __attribute__((always_inline)) INLINE void voronoi3d_cell_copy(
     destination->offsets[i] = source->offsets[i];
   }
 
-  /* Copy the edge information. No idea how many edges we have, so we copy
-     everything. */
-  for (int i = 0; i < VORONOI3D_MAXNUMEDGE; ++i) {
+  /* Number of edges in use: the edges of every vertex are stored
+     contiguously, in the order of the vertices. */
+  const int nvert = source->nvert;
+  const int nedge =
+      nvert ? source->offsets[nvert - 1] + source->orders[nvert - 1] : 0;
+
+  /* Copy the edge information. */
+  for (int i = 0; i < nedge; ++i) {
     destination->edges[i] = source->edges[i];
   }
 
   /* Copy all additional edge information. */
-  for (int i = 0; i < VORONOI3D_MAXNUMEDGE; ++i) {
+  for (int i = 0; i < nedge; ++i) {
     destination->edgeindices[i] = source->edgeindices[i];
   }
 
   /* Copy neighbour information. Since neighbours are stored per edge, the total
-     number of neighbours in this list is larger than numngb and we copy
-     everything. */
-  for (int i = 0; i < VORONOI3D_MAXNUMEDGE; ++i) {
+     number of neighbours in this list is larger than numngb. */
+  for (int i = 0; i < nedge; ++i) {
     destination->ngbs[i] = source->ngbs[i];
   }
 }
@@ -0,0 +1,231 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2020 The SWIFT collaboration
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file io_compression.c
+ *  @brief Lossy compression of the floating-point fields written to the
+ *  snapshots.
+ *
+ *  The lossy levels reduce the number of mantissa bits of each value by
+ *  rounding to nearest. The discarded low bits are then all zeros, which the
+ *  shuffle and deflate filters compress very efficiently. Contrary to the HDF5
+ *  scale-offset and n-bit filters, this does not change the type of the
+ *  dataset, can be read back by any HDF5 library and works with the parallel
+ *  writes. The number of mantissa bits kept by each level is set in the
+ *  Snapshots section of the parameter file and stored in the
+ *  #output_options.
+ */
+
+/* Config parameters. */
+#include "../config.h"
+
+/* Standard headers. */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* This object's header. */
+#include "io_compression.h"
+
+/* Local headers. */
+#include "common_io.h"
+#include "error.h"
+#include "io_properties.h"
+#include "output_options.h"
+
+/**
+ * @brief Does a given compression level degrade the data of a field?
+ *
+ * Only the floating-point fields are affected by the lossy levels. Integer
+ * fields (e.g. IDs) are always written losslessly.
+ *
+ * @param output_options The #output_options holding the mantissa bits.
+ * @param props The #io_props of the field.
+ * @param level The #compression_levels requested for that field.
+ */
+int io_compression_is_lossy(const struct output_options* output_options,
+                            const struct io_props* props,
+                            const enum compression_levels level) {
+
+  if (props->type != FLOAT && props->type != DOUBLE) return 0;
+  return output_options->mantissa_bits[level] >= 0;
+}
+
+/**
+ * @brief Return the deflate level to use for a field.
+ *
+ * The lossy fields are always shuffled and deflated as that is what turns
+ * the rounded mantissas into smaller files.
+ *
+ * @param output_options The #output_options holding the mantissa bits.
+ * @param props The #io_props of the field.
+ * @param level The #compression_levels requested for that field.
+ * @param snapshot_compression The deflate level requested for all fields.
+ *
+ * @return The deflate level, 0 for no compression.
+ */
+int io_compression_deflate_level(const struct output_options* output_options,
+                                 const struct io_props* props,
+                                 const enum compression_levels level,
+                                 const int snapshot_compression) {
+
+  if (snapshot_compression > 0) return snapshot_compression;
+  if (io_compression_is_lossy(output_options, props, level))
+    return io_compression_lossy_deflate_level;
+  return 0;
+}
+
+/**
+ * @brief Return the maximal relative error made on a (normal) floating-point
+ * value for a given compression level.
+ *
+ * Values in the sub-normal range only get an absolute error bound of the
+ * same magnitude relative to the smallest normal number.
+ *
+ * @param output_options The #output_options holding the mantissa bits.
+ * @param level The #compression_levels.
+ */
+double io_compression_max_relative_error(
+    const struct output_options* output_options,
+    const enum compression_levels level) {
+
+  const int bits = output_options->mantissa_bits[level];
+  if (bits < 0) return 0.;
+
+  /* Round to nearest: half a unit in the last place kept. */
+  return 1. / (double)(2ull << bits);
+}
+
+/**
+ * @brief Round the mantissa of an array of floats.
+ *
+ * @param data The array.
+ * @param count The number of elements.
+ * @param bits The number of explicit mantissa bits to keep.
+ */
+static void io_compression_round_float(float* data, const size_t count,
+                                       const int bits) {
+
+  const int drop = 23 - bits;
+  const uint32_t exp_mask = 0x7f800000u;
+  const uint32_t half = 1u << (drop - 1);
+  const uint32_t mask = ~((1u << drop) - 1u);
+
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t u;
+    memcpy(&u, &data[i], sizeof(uint32_t));
+
+    /* Leave Inf and NaN untouched */
+    if ((u & exp_mask) == exp_mask) continue;
+
+    /* Round to nearest. Fall back to truncation if that overflows. */
+    uint32_t r = (u + half) & mask;
+    if ((r & exp_mask) == exp_mask) r = u & mask;
+
+    memcpy(&data[i], &r, sizeof(uint32_t));
+  }
+}
+
+/**
+ * @brief Round the mantissa of an array of doubles.
+ *
+ * @param data The array.
+ * @param count The number of elements.
+ * @param bits The number of explicit mantissa bits to keep.
+ */
+static void io_compression_round_double(double* data, const size_t count,
+                                        const int bits) {
+
+  const int drop = 52 - bits;
+  const uint64_t exp_mask = 0x7ff0000000000000ull;
+  const uint64_t half = 1ull << (drop - 1);
+  const uint64_t mask = ~((1ull << drop) - 1ull);
+
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t u;
+    memcpy(&u, &data[i], sizeof(uint64_t));
+
+    /* Leave Inf and NaN untouched */
+    if ((u & exp_mask) == exp_mask) continue;
+
+    /* Round to nearest. Fall back to truncation if that overflows. */
+    uint64_t r = (u + half) & mask;
+    if ((r & exp_mask) == exp_mask) r = u & mask;
+
+    memcpy(&data[i], &r, sizeof(uint64_t));
+  }
+}
+
+/**
+ * @brief Apply the lossy compression of a field to the buffer about to be
+ * written to the snapshot.
+ *
+ * Does nothing for lossless levels and non floating-point fields.
+ *
+ * @param output_options The #output_options holding the mantissa bits.
+ * @param temp The buffer filled by io_copy_temp_buffer().
+ * @param props The #io_props of the field.
+ * @param N The number of particles in the buffer.
+ * @param level The #compression_levels requested for that field.
+ */
+void io_compression_apply(const struct output_options* output_options,
+                          void* temp, const struct io_props* props, size_t N,
+                          const enum compression_levels level) {
+
+  if (!io_compression_is_lossy(output_options, props, level)) return;
+
+  const size_t count = N * props->dimension;
+  const int bits = output_options->mantissa_bits[level];
+
+  if (props->type == FLOAT)
+    io_compression_round_float((float*)temp, count, bits);
+  else
+    io_compression_round_double((double*)temp, count, bits);
+}
+
+#if defined(HAVE_HDF5)
+
+/**
+ * @brief Document the lossy compression applied to a dataset in its
+ * attributes.
+ *
+ * Does nothing for lossless levels and non floating-point fields.
+ *
+ * @param output_options The #output_options holding the mantissa bits.
+ * @param h_data The HDF5 dataset.
+ * @param props The #io_props of the field.
+ * @param level The #compression_levels used for that field.
+ */
+void io_compression_write_attributes(
+    const struct output_options* output_options, hid_t h_data,
+    const struct io_props* props, const enum compression_levels level) {
+
+  if (!io_compression_is_lossy(output_options, props, level)) return;
+
+  char buffer[FIELD_BUFFER_SIZE];
+  sprintf(buffer, "Mantissa rounded to %d bits",
+          output_options->mantissa_bits[level]);
+
+  io_write_attribute_s(h_data, "Lossy compression filter", buffer);
+  io_write_attribute_d(
+      h_data, "Lossy compression maximal relative error",
+      io_compression_max_relative_error(output_options, level));
+}
+
+#endif /* HAVE_HDF5 */
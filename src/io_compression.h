@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2020 The SWIFT collaboration
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_IO_COMPRESSION_H
+#define SWIFT_IO_COMPRESSION_H
+
+/* Config parameters. */
+#include "../config.h"
+
+/* Standard headers. */
+#include <stddef.h>
+
+#if defined(HAVE_HDF5)
+#include <hdf5.h>
+#endif
+
+/* Avoid cyclic inclusion problems */
+struct io_props;
+struct output_options;
+
+/**
+ * @brief Compression levels for snapshot fields
+ */
+enum compression_levels {
+  compression_do_not_write = 0,
+  compression_write_lossless,
+  compression_write_low_lossy,
+  compression_write_med_lossy,
+  compression_write_high_lossy,
+  /* Counter, always leave last */
+  compression_level_count,
+};
+
+/*! Default value for SelectOutput */
+#define compression_level_default compression_write_lossless
+
+/*! Deflate level used for lossy fields when snapshots are not compressed */
+#define io_compression_lossy_deflate_level 4
+
+/*! Default number of explicit mantissa bits kept by the lossy levels */
+#define io_compression_low_mantissa_bits_default 16
+#define io_compression_med_mantissa_bits_default 10
+#define io_compression_high_mantissa_bits_default 6
+
+/*! Largest number of explicit mantissa bits a lossy level can keep (floats
+ * have 23, at least one must be dropped) */
+#define io_compression_max_mantissa_bits 22
+
+/* Function prototypes. */
+int io_compression_is_lossy(const struct output_options* output_options,
+                            const struct io_props* props,
+                            const enum compression_levels level);
+int io_compression_deflate_level(const struct output_options* output_options,
+                                 const struct io_props* props,
+                                 const enum compression_levels level,
+                                 const int snapshot_compression);
+double io_compression_max_relative_error(
+    const struct output_options* output_options,
+    const enum compression_levels level);
+void io_compression_apply(const struct output_options* output_options,
+                          void* temp, const struct io_props* props, size_t N,
+                          const enum compression_levels level);
+
+#if defined(HAVE_HDF5)
+void io_compression_write_attributes(
+    const struct output_options* output_options, hid_t h_data,
+    const struct io_props* props, const enum compression_levels level);
+#endif
+
+#endif /* SWIFT_IO_COMPRESSION_H */
@@ -26,8 +26,11 @@
 #include <mpi.h>
 #endif
 
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "atomic.h"
 #include "chemistry_io.h"
@@ -155,6 +158,10 @@ void los_init(const double dim[3], struct los_props *los_params,
   parser_get_opt_param_double_array(
       params, "LineOfSight:range_when_shooting_down_z", 2,
       los_params->range_when_shooting_down_axis[2]);
+
+  /* Do we write one file per MPI rank? */
+  los_params->distributed =
+      parser_get_opt_param_int(params, "LineOfSight:distributed", 0);
 }
 
 /**
@@ -263,7 +270,7 @@ void generate_sightlines(struct line_of_sight *Los,
 void print_los_info(const struct line_of_sight *Los, const int i) {
 
   message(
-      "[LOS %i] Xpos:%g Ypos:%g parts_in_los:%i "
+      "[LOS %i] Xpos:%g Ypos:%g parts_in_los:%zu "
       "num_intersecting_top_level_cells:%i",
       i, Los[i].Xpos, Los[i].Ypos, Los[i].particles_in_los_total,
       Los[i].num_intersecting_top_level_cells);
@@ -277,9 +284,11 @@ void print_los_info(const struct line_of_sight *Los, const int i) {
  * @param j Line of sight ID.
  * @param e The engine.
  * @param grp HDF5 group to write to.
+ * @param temp The converted data of this attribute for the N parts.
  */
 void write_los_hdf5_dataset(const struct io_props props, const size_t N,
-                            const int j, const struct engine *e, hid_t grp) {
+                            const int j, const struct engine *e, hid_t grp,
+                            const void *temp) {
 
   /* Create data space */
   const hid_t h_space = H5Screate(H5S_SIMPLE);
@@ -317,40 +326,34 @@ void write_los_hdf5_dataset(const struct io_props props, const size_t N,
   /* Dataset properties */
   const hid_t h_prop = H5Pcreate(H5P_DATASET_CREATE);
 
-  /* Set chunk size */
-  h_err = H5Pset_chunk(h_prop, rank, chunk_shape);
-  if (h_err < 0)
-    error("Error while setting chunk size (%llu, %llu) for field '%s'.",
-          chunk_shape[0], chunk_shape[1], props.name);
-
-  /* Impose check-sum to verify data corruption */
-  h_err = H5Pset_fletcher32(h_prop);
-  if (h_err < 0)
-    error("Error while setting checksum options for field '%s'.", props.name);
+  /* Empty datasets (only in distributed files) cannot be chunked */
+  if (N > 0) {
 
-  /* Impose data compression */
-  if (e->snapshot_compression > 0) {
-    h_err = H5Pset_shuffle(h_prop);
+    /* Set chunk size */
+    h_err = H5Pset_chunk(h_prop, rank, chunk_shape);
     if (h_err < 0)
-      error("Error while setting shuffling options for field '%s'.",
-            props.name);
+      error("Error while setting chunk size (%llu, %llu) for field '%s'.",
+            chunk_shape[0], chunk_shape[1], props.name);
 
-    h_err = H5Pset_deflate(h_prop, e->snapshot_compression);
+    /* Impose check-sum to verify data corruption */
+    h_err = H5Pset_fletcher32(h_prop);
     if (h_err < 0)
-      error("Error while setting compression options for field '%s'.",
+      error("Error while setting checksum options for field '%s'.",
             props.name);
-  }
-
-  /* Allocate temporary buffer */
-  const size_t num_elements = N * props.dimension;
-  const size_t typeSize = io_sizeof_type(props.type);
-  void *temp = NULL;
-  if (swift_memalign("writebuff", (void **)&temp, IO_BUFFER_ALIGNMENT,
-                     num_elements * typeSize) != 0)
-    error("Unable to allocate temporary i/o buffer");
 
-  /* Copy particle data to temp buffer */
-  io_copy_temp_buffer(temp, e, props, N, e->internal_units, e->snapshot_units);
+    /* Impose data compression */
+    if (e->snapshot_compression > 0) {
+      h_err = H5Pset_shuffle(h_prop);
+      if (h_err < 0)
+        error("Error while setting shuffling options for field '%s'.",
+              props.name);
+
+      h_err = H5Pset_deflate(h_prop, e->snapshot_compression);
+      if (h_err < 0)
+        error("Error while setting compression options for field '%s'.",
+              props.name);
+    }
+  }
 
   /* Create dataset */
   char att_name[200];
@@ -360,9 +363,11 @@ void write_los_hdf5_dataset(const struct io_props props, const size_t N,
   if (h_data < 0) error("Error while creating dataspace '%s'.", props.name);
 
   /* Write dataset */
-  herr_t status = H5Dwrite(h_data, io_hdf5_type(props.type), H5S_ALL, H5S_ALL,
-                           H5P_DEFAULT, temp);
-  if (status < 0) error("Error while writing data array '%s'.", props.name);
+  if (N > 0) {
+    herr_t status = H5Dwrite(h_data, io_hdf5_type(props.type), H5S_ALL,
+                             H5S_ALL, H5P_DEFAULT, temp);
+    if (status < 0) error("Error while writing data array '%s'.", props.name);
+  }
 
   /* Write unit conversion factors for this data set */
   char buffer[FIELD_BUFFER_SIZE] = {0};
@@ -399,29 +404,29 @@ void write_los_hdf5_dataset(const struct io_props props, const size_t N,
   /* Write the full description */
   io_write_attribute_s(h_data, "Description", props.description);
 
-  /* Free and close everything */
-  swift_free("writebuff", temp);
+  /* Close everything */
   H5Pclose(h_prop);
   H5Dclose(h_data);
   H5Sclose(h_space);
 }
 
 /**
- * @brief Write parts in LOS to HDF5 file.
+ * @brief Collect the gas output fields selected for the line of sights.
+ *
+ * The #io_props point to the particle arrays of the #space, the parts in
+ * each line of sight are then gathered from there field by field.
  *
- * @param grp HDF5 group of this LOS.
- * @param j LOS ID.
- * @param N number of parts in this line of sight.
- * @param parts the list of parts in this LOS.
  * @param e The engine.
- * @param xparts the list of xparts in this LOS.
+ * @param list (return) The selected fields.
+ *
+ * @return The number of selected fields.
  */
-void write_los_hdf5_datasets(hid_t grp, const int j, const size_t N,
-                             const struct part *parts, const struct engine *e,
-                             const struct xpart *xparts) {
+int los_select_output_fields(const struct engine *e, struct io_props *list) {
 
   /* What kind of run are we working with? */
   struct swift_params *params = e->parameter_file;
+  const struct part *parts = e->s->parts;
+  const struct xpart *xparts = e->s->xparts;
   const int with_cosmology = e->policy & engine_policy_cosmology;
   const int with_cooling = e->policy & engine_policy_cooling;
   const int with_temperature = e->policy & engine_policy_temperature;
@@ -434,7 +439,6 @@ void write_los_hdf5_datasets(hid_t grp, const int j, const size_t N,
 #endif
 
   int num_fields = 0;
-  struct io_props list[100];
 
   /* Find all the gas output fields */
   hydro_write_particles(parts, xparts, list, &num_fields);
@@ -454,17 +458,17 @@ void write_los_hdf5_datasets(hid_t grp, const int j, const size_t N,
   num_fields +=
       star_formation_write_particles(parts, xparts, list + num_fields);
 
-  /* Loop over each output field */
+  /* Only keep the ones the user did not cancel */
+  int num_selected = 0;
   for (int i = 0; i < num_fields; i++) {
 
-    /* Did the user cancel this field? */
     char field[PARSER_MAX_LINE_SIZE];
     sprintf(field, "SelectOutputLOS:%.*s", FIELD_BUFFER_SIZE, list[i].name);
-    int should_write = parser_get_opt_param_int(params, field, 1);
-
-    /* Write (if selected) */
-    if (should_write) write_los_hdf5_dataset(list[i], N, j, e, grp);
+    if (parser_get_opt_param_int(params, field, 1))
+      list[num_selected++] = list[i];
   }
+
+  return num_selected;
 }
 
 /**
@@ -474,10 +478,13 @@ void write_los_hdf5_datasets(hid_t grp, const int j, const size_t N,
  * @param e The engine.
  * @param LOS_params The line of sight params.
  * @param total_num_parts_in_los The total number of particles in all the LoS.
+ * @param num_parts_in_file The number of particles written to this file.
+ * @param num_files The number of files the LoS are written to.
  */
 void write_hdf5_header(hid_t h_file, const struct engine *e,
                        const struct los_props *LOS_params,
-                       const size_t total_num_parts_in_los) {
+                       const size_t total_num_parts_in_los,
+                       const size_t num_parts_in_file, const int num_files) {
 
   /* Open header to write simulation properties */
   hid_t h_grp =
@@ -513,20 +520,22 @@ void write_hdf5_header(hid_t h_file, const struct engine *e,
   /* Number of particles of each type */
   long long N_total[swift_type_count] = {0};
   N_total[0] = total_num_parts_in_los;
+  long long N_file[swift_type_count] = {0};
+  N_file[0] = num_parts_in_file;
   unsigned int numParticles[swift_type_count] = {0};
   unsigned int numParticlesHighWord[swift_type_count] = {0};
   for (int ptype = 0; ptype < swift_type_count; ++ptype) {
     numParticles[ptype] = (unsigned int)N_total[ptype];
     numParticlesHighWord[ptype] = (unsigned int)(N_total[ptype] >> 32);
   }
-  io_write_attribute(h_grp, "NumPart_ThisFile", LONGLONG, N_total,
+  io_write_attribute(h_grp, "NumPart_ThisFile", LONGLONG, N_file,
                      swift_type_count);
   io_write_attribute(h_grp, "NumPart_Total", UINT, numParticles,
                      swift_type_count);
   io_write_attribute(h_grp, "NumPart_Total_HighWord", UINT,
                      numParticlesHighWord, swift_type_count);
-  io_write_attribute_i(h_grp, "NumFilesPerSnapshot", 1);
-  io_write_attribute_i(h_grp, "ThisFile", 0);
+  io_write_attribute_i(h_grp, "NumFilesPerSnapshot", num_files);
+  io_write_attribute_i(h_grp, "ThisFile", num_files > 1 ? e->nodeID : 0);
   io_write_attribute_s(h_grp, "OutputType", "LineOfSight");
 
   /* Close group */
@@ -555,9 +564,57 @@ void write_hdf5_header(hid_t h_file, const struct engine *e,
   H5Gclose(h_grp);
 }
 
+/**
+ * @brief Does a given part contribute to a line of sight?
+ *
+ * @param p The #part (not inhibited).
+ * @param los The line_of_sight structure.
+ */
+static INLINE int los_contains_part(const struct part *p,
+                                    const struct line_of_sight *los) {
+
+  /* Don't consider part if outwith allowed z-range. */
+  if (p->x[los->zaxis] < los->range_when_shooting_down_axis[0] ||
+      p->x[los->zaxis] > los->range_when_shooting_down_axis[1])
+    return 0;
+
+  /* Distance from this part to LOS along x dim. */
+  double dx = p->x[los->xaxis] - los->Xpos;
+
+  /* Periodic wrap. */
+  if (los->periodic) dx = nearest(dx, los->dim[los->xaxis]);
+
+  /* Square. */
+  const double dx2 = dx * dx;
+
+  /* Smoothing length of this part. */
+  const double hsml = p->h * kernel_gamma;
+  const double hsml2 = hsml * hsml;
+
+  /* Does this particle fall into our LOS? */
+  if (dx2 >= hsml2) return 0;
+
+  /* Distance from this part to LOS along y dim. */
+  double dy = p->x[los->yaxis] - los->Ypos;
+
+  /* Periodic wrap. */
+  if (los->periodic) dy = nearest(dy, los->dim[los->yaxis]);
+
+  /* Square. */
+  const double dy2 = dy * dy;
+
+  /* Does this part still fall into our LOS? */
+  if (dy2 >= hsml2) return 0;
+
+  /* 2D distance to LOS. */
+  return (dx2 + dy2 <= hsml2);
+}
+
 /**
  * @brief Loop over each part to see which ones intersect the LOS.
  *
+ * Brute-force version only used to check the binned search.
+ *
  * @param map_data The parts.
  * @param count The number of parts.
  * @param extra_data The line_of_sight structure for this LOS.
@@ -576,112 +633,413 @@ void los_first_loop_mapper(void *restrict map_data, int count,
     /* Don't consider inhibited parts. */
     if (parts[i].time_bin == time_bin_inhibited) continue;
 
-    /* Don't consider part if outwith allowed z-range. */
-    if (parts[i].x[LOS_list->zaxis] <
-            LOS_list->range_when_shooting_down_axis[0] ||
-        parts[i].x[LOS_list->zaxis] >
-            LOS_list->range_when_shooting_down_axis[1])
-      continue;
-
-    /* Distance from this part to LOS along x dim. */
-    double dx = parts[i].x[LOS_list->xaxis] - LOS_list->Xpos;
-
-    /* Periodic wrap. */
-    if (LOS_list->periodic) dx = nearest(dx, LOS_list->dim[LOS_list->xaxis]);
-
-    /* Square. */
-    const double dx2 = dx * dx;
+    if (los_contains_part(&parts[i], LOS_list)) los_particle_count++;
+  }
 
-    /* Smoothing length of this part. */
-    const double hsml = parts[i].h * kernel_gamma;
-    const double hsml2 = hsml * hsml;
+  atomic_add(&LOS_list->particles_in_los_local, los_particle_count);
+}
 
-    /* Does this particle fall into our LOS? */
-    if (dx2 < hsml2) {
+/**
+ * @brief Bin the sightlines shooting down one simulation axis on a regular
+ * grid covering the plane orthogonal to it.
+ *
+ * @param grid The #los_grid to construct.
+ * @param LOS_list The list of all the sightlines.
+ * @param first Index of the first sightline shooting down this axis.
+ * @param count Number of sightlines shooting down this axis.
+ */
+void los_grid_init(struct los_grid *grid, const struct line_of_sight *LOS_list,
+                   const int first, const int count) {
+
+  grid->first = first;
+  grid->count = count;
+  grid->bin_offsets = NULL;
+  grid->los_index = NULL;
+  if (count == 0) return;
+
+  const struct line_of_sight *los = &LOS_list[first];
+  grid->xaxis = los->xaxis;
+  grid->yaxis = los->yaxis;
+  grid->periodic = los->periodic;
+
+  /* Aim for about one sightline per bin */
+  int n = (int)sqrt((double)count);
+  n = max(n, 1);
+  n = min(n, los_grid_max_bins);
+  grid->n = n;
+  grid->width[0] = los->dim[los->xaxis] / n;
+  grid->width[1] = los->dim[los->yaxis] / n;
+
+  if ((grid->bin_offsets = (int *)swift_malloc(
+           "los_grid", (n * n + 1) * sizeof(int))) == NULL ||
+      (grid->los_index =
+           (int *)swift_malloc("los_grid", count * sizeof(int))) == NULL)
+    error("Failed to allocate the LOS grid.");
+  bzero(grid->bin_offsets, (n * n + 1) * sizeof(int));
+
+  /* Count the sightlines in each bin */
+  int *bins = (int *)malloc(count * sizeof(int));
+  if (bins == NULL) error("Failed to allocate the LOS bins.");
+  for (int k = 0; k < count; k++) {
+    const struct line_of_sight *l = &LOS_list[first + k];
+    double pos[2] = {l->Xpos, l->Ypos};
+    int ind[2];
+    for (int d = 0; d < 2; d++) {
+      if (grid->periodic)
+        pos[d] = box_wrap(pos[d], 0., grid->width[d] * n);
+      ind[d] = (int)floor(pos[d] / grid->width[d]);
+      ind[d] = max(ind[d], 0);
+      ind[d] = min(ind[d], n - 1);
+    }
+    bins[k] = ind[0] * n + ind[1];
+    grid->bin_offsets[bins[k] + 1]++;
+  }
 
-      /* Distance from this part to LOS along y dim. */
-      double dy = parts[i].x[LOS_list->yaxis] - LOS_list->Ypos;
+  /* Turn the counts into offsets and fill the bins */
+  for (int b = 0; b < n * n; b++)
+    grid->bin_offsets[b + 1] += grid->bin_offsets[b];
+  int *cursor = (int *)malloc(n * n * sizeof(int));
+  if (cursor == NULL) error("Failed to allocate the LOS bins.");
+  memcpy(cursor, grid->bin_offsets, n * n * sizeof(int));
+  for (int k = 0; k < count; k++)
+    grid->los_index[cursor[bins[k]]++] = first + k;
+
+  free(cursor);
+  free(bins);
+}
 
-      /* Periodic wrap. */
-      if (LOS_list->periodic) dy = nearest(dy, LOS_list->dim[LOS_list->yaxis]);
+/**
+ * @brief Free the memory used by a #los_grid.
+ */
+void los_grid_clean(struct los_grid *grid) {
+  if (grid->bin_offsets != NULL) swift_free("los_grid", grid->bin_offsets);
+  if (grid->los_index != NULL) swift_free("los_grid", grid->los_index);
+}
 
-      /* Square. */
-      const double dy2 = dy * dy;
+/**
+ * @brief Range of bins of a #los_grid covering an interval along one of its
+ * two dimensions.
+ *
+ * With periodic boundaries, the range can extend outside [0, n) and must be
+ * wrapped by the caller.
+ *
+ * @param grid The #los_grid.
+ * @param d The dimension (0 or 1).
+ * @param min The lower end of the interval.
+ * @param max The upper end of the interval.
+ * @param first (return) The first bin.
+ * @param last (return) The last bin, first > last if the range is empty.
+ */
+static INLINE void los_grid_range(const struct los_grid *grid, const int d,
+                                  const double min, const double max,
+                                  int *first, int *last) {
+
+  const int n = grid->n;
+  int i0 = (int)floor(min / grid->width[d]);
+  int i1 = (int)floor(max / grid->width[d]);
+
+  if (grid->periodic) {
+    if (i1 - i0 + 1 >= n) {
+      i0 = 0;
+      i1 = n - 1;
+    }
+  } else {
+    if (i0 < 0) i0 = 0;
+    if (i1 > n - 1) i1 = n - 1;
+  }
 
-      /* Does this part still fall into our LOS? */
-      if (dy2 < hsml2) {
+  *first = i0;
+  *last = i1;
+}
 
-        /* 2D distance to LOS. */
-        if (dx2 + dy2 <= hsml2) {
+/**
+ * @brief Is there any sightline in a rectangle of a #los_grid?
+ *
+ * @param grid The #los_grid.
+ * @param min The lower corner of the rectangle.
+ * @param max The upper corner of the rectangle.
+ */
+static INLINE int los_grid_any(const struct los_grid *grid,
+                               const double min[2], const double max[2]) {
+
+  const int n = grid->n;
+  int i0, i1, j0, j1;
+  los_grid_range(grid, 0, min[0], max[0], &i0, &i1);
+  los_grid_range(grid, 1, min[1], max[1], &j0, &j1);
+
+  for (int i = i0; i <= i1; i++) {
+    const int ii = (i % n + n) % n;
+    for (int j = j0; j <= j1; j++) {
+      const int b = ii * n + (j % n + n) % n;
+      if (grid->bin_offsets[b + 1] > grid->bin_offsets[b]) return 1;
+    }
+  }
+  return 0;
+}
 
-          /* We've found one. */
-          los_particle_count++;
+/**
+ * @brief Mapper looping once over the parts of some top-level cells and
+ * finding all the sightlines each of them contributes to.
+ *
+ * In the counting pass, this also records the number of top-level cells
+ * intersected by each sightline.
+ *
+ * @param map_data The indices of the top-level cells.
+ * @param num_elements The number of cells.
+ * @param extra_data The #los_mapper_data.
+ */
+void los_cells_mapper(void *restrict map_data, int num_elements,
+                      void *restrict extra_data) {
+
+  const struct los_mapper_data *data =
+      (const struct los_mapper_data *)extra_data;
+  struct line_of_sight *LOS_list = data->LOS_list;
+  const struct los_grid *grids = data->grids;
+  const int *cell_ind = (const int *)map_data;
+  const int fill = (data->los_parts_index != NULL);
+
+  for (int ind = 0; ind < num_elements; ind++) {
+
+    const struct cell *c = &data->cells[cell_ind[ind]];
+    if (c->hydro.count == 0) continue;
+
+    /* Which axes have sightlines that can see the parts of this cell? */
+    int active[3] = {0, 0, 0};
+    int num_active = 0;
+    for (int g = 0; g < 3; g++) {
+      const struct los_grid *grid = &grids[g];
+      if (grid->count == 0) continue;
+
+      const double hsml = c->hydro.h_max * kernel_gamma;
+      const double w[2] = {c->width[grid->xaxis], c->width[grid->yaxis]};
+      const double loc[2] = {c->loc[grid->xaxis], c->loc[grid->yaxis]};
+      const double min[2] = {loc[0] - hsml, loc[1] - hsml};
+      const double max[2] = {loc[0] + w[0] + hsml, loc[1] + w[1] + hsml};
+      active[g] = los_grid_any(grid, min, max);
+      num_active += active[g];
+
+      /* Count the cells each sightline intersects, using the same criterion
+       * as when the cells were looped over once per sightline. */
+      if (!fill) {
+        const double ext[2] = {fmax(hsml, w[0]), fmax(hsml, w[1])};
+        int i0, i1, j0, j1;
+        los_grid_range(grid, 0, loc[0] - ext[0], loc[0] + w[0] + ext[0], &i0,
+                       &i1);
+        los_grid_range(grid, 1, loc[1] - ext[1], loc[1] + w[1] + ext[1], &j0,
+                       &j1);
+        const int n = grid->n;
+        for (int i = i0; i <= i1; i++) {
+          const int ii = (i % n + n) % n;
+          for (int j = j0; j <= j1; j++) {
+            const int b = ii * n + (j % n + n) % n;
+            for (int k = grid->bin_offsets[b]; k < grid->bin_offsets[b + 1];
+                 k++) {
+              struct line_of_sight *los = &LOS_list[grid->los_index[k]];
+              if (does_los_intersect(c, los))
+                atomic_inc(&los->num_intersecting_top_level_cells);
+            }
+          }
+        }
+      }
+    }
+    if (num_active == 0) continue;
+
+    /* Loop over the parts of this cell once. */
+    const struct part *cell_parts = c->hydro.parts;
+    for (int i = 0; i < c->hydro.count; i++) {
+
+      const struct part *p = &cell_parts[i];
+
+      /* Don't consider inhibited parts. */
+      if (p->time_bin == time_bin_inhibited) continue;
+
+      const double hsml = p->h * kernel_gamma;
+
+      for (int g = 0; g < 3; g++) {
+        if (!active[g]) continue;
+        const struct los_grid *grid = &grids[g];
+        const int n = grid->n;
+
+        /* Bins of sightlines this part can smooth into. */
+        int i0, i1, j0, j1;
+        los_grid_range(grid, 0, p->x[grid->xaxis] - hsml,
+                       p->x[grid->xaxis] + hsml, &i0, &i1);
+        los_grid_range(grid, 1, p->x[grid->yaxis] - hsml,
+                       p->x[grid->yaxis] + hsml, &j0, &j1);
+
+        for (int ii = i0; ii <= i1; ii++) {
+          const int iw = (ii % n + n) % n;
+          for (int jj = j0; jj <= j1; jj++) {
+            const int b = iw * n + (jj % n + n) % n;
+            for (int k = grid->bin_offsets[b]; k < grid->bin_offsets[b + 1];
+                 k++) {
+
+              const int j = grid->los_index[k];
+              if (!los_contains_part(p, &LOS_list[j])) continue;
+
+              if (fill) {
+                const size_t slot = atomic_inc(&data->los_parts_cursor[j]);
+                data->los_parts_index[data->los_parts_offset[j] + slot] =
+                    p - data->parts;
+              } else {
+                atomic_inc(&LOS_list[j].particles_in_los_local);
+              }
+            }
+          }
         }
       }
     }
-  } /* End of loop over all parts */
+  }
+}
 
-  atomic_add(&LOS_list->particles_in_los_local, los_particle_count);
+/**
+ * @brief Compare two part indices.
+ */
+static int los_cmp_index(const void *a, const void *b) {
+  const size_t ia = *(const size_t *)a;
+  const size_t ib = *(const size_t *)b;
+  return (ia > ib) - (ia < ib);
 }
 
 /**
- * @brief Find all top level cells that a LOS will intersect.
- *
- * This includes the top level cells the LOS directly passes through
- * and the neighbouring top level cells whose parts could smooth into the LOS.
+ * @brief Mapper sorting the parts found in each sightline so that they are
+ * written in the order they appear in the #space.
  *
- * @param e The engine.
- * @param los The line_of_sight structure.
- * @param los_cells_top (return) Array indicating whether this cell is
- * intersected.
- * @param cells The array of top-level cells.
- * @param local_cells_with_particles The list of local non-empty top-level
- * cells.
- * @param nr_local_cells_with_particles The number of local non-empty top-level
- * cells.
+ * @param map_data The indices of the sightlines.
+ * @param num_elements The number of sightlines.
+ * @param extra_data The #los_mapper_data.
  */
-void find_intersecting_top_level_cells(
-    const struct engine *e, struct line_of_sight *los,
-    int *restrict los_cells_top, const struct cell *cells,
-    const int *restrict local_cells_with_particles,
-    const int nr_local_cells_with_particles) {
-
-  /* Keep track of how many top level cells we intersect. */
-  int num_intersecting_top_level_cells = 0;
-
-  /* Loop over each top level cell */
-  for (int n = 0; n < nr_local_cells_with_particles; n++) {
+void los_sort_mapper(void *restrict map_data, int num_elements,
+                     void *restrict extra_data) {
+
+  const struct los_mapper_data *data =
+      (const struct los_mapper_data *)extra_data;
+  const int *los_ind = (const int *)map_data;
+
+  for (int k = 0; k < num_elements; k++) {
+    const int j = los_ind[k];
+    qsort(data->los_parts_index + data->los_parts_offset[j],
+          data->LOS_list[j].particles_in_los_local, sizeof(size_t),
+          los_cmp_index);
+  }
+}
 
-    /* This top level cell. */
-    const struct cell *c = &cells[local_cells_with_particles[n]];
+/**
+ * @brief Mapper gathering one output field of the parts in a sightline into a
+ * contiguous buffer.
+ *
+ * @param map_data The indices of the parts in the #space.
+ * @param N The number of parts.
+ * @param extra_data The #los_gather_data.
+ */
+void los_gather_mapper(void *restrict map_data, int N,
+                       void *restrict extra_data) {
+
+  const struct los_gather_data *data =
+      (const struct los_gather_data *)extra_data;
+  const struct io_props props = data->props;
+  const struct engine *e = data->e;
+  const size_t *index = (const size_t *)map_data;
+  const size_t copySize = io_sizeof_type(props.type) * props.dimension;
+
+  /* How far are we with this chunk? */
+  const ptrdiff_t delta = index - data->index_start;
+  char *temp = data->temp + delta * copySize;
+
+  for (int k = 0; k < N; k++) {
+    const size_t i = index[k];
+    void *out = temp + k * copySize;
+
+    if (props.conversion == 0)
+      memcpy(out, props.field + i * props.partSize, copySize);
+    else if (props.convert_part_f != NULL)
+      props.convert_part_f(e, props.parts + i, props.xparts + i, (float *)out);
+    else if (props.convert_part_i != NULL)
+      props.convert_part_i(e, props.parts + i, props.xparts + i, (int *)out);
+    else if (props.convert_part_d != NULL)
+      props.convert_part_d(e, props.parts + i, props.xparts + i,
+                           (double *)out);
+    else if (props.convert_part_l != NULL)
+      props.convert_part_l(e, props.parts + i, props.xparts + i,
+                           (long long *)out);
+    else
+      error("Missing conversion function for field '%s'", props.name);
+  }
+}
 
-    if (does_los_intersect(c, los)) {
-      num_intersecting_top_level_cells++;
-      los_cells_top[n] = 1;
+/**
+ * @brief Gather one output field of the parts of a sightline found on this
+ * node, converted to the snapshot units.
+ *
+ * @param e The engine.
+ * @param props The field to gather.
+ * @param index The indices of the parts in the #space.
+ * @param N The number of parts.
+ * @param temp The buffer to fill.
+ */
+void los_gather_field(const struct engine *e, const struct io_props props,
+                      const size_t *index, const size_t N, void *temp) {
+
+  if (N == 0) return;
+
+  struct los_gather_data data;
+  data.props = props;
+  data.e = e;
+  data.index_start = index;
+  data.temp = (char *)temp;
+  threadpool_map((struct threadpool *)&e->threadpool, los_gather_mapper,
+                 (void *)index, N, sizeof(size_t), threadpool_auto_chunk_size,
+                 &data);
+
+  /* Unit conversion if necessary */
+  const double factor = units_conversion_factor(
+      e->internal_units, e->snapshot_units, props.units);
+  if (factor != 1.) {
+    const size_t num_elements = N * props.dimension;
+    if (io_is_double_precision(props.type)) {
+      double *temp_d = (double *)temp;
+      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= factor;
+    } else {
+      float *temp_f = (float *)temp;
+      for (size_t i = 0; i < num_elements; ++i) temp_f[i] *= factor;
     }
   }
+}
 
-#ifdef WITH_MPI
-  if (MPI_Allreduce(MPI_IN_PLACE, &num_intersecting_top_level_cells, 1, MPI_INT,
-                    MPI_SUM, MPI_COMM_WORLD) != MPI_SUCCESS)
-    error("Failed to allreduce num_intersecting_top_level_cells.");
-#endif
+/**
+ * @brief Offset of an output field in the buffer packing all the fields of
+ * some parts, one field after the other.
+ *
+ * Each field starts on an 8 bytes boundary so that it can be accessed in
+ * place. The offset of field num_fields is the size of the whole buffer.
+ *
+ * @param list The output fields.
+ * @param f The field of interest.
+ * @param N The number of parts.
+ */
+static size_t los_field_offset(const struct io_props *list, const int f,
+                               const size_t N) {
 
-  /* Store how many top level cells this LOS intersects. */
-  los->num_intersecting_top_level_cells = num_intersecting_top_level_cells;
+  size_t offset = 0;
+  for (int g = 0; g < f; g++) {
+    const size_t copySize = io_sizeof_type(list[g].type) * list[g].dimension;
+    offset += ((N * copySize + 7) / 8) * 8;
+  }
+  return offset;
 }
 
 /**
  * @brief Main work function for computing line of sights.
  *
- * 1) Construct N random line of sight positions.
- * 2) Loop over each line of sight.
- *  - 2.1) Find which top level cells sightline intersects.
- *  - 2.2) Loop over each part in these top level cells to see which intersect
- * sightline.
- *  - 2.3) Use this count to construct a LOS parts/xparts array.
- *  - 2.4) Loop over each part and extract those in sightline to new array.
- *  - 2.5) Save sightline parts to HDF5 file.
+ * 1) Construct N random line of sight positions and bin them on a grid for
+ *    each of the simulation axes they shoot down.
+ * 2) Loop once over the parts of the local top-level cells in parallel,
+ *    finding the sightlines each part contributes to, to count the parts in
+ *    each sightline.
+ * 3) Loop again, this time recording the index of these parts.
+ * 4) For each sightline, gather only the selected output fields of its parts,
+ *    packed in a single buffer, and write them, either to a single file
+ *    written by rank 0 or to one file per rank.
  *
  * @param e The engine.
  */
@@ -695,118 +1053,176 @@ void do_line_of_sight(struct engine *e) {
   const double dim[3] = {s->dim[0], s->dim[1], s->dim[2]};
   const struct los_props *LOS_params = e->los_properties;
   const int verbose = e->verbose;
+  const int num_tot = LOS_params->num_tot;
+
+  /* Do we write one file per rank? */
+#ifdef WITH_MPI
+  const int distributed = LOS_params->distributed;
+#else
+  const int distributed = 0;
+#endif
+  const int num_files = distributed ? e->nr_nodes : 1;
+  const int writer = distributed || e->nodeID == 0;
 
   /* Start by generating the random sightline positions. */
   struct line_of_sight *LOS_list = (struct line_of_sight *)malloc(
-      LOS_params->num_tot * sizeof(struct line_of_sight));
+      num_tot * sizeof(struct line_of_sight));
 
   if (e->nodeID == 0) {
     generate_sightlines(LOS_list, LOS_params, periodic, dim);
-    if (verbose)
-      message("Generated %i random sightlines.", LOS_params->num_tot);
+    if (verbose) message("Generated %i random sightlines.", num_tot);
   }
 
 #ifdef WITH_MPI
   /* Share the list of LoS with all the MPI ranks */
-  MPI_Bcast(LOS_list, LOS_params->num_tot * sizeof(struct line_of_sight),
-            MPI_BYTE, 0, MPI_COMM_WORLD);
-#endif
-
-  /* Node 0 creates the HDF5 file. */
-  hid_t h_file = -1, h_grp = -1;
-  char fileName[256], groupName[200];
-
-  if (e->nodeID == 0) {
-    sprintf(fileName, "%s_%04i.hdf5", LOS_params->basename,
-            e->los_output_count);
-    if (verbose) message("Creating LOS file: %s", fileName);
-    h_file = H5Fcreate(fileName, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
-    if (h_file < 0) error("Error while opening file '%s'.", fileName);
-  }
-
-#ifdef WITH_MPI
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Bcast(LOS_list, num_tot * sizeof(struct line_of_sight), MPI_BYTE, 0,
+            MPI_COMM_WORLD);
 #endif
 
-  /* Keep track of the total number of parts in all sightlines. */
-  size_t total_num_parts_in_los = 0;
-
-  /* ------------------------------- */
-  /* Main loop over each random LOS. */
-  /* ------------------------------- */
-
-  /* Get list of local non-empty top level cells. */
-  const struct cell *cells = e->s->cells_top;
-  const int *local_cells_with_particles = e->s->local_cells_with_particles_top;
-  const int nr_local_cells_with_particles = s->nr_local_cells_with_particles;
-
-  /* Loop over each random LOS. */
-  for (int j = 0; j < LOS_params->num_tot; j++) {
-
-    /* Create empty top level cell list for this LOS */
-    int *los_cells_top = (int *)swift_malloc(
-        "tl_cells_los", nr_local_cells_with_particles * sizeof(int));
-    bzero(los_cells_top, nr_local_cells_with_particles * sizeof(int));
-
-    /* Find all top level cells this LOS will intersect. */
-    find_intersecting_top_level_cells(e, &LOS_list[j], los_cells_top, cells,
-                                      local_cells_with_particles,
-                                      nr_local_cells_with_particles);
-
-    /* Next count all the parts that intersect with this line of sight */
-    for (int n = 0; n < nr_local_cells_with_particles; n++) {
-      if (los_cells_top[n] == 1) {
-        const struct cell *c = &cells[local_cells_with_particles[n]];
-        threadpool_map(&s->e->threadpool, los_first_loop_mapper, c->hydro.parts,
-                       c->hydro.count, sizeof(struct part),
-                       threadpool_auto_chunk_size, &LOS_list[j]);
-      }
-    }
+  /* Bin the sightlines of each axis (in the order they were generated). */
+  struct los_grid grids[3];
+  los_grid_init(&grids[0], LOS_list, 0, LOS_params->num_along_z);
+  los_grid_init(&grids[1], LOS_list, LOS_params->num_along_z,
+                LOS_params->num_along_x);
+  los_grid_init(&grids[2], LOS_list,
+                LOS_params->num_along_z + LOS_params->num_along_x,
+                LOS_params->num_along_y);
+
+  /* Loop over the parts of the local non-empty top level cells. */
+  struct los_mapper_data data;
+  data.LOS_list = LOS_list;
+  data.grids = grids;
+  data.cells = s->cells_top;
+  data.parts = s->parts;
+  data.los_parts_index = NULL;
+  data.los_parts_offset = NULL;
+  data.los_parts_cursor = NULL;
+
+  /* Count the parts in each sightline, looping over them once. */
+  threadpool_map(&e->threadpool, los_cells_mapper,
+                 s->local_cells_with_particles_top,
+                 s->nr_local_cells_with_particles, sizeof(int),
+                 threadpool_auto_chunk_size, &data);
 
 #ifdef SWIFT_DEBUG_CHECKS
-    /* Confirm we are capturing all the parts that intersect the LOS by redoing
-     * the count looping over all parts in the space (not just those in the
-     * subset of top level cells). */
+  /* Confirm we are capturing all the parts that intersect the LOS by redoing
+   * the count looping over all parts in the space for each LOS. */
+  for (int j = 0; j < num_tot; j++) {
 
-    struct part *parts = s->parts;
-    const size_t nr_parts = s->nr_parts;
-    const int old_particles_in_los_local = LOS_list[j].particles_in_los_local;
+    const size_t old_particles_in_los_local =
+        LOS_list[j].particles_in_los_local;
     LOS_list[j].particles_in_los_local = 0;
 
-    /* Count all parts that intersect with this line of sight. */
-    threadpool_map(&s->e->threadpool, los_first_loop_mapper, parts, nr_parts,
-                   sizeof(struct part), threadpool_auto_chunk_size,
-                   &LOS_list[j]);
+    threadpool_map(&e->threadpool, los_first_loop_mapper, s->parts,
+                   s->nr_parts, sizeof(struct part),
+                   threadpool_auto_chunk_size, &LOS_list[j]);
 
-    /* Make sure we get the same answer as above. */
     if (old_particles_in_los_local != LOS_list[j].particles_in_los_local)
-      error("Space vs cells don't match s:%d != c:%d",
+      error("Space vs cells don't match for LOS %d s:%zu != c:%zu", j,
             LOS_list[j].particles_in_los_local, old_particles_in_los_local);
+  }
 #endif
 
+  /* Record where the parts of each sightline go. */
+  size_t *offsets = (size_t *)malloc((num_tot + 1) * sizeof(size_t));
+  size_t *cursor = (size_t *)calloc(num_tot, sizeof(size_t));
+  int *los_ind = (int *)malloc(num_tot * sizeof(int));
+  if (offsets == NULL || cursor == NULL || los_ind == NULL)
+    error("Failed to allocate LOS offsets.");
+  offsets[0] = 0;
+  for (int j = 0; j < num_tot; j++) {
+    offsets[j + 1] = offsets[j] + LOS_list[j].particles_in_los_local;
+    los_ind[j] = j;
+  }
+
+  size_t *index = NULL;
+  if ((index = (size_t *)swift_malloc(
+           "los_parts_index",
+           max(offsets[num_tot], (size_t)1) * sizeof(size_t))) == NULL)
+    error("Failed to allocate LOS part indices.");
+
+  /* Loop over the parts again, recording the index of the ones found. */
+  data.los_parts_index = index;
+  data.los_parts_offset = offsets;
+  data.los_parts_cursor = cursor;
+  threadpool_map(&e->threadpool, los_cells_mapper,
+                 s->local_cells_with_particles_top,
+                 s->nr_local_cells_with_particles, sizeof(int),
+                 threadpool_auto_chunk_size, &data);
+
+#ifdef SWIFT_DEBUG_CHECKS
+  for (int j = 0; j < num_tot; j++)
+    if (cursor[j] != LOS_list[j].particles_in_los_local)
+      error("LOS counts don't add up");
+#endif
+
+  /* Write the parts in the order of the space, as when looping over the
+   * cells one sightline at a time. */
+  threadpool_map(&e->threadpool, los_sort_mapper, los_ind, num_tot,
+                 sizeof(int), threadpool_auto_chunk_size, &data);
+
+  /* How many parts does each rank have for each LOS? */
+  long long *counts =
+      (long long *)malloc(sizeof(long long) * num_tot * e->nr_nodes);
+  int *num_cells = (int *)malloc(sizeof(int) * num_tot);
+  if (counts == NULL || num_cells == NULL)
+    error("Failed to allocate LOS counts.");
+  for (int j = 0; j < num_tot; j++) {
+    counts[e->nodeID * num_tot + j] = LOS_list[j].particles_in_los_local;
+    num_cells[j] = LOS_list[j].num_intersecting_top_level_cells;
+  }
 #ifdef WITH_MPI
-    /* Make sure all nodes know how many parts are in this LOS */
-    int *counts = (int *)malloc(sizeof(int) * e->nr_nodes);
-    int *offsets = (int *)malloc(sizeof(int) * e->nr_nodes);
+  if (MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, counts, num_tot,
+                    MPI_LONG_LONG_INT, MPI_COMM_WORLD) != MPI_SUCCESS)
+    error("Failed to allgather the LOS counts.");
+  if (MPI_Allreduce(MPI_IN_PLACE, num_cells, num_tot, MPI_INT, MPI_SUM,
+                    MPI_COMM_WORLD) != MPI_SUCCESS)
+    error("Failed to allreduce num_intersecting_top_level_cells.");
+#endif
 
-    /* How many parts does each rank have for this LOS? */
-    MPI_Allgather(&LOS_list[j].particles_in_los_local, 1, MPI_INT, counts, 1,
-                  MPI_INT, MPI_COMM_WORLD);
+  /* Keep track of the total number of parts in all sightlines. */
+  size_t total_num_parts_in_los = 0;
+  size_t num_parts_in_file = 0;
+  for (int j = 0; j < num_tot; j++) {
+    LOS_list[j].particles_in_los_total = 0;
+    for (int k = 0; k < e->nr_nodes; k++)
+      LOS_list[j].particles_in_los_total += counts[k * num_tot + j];
+    LOS_list[j].num_intersecting_top_level_cells = num_cells[j];
+    total_num_parts_in_los += LOS_list[j].particles_in_los_total;
+    num_parts_in_file += distributed ? LOS_list[j].particles_in_los_local
+                                     : LOS_list[j].particles_in_los_total;
+  }
 
-    int offset_count = 0;
-    for (int k = 0; k < e->nr_nodes; k++) {
+  /* The writing rank(s) create the HDF5 file. */
+  hid_t h_file = -1, h_grp = -1;
+  char fileName[256], groupName[200];
 
-      /* Total parts in this LOS. */
-      LOS_list[j].particles_in_los_total += counts[k];
+  if (writer) {
+    if (distributed)
+      sprintf(fileName, "%s_%04i.%d.hdf5", LOS_params->basename,
+              e->los_output_count, e->nodeID);
+    else
+      sprintf(fileName, "%s_%04i.hdf5", LOS_params->basename,
+              e->los_output_count);
+    if (verbose) message("Creating LOS file: %s", fileName);
+    h_file = H5Fcreate(fileName, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (h_file < 0) error("Error while opening file '%s'.", fileName);
+  }
 
-      /* Counts and offsets for Gatherv. */
-      offsets[k] = offset_count;
-      offset_count += counts[k];
-    }
-#else
-    LOS_list[j].particles_in_los_total = LOS_list[j].particles_in_los_local;
+  /* The fields to write. */
+  struct io_props list[100];
+  const int num_fields = los_select_output_fields(e, list);
+
+#ifdef WITH_MPI
+  int *bytes = (int *)malloc(sizeof(int) * e->nr_nodes);
+  int *displs = (int *)malloc(sizeof(int) * e->nr_nodes);
 #endif
-    total_num_parts_in_los += LOS_list[j].particles_in_los_total;
+
+  /* ------------------------------- */
+  /* Main loop over each random LOS. */
+  /* ------------------------------- */
+
+  for (int j = 0; j < num_tot; j++) {
 
     /* Print information about this LOS */
     if (e->nodeID == 0) print_los_info(LOS_list, j);
@@ -817,134 +1233,16 @@ void do_line_of_sight(struct engine *e) {
         message("*WARNING* LOS %i is empty", j);
         print_los_info(LOS_list, j);
       }
-#ifdef WITH_MPI
-      free(counts);
-      free(offsets);
-#endif
-      swift_free("tl_cells_los", los_cells_top);
       continue;
     }
 
-    /* Setup LOS part and xpart structures. */
-    struct part *LOS_parts = NULL;
-    struct xpart *LOS_xparts = NULL;
-
-    /* Rank 0 allocates more space as it will gather all the data for writing */
-    if (e->nodeID == 0) {
-      if ((LOS_parts = (struct part *)swift_malloc(
-               "los_parts_array",
-               sizeof(struct part) * LOS_list[j].particles_in_los_total)) ==
-          NULL)
-        error("Failed to allocate LOS part memory.");
-      if ((LOS_xparts = (struct xpart *)swift_malloc(
-               "los_xparts_array",
-               sizeof(struct xpart) * LOS_list[j].particles_in_los_total)) ==
-          NULL)
-        error("Failed to allocate LOS xpart memory.");
-    } else {
-      if ((LOS_parts = (struct part *)swift_malloc(
-               "los_parts_array",
-               sizeof(struct part) * LOS_list[j].particles_in_los_local)) ==
-          NULL)
-        error("Failed to allocate LOS part memory.");
-      if ((LOS_xparts = (struct xpart *)swift_malloc(
-               "los_xparts_array",
-               sizeof(struct xpart) * LOS_list[j].particles_in_los_local)) ==
-          NULL)
-        error("Failed to allocate LOS xpart memory.");
-    }
-
-    /* Loop over each part again, pulling out those in LOS. */
-    int count = 0;
-
-    for (int n = 0; n < e->s->nr_local_cells_with_particles; ++n) {
-
-      if (los_cells_top[n] == 0) continue;
-
-      const struct cell *c = &cells[local_cells_with_particles[n]];
-      const struct part *cell_parts = c->hydro.parts;
-      const struct xpart *cell_xparts = c->hydro.xparts;
-      const size_t num_parts_in_cell = c->hydro.count;
-
-      for (size_t i = 0; i < num_parts_in_cell; i++) {
-
-        /* Don't consider inhibited parts. */
-        if (cell_parts[i].time_bin == time_bin_inhibited) continue;
-
-        /* Don't consider part if outwith allowed z-range. */
-        if (cell_parts[i].x[LOS_list[j].zaxis] <
-                LOS_list[j].range_when_shooting_down_axis[0] ||
-            cell_parts[i].x[LOS_list[j].zaxis] >
-                LOS_list[j].range_when_shooting_down_axis[1])
-          continue;
-
-        /* Distance from this part to LOS along x dim. */
-        double dx = cell_parts[i].x[LOS_list[j].xaxis] - LOS_list[j].Xpos;
-
-        /* Periodic wrap. */
-        if (LOS_list[j].periodic)
-          dx = nearest(dx, LOS_list[j].dim[LOS_list[j].xaxis]);
-
-        /* Square */
-        const double dx2 = dx * dx;
-
-        /* Smoothing length of this part. */
-        const double hsml = cell_parts[i].h * kernel_gamma;
-        const double hsml2 = hsml * hsml;
-
-        /* Does this part fall into our LOS? */
-        if (dx2 < hsml2) {
-
-          /* Distance from this part to LOS along y dim. */
-          double dy = cell_parts[i].x[LOS_list[j].yaxis] - LOS_list[j].Ypos;
-
-          /* Periodic wrap. */
-          if (LOS_list[j].periodic)
-            dy = nearest(dy, LOS_list[j].dim[LOS_list[j].yaxis]);
-
-          /* Square */
-          const double dy2 = dy * dy;
-
-          /* Does this part still fall into our LOS? */
-          if (dy2 < hsml2) {
-            /* 2D distance to LOS. */
-
-            if (dx2 + dy2 <= hsml2) {
-
-              /* Store part and xpart properties. */
-              memcpy(&LOS_parts[count], &cell_parts[i], sizeof(struct part));
-              memcpy(&LOS_xparts[count], &cell_xparts[i], sizeof(struct xpart));
-
-              count++;
-            }
-          }
-        }
-      }
-    }
-
-#ifdef SWIFT_DEBUG_CHECKS
-    if (count != LOS_list[j].particles_in_los_local)
-      error("LOS counts don't add up");
-#endif
-
-#ifdef WITH_MPI
-    /* Collect all parts in this LOS to rank 0. */
-    if (e->nodeID == 0) {
-      MPI_Gatherv(MPI_IN_PLACE, 0, part_mpi_type, LOS_parts, counts, offsets,
-                  part_mpi_type, 0, MPI_COMM_WORLD);
-      MPI_Gatherv(MPI_IN_PLACE, 0, xpart_mpi_type, LOS_xparts, counts, offsets,
-                  xpart_mpi_type, 0, MPI_COMM_WORLD);
-    } else {
-      MPI_Gatherv(LOS_parts, LOS_list[j].particles_in_los_local, part_mpi_type,
-                  LOS_parts, counts, offsets, part_mpi_type, 0, MPI_COMM_WORLD);
-      MPI_Gatherv(LOS_xparts, LOS_list[j].particles_in_los_local,
-                  xpart_mpi_type, LOS_xparts, counts, offsets, xpart_mpi_type,
-                  0, MPI_COMM_WORLD);
-    }
-#endif
+    const size_t N_local = LOS_list[j].particles_in_los_local;
+    const long long N_write = distributed ? LOS_list[j].particles_in_los_local
+                                          : LOS_list[j].particles_in_los_total;
+    const size_t N_buff = writer ? (size_t)N_write : N_local;
+    const size_t *los_index = index + offsets[j];
 
-    /* Rank 0 writes particles to file. */
-    if (e->nodeID == 0) {
+    if (writer) {
 
       /* Create HDF5 group for this LOS */
       sprintf(groupName, "/LOS_%04i", j);
@@ -953,41 +1251,114 @@ void do_line_of_sight(struct engine *e) {
       if (h_grp < 0) error("Error while creating LOS HDF5 group\n");
 
       /* Record this LOS attributes */
-      io_write_attribute(h_grp, "NumParts", INT,
-                         &LOS_list[j].particles_in_los_total, 1);
+      io_write_attribute(h_grp, "NumParts", LONGLONG, &N_write, 1);
       io_write_attribute(h_grp, "Xaxis", INT, &LOS_list[j].xaxis, 1);
       io_write_attribute(h_grp, "Yaxis", INT, &LOS_list[j].yaxis, 1);
       io_write_attribute(h_grp, "Zaxis", INT, &LOS_list[j].zaxis, 1);
       io_write_attribute(h_grp, "Xpos", DOUBLE, &LOS_list[j].Xpos, 1);
       io_write_attribute(h_grp, "Ypos", DOUBLE, &LOS_list[j].Ypos, 1);
+    }
 
-      /* Write the data for this LOS */
-      write_los_hdf5_datasets(h_grp, j, LOS_list[j].particles_in_los_total,
-                              LOS_parts, e, LOS_xparts);
+    /* Pack all the fields of our parts, one after the other (rank 0 keeps
+     * its own at the start of the buffer) */
+    const size_t local_size = los_field_offset(list, num_fields, N_local);
+    const size_t buff_size =
+        writer ? los_field_offset(list, num_fields, N_buff) : local_size;
+    char *temp = NULL;
+    if (swift_memalign("writebuff", (void **)&temp, IO_BUFFER_ALIGNMENT,
+                       max(buff_size, (size_t)1)) != 0)
+      error("Unable to allocate temporary i/o buffer");
 
-      /* Close HDF5 group */
-      H5Gclose(h_grp);
+    for (int f = 0; f < num_fields; f++)
+      los_gather_field(e, list[f], los_index, N_local,
+                       temp + los_field_offset(list, f, N_local));
+
+#ifdef WITH_MPI
+    /* Collect the fields of all the parts in this LOS on rank 0, with a
+     * single message per rank. */
+    if (!distributed && e->nr_nodes > 1) {
+      size_t offset = 0;
+      for (int k = 0; k < e->nr_nodes; k++) {
+        const size_t b =
+            los_field_offset(list, num_fields, counts[k * num_tot + j]);
+        if (offset + b > INT_MAX) error("LOS too large to be gathered.");
+        bytes[k] = b;
+        displs[k] = offset;
+        offset += b;
+      }
+      if (e->nodeID == 0)
+        MPI_Gatherv(MPI_IN_PLACE, 0, MPI_BYTE, temp, bytes, displs, MPI_BYTE, 0,
+                    MPI_COMM_WORLD);
+      else
+        MPI_Gatherv(temp, bytes[e->nodeID], MPI_BYTE, NULL, NULL, NULL,
+                    MPI_BYTE, 0, MPI_COMM_WORLD);
     }
+#endif
+
+    for (int f = 0; writer && f < num_fields; f++) {
 
-      /* Free up some memory */
 #ifdef WITH_MPI
-    free(counts);
-    free(offsets);
+      /* Collect the field from the packed buffer of each rank */
+      if (!distributed && e->nr_nodes > 1) {
+
+        const size_t copySize =
+            io_sizeof_type(list[f].type) * list[f].dimension;
+
+        char *field = NULL;
+        if (swift_memalign("writebuff", (void **)&field, IO_BUFFER_ALIGNMENT,
+                           N_buff * copySize) != 0)
+          error("Unable to allocate temporary i/o buffer");
+
+        size_t count = 0;
+        for (int k = 0; k < e->nr_nodes; k++) {
+          const size_t N_rank = counts[k * num_tot + j];
+          memcpy(field + count * copySize,
+                 temp + displs[k] + los_field_offset(list, f, N_rank),
+                 N_rank * copySize);
+          count += N_rank;
+        }
+
+        write_los_hdf5_dataset(list[f], N_write, j, e, h_grp, field);
+        swift_free("writebuff", field);
+        continue;
+      }
 #endif
-    swift_free("tl_cells_los", los_cells_top);
-    swift_free("los_parts_array", LOS_parts);
-    swift_free("los_xparts_array", LOS_xparts);
+
+      /* All the parts are ours, write the field in place */
+      write_los_hdf5_dataset(list[f], N_write, j, e, h_grp,
+                             temp + los_field_offset(list, f, N_local));
+    }
+
+    swift_free("writebuff", temp);
+
+    /* Close HDF5 group */
+    if (writer) H5Gclose(h_grp);
 
   } /* End of loop over each LOS */
 
-  if (e->nodeID == 0) {
+  if (writer) {
     /* Write header */
-    write_hdf5_header(h_file, e, LOS_params, total_num_parts_in_los);
+    write_hdf5_header(h_file, e, LOS_params, total_num_parts_in_los,
+                      num_parts_in_file, num_files);
 
     /* Close HDF5 file */
     H5Fclose(h_file);
   }
 
+  /* Free up some memory */
+#ifdef WITH_MPI
+  free(bytes);
+  free(displs);
+#endif
+  for (int g = 0; g < 3; g++) los_grid_clean(&grids[g]);
+  swift_free("los_parts_index", index);
+  free(offsets);
+  free(cursor);
+  free(los_ind);
+  free(counts);
+  free(num_cells);
+  free(LOS_list);
+
   /* Up the LOS counter. */
   e->los_output_count++;
 
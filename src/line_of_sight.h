@@ -56,10 +56,10 @@ struct line_of_sight {
   double Ypos;
 
   /*! Number of parts in LOS. */
-  int particles_in_los_total;
+  size_t particles_in_los_total;
 
   /*! Number of parts in LOS on this node. */
-  int particles_in_los_local;
+  size_t particles_in_los_local;
 
   /*! Is the simulation periodic? */
   int periodic;
@@ -109,6 +109,83 @@ struct los_props {
 
   /*! Base name for line of sight HDF5 files. */
   char basename[200];
+
+  /*! Write one file per MPI rank rather than gathering on rank 0? */
+  int distributed;
+};
+
+/*! Maximal number of bins per dimension of a #los_grid. */
+#define los_grid_max_bins 256
+
+/**
+ * @brief The sightlines shooting down one simulation axis, binned on a
+ * regular grid covering the plane orthogonal to it.
+ */
+struct los_grid {
+
+  /*! The two axes defining the plane of the grid. */
+  enum los_direction xaxis, yaxis;
+
+  /*! Index of the first sightline and number of sightlines in the grid. */
+  int first, count;
+
+  /*! Number of bins along each dimension. */
+  int n;
+
+  /*! Width of the bins along each dimension. */
+  double width[2];
+
+  /*! Are the boundaries periodic? */
+  int periodic;
+
+  /*! Offsets of each bin in los_index (n * n + 1 elements). */
+  int *bin_offsets;
+
+  /*! Index of the sightlines in each bin. */
+  int *los_index;
+};
+
+/**
+ * @brief Data used by the mappers looping over the parts of the top-level
+ * cells.
+ */
+struct los_mapper_data {
+
+  /*! All the sightlines. */
+  struct line_of_sight *LOS_list;
+
+  /*! The grids of sightlines along each axis. */
+  const struct los_grid *grids;
+
+  /*! The top-level cells and the parts of the #space. */
+  const struct cell *cells;
+  const struct part *parts;
+
+  /*! Index of the parts found in each sightline (NULL when counting). */
+  size_t *los_parts_index;
+
+  /*! Offset of each sightline in los_parts_index and number filled so far. */
+  size_t *los_parts_offset;
+  size_t *los_parts_cursor;
+};
+
+/**
+ * @brief Data used by the mapper gathering a field of the parts in a
+ * sightline.
+ */
+struct los_gather_data {
+
+  /*! The field to gather. */
+  struct io_props props;
+
+  /*! The engine. */
+  const struct engine *e;
+
+  /*! Start of the index of the parts to gather. */
+  const size_t *index_start;
+
+  /*! The buffer to fill. */
+  char *temp;
 };
 
 void print_los_info(const struct line_of_sight *Los, const int i);
@@ -27,6 +27,7 @@
 #include "../config.h"
 
 /* Standard includes. */
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -49,17 +50,17 @@
 #include "error.h"
 #include "memuse_rnodes.h"
 
-#ifdef SWIFT_MEMUSE_REPORTS
-
-/* The initial size and increment of the log entries buffer. */
-#define MEMUSE_INITLOG 1000000
-
 /* A megabyte for conversions. */
 #define MEGABYTE 1048576.0
 
 /* Maximum length of label in log entry. */
 #define MEMUSE_MAXLABLEN 32
 
+#ifdef SWIFT_MEMUSE_REPORTS
+
+/* The initial size and increment of the log entries buffer. */
+#define MEMUSE_INITLOG 1000000
+
 /* Also recorded in logger. */
 extern int engine_rank;
 extern int engine_current_step;
@@ -504,3 +505,382 @@ const char *memuse_process(int inmb) {
   }
   return buffer;
 }
+
+/* Maximum number of distinct labels followed by the memory counters (power
+ * of 2). Any others are gathered in a single extra counter. */
+#define MEMUSE_MAXLABELS 512
+
+/* Initial size of each stripe of the table of allocations followed by the
+ * counters. */
+#define MEMUSE_INITALLOCS 256
+
+/* Number of independently locked stripes of the table of allocations (power
+ * of 2). */
+#define MEMUSE_NRSTRIPES 64
+
+/* Memory in use for a label. */
+struct memuse_counter {
+
+  /* The label, empty if the counter is not used yet. */
+  char label[MEMUSE_MAXLABLEN + 1];
+
+  /* Is the label set? */
+  volatile int used;
+
+  /* Bytes currently allocated. */
+  volatile size_t current;
+
+  /* Number of allocations currently active. */
+  volatile size_t count;
+
+  /* Largest value of current since the start of the step. */
+  volatile size_t step_peak;
+
+  /* Largest value of current since the start of the run. */
+  volatile size_t peak;
+};
+
+/* An active allocation known to the counters. */
+struct memuse_counter_alloc {
+  void *ptr;
+  size_t size;
+  int label;
+};
+
+/* A stripe of the hash table of active allocations (open addressing, linear
+ * probing). Each pointer always lands in the same stripe, so the threads only
+ * contend when they allocate or free memory in the same stripe. */
+struct memuse_counter_stripe {
+  struct memuse_counter_alloc *allocs;
+  size_t size;
+  size_t count;
+  pthread_mutex_t lock;
+} __attribute__((aligned(64)));
+
+/* The counters for each label and the total, updated atomically as the
+ * allocations can come from any thread, and the table of active allocations
+ * they are updated from. */
+static struct memuse_counter memuse_counters[MEMUSE_MAXLABELS + 1];
+static struct memuse_counter memuse_counters_total;
+static struct memuse_counter_stripe memuse_counters_stripes[MEMUSE_NRSTRIPES] =
+    {[0 ... MEMUSE_NRSTRIPES - 1] = {.lock = PTHREAD_MUTEX_INITIALIZER}};
+
+/* Lock for the creation of new labels, their look-up is lock-free. */
+static pthread_mutex_t memuse_counters_label_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The memory budget in bytes, 0 for none. */
+static size_t memuse_budget = 0;
+
+/**
+ * @brief Find the counter of a label, creating it if needed.
+ *
+ * @param label the label.
+ * @result the index of the counter in memuse_counters.
+ */
+static int memuse_counters_label(const char *label) {
+
+  /* FNV-1a hash of the label. */
+  uint32_t hash = 2166136261u;
+  for (int k = 0; k < MEMUSE_MAXLABLEN && label[k] != '\0'; k++)
+    hash = (hash ^ (uint8_t)label[k]) * 16777619u;
+
+  for (int k = 0; k < MEMUSE_MAXLABELS; k++) {
+    const int ind = (hash + k) & (MEMUSE_MAXLABELS - 1);
+    struct memuse_counter *c = &memuse_counters[ind];
+
+    /* Claim the counter if it is free, unless another thread got there
+     * first. */
+    if (!c->used) {
+      pthread_mutex_lock(&memuse_counters_label_lock);
+      if (!c->used) {
+        strncpy(c->label, label, MEMUSE_MAXLABLEN);
+        c->label[MEMUSE_MAXLABLEN] = '\0';
+        __sync_synchronize();
+        c->used = 1;
+        pthread_mutex_unlock(&memuse_counters_label_lock);
+        return ind;
+      }
+      pthread_mutex_unlock(&memuse_counters_label_lock);
+    }
+    if (strncmp(c->label, label, MEMUSE_MAXLABLEN) == 0) return ind;
+  }
+
+  /* Table full, use the overflow counter. */
+  struct memuse_counter *c = &memuse_counters[MEMUSE_MAXLABELS];
+  if (!c->used) {
+    pthread_mutex_lock(&memuse_counters_label_lock);
+    if (!c->used) {
+      strcpy(c->label, "other");
+      __sync_synchronize();
+      c->used = 1;
+    }
+    pthread_mutex_unlock(&memuse_counters_label_lock);
+  }
+  return MEMUSE_MAXLABELS;
+}
+
+/**
+ * @brief Hash of a pointer. The low bits select the stripe, the others the
+ * position in the stripe.
+ */
+static size_t memuse_counters_hash(const void *ptr) {
+  const uint64_t key = (uint64_t)(uintptr_t)ptr >> 4;
+  return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+/**
+ * @brief Position of a pointer in its stripe of the table of allocations.
+ */
+static size_t memuse_counters_slot(const struct memuse_counter_stripe *stripe,
+                                   const void *ptr) {
+  return (memuse_counters_hash(ptr) / MEMUSE_NRSTRIPES) & (stripe->size - 1);
+}
+
+/**
+ * @brief Insert an allocation in a stripe, which must have space for it.
+ */
+static void memuse_counters_insert(struct memuse_counter_stripe *stripe,
+                                   const struct memuse_counter_alloc *alloc) {
+  size_t ind = memuse_counters_slot(stripe, alloc->ptr);
+  while (stripe->allocs[ind].ptr != NULL)
+    ind = (ind + 1) & (stripe->size - 1);
+  stripe->allocs[ind] = *alloc;
+}
+
+/**
+ * @brief Double the size of a stripe of the table of active allocations.
+ */
+static void memuse_counters_grow(struct memuse_counter_stripe *stripe) {
+
+  struct memuse_counter_alloc *old = stripe->allocs;
+  const size_t old_size = stripe->size;
+
+  stripe->size = (old_size == 0) ? MEMUSE_INITALLOCS : 2 * old_size;
+  stripe->allocs = (struct memuse_counter_alloc *)calloc(
+      stripe->size, sizeof(struct memuse_counter_alloc));
+  if (stripe->allocs == NULL)
+    error("Failed to allocate the memory counters table.");
+
+  for (size_t k = 0; k < old_size; k++)
+    if (old[k].ptr != NULL) memuse_counters_insert(stripe, &old[k]);
+  free(old);
+}
+
+/**
+ * @brief Atomically raise a peak to a new value.
+ */
+static void memuse_counter_max(volatile size_t *peak, size_t value) {
+  size_t old = *peak;
+  while (old < value) {
+    const size_t test = old;
+    old = atomic_cas(peak, test, value);
+    if (old == test) break;
+  }
+}
+
+/**
+ * @brief Add some memory to a counter and update its peaks.
+ */
+static void memuse_counter_add(struct memuse_counter *c, size_t size) {
+  const size_t current = atomic_add(&c->current, size) + size;
+  atomic_inc(&c->count);
+  memuse_counter_max(&c->step_peak, current);
+  memuse_counter_max(&c->peak, current);
+}
+
+/**
+ * @brief Record an allocation in the per-label memory counters.
+ *
+ * Cheap enough to be always on for the significant allocations made through
+ * the swift_malloc() family.
+ *
+ * @param label the label associated with the memory.
+ * @param ptr the memory pointer.
+ * @param size the size in bytes of the memory.
+ */
+void memuse_counters_alloc(const char *label, void *ptr, size_t size) {
+
+  if (ptr == NULL) return;
+
+  const struct memuse_counter_alloc alloc = {ptr, size,
+                                             memuse_counters_label(label)};
+
+  struct memuse_counter_stripe *stripe =
+      &memuse_counters_stripes[memuse_counters_hash(ptr) &
+                               (MEMUSE_NRSTRIPES - 1)];
+  pthread_mutex_lock(&stripe->lock);
+
+  /* Keep the stripe at most half full. */
+  if (2 * (stripe->count + 1) > stripe->size) memuse_counters_grow(stripe);
+  memuse_counters_insert(stripe, &alloc);
+  stripe->count++;
+
+  pthread_mutex_unlock(&stripe->lock);
+
+  memuse_counter_add(&memuse_counters[alloc.label], size);
+  memuse_counter_add(&memuse_counters_total, size);
+}
+
+/**
+ * @brief Record the release of memory in the per-label memory counters.
+ *
+ * Must be called before the memory is actually freed so that its address
+ * cannot be handed out to another allocation first. Unknown pointers are
+ * ignored.
+ *
+ * @param ptr the memory pointer.
+ * @result the size of the memory that was recorded for this pointer.
+ */
+size_t memuse_counters_free(void *ptr) {
+
+  size_t size = 0;
+  int label = -1;
+
+  struct memuse_counter_stripe *stripe =
+      &memuse_counters_stripes[memuse_counters_hash(ptr) &
+                               (MEMUSE_NRSTRIPES - 1)];
+  pthread_mutex_lock(&stripe->lock);
+
+  if (stripe->count > 0) {
+
+    struct memuse_counter_alloc *allocs = stripe->allocs;
+    const size_t mask = stripe->size - 1;
+    size_t ind = memuse_counters_slot(stripe, ptr);
+    while (allocs[ind].ptr != NULL && allocs[ind].ptr != ptr)
+      ind = (ind + 1) & mask;
+
+    if (allocs[ind].ptr == ptr) {
+
+      size = allocs[ind].size;
+      label = allocs[ind].label;
+      stripe->count--;
+
+      /* Remove the entry, moving back any that were displaced by it. */
+      size_t next = ind;
+      while (1) {
+        next = (next + 1) & mask;
+        if (allocs[next].ptr == NULL) break;
+        const size_t home = memuse_counters_slot(stripe, allocs[next].ptr);
+        if (((next - home) & mask) >= ((next - ind) & mask)) {
+          allocs[ind] = allocs[next];
+          ind = next;
+        }
+      }
+      allocs[ind].ptr = NULL;
+    }
+  }
+
+  pthread_mutex_unlock(&stripe->lock);
+
+  if (label >= 0) {
+    struct memuse_counter *c = &memuse_counters[label];
+    atomic_sub(&c->current, size);
+    atomic_dec(&c->count);
+    atomic_sub(&memuse_counters_total.current, size);
+    atomic_dec(&memuse_counters_total.count);
+  }
+  return size;
+}
+
+/**
+ * @brief Start a new step for the memory counters, i.e. reset the step peaks
+ * to the memory currently in use.
+ *
+ * Allocations made by other threads at the same time may be missed by the
+ * new step peaks.
+ */
+void memuse_counters_new_step(void) {
+  for (int k = 0; k <= MEMUSE_MAXLABELS; k++)
+    memuse_counters[k].step_peak = memuse_counters[k].current;
+  memuse_counters_total.step_peak = memuse_counters_total.current;
+}
+
+/**
+ * @brief Return the peak memory use of this step and the label that
+ * contributed most to it.
+ *
+ * @param label (return) the label with the largest step peak, must have space
+ *              for at least 33 characters.
+ * @param label_peak (return) the step peak of that label in bytes.
+ * @result the peak memory use of this step in bytes.
+ */
+size_t memuse_counters_step_peak(char *label, size_t *label_peak) {
+
+  label[0] = '\0';
+  *label_peak = 0;
+  for (int k = 0; k <= MEMUSE_MAXLABELS; k++) {
+    if (memuse_counters[k].used && memuse_counters[k].step_peak > *label_peak) {
+      *label_peak = memuse_counters[k].step_peak;
+      strcpy(label, memuse_counters[k].label);
+    }
+  }
+  return memuse_counters_total.step_peak;
+}
+
+/**
+ * @brief Dump the memory counters of each label to a file, using the format
+ *        of the summary of the memuse_log_dump() reports.
+ *
+ * @param filename name of file for the dump.
+ */
+void memuse_counters_dump(const char *filename) {
+
+  FILE *fd;
+  if ((fd = fopen(filename, "w")) == NULL) {
+    message("Failed to create memuse counters file '%s', not dumped.",
+            filename);
+    return;
+  }
+
+  fprintf(fd, "# Memory use by label:\n");
+  fprintf(fd, "##  %30s %16s %16s %16s %16s\n", "label", "MB", "numactive",
+          "steppeakMB", "peakMB");
+  fprintf(fd, "##\n");
+  for (int k = 0; k <= MEMUSE_MAXLABELS; k++) {
+    const struct memuse_counter *c = &memuse_counters[k];
+    if (!c->used || c->peak == 0) continue;
+    fprintf(fd, "## %30s %16.3f %16zu %16.3f %16.3f\n", c->label,
+            c->current / MEGABYTE, c->count, c->step_peak / MEGABYTE,
+            c->peak / MEGABYTE);
+  }
+  fprintf(fd, "##\n");
+  fprintf(fd, "# Total memory still in use : %.3f (MB)\n",
+          memuse_counters_total.current / MEGABYTE);
+  fprintf(fd, "# Peak memory usage         : %.3f (MB)\n",
+          memuse_counters_total.step_peak / MEGABYTE);
+  fprintf(fd, "# Peak memory usage of run  : %.3f (MB)\n",
+          memuse_counters_total.peak / MEGABYTE);
+
+  if (memuse_budget > 0)
+    fprintf(fd, "# Memory budget             : %.3f (MB)\n",
+            memuse_budget / MEGABYTE);
+  fprintf(fd, "#\n");
+  fprintf(fd, "# Memory use by process (all/system): %s\n", memuse_process(1));
+  fprintf(fd, "# cpufreq: %lld\n", clocks_get_cpufreq());
+
+  fclose(fd);
+}
+
+/**
+ * @brief Set the budget for the memory followed by the counters.
+ *
+ * The budget is advisory: nothing fails when it is exceeded, but the parts of
+ * the code that can trade speed for memory (e.g. the i/o buffers or the
+ * allocation margins of the particle arrays) use the lower-memory option
+ * when their allocation would not fit in it.
+ *
+ * @param budget the budget in bytes, 0 for no budget.
+ */
+void memuse_budget_set(size_t budget) { memuse_budget = budget; }
+
+/**
+ * @brief The memory left in the budget.
+ *
+ * @result the number of bytes that can still be allocated before exceeding
+ *         the budget, SIZE_MAX if there is no budget.
+ */
+size_t memuse_budget_available(void) {
+  if (memuse_budget == 0) return SIZE_MAX;
+  const size_t current = memuse_counters_total.current;
+  return (current < memuse_budget) ? memuse_budget - current : 0;
+}
@@ -30,6 +30,25 @@ void memuse_use(long *size, long *resident, long *shared, long *text,
                 long *data, long *library, long *dirty);
 const char *memuse_process(int inmb);
 
+void memuse_counters_alloc(const char *label, void *ptr, size_t size);
+size_t memuse_counters_free(void *ptr);
+void memuse_counters_new_step(void);
+size_t memuse_counters_step_peak(char *label, size_t *label_peak);
+void memuse_counters_dump(const char *filename);
+
+void memuse_budget_set(size_t budget);
+size_t memuse_budget_available(void);
+
+/**
+ * @brief Would an extra allocation fit in the memory budget?
+ *
+ * @param size The size in bytes of the allocation.
+ * @result 1 if it does or if there is no budget, 0 otherwise.
+ */
+__attribute__((always_inline)) inline int memuse_budget_allows(size_t size) {
+  return size <= memuse_budget_available();
+}
+
 #ifdef SWIFT_MEMUSE_REPORTS
 void memuse_log_dump(const char *filename);
 void memuse_log_dump_error(int rank);
@@ -57,6 +76,7 @@ __attribute__((always_inline)) inline int swift_memalign(const char *label,
                                                          size_t alignment,
                                                          size_t size) {
   int result = posix_memalign(memptr, alignment, size);
+  if (result == 0) memuse_counters_alloc(label, *memptr, size);
 #ifdef SWIFT_MEMUSE_REPORTS
   if (result == 0) {
     memuse_log_allocation(label, *memptr, 1, size);
@@ -82,6 +102,7 @@ __attribute__((always_inline)) inline int swift_memalign(const char *label,
 __attribute__((always_inline)) inline void *swift_malloc(const char *label,
                                                          size_t size) {
   void *memptr = malloc(size);
+  if (memptr != NULL) memuse_counters_alloc(label, memptr, size);
 #ifdef SWIFT_MEMUSE_REPORTS
   if (memptr != NULL) {
     memuse_log_allocation(label, memptr, 1, size);
@@ -109,6 +130,7 @@ __attribute__((always_inline)) inline void *swift_calloc(const char *label,
                                                          size_t nmemb,
                                                          size_t size) {
   void *memptr = calloc(nmemb, size);
+  if (memptr != NULL) memuse_counters_alloc(label, memptr, size * nmemb);
 #ifdef SWIFT_MEMUSE_REPORTS
   if (memptr != NULL) {
     memuse_log_allocation(label, memptr, 1, size * nmemb);
@@ -135,7 +157,17 @@ __attribute__((always_inline)) inline void *swift_calloc(const char *label,
 __attribute__((always_inline)) inline void *swift_realloc(const char *label,
                                                           void *ptr,
                                                           size_t size) {
+
+  /* Stop counting the old memory before it can be handed out again. */
+  const size_t old_size = (ptr != NULL) ? memuse_counters_free(ptr) : 0;
   void *memptr = realloc(ptr, size);
+  if (memptr != NULL) {
+    memuse_counters_alloc(label, memptr, size);
+  } else if (ptr != NULL && size != 0) {
+
+    /* Failed, the old memory is still in use. */
+    memuse_counters_alloc(label, ptr, old_size);
+  }
 #ifdef SWIFT_MEMUSE_REPORTS
   if (memptr != NULL) {
 
@@ -168,6 +200,7 @@ __attribute__((always_inline)) inline void *swift_realloc(const char *label,
  */
 __attribute__((always_inline)) inline void swift_free(const char *label,
                                                       void *ptr) {
+  if (ptr != NULL) memuse_counters_free(ptr);
   free(ptr);
 #ifdef SWIFT_MEMUSE_REPORTS
   memuse_log_allocation(label, ptr, 0, 0);
@@ -529,6 +529,8 @@ void pm_mesh_compute_potential(struct pm_mesh* mesh, const struct space* s,
     error("Error allocating memory for transform of density mesh");
   memuse_log_allocation("fftw_frho", frho, 1,
                         sizeof(fftw_complex) * N * N * (N_half + 1));
+  memuse_counters_alloc("fftw_frho", frho,
+                        sizeof(fftw_complex) * N * N * (N_half + 1));
 
   /* Prepare the FFT library */
   fftw_plan forward_plan = fftw_plan_dft_r2c_3d(
@@ -621,6 +623,7 @@ void pm_mesh_compute_potential(struct pm_mesh* mesh, const struct space* s,
   fftw_destroy_plan(forward_plan);
   fftw_destroy_plan(inverse_plan);
   memuse_log_allocation("fftw_frho", frho, 0, 0);
+  memuse_counters_free(frho);
   fftw_free(frho);
 
 #else
@@ -692,6 +695,8 @@ void pm_mesh_allocate(struct pm_mesh* mesh) {
     error("Error allocating memory for the long-range gravity mesh.");
   memuse_log_allocation("fftw_mesh.potential", mesh->potential, 1,
                         sizeof(double) * N * N * N);
+  memuse_counters_alloc("fftw_mesh.potential", mesh->potential,
+                        sizeof(double) * N * N * N);
 #else
   error("No FFTW library found. Cannot compute periodic long-range forces.");
 #endif
@@ -708,6 +713,7 @@ void pm_mesh_free(struct pm_mesh* mesh) {
 
   if (mesh->potential) {
     memuse_log_allocation("fftw_mesh.potential", mesh->potential, 0, 0);
+    memuse_counters_free(mesh->potential);
     free(mesh->potential);
   }
   mesh->potential = NULL;
@@ -849,6 +855,8 @@ void pm_mesh_struct_restore(struct pm_mesh* mesh, FILE* stream) {
       error("Error allocating memory for the long-range gravity mesh.");
     memuse_log_allocation("fftw_mesh.potential", mesh->potential, 1,
                           sizeof(double) * N * N * N);
+    memuse_counters_alloc("fftw_mesh.potential", mesh->potential,
+                          sizeof(double) * N * N * N);
 #else
     error("No FFTW library found. Cannot compute periodic long-range forces.");
 #endif
@@ -31,44 +31,8 @@
 
 #ifdef WITH_MPI
 
-/* MPI data type for the multipole transfer and reduction */
+/* MPI data type for the multipole transfer */
 MPI_Datatype multipole_mpi_type;
-MPI_Op multipole_mpi_reduce_op;
-
-/**
- * @brief Apply a bit-by-bit XOR operattion on #gravity_tensors (i.e. does
- * a^=b).
- *
- * @param a The #gravity_tensors to add to.
- * @param b The #gravity_tensors to add.
- */
-void gravity_binary_xor(struct gravity_tensors *a,
-                        const struct gravity_tensors *b) {
-
-  char *aa = (char *)a;
-  const char *bb = (const char *)b;
-
-  for (size_t i = 0; i < sizeof(struct gravity_tensors); ++i) {
-    aa[i] ^= bb[i];
-  }
-}
-
-/**
- * @brief MPI reduction function for the #gravity_tensors.
- *
- * @param invec Array of #gravity_tensors to read.
- * @param inoutvec Array of #gravity_tensors to read and do the reduction into.
- * @param len The length of the array.
- * @param datatype The MPI type this function acts upon (unused).
- */
-void gravity_tensors_mpi_reduce(void *invec, void *inoutvec, int *len,
-                                MPI_Datatype *datatype) {
-
-  for (int i = 0; i < *len; ++i) {
-    gravity_binary_xor(&((struct gravity_tensors *)inoutvec)[i],
-                       &((const struct gravity_tensors *)invec)[i]);
-  }
-}
 
 void multipole_create_mpi_types(void) {
 
@@ -81,13 +45,7 @@ void multipole_create_mpi_types(void) {
       MPI_Type_commit(&multipole_mpi_type) != MPI_SUCCESS) {
     error("Failed to create MPI type for multipole.");
   }
-
-  /* And the reduction operator */
-  MPI_Op_create(gravity_tensors_mpi_reduce, 1, &multipole_mpi_reduce_op);
 }
 
-void multipole_free_mpi_types(void) {
-  MPI_Type_free(&multipole_mpi_type);
-  MPI_Op_free(&multipole_mpi_reduce_op);
-}
+void multipole_free_mpi_types(void) { MPI_Type_free(&multipole_mpi_type); }
 #endif
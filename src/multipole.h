@@ -1002,7 +1002,8 @@ __attribute__((nonnull)) INLINE static void gravity_P2M(
 #endif
 
     epsilon_max = max(epsilon_max, epsilon);
-    min_old_a_grav_norm = min(min_old_a_grav_norm, gparts[k].old_a_grav_norm);
+    min_old_a_grav_norm =
+        min(min_old_a_grav_norm, gravity_get_old_a_grav_norm(&gparts[k]));
     mass += m;
     com[0] += gparts[k].x[0] * m;
     com[1] += gparts[k].x[1] * m;
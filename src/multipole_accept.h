@@ -24,6 +24,7 @@
 
 /* Local includes */
 #include "binomial.h"
+#include "gravity.h"
 #include "gravity_properties.h"
 #include "integer_power.h"
 #include "kernel_long_gravity.h"
@@ -239,7 +240,7 @@ __attribute__((nonnull, pure)) INLINE static int gravity_M2P_accept(
   }
 
   /* Get the estimate of the acceleration */
-  const float old_a_grav = pa->old_a_grav_norm;
+  const float old_a_grav = gravity_get_old_a_grav_norm(pa);
 
   /* Get the relative tolerance */
   const float eps = props->adaptive_tolerance;
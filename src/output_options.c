@@ -80,6 +80,33 @@ void output_options_init(struct swift_params* parameter_file, int mpi_rank,
 #endif
 
   output_options->select_output = select_output;
+
+  /* Mantissa bits kept by the lossy levels */
+  output_options->mantissa_bits[compression_do_not_write] = -1;
+  output_options->mantissa_bits[compression_write_lossless] = -1;
+  output_options->mantissa_bits[compression_write_low_lossy] =
+      parser_get_opt_param_int(parameter_file,
+                               "Snapshots:lossy_low_mantissa_bits",
+                               io_compression_low_mantissa_bits_default);
+  output_options->mantissa_bits[compression_write_med_lossy] =
+      parser_get_opt_param_int(parameter_file,
+                               "Snapshots:lossy_med_mantissa_bits",
+                               io_compression_med_mantissa_bits_default);
+  output_options->mantissa_bits[compression_write_high_lossy] =
+      parser_get_opt_param_int(parameter_file,
+                               "Snapshots:lossy_high_mantissa_bits",
+                               io_compression_high_mantissa_bits_default);
+
+  for (int level = compression_write_low_lossy; level < compression_level_count;
+       level++) {
+    const int bits = output_options->mantissa_bits[level];
+    if (bits < 0 || bits > io_compression_max_mantissa_bits)
+      error(
+          "Invalid number of mantissa bits (%d) for the '%s' compression "
+          "level. It must be between 0 and %d.",
+          bits, compression_level_names[level],
+          io_compression_max_mantissa_bits);
+  }
 }
 
 /**
@@ -107,6 +134,9 @@ void output_options_struct_dump(struct output_options* output_options,
       (OUTPUT_LIST_MAX_NUM_OF_SELECT_OUTPUT_STYLES + 1) * swift_type_count;
   restart_write_blocks(output_options->num_fields_to_write, count * sizeof(int),
                        1, stream, "output_options", "output options");
+  restart_write_blocks(output_options->mantissa_bits,
+                       compression_level_count * sizeof(int), 1, stream,
+                       "output_options", "output options");
 }
 
 /**
@@ -127,11 +157,17 @@ void output_options_struct_restore(struct output_options* output_options,
       (OUTPUT_LIST_MAX_NUM_OF_SELECT_OUTPUT_STYLES + 1) * swift_type_count;
   restart_read_blocks(output_options->num_fields_to_write, count * sizeof(int),
                       1, stream, NULL, "output options");
+  restart_read_blocks(output_options->mantissa_bits,
+                      compression_level_count * sizeof(int), 1, stream, NULL,
+                      "output options");
 }
 
 /**
- * @brief Decides whether or not a given field should be written. Returns
- *        a truthy value if yes, falsey if not.
+ * @brief Decides whether or not a given field should be written and with
+ *        which compression level.
+ *
+ * The returned level is #compression_do_not_write (i.e. falsey) if the field
+ * should not be written.
  *
  * @param output_options pointer to the output options struct
  * @param snapshot_type pointer to a char array containing the type of
@@ -142,10 +178,9 @@ void output_options_struct_restore(struct output_options* output_options,
  * @param compression_level_current_default The default output strategy
  *.       based on the snapshot_type and part_type.
  *
- * @return should_write integer determining whether this field should be
- *         written
+ * @return The #compression_levels to use for this field.
  **/
-int output_options_should_write_field(
+enum compression_levels output_options_should_write_field(
     const struct output_options* output_options, const char* snapshot_type,
     const char* field_name, const enum part_type part_type,
     const enum compression_levels compression_level_current_default) {
@@ -160,17 +195,25 @@ int output_options_should_write_field(
       output_options->select_output, field, compression_level,
       compression_level_names[compression_level_current_default]);
 
-  int should_write = strcmp(compression_level_names[compression_do_not_write],
-                            compression_level);
+  /* Need to find out which of the entries this corresponds to... */
+  int level_index;
+  for (level_index = 0; level_index < compression_level_count; level_index++) {
+    if (!strcmp(compression_level_names[level_index], compression_level)) break;
+  }
+
+  if (level_index == compression_level_count)
+    error("Invalid compression level '%s' for field %s.", compression_level,
+          field);
 
 #ifdef SWIFT_DEBUG_CHECKS
   message(
       "Check for whether %s should be written returned %s from a provided "
       "value of \"%s\"",
-      field, should_write ? "True" : "False", compression_level);
+      field, level_index != compression_do_not_write ? "True" : "False",
+      compression_level);
 #endif
 
-  return should_write;
+  return (enum compression_levels)level_index;
 }
 
 /**
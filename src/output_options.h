@@ -20,26 +20,11 @@
 #define SWIFT_OUTPUT_OPTIONS_H
 
 /* Local headers. */
+#include "io_compression.h"
 #include "output_list.h"
 #include "part_type.h"
 #include "restart.h"
 
-/**
- * @brief Compression levels for snapshot fields
- */
-enum compression_levels {
-  compression_do_not_write = 0,
-  compression_write_lossless,
-  compression_write_low_lossy,
-  compression_write_med_lossy,
-  compression_write_high_lossy,
-  /* Counter, always leave last */
-  compression_level_count,
-};
-
-/*! Default value for SelectOutput */
-#define compression_level_default compression_write_lossless
-
 /*! Default name for the SelectOutput header */
 #define select_output_header_default_name "Default"
 
@@ -62,6 +47,9 @@ struct output_options {
    * output style is used but not specified. */
   int num_fields_to_write[OUTPUT_LIST_MAX_NUM_OF_SELECT_OUTPUT_STYLES + 1]
                          [swift_type_count];
+  /*! Number of explicit mantissa bits kept by each compression level.
+   * Negative values mean the level is lossless. */
+  int mantissa_bits[compression_level_count];
 };
 
 /* Create and destroy */
@@ -76,7 +64,7 @@ void output_options_struct_restore(struct output_options* output_options,
                                    FILE* stream);
 
 /* Logic functions */
-int output_options_should_write_field(
+enum compression_levels output_options_should_write_field(
     const struct output_options* output_options, const char* snapshot_type,
     const char* field_name, const enum part_type part_type,
     const enum compression_levels comp_level_current_default);
@@ -51,6 +51,7 @@
 #include "hydro_properties.h"
 #include "io_properties.h"
 #include "memuse.h"
+#include "minmax.h"
 #include "output_list.h"
 #include "output_options.h"
 #include "part.h"
@@ -66,14 +67,56 @@
 /* The current limit of ROMIO (the underlying MPI-IO layer) is 2GB */
 #define HDF5_PARALLEL_IO_MAX_BYTES 2147000000LL
 
+/* Number of particles per chunk of the compressed datasets */
+#define HDF5_PARALLEL_IO_CHUNK_SIZE (1 << 16)
+
+/* Parallel-HDF5 supports filters in collective writes from 1.10.2 but that
+ * version can't read the data back properly (see read_array_parallel()) */
+#if H5_VERSION_GE(1, 10, 3)
+#define HDF5_PARALLEL_IO_HAVE_FILTERS
+#endif
+
 /* Are we timing the i/o? */
 //#define IO_SPEED_MEASUREMENT
 
+/**
+ * @brief Return the deflate level to use for a field written in parallel.
+ *
+ * @param e The #engine we are writing from.
+ * @param props The #io_props of the field to write.
+ * @param N_total The total number of particles to write in this array.
+ * @param lossy_level The #compression_levels to apply to this field.
+ *
+ * @return The deflate level, 0 if the dataset is not compressed.
+ */
+static int parallel_io_deflate_level(const struct engine* e,
+                                     const struct io_props* props,
+                                     long long N_total,
+                                     const enum compression_levels lossy_level) {
+#ifdef HDF5_PARALLEL_IO_HAVE_FILTERS
+  if (N_total == 0) return 0;
+  return io_compression_deflate_level(e->output_options, props, lossy_level,
+                                      e->snapshot_compression);
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief Return the number of particles per chunk of a compressed dataset.
+ *
+ * @param N_total The total number of particles to write in this array.
+ */
+static long long parallel_io_chunk_size(long long N_total) {
+  return min(N_total, (long long)HDF5_PARALLEL_IO_CHUNK_SIZE);
+}
+
 /**
  * @brief Reads a chunk of data from an open HDF5 dataset
  *
  * @param h_data The HDF5 dataset to write to.
  * @param h_plist_id the parallel HDF5 properties.
+ * @param tp The #threadpool used to convert the data.
  * @param props The #io_props of the field to read.
  * @param N The number of particles to write.
  * @param offset Offset in the array where this mpi task starts writing.
@@ -86,6 +129,7 @@
  * @param a The current value of the scale-factor.
  */
 void read_array_parallel_chunk(hid_t h_data, hid_t h_plist_id,
+                               struct threadpool* tp,
                                const struct io_props props, size_t N,
                                long long offset,
                                const struct unit_system* internal_units,
@@ -94,7 +138,6 @@ void read_array_parallel_chunk(hid_t h_data, hid_t h_plist_id,
                                double a) {
 
   const size_t typeSize = io_sizeof_type(props.type);
-  const size_t copySize = typeSize * props.dimension;
   const size_t num_elements = N * props.dimension;
 
   /* Can't handle writes of more than 2GB */
@@ -136,88 +179,9 @@ void read_array_parallel_chunk(hid_t h_data, hid_t h_plist_id,
                               h_filespace, h_plist_id, temp);
   if (h_err < 0) error("Error while reading data array '%s'.", props.name);
 
-  /* Unit conversion if necessary */
-  const double factor =
-      units_conversion_factor(ic_units, internal_units, props.units);
-  if (factor != 1.) {
-
-    /* message("Converting ! factor=%e", factor); */
-
-    if (io_is_double_precision(props.type)) {
-      double* temp_d = (double*)temp;
-      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= factor;
-    } else {
-      float* temp_f = (float*)temp;
-
-#ifdef SWIFT_DEBUG_CHECKS
-      float maximum = 0.;
-      float minimum = FLT_MAX;
-#endif
-
-      /* Loop that converts the Units */
-      for (size_t i = 0; i < num_elements; ++i) {
-
-#ifdef SWIFT_DEBUG_CHECKS
-        /* Find the absolute minimum and maximum values */
-        const float abstemp_f = fabsf(temp_f[i]);
-        if (abstemp_f != 0.f) {
-          maximum = max(maximum, abstemp_f);
-          minimum = min(minimum, abstemp_f);
-        }
-#endif
-
-        /* Convert the float units */
-        temp_f[i] *= factor;
-      }
-
-#ifdef SWIFT_DEBUG_CHECKS
-      /* The two possible errors: larger than float or smaller
-       * than float precission. */
-      if (factor * maximum > FLT_MAX) {
-        error("Unit conversion results in numbers larger than floats");
-      } else if (factor * minimum < FLT_MIN) {
-        error("Numbers smaller than float precision");
-      }
-#endif
-    }
-  }
-
-  /* Clean-up h if necessary */
-  const float h_factor_exp = units_h_factor(internal_units, props.units);
-  if (cleanup_h && h_factor_exp != 0.f) {
-
-    /* message("Multipltying '%s' by h^%f=%f", props.name, h_factor_exp,
-     * h_factor); */
-
-    if (io_is_double_precision(props.type)) {
-      double* temp_d = (double*)temp;
-      const double h_factor = pow(h, h_factor_exp);
-      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= h_factor;
-    } else {
-      float* temp_f = (float*)temp;
-      const float h_factor = pow(h, h_factor_exp);
-      for (size_t i = 0; i < num_elements; ++i) temp_f[i] *= h_factor;
-    }
-  }
-
-  /* Clean-up a if necessary */
-  if (cleanup_sqrt_a && a != 1. && (strcmp(props.name, "Velocities") == 0)) {
-
-    if (io_is_double_precision(props.type)) {
-      double* temp_d = (double*)temp;
-      const double vel_factor = sqrt(a);
-      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= vel_factor;
-    } else {
-      float* temp_f = (float*)temp;
-      const float vel_factor = sqrt(a);
-      for (size_t i = 0; i < num_elements; ++i) temp_f[i] *= vel_factor;
-    }
-  }
-
-  /* Copy temporary buffer to particle data */
-  char* temp_c = (char*)temp;
-  for (size_t i = 0; i < N; ++i)
-    memcpy(props.field + i * props.partSize, &temp_c[i * copySize], copySize);
+  /* Convert the data and copy it into the particles */
+  io_convert_read_buffer(tp, temp, props, N, internal_units, ic_units,
+                         cleanup_h, cleanup_sqrt_a, h, a);
 
   /* Free and close everything */
   free(temp);
@@ -229,6 +193,7 @@ void read_array_parallel_chunk(hid_t h_data, hid_t h_plist_id,
  * @brief Reads a data array from a given HDF5 group.
  *
  * @param grp The group from which to read.
+ * @param tp The #threadpool used to convert the data.
  * @param props The #io_props of the field to read.
  * @param N The number of particles on that rank.
  * @param N_total The total number of particles.
@@ -242,7 +207,8 @@ void read_array_parallel_chunk(hid_t h_data, hid_t h_plist_id,
  * @param h The value of the reduced Hubble constant to use for cleaning.
  * @param a The current value of the scale-factor.
  */
-void read_array_parallel(hid_t grp, struct io_props props, size_t N,
+void read_array_parallel(hid_t grp, struct threadpool* tp,
+                         struct io_props props, size_t N,
                          long long N_total, int mpi_rank, long long offset,
                          const struct unit_system* internal_units,
                          const struct unit_system* ic_units, int cleanup_h,
@@ -335,8 +301,8 @@ void read_array_parallel(hid_t grp, struct io_props props, size_t N,
 
     /* Write the first chunk */
     const size_t this_chunk = (N > max_chunk_size) ? max_chunk_size : N;
-    read_array_parallel_chunk(h_data, h_plist_id, props, this_chunk, offset,
-                              internal_units, ic_units, cleanup_h,
+    read_array_parallel_chunk(h_data, h_plist_id, tp, props, this_chunk,
+                              offset, internal_units, ic_units, cleanup_h,
                               cleanup_sqrt_a, h, a);
 
     /* Compute how many items are left */
@@ -379,11 +345,13 @@ void read_array_parallel(hid_t grp, struct io_props props, size_t N,
  * @param partTypeGroupName The name of the group we are writing to.
  * @param props The #io_props of the field to write.
  * @param N_total The total number of particles to write in this array.
+ * @param lossy_level The #compression_levels to apply to this field.
  * @param snapshot_units The units used for the data in this snapshot.
  */
 void prepare_array_parallel(struct engine* e, hid_t grp, const char* fileName,
                             FILE* xmfFile, char* partTypeGroupName,
                             struct io_props props, long long N_total,
+                            const enum compression_levels lossy_level,
                             const struct unit_system* snapshot_units) {
 
   /* Create data space */
@@ -391,6 +359,10 @@ void prepare_array_parallel(struct engine* e, hid_t grp, const char* fileName,
   if (h_space < 0)
     error("Error while creating data space for field '%s'.", props.name);
 
+  /* Are we compressing this field? */
+  const int deflate_level =
+      parallel_io_deflate_level(e, &props, N_total, lossy_level);
+
   int rank = 0;
   hsize_t shape[2];
   hsize_t chunk_shape[2];
@@ -398,39 +370,54 @@ void prepare_array_parallel(struct engine* e, hid_t grp, const char* fileName,
     rank = 2;
     shape[0] = N_total;
     shape[1] = props.dimension;
-    chunk_shape[0] = 1 << 20; /* Just a guess...*/
+    chunk_shape[0] = parallel_io_chunk_size(N_total);
     chunk_shape[1] = props.dimension;
   } else {
     rank = 1;
     shape[0] = N_total;
     shape[1] = 0;
-    chunk_shape[0] = 1 << 20; /* Just a guess...*/
+    chunk_shape[0] = parallel_io_chunk_size(N_total);
     chunk_shape[1] = 0;
   }
 
-  /* Make sure the chunks are not larger than the dataset */
-  if ((long long)chunk_shape[0] > N_total) chunk_shape[0] = N_total;
-
   /* Change shape of data space */
   hid_t h_err = H5Sset_extent_simple(h_space, rank, shape, NULL);
   if (h_err < 0)
     error("Error while changing data space shape for field '%s'.", props.name);
 
-  /* Create property list for collective dataset write.    */
-  const hid_t h_plist_id = H5Pcreate(H5P_DATASET_XFER);
-  H5Pset_dxpl_mpio(h_plist_id, H5FD_MPIO_COLLECTIVE);
+  /* Dataset properties */
+  const hid_t h_prop = H5Pcreate(H5P_DATASET_CREATE);
+
+  /* Only compressed datasets are chunked. The ranks then write whole chunks
+   * (see write_array_parallel_aligned()). */
+  if (deflate_level > 0) {
+
+    /* Set chunk size */
+    h_err = H5Pset_chunk(h_prop, rank, chunk_shape);
+    if (h_err < 0)
+      error("Error while setting chunk size (%llu, %llu) for field '%s'.",
+            chunk_shape[0], chunk_shape[1], props.name);
+
+    /* All the chunks are written, no need for fill values */
+    h_err = H5Pset_fill_time(h_prop, H5D_FILL_TIME_NEVER);
+    if (h_err < 0)
+      error("Error while setting fill time for field '%s'.", props.name);
 
-  /* Set chunk size */
-  /* h_err = H5Pset_chunk(h_prop, rank, chunk_shape); */
-  /* if (h_err < 0) { */
-  /*   error("Error while setting chunk size (%llu, %llu) for field '%s'.", */
-  /*         chunk_shape[0], chunk_shape[1], props.name); */
-  /* } */
+    /* Impose data compression */
+    h_err = H5Pset_shuffle(h_prop);
+    if (h_err < 0)
+      error("Error while setting shuffling options for field '%s'.",
+            props.name);
+
+    h_err = H5Pset_deflate(h_prop, deflate_level);
+    if (h_err < 0)
+      error("Error while setting compression options for field '%s'.",
+            props.name);
+  }
 
   /* Create dataset */
-  const hid_t h_data =
-      H5Dcreate(grp, props.name, io_hdf5_type(props.type), h_space, H5P_DEFAULT,
-                H5P_DEFAULT, H5P_DEFAULT);
+  const hid_t h_data = H5Dcreate(grp, props.name, io_hdf5_type(props.type),
+                                 h_space, H5P_DEFAULT, h_prop, H5P_DEFAULT);
   if (h_data < 0) error("Error while creating dataspace '%s'.", props.name);
 
   /* Write unit conversion factors for this data set */
@@ -468,63 +455,35 @@ void prepare_array_parallel(struct engine* e, hid_t grp, const char* fileName,
   /* Write the full description */
   io_write_attribute_s(h_data, "Description", props.description);
 
+  /* Write the lossy compression applied, if any */
+  io_compression_write_attributes(e->output_options, h_data, &props,
+                                  lossy_level);
+
   /* Add a line to the XMF */
   if (xmfFile != NULL)
     xmf_write_line(xmfFile, fileName, partTypeGroupName, props.name, N_total,
                    props.dimension, props.type);
 
   /* Close everything */
-  H5Pclose(h_plist_id);
+  H5Pclose(h_prop);
   H5Dclose(h_data);
   H5Sclose(h_space);
 }
 
 /**
- * @brief Writes a chunk of data in an open HDF5 dataset
+ * @brief Writes a buffer of converted data to an open HDF5 dataset
+ *
+ * This is a collective operation.
  *
- * @param e The #engine we are writing from.
  * @param h_data The HDF5 dataset to write to.
  * @param props The #io_props of the field to write.
+ * @param temp The buffer of converted data.
  * @param N The number of particles to write.
  * @param offset Offset in the array where this mpi task starts writing.
- * @param internal_units The #unit_system used internally.
- * @param snapshot_units The #unit_system used in the snapshots.
  */
-void write_array_parallel_chunk(struct engine* e, hid_t h_data,
-                                const struct io_props props, size_t N,
-                                long long offset,
-                                const struct unit_system* internal_units,
-                                const struct unit_system* snapshot_units) {
-
-  const size_t typeSize = io_sizeof_type(props.type);
-  const size_t num_elements = N * props.dimension;
-
-  /* Can't handle writes of more than 2GB */
-  if (N * props.dimension * typeSize > HDF5_PARALLEL_IO_MAX_BYTES)
-    error("Dataset too large to be written in one pass!");
-
-  /* message("Writing '%s' array...", props.name); */
-
-  /* Allocate temporary buffer */
-  void* temp = NULL;
-  if (swift_memalign("writebuff", (void**)&temp, IO_BUFFER_ALIGNMENT,
-                     num_elements * typeSize) != 0)
-    error("Unable to allocate temporary i/o buffer");
-
-#ifdef IO_SPEED_MEASUREMENT
-  MPI_Barrier(MPI_COMM_WORLD);
-  ticks tic = getticks();
-#endif
-
-  /* Copy the particle data to the temporary buffer */
-  io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
-
-#ifdef IO_SPEED_MEASUREMENT
-  MPI_Barrier(MPI_COMM_WORLD);
-  if (engine_rank == 0)
-    message("Copying for '%s' took %.3f %s.", props.name,
-            clocks_from_ticks(getticks() - tic), clocks_getunit());
-#endif
+void write_array_parallel_buffer(hid_t h_data, const struct io_props props,
+                                 const void* temp, size_t N,
+                                 long long offset) {
 
   /* Create data space */
   const hid_t h_memspace = H5Screate(H5S_SIMPLE);
@@ -574,7 +533,7 @@ void write_array_parallel_chunk(struct engine* e, hid_t h_data,
 
 #ifdef IO_SPEED_MEASUREMENT
   MPI_Barrier(MPI_COMM_WORLD);
-  tic = getticks();
+  ticks tic = getticks();
 #endif
 
   /* Write temporary buffer to HDF5 dataspace */
@@ -586,7 +545,8 @@ void write_array_parallel_chunk(struct engine* e, hid_t h_data,
   MPI_Barrier(MPI_COMM_WORLD);
   ticks toc = getticks();
   float ms = clocks_from_ticks(toc - tic);
-  int megaBytes = N * props.dimension * typeSize / (1024 * 1024);
+  int megaBytes = N * props.dimension * io_sizeof_type(props.type) /
+                  (1024 * 1024);
   int total = 0;
   MPI_Reduce(&megaBytes, &total, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
   if (engine_rank == 0)
@@ -594,13 +554,201 @@ void write_array_parallel_chunk(struct engine* e, hid_t h_data,
             props.name, total, ms, clocks_getunit(), total / (ms / 1000.));
 #endif
 
-  /* Free and close everything */
-  swift_free("writebuff", temp);
+  /* Close everything */
   H5Pclose(h_plist_id);
   H5Sclose(h_memspace);
   H5Sclose(h_filespace);
 }
 
+/**
+ * @brief Writes a chunk of data in an open HDF5 dataset
+ *
+ * @param e The #engine we are writing from.
+ * @param h_data The HDF5 dataset to write to.
+ * @param props The #io_props of the field to write.
+ * @param N The number of particles to write.
+ * @param offset Offset in the array where this mpi task starts writing.
+ * @param lossy_level The #compression_levels to apply to this field.
+ * @param internal_units The #unit_system used internally.
+ * @param snapshot_units The #unit_system used in the snapshots.
+ */
+void write_array_parallel_chunk(struct engine* e, hid_t h_data,
+                                const struct io_props props, size_t N,
+                                long long offset,
+                                const enum compression_levels lossy_level,
+                                const struct unit_system* internal_units,
+                                const struct unit_system* snapshot_units) {
+
+  const size_t typeSize = io_sizeof_type(props.type);
+  const size_t num_elements = N * props.dimension;
+
+  /* Can't handle writes of more than 2GB */
+  if (N * props.dimension * typeSize > HDF5_PARALLEL_IO_MAX_BYTES)
+    error("Dataset too large to be written in one pass!");
+
+  /* message("Writing '%s' array...", props.name); */
+
+  /* Allocate temporary buffer */
+  void* temp = NULL;
+  if (swift_memalign("writebuff", (void**)&temp, IO_BUFFER_ALIGNMENT,
+                     num_elements * typeSize) != 0)
+    error("Unable to allocate temporary i/o buffer");
+
+#ifdef IO_SPEED_MEASUREMENT
+  MPI_Barrier(MPI_COMM_WORLD);
+  ticks tic = getticks();
+#endif
+
+  /* Copy the particle data to the temporary buffer */
+  io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
+  io_compression_apply(e->output_options, temp, &props, N, lossy_level);
+
+#ifdef IO_SPEED_MEASUREMENT
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (engine_rank == 0)
+    message("Copying for '%s' took %.3f %s.", props.name,
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+#endif
+
+  /* Write it to the file */
+  write_array_parallel_buffer(h_data, props, temp, N, offset);
+
+  /* Free everything */
+  swift_free("writebuff", temp);
+}
+
+/**
+ * @brief Writes a compressed data array in an open HDF5 dataset in a single
+ * collective pass where every rank writes whole chunks.
+ *
+ * Parallel-HDF5 can write filtered datasets collectively but the chunks
+ * touched by several ranks must be gathered on one of them and, if they are
+ * written in different passes, read back and re-compressed. To avoid this,
+ * the ranks first exchange the particles at the edges of their section of
+ * the array such that each of them holds a range starting and ending on a
+ * chunk boundary. This only involves neighbouring ranks unless some of them
+ * hold less than a chunk.
+ *
+ * @param e The #engine we are writing from.
+ * @param h_data The HDF5 dataset to write to.
+ * @param props The #io_props of the field to write.
+ * @param N The number of particles to write.
+ * @param N_total Total number of particles across all cores.
+ * @param offset Offset in the array where this mpi task starts writing.
+ * @param lossy_level The #compression_levels to apply to this field.
+ * @param internal_units The #unit_system used internally.
+ * @param snapshot_units The #unit_system used in the snapshots.
+ *
+ * @return 1 if the data was written, 0 if the sections are too large to be
+ * written in one pass, in which case nothing was done. The same value is
+ * returned on all ranks.
+ */
+int write_array_parallel_aligned(struct engine* e, hid_t h_data,
+                                 const struct io_props props, size_t N,
+                                 long long N_total, long long offset,
+                                 const enum compression_levels lossy_level,
+                                 const struct unit_system* internal_units,
+                                 const struct unit_system* snapshot_units) {
+
+  const int nr_nodes = e->nr_nodes;
+  const int nodeID = e->nodeID;
+  const size_t copySize = io_sizeof_type(props.type) * props.dimension;
+  const long long chunk = parallel_io_chunk_size(N_total);
+
+  /* Where does everybody start writing? */
+  long long* offsets = NULL;
+  long long* aligned = NULL;
+  if ((offsets = (long long*)malloc((nr_nodes + 1) * sizeof(long long))) ==
+          NULL ||
+      (aligned = (long long*)malloc((nr_nodes + 1) * sizeof(long long))) ==
+          NULL)
+    error("Unable to allocate the offsets of the ranks.");
+  MPI_Allgather(&offset, 1, MPI_LONG_LONG_INT, offsets, 1, MPI_LONG_LONG_INT,
+                MPI_COMM_WORLD);
+  offsets[nr_nodes] = N_total;
+
+  /* Move all the boundaries to the next chunk boundary. Rank k then writes
+   * [aligned[k], aligned[k + 1]). */
+  int needs_exchange = 0;
+  size_t max_count = 0;
+  for (int k = 0; k <= nr_nodes; k++) {
+    aligned[k] = min(((offsets[k] + chunk - 1) / chunk) * chunk, N_total);
+    if (aligned[k] != offsets[k]) needs_exchange = 1;
+    if (k > 0) {
+      max_count = max(max_count, (size_t)(offsets[k] - offsets[k - 1]));
+      max_count = max(max_count, (size_t)(aligned[k] - aligned[k - 1]));
+    }
+  }
+
+  /* Can we do this in one go? */
+  if (max_count * copySize > HDF5_PARALLEL_IO_MAX_BYTES) {
+    free(offsets);
+    free(aligned);
+    return 0;
+  }
+
+  /* Convert our section of the array */
+  void* temp = NULL;
+  if (swift_memalign("writebuff", (void**)&temp, IO_BUFFER_ALIGNMENT,
+                     N * copySize) != 0)
+    error("Unable to allocate temporary i/o buffer");
+  io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
+  io_compression_apply(e->output_options, temp, &props, N, lossy_level);
+
+  const long long aligned_offset = aligned[nodeID];
+  const size_t aligned_N = aligned[nodeID + 1] - aligned[nodeID];
+
+  if (needs_exchange) {
+
+    /* Send what falls outside our chunks to the rank writing them */
+    int* counts = NULL;
+    if ((counts = (int*)malloc(4 * nr_nodes * sizeof(int))) == NULL)
+      error("Unable to allocate the exchange counts.");
+    int* sendcounts = counts;
+    int* senddispls = counts + nr_nodes;
+    int* recvcounts = counts + 2 * nr_nodes;
+    int* recvdispls = counts + 3 * nr_nodes;
+
+    for (int k = 0; k < nr_nodes; k++) {
+
+      /* Overlap of our section with the chunks of rank k */
+      long long lo = max(offset, aligned[k]);
+      long long hi = min(offset + (long long)N, aligned[k + 1]);
+      sendcounts[k] = (hi > lo) ? (hi - lo) * copySize : 0;
+      senddispls[k] = (hi > lo) ? (lo - offset) * copySize : 0;
+
+      /* Overlap of the section of rank k with our chunks */
+      lo = max(offsets[k], aligned_offset);
+      hi = min(offsets[k + 1], aligned[nodeID + 1]);
+      recvcounts[k] = (hi > lo) ? (hi - lo) * copySize : 0;
+      recvdispls[k] = (hi > lo) ? (lo - aligned_offset) * copySize : 0;
+    }
+
+    void* aligned_temp = NULL;
+    if (swift_memalign("writebuff", (void**)&aligned_temp, IO_BUFFER_ALIGNMENT,
+                       aligned_N * copySize) != 0)
+      error("Unable to allocate temporary i/o buffer");
+
+    if (MPI_Alltoallv(temp, sendcounts, senddispls, MPI_BYTE, aligned_temp,
+                      recvcounts, recvdispls, MPI_BYTE,
+                      MPI_COMM_WORLD) != MPI_SUCCESS)
+      error("Failed to exchange the chunk edges of field '%s'.", props.name);
+
+    swift_free("writebuff", temp);
+    temp = aligned_temp;
+    free(counts);
+  }
+
+  /* Write it to the file */
+  write_array_parallel_buffer(h_data, props, temp, aligned_N, aligned_offset);
+
+  /* Free everything */
+  swift_free("writebuff", temp);
+  free(offsets);
+  free(aligned);
+  return 1;
+}
+
 /**
  * @brief Writes a data array in given HDF5 group.
  *
@@ -614,15 +762,19 @@ void write_array_parallel_chunk(struct engine* e, hid_t h_data,
  * @param N_total Total number of particles across all cores.
  * @param mpi_rank The rank of this node.
  * @param offset Offset in the array where this mpi task starts writing.
+ * @param lossy_level The #compression_levels to apply to this field.
  * @param internal_units The #unit_system used internally.
  * @param snapshot_units The #unit_system used in the snapshots.
+ *
+ * @return The number of bytes used in the file by this array.
  */
-void write_array_parallel(struct engine* e, hid_t grp, char* fileName,
-                          char* partTypeGroupName, struct io_props props,
-                          size_t N, long long N_total, int mpi_rank,
-                          long long offset,
-                          const struct unit_system* internal_units,
-                          const struct unit_system* snapshot_units) {
+hsize_t write_array_parallel(struct engine* e, hid_t grp, char* fileName,
+                             char* partTypeGroupName, struct io_props props,
+                             size_t N, long long N_total, int mpi_rank,
+                             long long offset,
+                             const enum compression_levels lossy_level,
+                             const struct unit_system* internal_units,
+                             const struct unit_system* snapshot_units) {
 
   const size_t typeSize = io_sizeof_type(props.type);
 
@@ -634,9 +786,15 @@ void write_array_parallel(struct engine* e, hid_t grp, char* fileName,
   const hid_t h_data = H5Dopen(grp, props.name, H5P_DEFAULT);
   if (h_data < 0) error("Error while opening dataset '%s'.", props.name);
 
+  /* Compressed arrays are written in whole chunks if possible */
+  char redo = 1;
+  if (parallel_io_deflate_level(e, &props, N_total, lossy_level) > 0)
+    redo = !write_array_parallel_aligned(e, h_data, props, N, N_total, offset,
+                                         lossy_level, internal_units,
+                                         snapshot_units);
+
   /* Given the limitations of ROM-IO we will need to write the data in chunk of
      HDF5_PARALLEL_IO_MAX_BYTES bytes per node until all the nodes are done. */
-  char redo = 1;
   while (redo) {
 
     /* Maximal number of elements */
@@ -646,7 +804,7 @@ void write_array_parallel(struct engine* e, hid_t grp, char* fileName,
     /* Write the first chunk */
     const size_t this_chunk = (N > max_chunk_size) ? max_chunk_size : N;
     write_array_parallel_chunk(e, h_data, props, this_chunk, offset,
-                               internal_units, snapshot_units);
+                               lossy_level, internal_units, snapshot_units);
 
     /* Compute how many items are left */
     if (N > max_chunk_size) {
@@ -673,6 +831,9 @@ void write_array_parallel(struct engine* e, hid_t grp, char* fileName,
       message("Need to redo one iteration for array '%s'", props.name);
   }
 
+  /* How much space did we use? */
+  const hsize_t storage_size = H5Dget_storage_size(h_data);
+
   /* Close everything */
   H5Dclose(h_data);
 
@@ -682,6 +843,8 @@ void write_array_parallel(struct engine* e, hid_t grp, char* fileName,
     message("'%s' took %.3f %s.", props.name,
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 #endif
+
+  return storage_size;
 }
 
 /**
@@ -938,6 +1101,10 @@ void read_ic_parallel(char* fileName, const struct unit_system* internal_units,
   /* message("BoxSize = %lf", dim[0]); */
   /* message("NumPart = [%zd, %zd] Total = %zd", *Ngas, Ndm, *Ngparts); */
 
+  /* Let's initialise a bit of thread parallelism here */
+  struct threadpool tp;
+  threadpool_init(&tp, n_threads);
+
   /* Loop over all particle types */
   for (int ptype = 0; ptype < swift_type_count; ptype++) {
 
@@ -1015,7 +1182,7 @@ void read_ic_parallel(char* fileName, const struct unit_system* internal_units,
         if (remap_ids && strcmp(list[i].name, "ParticleIDs") == 0) continue;
 
         /* Read array. */
-        read_array_parallel(h_grp, list[i], Nparticles, N_total[ptype],
+        read_array_parallel(h_grp, &tp, list[i], Nparticles, N_total[ptype],
                             mpi_rank, offset[ptype], internal_units, ic_units,
                             cleanup_h, cleanup_sqrt_a, h, a);
       }
@@ -1029,10 +1196,6 @@ void read_ic_parallel(char* fileName, const struct unit_system* internal_units,
 
   if (!dry_run && with_gravity) {
 
-    /* Let's initialise a bit of thread parallelism here */
-    struct threadpool tp;
-    threadpool_init(&tp, n_threads);
-
     /* Prepare the DM particles */
     io_prepare_dm_gparts(&tp, *gparts, Ndm);
 
@@ -1059,10 +1222,10 @@ void read_ic_parallel(char* fileName, const struct unit_system* internal_units,
       io_duplicate_black_holes_gparts(
           &tp, *bparts, *gparts, *Nblackholes,
           Ndm + Ndm_background + *Ngas + *Nsinks + *Nstars);
-
-    threadpool_clean(&tp);
   }
 
+  threadpool_clean(&tp);
+
   /* message("Done Reading particles..."); */
 
   /* Clean up */
@@ -1317,13 +1480,15 @@ void prepare_file(struct engine* e, const char* fileName,
     for (int i = 0; i < num_fields; ++i) {
 
       /* Did the user cancel this field? */
-      const int should_write = output_options_should_write_field(
-          output_options, current_selection_name, list[i].name,
-          (enum part_type)ptype, compression_level_current_default);
+      const enum compression_levels compression_level =
+          output_options_should_write_field(
+              output_options, current_selection_name, list[i].name,
+              (enum part_type)ptype, compression_level_current_default);
 
-      if (should_write) {
+      if (compression_level != compression_do_not_write) {
         prepare_array_parallel(e, h_grp, fileName, xmfFile, partTypeGroupName,
-                               list[i], N_total[ptype], snapshot_units);
+                               list[i], N_total[ptype], compression_level,
+                               snapshot_units);
         num_fields_written++;
       }
     }
@@ -1442,6 +1607,18 @@ void write_output_parallel(struct engine* e,
   ticks tic = getticks();
 #endif
 
+  /* Volume of particle data written before and after compression */
+  const ticks tic_write = getticks();
+  hsize_t raw_bytes = 0, stored_bytes = 0;
+
+#ifndef HDF5_PARALLEL_IO_HAVE_FILTERS
+  if (e->snapshot_compression > 0 && e->snapshot_output_count == 0 &&
+      mpi_rank == 0)
+    message(
+        "WARNING: Snapshot compression requires parallel-HDF5 1.10.3 or "
+        "later. Writing uncompressed data.");
+#endif
+
   /* File names */
   char fileName[FILENAME_BUFFER_SIZE];
   char xmfFileName[FILENAME_BUFFER_SIZE];
@@ -1495,11 +1672,17 @@ void write_output_parallel(struct engine* e,
     if (h_grp_cells < 0) error("Error while creating cells group");
   }
 
+  /* Name of the stand-alone cell index file, if requested */
+  char indexFileName[1024];
+  if (e->snapshot_cell_index_file)
+    io_get_cell_index_filename(indexFileName, fileName);
+
   /* Write the location of the particles in the arrays */
   io_write_cell_offsets(h_grp_cells, e->s->cdim, e->s->dim, e->s->pos_dithering,
                         e->s->cells_top, e->s->nr_cells, e->s->width, mpi_rank,
                         /*distributed=*/0, N_total, offset, numFields,
-                        internal_units, snapshot_units);
+                        internal_units, snapshot_units,
+                        e->snapshot_cell_index_file ? indexFileName : NULL);
 
   /* Close everything */
   if (mpi_rank == 0) {
@@ -1886,14 +2069,19 @@ void write_output_parallel(struct engine* e,
     for (int i = 0; i < num_fields; ++i) {
 
       /* Did the user cancel this field? */
-      const int should_write = output_options_should_write_field(
-          output_options, current_selection_name, list[i].name,
-          (enum part_type)ptype, compression_level_current_default);
-
-      if (should_write)
-        write_array_parallel(e, h_grp, fileName, partTypeGroupName, list[i],
-                             Nparticles, N_total[ptype], mpi_rank,
-                             offset[ptype], internal_units, snapshot_units);
+      const enum compression_levels compression_level =
+          output_options_should_write_field(
+              output_options, current_selection_name, list[i].name,
+              (enum part_type)ptype, compression_level_current_default);
+
+      if (compression_level != compression_do_not_write) {
+        stored_bytes += write_array_parallel(
+            e, h_grp, fileName, partTypeGroupName, list[i], Nparticles,
+            N_total[ptype], mpi_rank, offset[ptype], compression_level,
+            internal_units, snapshot_units);
+        raw_bytes += N_total[ptype] * list[i].dimension *
+                     io_sizeof_type(list[i].type);
+      }
     }
 
     /* Free temporary array */
@@ -1953,6 +2141,17 @@ void write_output_parallel(struct engine* e,
             clocks_getunit());
 #endif
 
+  if (e->verbose && mpi_rank == 0) {
+    const double seconds = clocks_from_ticks(getticks() - tic_write) / 1000.;
+    message(
+        "Wrote %.3f MB of particle data (%.3f MB before compression, ratio "
+        "%.2f) at %.3f MB/s (%.3f MB/s before compression).",
+        stored_bytes / (1024. * 1024.), raw_bytes / (1024. * 1024.),
+        stored_bytes > 0 ? (double)raw_bytes / stored_bytes : 1.,
+        stored_bytes / (1024. * 1024.) / seconds,
+        raw_bytes / (1024. * 1024.) / seconds);
+  }
+
   e->snapshot_output_count++;
   if (e->snapshot_invoke_stf) e->stf_output_count++;
 }
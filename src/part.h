@@ -45,6 +45,16 @@ struct threadpool;
 #define bpart_align 128
 #define sink_align 128
 
+/* Unpadded gparts are only aligned on their natural boundary, instead of
+ * being padded up to a multiple of SWIFT_STRUCT_ALIGNMENT */
+#ifdef GRAVITY_UNPADDED_GPARTS
+#define SWIFT_GPART_ALIGN
+#define memswap_gpart(a, b) memswap_unaligned(a, b, sizeof(struct gpart))
+#else
+#define SWIFT_GPART_ALIGN SWIFT_STRUCT_ALIGN
+#define memswap_gpart(a, b) memswap(a, b, sizeof(struct gpart))
+#endif
+
 /* Import the right hydro particle definition */
 #if defined(MINIMAL_SPH)
 #include "./hydro/Minimal/hydro_part.h"
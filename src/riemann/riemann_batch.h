@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2020 The SWIFT collaboration
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_RIEMANN_BATCH_H
+#define SWIFT_RIEMANN_BATCH_H
+
+/* Local headers. */
+#include "align.h"
+#include "inline.h"
+
+/*! Maximal number of Riemann problems solved together */
+#define RIEMANN_BATCH_SIZE 128
+
+/**
+ * @brief A set of independent Riemann problems, stored as a structure of
+ * arrays so that the batched solvers can process them in SIMD lanes.
+ *
+ * Each problem is the same as the input of riemann_solve_for_flux(): a left
+ * and right state (density, velocity, pressure), the unit normal of the
+ * interface and the velocity of the interface. The solution is written to
+ * #flux.
+ */
+struct riemann_batch {
+
+  /*! Left states */
+  float WL[5][RIEMANN_BATCH_SIZE] SWIFT_CACHE_ALIGN;
+
+  /*! Right states */
+  float WR[5][RIEMANN_BATCH_SIZE] SWIFT_CACHE_ALIGN;
+
+  /*! Unit vectors of the interfaces */
+  float n[3][RIEMANN_BATCH_SIZE] SWIFT_CACHE_ALIGN;
+
+  /*! Velocities of the interfaces */
+  float vij[3][RIEMANN_BATCH_SIZE] SWIFT_CACHE_ALIGN;
+
+  /*! Fluxes through the interfaces */
+  float flux[5][RIEMANN_BATCH_SIZE] SWIFT_CACHE_ALIGN;
+
+  /*! Number of problems in the batch */
+  int count;
+};
+
+/**
+ * @brief Append a Riemann problem to a batch.
+ *
+ * The caller is responsible for solving the batch before it overflows.
+ *
+ * @param b The #riemann_batch.
+ * @param WL Left state variables.
+ * @param WR Right state variables.
+ * @param n Unit vector of the interface.
+ * @param vij Velocity of the interface.
+ * @return The index of the problem in the batch.
+ */
+__attribute__((always_inline)) INLINE static int riemann_batch_add(
+    struct riemann_batch *restrict b, const float *WL, const float *WR,
+    const float *n, const float *vij) {
+
+  const int i = b->count++;
+  for (int k = 0; k < 5; k++) {
+    b->WL[k][i] = WL[k];
+    b->WR[k][i] = WR[k];
+  }
+  for (int k = 0; k < 3; k++) {
+    b->n[k][i] = n[k];
+    b->vij[k][i] = vij[k];
+  }
+  return i;
+}
+
+/**
+ * @brief Copy one of the problems of a batch to scalar arrays.
+ *
+ * @param b The #riemann_batch.
+ * @param i Index of the problem.
+ * @param WL (return) Left state variables.
+ * @param WR (return) Right state variables.
+ * @param n (return) Unit vector of the interface.
+ * @param vij (return) Velocity of the interface.
+ */
+__attribute__((always_inline)) INLINE static void riemann_batch_get(
+    const struct riemann_batch *restrict b, const int i, float *WL, float *WR,
+    float *n, float *vij) {
+
+  for (int k = 0; k < 5; k++) {
+    WL[k] = b->WL[k][i];
+    WR[k] = b->WR[k][i];
+  }
+  for (int k = 0; k < 3; k++) {
+    n[k] = b->n[k][i];
+    vij[k] = b->vij[k][i];
+  }
+}
+
+/**
+ * @brief Store the flux of one of the problems of a batch.
+ *
+ * @param b The #riemann_batch.
+ * @param i Index of the problem.
+ * @param totflux Flux through the interface.
+ */
+__attribute__((always_inline)) INLINE static void riemann_batch_set_flux(
+    struct riemann_batch *restrict b, const int i, const float *totflux) {
+
+  for (int k = 0; k < 5; k++) b->flux[k][i] = totflux[k];
+}
+
+#endif /* SWIFT_RIEMANN_BATCH_H */
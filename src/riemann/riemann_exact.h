@@ -39,6 +39,7 @@
 #include "adiabatic_index.h"
 #include "error.h"
 #include "minmax.h"
+#include "riemann_batch.h"
 #include "riemann_checks.h"
 #include "riemann_vacuum.h"
 
@@ -661,4 +662,42 @@ riemann_solve_for_middle_state_flux(const float* Wi, const float* Wj,
 #endif
 }
 
+/**
+ * @brief Solve a batch of Riemann problems for the flux.
+ *
+ * The exact solver iterates a different number of times for every problem, so
+ * there is nothing to gain from running it in SIMD lanes: the problems are
+ * solved one after the other.
+ *
+ * @param b The #riemann_batch.
+ */
+__attribute__((always_inline)) INLINE static void riemann_solve_for_flux_batch(
+    struct riemann_batch* restrict b) {
+
+  for (int i = 0; i < b->count; i++) {
+    float WL[5], WR[5], n[3], vij[3], totflux[5];
+    riemann_batch_get(b, i, WL, WR, n, vij);
+    riemann_solve_for_flux(WL, WR, n, vij, totflux);
+    riemann_batch_set_flux(b, i, totflux);
+  }
+}
+
+/**
+ * @brief Solve a batch of Riemann problems for the middle state flux.
+ *
+ * See riemann_solve_for_flux_batch().
+ *
+ * @param b The #riemann_batch.
+ */
+__attribute__((always_inline)) INLINE static void
+riemann_solve_for_middle_state_flux_batch(struct riemann_batch* restrict b) {
+
+  for (int i = 0; i < b->count; i++) {
+    float WL[5], WR[5], n[3], vij[3], totflux[5];
+    riemann_batch_get(b, i, WL, WR, n, vij);
+    riemann_solve_for_middle_state_flux(WL, WR, n, vij, totflux);
+    riemann_batch_set_flux(b, i, totflux);
+  }
+}
+
 #endif /* SWIFT_RIEMANN_EXACT_H */
@@ -30,6 +30,7 @@
 #include "adiabatic_index.h"
 #include "error.h"
 #include "minmax.h"
+#include "riemann_batch.h"
 #include "riemann_checks.h"
 #include "riemann_vacuum.h"
 
@@ -244,4 +245,309 @@ riemann_solve_for_middle_state_flux(const float *WL, const float *WR,
 #endif
 }
 
+/**
+ * @brief Flag the problems of a batch that the vectorized HLLC solver cannot
+ * handle.
+ *
+ * Problems with a vanishing density or pressure are solved by the scalar
+ * solver. Since the vectorized loop still evaluates them, their densities and
+ * pressures are replaced by unity until riemann_hllc_batch_solve_scalar()
+ * restores them. This keeps the vectorized loop free of divisions by zero.
+ *
+ * @param b The #riemann_batch.
+ * @param scalar (return) Flags of the problems that need the scalar solver.
+ * @param saved (return) Original densities and pressures of those problems.
+ */
+__attribute__((always_inline)) INLINE static void riemann_hllc_batch_mask(
+    struct riemann_batch *restrict b, int *restrict scalar,
+    float saved[4][RIEMANN_BATCH_SIZE]) {
+
+  const int count = b->count;
+  int num_scalar = 0;
+
+  for (int i = 0; i < count; i++) {
+    scalar[i] = (b->WL[0][i] <= 0.0f) | (b->WR[0][i] <= 0.0f) |
+                (b->WL[4][i] <= 0.0f) | (b->WR[4][i] <= 0.0f);
+    num_scalar += scalar[i];
+  }
+
+  for (int i = 0; i < count && num_scalar > 0; i++) {
+    if (!scalar[i]) continue;
+    saved[0][i] = b->WL[0][i];
+    saved[1][i] = b->WL[4][i];
+    saved[2][i] = b->WR[0][i];
+    saved[3][i] = b->WR[4][i];
+    b->WL[0][i] = b->WL[4][i] = b->WR[0][i] = b->WR[4][i] = 1.0f;
+    num_scalar--;
+  }
+}
+
+/**
+ * @brief Solve the problems of a batch that were flagged during the
+ * vectorized HLLC loop with the scalar solver.
+ *
+ * @param b The #riemann_batch.
+ * @param scalar Flags of the problems that need the scalar solver.
+ * @param saved Original densities and pressures, for the problems that were
+ * masked by riemann_hllc_batch_mask().
+ * @param masked Flags of the problems that were masked.
+ * @param middle_state Solve for the middle state flux?
+ */
+__attribute__((always_inline)) INLINE static void
+riemann_hllc_batch_solve_scalar(struct riemann_batch *restrict b,
+                                const int *restrict scalar,
+                                float saved[4][RIEMANN_BATCH_SIZE],
+                                const int *restrict masked,
+                                const int middle_state) {
+
+  /* Gather the indices first: looping over them keeps the compiler from
+     if-converting (and evaluating on every lane) the branchy scalar solver. */
+  int index[RIEMANN_BATCH_SIZE];
+  int num_scalar = 0;
+  for (int i = 0; i < b->count; i++)
+    if (scalar[i]) index[num_scalar++] = i;
+
+  for (int k = 0; k < num_scalar; k++) {
+    const int i = index[k];
+
+    if (masked[i]) {
+      b->WL[0][i] = saved[0][i];
+      b->WL[4][i] = saved[1][i];
+      b->WR[0][i] = saved[2][i];
+      b->WR[4][i] = saved[3][i];
+    }
+
+    float WL[5], WR[5], n[3], vij[3], totflux[5];
+    riemann_batch_get(b, i, WL, WR, n, vij);
+    if (middle_state)
+      riemann_solve_for_middle_state_flux(WL, WR, n, vij, totflux);
+    else
+      riemann_solve_for_flux(WL, WR, n, vij, totflux);
+    riemann_batch_set_flux(b, i, totflux);
+  }
+}
+
+/**
+ * @brief Wave speed estimates of the HLLC solver for one problem of a batch.
+ *
+ * Branch-free equivalent of steps 0-2 of riemann_solve_for_flux(), for
+ * strictly positive densities and pressures.
+ *
+ * @param rhoL Left density.
+ * @param uL Left velocity along the interface normal.
+ * @param PL Left pressure.
+ * @param rhoR Right density.
+ * @param uR Right velocity along the interface normal.
+ * @param PR Right pressure.
+ * @param pstar (return) Pressure estimate in the middle state.
+ * @param SLmuL (return) Left wave speed in the frame of the left state.
+ * @param SRmuR (return) Right wave speed in the frame of the right state.
+ * @param Sstar (return) Contact wave speed.
+ * @return 1 if the states generate vacuum, 0 otherwise.
+ */
+__attribute__((always_inline)) INLINE static int riemann_hllc_batch_speeds(
+    const float rhoL, const float uL, const float PL, const float rhoR,
+    const float uR, const float PR, float *restrict pstar,
+    float *restrict SLmuL, float *restrict SRmuR, float *restrict Sstar) {
+
+  const float aL = sqrtf(hydro_gamma * PL / rhoL);
+  const float aR = sqrtf(hydro_gamma * PR / rhoR);
+
+  /* Vacuum generation, see riemann_is_vacuum() */
+  const int vacuum = (hydro_two_over_gamma_minus_one * aL +
+                          hydro_two_over_gamma_minus_one * aR <=
+                      uR - uL);
+
+  /* STEP 1: pressure estimate */
+  const float rhobar = rhoL + rhoR;
+  const float abar = aL + aR;
+  const float pPVRS = 0.5f * ((PL + PR) - 0.25f * (uR - uL) * rhobar * abar);
+  *pstar = max(0.0f, pPVRS);
+
+  /* STEP 2: wave speed estimates. The argument of the square root is at least
+     1 - (gamma + 1) / (2 gamma) > 0. */
+  const float qL2 = 1.0f + 0.5f * hydro_gamma_plus_one * hydro_one_over_gamma *
+                               (*pstar / PL - 1.0f);
+  const float qR2 = 1.0f + 0.5f * hydro_gamma_plus_one * hydro_one_over_gamma *
+                               (*pstar / PR - 1.0f);
+  const float qL = sqrtf((*pstar > PL) ? qL2 : 1.0f);
+  const float qR = sqrtf((*pstar > PR) ? qR2 : 1.0f);
+  *SLmuL = -aL * qL;
+  *SRmuR = aR * qR;
+  *Sstar = (PR - PL + rhoL * uL * *SLmuL - rhoR * uR * *SRmuR) /
+           (rhoL * *SLmuL - rhoR * *SRmuR);
+
+  return vacuum;
+}
+
+/**
+ * @brief Solve a batch of Riemann problems for the flux.
+ *
+ * Batched version of riemann_solve_for_flux(). The branches of the HLLC
+ * solver are replaced by selections so that the loop over the problems
+ * vectorizes. Problems involving vacuum or vanishing pressures are masked out
+ * of that loop and solved with the scalar solver afterwards; they are rare.
+ *
+ * @param b The #riemann_batch.
+ */
+__attribute__((always_inline)) INLINE static void riemann_solve_for_flux_batch(
+    struct riemann_batch *restrict b) {
+
+  const int count = b->count;
+  int masked[RIEMANN_BATCH_SIZE], scalar[RIEMANN_BATCH_SIZE];
+  float saved[4][RIEMANN_BATCH_SIZE];
+
+#ifdef SWIFT_DEBUG_CHECKS
+  for (int i = 0; i < count; i++) {
+    float WL[5], WR[5], n[3], vij[3];
+    riemann_batch_get(b, i, WL, WR, n, vij);
+    riemann_check_input(WL, WR, n, vij);
+  }
+#endif
+
+  riemann_hllc_batch_mask(b, masked, saved);
+
+  for (int i = 0; i < count; i++) {
+
+    const float n0 = b->n[0][i], n1 = b->n[1][i], n2 = b->n[2][i];
+
+    /* STEP 0: obtain velocity in interface frame */
+    const float rhoL = b->WL[0][i], PL = b->WL[4][i];
+    const float rhoR = b->WR[0][i], PR = b->WR[4][i];
+    const float uL = b->WL[1][i] * n0 + b->WL[2][i] * n1 + b->WL[3][i] * n2;
+    const float uR = b->WR[1][i] * n0 + b->WR[2][i] * n1 + b->WR[3][i] * n2;
+
+    /* STEPS 1 and 2 */
+    float pstar, SLmuL, SRmuR, Sstar;
+    const int vacuum = riemann_hllc_batch_speeds(rhoL, uL, PL, rhoR, uR, PR,
+                                                 &pstar, &SLmuL, &SRmuR, &Sstar);
+    scalar[i] = masked[i] | vacuum;
+
+    /* STEP 3: HLLC flux in a frame moving with the interface velocity.
+       Pick the side of the contact discontinuity the interface is on. */
+    const int left = (Sstar >= 0.0f);
+    const float rho = left ? rhoL : rhoR;
+    const float u = left ? uL : uR;
+    const float P = left ? PL : PR;
+    const float Smu = left ? SLmuL : SRmuR;
+    const float v0 = left ? b->WL[1][i] : b->WR[1][i];
+    const float v1 = left ? b->WL[2][i] : b->WR[2][i];
+    const float v2 = left ? b->WL[3][i] : b->WR[3][i];
+
+    const float rhou = rho * u;
+    const float vv = v0 * v0 + v1 * v1 + v2 * v2;
+    const float e = P / rho * hydro_one_over_gamma_minus_one + 0.5f * vv;
+    const float S = Smu + u;
+
+    /* flux of the state on that side */
+    float f0 = rhou;
+    float f1 = rhou * v0 + P * n0;
+    float f2 = rhou * v1 + P * n1;
+    float f3 = rhou * v2 + P * n2;
+    float f4 = rhou * e + P * u;
+
+    /* star state correction, if the outer wave moves away from the
+       interface */
+    const int star = (left ? -S : S) > 0.0f;
+    const float starfac = Smu / (star ? S - Sstar : 1.0f) - 1.0f;
+    const float rhoS = rho * S;
+    const float rhoSstarfac = star ? rhoS * starfac : 0.0f;
+    const float rhoSSstarmu = star ? rhoS * (Sstar - u) : 0.0f;
+
+    f0 += rhoSstarfac;
+    f1 += rhoSstarfac * v0 + rhoSSstarmu * n0;
+    f2 += rhoSstarfac * v1 + rhoSSstarmu * n1;
+    f3 += rhoSstarfac * v2 + rhoSSstarmu * n2;
+    f4 += rhoSstarfac * e + rhoSSstarmu * (Sstar + P / (rho * Smu));
+
+    /* deboost to lab frame, see riemann_solve_for_flux() */
+    const float w0 = b->vij[0][i], w1 = b->vij[1][i], w2 = b->vij[2][i];
+    const float ww = w0 * w0 + w1 * w1 + w2 * w2;
+    b->flux[4][i] = f4 + w0 * f1 + w1 * f2 + w2 * f3 + 0.5f * ww * f0;
+    b->flux[0][i] = f0;
+    b->flux[1][i] = f1 + w0 * f0;
+    b->flux[2][i] = f2 + w1 * f0;
+    b->flux[3][i] = f3 + w2 * f0;
+  }
+
+  /* Vacuum is always solved exactly by the scalar solver */
+  riemann_hllc_batch_solve_scalar(b, scalar, saved, masked,
+                                  /*middle_state=*/0);
+
+#ifdef SWIFT_DEBUG_CHECKS
+  for (int i = 0; i < count; i++) {
+    float WL[5], WR[5], n[3], vij[3];
+    riemann_batch_get(b, i, WL, WR, n, vij);
+    const float totflux[5] = {b->flux[0][i], b->flux[1][i], b->flux[2][i],
+                              b->flux[3][i], b->flux[4][i]};
+    riemann_check_output(WL, WR, n, vij, totflux);
+  }
+#endif
+}
+
+/**
+ * @brief Solve a batch of Riemann problems for the middle state flux.
+ *
+ * Batched version of riemann_solve_for_middle_state_flux(), see
+ * riemann_solve_for_flux_batch().
+ *
+ * @param b The #riemann_batch.
+ */
+__attribute__((always_inline)) INLINE static void
+riemann_solve_for_middle_state_flux_batch(struct riemann_batch *restrict b) {
+
+  const int count = b->count;
+  int masked[RIEMANN_BATCH_SIZE], scalar[RIEMANN_BATCH_SIZE];
+  float saved[4][RIEMANN_BATCH_SIZE];
+
+#ifdef SWIFT_DEBUG_CHECKS
+  for (int i = 0; i < count; i++) {
+    float WL[5], WR[5], n[3], vij[3];
+    riemann_batch_get(b, i, WL, WR, n, vij);
+    riemann_check_input(WL, WR, n, vij);
+  }
+#endif
+
+  riemann_hllc_batch_mask(b, masked, saved);
+
+  for (int i = 0; i < count; i++) {
+
+    const float n0 = b->n[0][i], n1 = b->n[1][i], n2 = b->n[2][i];
+
+    /* STEP 0: obtain velocity in interface frame */
+    const float rhoL = b->WL[0][i], PL = b->WL[4][i];
+    const float rhoR = b->WR[0][i], PR = b->WR[4][i];
+    const float uL = b->WL[1][i] * n0 + b->WL[2][i] * n1 + b->WL[3][i] * n2;
+    const float uR = b->WR[1][i] * n0 + b->WR[2][i] * n1 + b->WR[3][i] * n2;
+
+    /* STEPS 1 and 2 */
+    float pstar, SLmuL, SRmuR, Sstar;
+    const int vacuum = riemann_hllc_batch_speeds(rhoL, uL, PL, rhoR, uR, PR,
+                                                 &pstar, &SLmuL, &SRmuR, &Sstar);
+    scalar[i] = masked[i] | vacuum;
+
+    const float vface =
+        b->vij[0][i] * n0 + b->vij[1][i] * n1 + b->vij[2][i] * n2;
+
+    b->flux[0][i] = 0.0f;
+    b->flux[1][i] = pstar * n0;
+    b->flux[2][i] = pstar * n1;
+    b->flux[3][i] = pstar * n2;
+    b->flux[4][i] = pstar * (Sstar + vface);
+  }
+
+  riemann_hllc_batch_solve_scalar(b, scalar, saved, masked,
+                                  /*middle_state=*/1);
+
+#ifdef SWIFT_DEBUG_CHECKS
+  for (int i = 0; i < count; i++) {
+    float WL[5], WR[5], n[3], vij[3];
+    riemann_batch_get(b, i, WL, WR, n, vij);
+    const float totflux[5] = {b->flux[0][i], b->flux[1][i], b->flux[2][i],
+                              b->flux[3][i], b->flux[4][i]};
+    riemann_check_output(WL, WR, n, vij, totflux);
+  }
+#endif
+}
+
 #endif /* SWIFT_RIEMANN_HLLC_H */
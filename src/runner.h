@@ -28,7 +28,14 @@
 
 /* Local headers. */
 #include "cache.h"
+#include "const.h"
 #include "gravity_cache.h"
+#include "hardware_counters.h"
+#include "task_trace.h"
+
+#ifdef GIZMO_BATCHED_RIEMANN
+#include "hydro/Gizmo/hydro_flux_batch.h"
+#endif
 
 struct cell;
 struct engine;
@@ -74,6 +81,19 @@ struct runner {
   struct cache cj_cache;
 #endif
 
+#ifdef GIZMO_BATCHED_RIEMANN
+  /*! The flux exchanges waiting for their Riemann problem to be solved. */
+  struct hydro_flux_batch flux_batch;
+#endif
+
+  /*! The events recorded by this runner when tracing the tasks. */
+  struct task_trace trace;
+
+#ifdef SWIFT_HARDWARE_COUNTERS
+  /*! The hardware counters of the tasks run by this runner. */
+  struct hardware_counters hw_counters;
+#endif
+
 #ifdef SWIFT_DEBUG_CHECKS
   /*! Pointer to the task this runner is currently performing */
   const struct task *t;
@@ -102,6 +122,7 @@ void runner_do_drift_bpart(struct runner *r, struct cell *c, int timer);
 void runner_do_kick1(struct runner *r, struct cell *c, int timer);
 void runner_do_kick2(struct runner *r, struct cell *c, int timer);
 void runner_do_timestep(struct runner *r, struct cell *c, int timer);
+void runner_do_kick2_timestep(struct runner *r, struct cell *c, int timer);
 void runner_do_end_hydro_force(struct runner *r, struct cell *c, int timer);
 void runner_do_end_grav_force(struct runner *r, struct cell *c, int timer);
 void runner_do_init(struct runner *r, struct cell *c, int timer);
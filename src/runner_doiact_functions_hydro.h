@@ -140,6 +140,8 @@ void DOPAIR1_NAIVE(struct runner *r, struct cell *restrict ci,
     } /* loop over the parts in cj. */
   }   /* loop over the parts in ci. */
 
+  IACT_FLUSH();
+
   TIMER_TOC(TIMER_DOPAIR);
 }
 
@@ -270,6 +272,8 @@ void DOPAIR2_NAIVE(struct runner *r, struct cell *restrict ci,
     } /* loop over the parts in cj. */
   }   /* loop over the parts in ci. */
 
+  IACT_FLUSH();
+
   TIMER_TOC(TIMER_DOPAIR);
 }
 
@@ -387,6 +391,8 @@ void DOSELF1_NAIVE(struct runner *r, struct cell *restrict c) {
     } /* loop over the parts in cj. */
   }   /* loop over the parts in ci. */
 
+  IACT_FLUSH();
+
   TIMER_TOC(TIMER_DOSELF);
 }
 
@@ -504,6 +510,8 @@ void DOSELF2_NAIVE(struct runner *r, struct cell *restrict c) {
     } /* loop over the parts in cj. */
   }   /* loop over the parts in ci. */
 
+  IACT_FLUSH();
+
   TIMER_TOC(TIMER_DOSELF);
 }
 
@@ -594,6 +602,8 @@ void DOPAIR_SUBSET_NAIVE(struct runner *r, struct cell *restrict ci,
     } /* loop over the parts in cj. */
   }   /* loop over the parts in ci. */
 
+  IACT_FLUSH();
+
   TIMER_TOC(timer_dopair_subset_naive);
 }
 
@@ -752,6 +762,8 @@ void DOPAIR_SUBSET(struct runner *r, struct cell *restrict ci,
     }   /* loop over the parts in ci. */
   }
 
+  IACT_FLUSH();
+
   TIMER_TOC(timer_dopair_subset);
 }
 
@@ -897,6 +909,8 @@ void DOSELF_SUBSET(struct runner *r, struct cell *restrict ci,
     } /* loop over the parts in cj. */
   }   /* loop over the parts in ci. */
 
+  IACT_FLUSH();
+
   TIMER_TOC(timer_doself_subset);
 }
 
@@ -1158,6 +1172,8 @@ void DOPAIR1(struct runner *r, struct cell *ci, struct cell *cj, const int sid,
     }   /* loop over the parts in cj. */
   }     /* Cell cj is active */
 
+  IACT_FLUSH();
+
   TIMER_TOC(TIMER_DOPAIR);
 }
 
@@ -1750,6 +1766,8 @@ void DOPAIR2(struct runner *r, struct cell *ci, struct cell *cj, const int sid,
   if (cell_is_active_hydro(cj, e))  // && !cell_is_all_active_hydro(cj, e))
     free(sort_active_j);
 
+  IACT_FLUSH();
+
   TIMER_TOC(TIMER_DOPAIR);
 }
 
@@ -2020,6 +2038,8 @@ void DOSELF1(struct runner *r, struct cell *restrict c) {
 
   free(indt);
 
+  IACT_FLUSH();
+
   TIMER_TOC(TIMER_DOSELF);
 }
 
@@ -2212,6 +2232,8 @@ void DOSELF2(struct runner *r, struct cell *restrict c) {
 
   free(indt);
 
+  IACT_FLUSH();
+
   TIMER_TOC(TIMER_DOSELF);
 }
 
@@ -95,12 +95,32 @@
 #define _DOSUB_SUBSET(f) PASTE(runner_dosub_subset, f)
 #define DOSUB_SUBSET _DOSUB_SUBSET(FUNCTION)
 
+#undef IACT_NONSYM
+#undef IACT
+#undef IACT_FLUSH
+
+#if defined(GIZMO_BATCHED_RIEMANN) && (FUNCTION_TASK_LOOP == TASK_LOOP_FORCE)
+
+/* Queue the Riemann problems in the runner's batch. The batch has to be
+   flushed before the function that filled it returns. */
+#define IACT_NONSYM(r2, dx, hi, hj, pi, pj, a, H) \
+  runner_iact_nonsym_force_batched(r2, dx, hi, hj, pi, pj, a, H, &r->flux_batch)
+#define IACT(r2, dx, hi, hj, pi, pj, a, H) \
+  runner_iact_force_batched(r2, dx, hi, hj, pi, pj, a, H, &r->flux_batch)
+#define IACT_FLUSH() runner_iact_force_batch_flush(&r->flux_batch)
+
+#else
+
 #define _IACT_NONSYM(f) PASTE(runner_iact_nonsym, f)
 #define IACT_NONSYM _IACT_NONSYM(FUNCTION)
 
 #define _IACT(f) PASTE(runner_iact, f)
 #define IACT _IACT(FUNCTION)
 
+#define IACT_FLUSH()
+
+#endif
+
 #define _IACT_NONSYM_VEC(f) PASTE(runner_iact_nonsym_vec, f)
 #define IACT_NONSYM_VEC _IACT_NONSYM_VEC(FUNCTION)
 
@@ -74,6 +74,10 @@
 #define _DOSUB_PAIR2(f) PASTE(runner_dosub_pair2, f)
 #define DOSUB_PAIR2 _DOSUB_PAIR2(FUNCTION)
 
+/* The hydro force loop may have redefined these as function-like macros */
+#undef IACT_NONSYM
+#undef IACT
+
 #define _IACT_NONSYM(f) PASTE(runner_iact_nonsym, f)
 #define IACT_NONSYM _IACT_NONSYM(FUNCTION)
 
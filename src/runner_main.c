@@ -116,15 +116,24 @@ void *runner_main(void *data) {
   struct scheduler *sched = &e->sched;
   unsigned int seed = r->id;
   pthread_setspecific(sched->local_seed_pointer, &seed);
+
+#ifdef SWIFT_HARDWARE_COUNTERS
+  /* The counters follow the thread that opens them. */
+  hardware_counters_init(&r->hw_counters);
+#endif
+
   /* Main loop. */
   while (1) {
 
-    /* Wait at the barrier. */
-    engine_barrier(e);
+    /* Work on the engine's mappers until we are released to run tasks. */
+    threadpool_serve(&e->threadpool);
 
     /* Can we go home yet? */
     if (e->step_props & engine_step_prop_done) break;
 
+    /* Make our trace buffer reachable from the scheduler, if tracing. */
+    if (task_trace_active) task_trace_set_local(&r->trace);
+
     /* Re-set the pointer to the previous task, as there is none. */
     struct task *t = NULL;
     struct task *prev = NULL;
@@ -142,6 +151,11 @@ void *runner_main(void *data) {
 
         /* Did I get anything? */
         if (t == NULL) break;
+
+        /* Record the time spent waiting for it. */
+        if (task_trace_active && prev != NULL)
+          task_trace_log(&r->trace, task_trace_event_wait, t->type,
+                         t->subtype, prev->toc, t->tic, 0);
       }
 
       /* Get the cells. */
@@ -170,6 +184,10 @@ void *runner_main(void *data) {
       r->t = t;
 #endif
 
+#ifdef SWIFT_HARDWARE_COUNTERS
+      hardware_counters_start(&r->hw_counters);
+#endif
+
       /* Different types of tasks... */
       switch (t->type) {
         case task_type_self:
@@ -350,7 +368,10 @@ void *runner_main(void *data) {
           runner_do_kick1(r, ci, 1);
           break;
         case task_type_kick2:
-          runner_do_kick2(r, ci, 1);
+          if (t == ci->timestep)
+            runner_do_kick2_timestep(r, ci, 1);
+          else
+            runner_do_kick2(r, ci, 1);
           break;
         case task_type_end_hydro_force:
           runner_do_end_hydro_force(r, ci, 1);
@@ -471,6 +492,10 @@ void *runner_main(void *data) {
           error("Unknown/invalid task type (%d).", t->type);
       }
 
+#ifdef SWIFT_HARDWARE_COUNTERS
+      hardware_counters_stop(&r->hw_counters, t->type, t->subtype);
+#endif
+
 /* Mark that we have run this task on these cells */
 #ifdef SWIFT_DEBUG_CHECKS
       if (ci != NULL) {
@@ -490,6 +515,11 @@ void *runner_main(void *data) {
       prev = t;
       t = scheduler_done(sched, t);
 
+      /* Record the execution of the task. */
+      if (task_trace_active && !prev->implicit)
+        task_trace_log(&r->trace, task_trace_event_task, prev->type,
+                       prev->subtype, prev->tic, prev->toc, 0);
+
     } /* main loop. */
   }
 
@@ -106,6 +106,11 @@ void runner_do_kick1(struct runner *r, struct cell *c, int timer) {
       !cell_is_starting_stars(c, e) && !cell_is_starting_black_holes(c, e))
     return;
 
+#ifdef SWIFT_DEBUG_CHECKS
+  if (with_cosmology && cosmo->ti_kick_factors != ti_current)
+    error("Cosmological kick factors not tabulated at the current time");
+#endif
+
   /* Recurse? */
   if (c->split) {
     for (int k = 0; k < 8; k++)
@@ -145,14 +150,12 @@ void runner_do_kick1(struct runner *r, struct cell *c, int timer) {
         /* Time interval for this half-kick */
         double dt_kick_grav, dt_kick_hydro, dt_kick_therm, dt_kick_corr;
         if (with_cosmology) {
-          dt_kick_hydro = cosmology_get_hydro_kick_factor(
-              cosmo, ti_begin, ti_begin + ti_step / 2);
-          dt_kick_grav = cosmology_get_grav_kick_factor(cosmo, ti_begin,
-                                                        ti_begin + ti_step / 2);
-          dt_kick_therm = cosmology_get_therm_kick_factor(
-              cosmo, ti_begin, ti_begin + ti_step / 2);
-          dt_kick_corr = cosmology_get_corr_kick_factor(cosmo, ti_begin,
-                                                        ti_begin + ti_step / 2);
+          const struct cosmology_kick_factors *kick =
+              &cosmo->kick1_factors[p->time_bin];
+          dt_kick_hydro = kick->hydro;
+          dt_kick_grav = kick->grav;
+          dt_kick_therm = kick->therm;
+          dt_kick_corr = kick->corr;
         } else {
           dt_kick_hydro = (ti_step / 2) * time_base;
           dt_kick_grav = (ti_step / 2) * time_base;
@@ -207,8 +210,7 @@ void runner_do_kick1(struct runner *r, struct cell *c, int timer) {
         /* Time interval for this half-kick */
         double dt_kick_grav;
         if (with_cosmology) {
-          dt_kick_grav = cosmology_get_grav_kick_factor(cosmo, ti_begin,
-                                                        ti_begin + ti_step / 2);
+          dt_kick_grav = cosmo->kick1_factors[gp->time_bin].grav;
         } else {
           dt_kick_grav = (ti_step / 2) * time_base;
         }
@@ -245,8 +247,7 @@ void runner_do_kick1(struct runner *r, struct cell *c, int timer) {
         /* Time interval for this half-kick */
         double dt_kick_grav;
         if (with_cosmology) {
-          dt_kick_grav = cosmology_get_grav_kick_factor(cosmo, ti_begin,
-                                                        ti_begin + ti_step / 2);
+          dt_kick_grav = cosmo->kick1_factors[sp->time_bin].grav;
         } else {
           dt_kick_grav = (ti_step / 2) * time_base;
         }
@@ -283,8 +284,7 @@ void runner_do_kick1(struct runner *r, struct cell *c, int timer) {
         /* Time interval for this half-kick */
         double dt_kick_grav;
         if (with_cosmology) {
-          dt_kick_grav = cosmology_get_grav_kick_factor(cosmo, ti_begin,
-                                                        ti_begin + ti_step / 2);
+          dt_kick_grav = cosmo->kick1_factors[bp->time_bin].grav;
         } else {
           dt_kick_grav = (ti_step / 2) * time_base;
         }
@@ -333,6 +333,11 @@ void runner_do_kick2(struct runner *r, struct cell *c, int timer) {
       !cell_is_active_stars(c, e) && !cell_is_active_black_holes(c, e))
     return;
 
+#ifdef SWIFT_DEBUG_CHECKS
+  if (with_cosmology && cosmo->ti_kick_factors != ti_current)
+    error("Cosmological kick factors not tabulated at the current time");
+#endif
+
   /* Recurse? */
   if (c->split) {
     for (int k = 0; k < 8; k++)
@@ -372,14 +377,12 @@ void runner_do_kick2(struct runner *r, struct cell *c, int timer) {
         /* Time interval for this half-kick */
         double dt_kick_grav, dt_kick_hydro, dt_kick_therm, dt_kick_corr;
         if (with_cosmology) {
-          dt_kick_hydro = cosmology_get_hydro_kick_factor(
-              cosmo, ti_begin + ti_step / 2, ti_end);
-          dt_kick_grav = cosmology_get_grav_kick_factor(
-              cosmo, ti_begin + ti_step / 2, ti_end);
-          dt_kick_therm = cosmology_get_therm_kick_factor(
-              cosmo, ti_begin + ti_step / 2, ti_end);
-          dt_kick_corr = cosmology_get_corr_kick_factor(
-              cosmo, ti_begin + ti_step / 2, ti_end);
+          const struct cosmology_kick_factors *kick =
+              &cosmo->kick2_factors[p->time_bin];
+          dt_kick_hydro = kick->hydro;
+          dt_kick_grav = kick->grav;
+          dt_kick_therm = kick->therm;
+          dt_kick_corr = kick->corr;
         } else {
           dt_kick_hydro = (ti_end - (ti_begin + ti_step / 2)) * time_base;
           dt_kick_grav = (ti_end - (ti_begin + ti_step / 2)) * time_base;
@@ -428,8 +431,7 @@ void runner_do_kick2(struct runner *r, struct cell *c, int timer) {
         /* Time interval for this half-kick */
         double dt_kick_grav;
         if (with_cosmology) {
-          dt_kick_grav = cosmology_get_grav_kick_factor(
-              cosmo, ti_begin + ti_step / 2, ti_begin + ti_step);
+          dt_kick_grav = cosmo->kick2_factors[gp->time_bin].grav;
         } else {
           dt_kick_grav = (ti_step / 2) * time_base;
         }
@@ -470,8 +472,7 @@ void runner_do_kick2(struct runner *r, struct cell *c, int timer) {
         /* Time interval for this half-kick */
         double dt_kick_grav;
         if (with_cosmology) {
-          dt_kick_grav = cosmology_get_grav_kick_factor(
-              cosmo, ti_begin + ti_step / 2, ti_begin + ti_step);
+          dt_kick_grav = cosmo->kick2_factors[sp->time_bin].grav;
         } else {
           dt_kick_grav = (ti_step / 2) * time_base;
         }
@@ -512,8 +513,7 @@ void runner_do_kick2(struct runner *r, struct cell *c, int timer) {
         /* Time interval for this half-kick */
         double dt_kick_grav;
         if (with_cosmology) {
-          dt_kick_grav = cosmology_get_grav_kick_factor(
-              cosmo, ti_begin + ti_step / 2, ti_begin + ti_step);
+          dt_kick_grav = cosmo->kick2_factors[bp->time_bin].grav;
         } else {
           dt_kick_grav = (ti_step / 2) * time_base;
         }
@@ -538,13 +538,17 @@ void runner_do_kick2(struct runner *r, struct cell *c, int timer) {
 
 /**
  * @brief Computes the next time-step of all active particles in this cell
- * and update the cell's statistics.
+ * and update the cell's statistics, optionally applying the second half-kick
+ * to each leaf just before.
  *
  * @param r The runner thread.
  * @param c The cell.
+ * @param with_kick2 Do we also apply the second half-kick?
  * @param timer Are we timing this ?
  */
-void runner_do_timestep(struct runner *r, struct cell *c, int timer) {
+static void runner_do_kick2_and_timestep(struct runner *r, struct cell *c,
+                                         const int with_kick2,
+                                         const int timer) {
 
   const struct engine *e = r->e;
   const integertime_t ti_current = e->ti_current;
@@ -585,6 +589,9 @@ void runner_do_timestep(struct runner *r, struct cell *c, int timer) {
   /* No children? */
   if (!c->split) {
 
+    /* Finish the step of the particles while they are in cache */
+    if (with_kick2) runner_do_kick2(r, c, 0);
+
     /* Loop over the particles in this cell. */
     for (int k = 0; k < count; k++) {
 
@@ -875,7 +882,7 @@ void runner_do_timestep(struct runner *r, struct cell *c, int timer) {
         struct cell *restrict cp = c->progeny[k];
 
         /* Recurse */
-        runner_do_timestep(r, cp, 0);
+        runner_do_kick2_and_timestep(r, cp, with_kick2, 0);
 
         /* And aggregate */
         updated += cp->hydro.updated;
@@ -939,7 +946,34 @@ void runner_do_timestep(struct runner *r, struct cell *c, int timer) {
     error("End of next black holes step is current time!");
 #endif
 
-  if (timer) TIMER_TOC(timer_timestep);
+  if (timer) TIMER_TOC(with_kick2 ? timer_kick2 : timer_timestep);
+}
+
+/**
+ * @brief Computes the next time-step of all active particles in this cell
+ * and update the cell's statistics.
+ *
+ * @param r The runner thread.
+ * @param c The cell.
+ * @param timer Are we timing this ?
+ */
+void runner_do_timestep(struct runner *r, struct cell *c, int timer) {
+  runner_do_kick2_and_timestep(r, c, /*with_kick2=*/0, timer);
+}
+
+/**
+ * @brief Apply the second half-kick and compute the next time-step of all
+ * active particles in this cell in a single walk of the tree.
+ *
+ * Only valid when no other task acts on the particles between the end of
+ * the step and the time-step calculation.
+ *
+ * @param r The runner thread.
+ * @param c The cell.
+ * @param timer Are we timing this ?
+ */
+void runner_do_kick2_timestep(struct runner *r, struct cell *c, int timer) {
+  runner_do_kick2_and_timestep(r, c, /*with_kick2=*/1, timer);
 }
 
 /**
@@ -26,6 +26,7 @@
 #include <limits.h>
 #include <math.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -47,12 +48,14 @@
 #include "intrinsics.h"
 #include "kernel_hydro.h"
 #include "memuse.h"
+#include "minmax.h"
 #include "mpiuse.h"
 #include "queue.h"
 #include "sort_part.h"
 #include "space.h"
 #include "space_getsid.h"
 #include "task.h"
+#include "task_trace.h"
 #include "threadpool.h"
 #include "timers.h"
 #include "version.h"
@@ -1310,10 +1313,11 @@ void scheduler_reset(struct scheduler *s, int size) {
     if ((s->tid_active =
              (int *)swift_malloc("tid_active", sizeof(int) * size)) == NULL)
       error("Failed to allocate aactive task lists.");
+
+    s->size = size;
   }
 
   /* Reset the counters. */
-  s->size = size;
   s->nr_tasks = 0;
   s->tasks_next = 0;
   s->waiting = 0;
@@ -1327,285 +1331,463 @@ void scheduler_reset(struct scheduler *s, int size) {
 }
 
 /**
- * @brief Compute the task weights
+ * @brief Compute the analytic cost of a task based on the particle counts
+ * of its cells.
  *
- * @param s The #scheduler.
- * @param verbose Are we talkative?
+ * @param t The #task.
+ * @param nodeID The node we are working on.
  */
-void scheduler_reweight(struct scheduler *s, int verbose) {
-  const int nr_tasks = s->nr_tasks;
-  int *tid = s->tasks_ind;
-  struct task *tasks = s->tasks;
-  const int nodeID = s->nodeID;
+static float scheduler_task_cost(const struct task *t, const int nodeID) {
+
   const float wscale = 0.001f;
-  const ticks tic = getticks();
+  float cost = 0.f;
+
+  const float count_i = (t->ci != NULL) ? t->ci->hydro.count : 0.f;
+  const float count_j = (t->cj != NULL) ? t->cj->hydro.count : 0.f;
+  const float gcount_i = (t->ci != NULL) ? t->ci->grav.count : 0.f;
+  const float gcount_j = (t->cj != NULL) ? t->cj->grav.count : 0.f;
+  const float scount_i = (t->ci != NULL) ? t->ci->stars.count : 0.f;
+  const float scount_j = (t->cj != NULL) ? t->cj->stars.count : 0.f;
+  const float bcount_i = (t->ci != NULL) ? t->ci->black_holes.count : 0.f;
+  const float bcount_j = (t->cj != NULL) ? t->cj->black_holes.count : 0.f;
+
+  switch (t->type) {
+    case task_type_sort:
+      cost = wscale * intrinsics_popcount(t->flags) * count_i *
+             (sizeof(int) * 8 - intrinsics_clz(t->ci->hydro.count));
+      break;
 
-  /* Run through the tasks backwards and set their weights. */
-  for (int k = nr_tasks - 1; k >= 0; k--) {
-    struct task *t = &tasks[tid[k]];
-    float cost = 0.f;
-    t->weight = 0.f;
+    case task_type_stars_sort:
+      cost = wscale * intrinsics_popcount(t->flags) * scount_i *
+             (sizeof(int) * 8 - intrinsics_clz(t->ci->stars.count));
+      break;
 
-    for (int j = 0; j < t->nr_unlock_tasks; j++)
-      if (t->unlock_tasks[j]->weight > t->weight)
-        t->weight = t->unlock_tasks[j]->weight;
+    case task_type_stars_resort:
+      cost = wscale * intrinsics_popcount(t->flags) * scount_i *
+             (sizeof(int) * 8 - intrinsics_clz(t->ci->stars.count));
+      break;
 
-    const float count_i = (t->ci != NULL) ? t->ci->hydro.count : 0.f;
-    const float count_j = (t->cj != NULL) ? t->cj->hydro.count : 0.f;
-    const float gcount_i = (t->ci != NULL) ? t->ci->grav.count : 0.f;
-    const float gcount_j = (t->cj != NULL) ? t->cj->grav.count : 0.f;
-    const float scount_i = (t->ci != NULL) ? t->ci->stars.count : 0.f;
-    const float scount_j = (t->cj != NULL) ? t->cj->stars.count : 0.f;
-    const float bcount_i = (t->ci != NULL) ? t->ci->black_holes.count : 0.f;
-    const float bcount_j = (t->cj != NULL) ? t->cj->black_holes.count : 0.f;
+    case task_type_self:
+      if (t->subtype == task_subtype_grav) {
+        cost = 1.f * (wscale * gcount_i) * gcount_i;
+      } else if (t->subtype == task_subtype_external_grav)
+        cost = 1.f * wscale * gcount_i;
+      else if (t->subtype == task_subtype_stars_density ||
+               t->subtype == task_subtype_stars_feedback)
+        cost = 1.f * wscale * scount_i * count_i;
+      else if (t->subtype == task_subtype_bh_density ||
+               t->subtype == task_subtype_bh_swallow ||
+               t->subtype == task_subtype_bh_feedback)
+        cost = 1.f * wscale * bcount_i * count_i;
+      else if (t->subtype == task_subtype_do_gas_swallow)
+        cost = 1.f * wscale * count_i;
+      else if (t->subtype == task_subtype_do_bh_swallow)
+        cost = 1.f * wscale * bcount_i;
+      else if (t->subtype == task_subtype_density ||
+               t->subtype == task_subtype_gradient ||
+               t->subtype == task_subtype_force ||
+               t->subtype == task_subtype_limiter)
+        cost = 1.f * (wscale * count_i) * count_i;
+      else
+        error("Untreated sub-type for selfs: %s", subtaskID_names[t->subtype]);
+      break;
 
-    switch (t->type) {
-      case task_type_sort:
-        cost = wscale * intrinsics_popcount(t->flags) * count_i *
-               (sizeof(int) * 8 - intrinsics_clz(t->ci->hydro.count));
-        break;
+    case task_type_pair:
+      if (t->subtype == task_subtype_grav) {
+        if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID)
+          cost = 3.f * (wscale * gcount_i) * gcount_j;
+        else
+          cost = 2.f * (wscale * gcount_i) * gcount_j;
+
+      } else if (t->subtype == task_subtype_stars_density ||
+                 t->subtype == task_subtype_stars_feedback) {
+        if (t->ci->nodeID != nodeID)
+          cost = 3.f * wscale * count_i * scount_j * sid_scale[t->flags];
+        else if (t->cj->nodeID != nodeID)
+          cost = 3.f * wscale * scount_i * count_j * sid_scale[t->flags];
+        else
+          cost = 2.f * wscale * (scount_i * count_j + scount_j * count_i) *
+                 sid_scale[t->flags];
 
-      case task_type_stars_sort:
-        cost = wscale * intrinsics_popcount(t->flags) * scount_i *
-               (sizeof(int) * 8 - intrinsics_clz(t->ci->stars.count));
-        break;
+      } else if (t->subtype == task_subtype_bh_density ||
+                 t->subtype == task_subtype_bh_swallow ||
+                 t->subtype == task_subtype_bh_feedback) {
+        if (t->ci->nodeID != nodeID)
+          cost = 3.f * wscale * count_i * bcount_j * sid_scale[t->flags];
+        else if (t->cj->nodeID != nodeID)
+          cost = 3.f * wscale * bcount_i * count_j * sid_scale[t->flags];
+        else
+          cost = 2.f * wscale * (bcount_i * count_j + bcount_j * count_i) *
+                 sid_scale[t->flags];
 
-      case task_type_stars_resort:
-        cost = wscale * intrinsics_popcount(t->flags) * scount_i *
-               (sizeof(int) * 8 - intrinsics_clz(t->ci->stars.count));
-        break;
+      } else if (t->subtype == task_subtype_do_gas_swallow) {
+        cost = 1.f * wscale * (count_i + count_j);
 
-      case task_type_self:
-        if (t->subtype == task_subtype_grav) {
-          cost = 1.f * (wscale * gcount_i) * gcount_i;
-        } else if (t->subtype == task_subtype_external_grav)
-          cost = 1.f * wscale * gcount_i;
-        else if (t->subtype == task_subtype_stars_density ||
-                 t->subtype == task_subtype_stars_feedback)
-          cost = 1.f * wscale * scount_i * count_i;
-        else if (t->subtype == task_subtype_bh_density ||
-                 t->subtype == task_subtype_bh_swallow ||
-                 t->subtype == task_subtype_bh_feedback)
-          cost = 1.f * wscale * bcount_i * count_i;
-        else if (t->subtype == task_subtype_do_gas_swallow)
-          cost = 1.f * wscale * count_i;
-        else if (t->subtype == task_subtype_do_bh_swallow)
-          cost = 1.f * wscale * bcount_i;
-        else if (t->subtype == task_subtype_density ||
+      } else if (t->subtype == task_subtype_do_bh_swallow) {
+        cost = 1.f * wscale * (bcount_i + bcount_j);
+
+      } else if (t->subtype == task_subtype_density ||
                  t->subtype == task_subtype_gradient ||
                  t->subtype == task_subtype_force ||
-                 t->subtype == task_subtype_limiter)
-          cost = 1.f * (wscale * count_i) * count_i;
+                 t->subtype == task_subtype_limiter) {
+        if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID)
+          cost = 3.f * (wscale * count_i) * count_j * sid_scale[t->flags];
         else
-          error("Untreated sub-type for selfs: %s",
-                subtaskID_names[t->subtype]);
-        break;
+          cost = 2.f * (wscale * count_i) * count_j * sid_scale[t->flags];
 
-      case task_type_pair:
-        if (t->subtype == task_subtype_grav) {
-          if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID)
-            cost = 3.f * (wscale * gcount_i) * gcount_j;
-          else
-            cost = 2.f * (wscale * gcount_i) * gcount_j;
-
-        } else if (t->subtype == task_subtype_stars_density ||
-                   t->subtype == task_subtype_stars_feedback) {
-          if (t->ci->nodeID != nodeID)
-            cost = 3.f * wscale * count_i * scount_j * sid_scale[t->flags];
-          else if (t->cj->nodeID != nodeID)
-            cost = 3.f * wscale * scount_i * count_j * sid_scale[t->flags];
-          else
-            cost = 2.f * wscale * (scount_i * count_j + scount_j * count_i) *
-                   sid_scale[t->flags];
-
-        } else if (t->subtype == task_subtype_bh_density ||
-                   t->subtype == task_subtype_bh_swallow ||
-                   t->subtype == task_subtype_bh_feedback) {
-          if (t->ci->nodeID != nodeID)
-            cost = 3.f * wscale * count_i * bcount_j * sid_scale[t->flags];
-          else if (t->cj->nodeID != nodeID)
-            cost = 3.f * wscale * bcount_i * count_j * sid_scale[t->flags];
-          else
-            cost = 2.f * wscale * (bcount_i * count_j + bcount_j * count_i) *
-                   sid_scale[t->flags];
-
-        } else if (t->subtype == task_subtype_do_gas_swallow) {
-          cost = 1.f * wscale * (count_i + count_j);
-
-        } else if (t->subtype == task_subtype_do_bh_swallow) {
-          cost = 1.f * wscale * (bcount_i + bcount_j);
-
-        } else if (t->subtype == task_subtype_density ||
-                   t->subtype == task_subtype_gradient ||
-                   t->subtype == task_subtype_force ||
-                   t->subtype == task_subtype_limiter) {
-          if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID)
-            cost = 3.f * (wscale * count_i) * count_j * sid_scale[t->flags];
-          else
-            cost = 2.f * (wscale * count_i) * count_j * sid_scale[t->flags];
-
-        } else {
-          error("Untreated sub-type for pairs: %s",
-                subtaskID_names[t->subtype]);
-        }
-        break;
+      } else {
+        error("Untreated sub-type for pairs: %s", subtaskID_names[t->subtype]);
+      }
+      break;
 
-      case task_type_sub_pair:
+    case task_type_sub_pair:
 #ifdef SWIFT_DEBUG_CHECKS
-        if (t->flags < 0) error("Negative flag value!");
+      if (t->flags < 0) error("Negative flag value!");
 #endif
-        if (t->subtype == task_subtype_stars_density ||
-            t->subtype == task_subtype_stars_feedback) {
-          if (t->ci->nodeID != nodeID) {
-            cost = 3.f * (wscale * count_i) * scount_j * sid_scale[t->flags];
-          } else if (t->cj->nodeID != nodeID) {
-            cost = 3.f * (wscale * scount_i) * count_j * sid_scale[t->flags];
-          } else {
-            cost = 2.f * wscale * (scount_i * count_j + scount_j * count_i) *
-                   sid_scale[t->flags];
-          }
-
-        } else if (t->subtype == task_subtype_bh_density ||
-                   t->subtype == task_subtype_bh_swallow ||
-                   t->subtype == task_subtype_bh_feedback) {
-          if (t->ci->nodeID != nodeID) {
-            cost = 3.f * (wscale * count_i) * bcount_j * sid_scale[t->flags];
-          } else if (t->cj->nodeID != nodeID) {
-            cost = 3.f * (wscale * bcount_i) * count_j * sid_scale[t->flags];
-          } else {
-            cost = 2.f * wscale * (bcount_i * count_j + bcount_j * count_i) *
-                   sid_scale[t->flags];
-          }
+      if (t->subtype == task_subtype_stars_density ||
+          t->subtype == task_subtype_stars_feedback) {
+        if (t->ci->nodeID != nodeID) {
+          cost = 3.f * (wscale * count_i) * scount_j * sid_scale[t->flags];
+        } else if (t->cj->nodeID != nodeID) {
+          cost = 3.f * (wscale * scount_i) * count_j * sid_scale[t->flags];
+        } else {
+          cost = 2.f * wscale * (scount_i * count_j + scount_j * count_i) *
+                 sid_scale[t->flags];
+        }
 
-        } else if (t->subtype == task_subtype_do_gas_swallow) {
-          cost = 1.f * wscale * (count_i + count_j);
+      } else if (t->subtype == task_subtype_bh_density ||
+                 t->subtype == task_subtype_bh_swallow ||
+                 t->subtype == task_subtype_bh_feedback) {
+        if (t->ci->nodeID != nodeID) {
+          cost = 3.f * (wscale * count_i) * bcount_j * sid_scale[t->flags];
+        } else if (t->cj->nodeID != nodeID) {
+          cost = 3.f * (wscale * bcount_i) * count_j * sid_scale[t->flags];
+        } else {
+          cost = 2.f * wscale * (bcount_i * count_j + bcount_j * count_i) *
+                 sid_scale[t->flags];
+        }
 
-        } else if (t->subtype == task_subtype_do_bh_swallow) {
-          cost = 1.f * wscale * (bcount_i + bcount_j);
+      } else if (t->subtype == task_subtype_do_gas_swallow) {
+        cost = 1.f * wscale * (count_i + count_j);
 
-        } else if (t->subtype == task_subtype_density ||
-                   t->subtype == task_subtype_gradient ||
-                   t->subtype == task_subtype_force ||
-                   t->subtype == task_subtype_limiter) {
-          if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID) {
-            cost = 3.f * (wscale * count_i) * count_j * sid_scale[t->flags];
-          } else {
-            cost = 2.f * (wscale * count_i) * count_j * sid_scale[t->flags];
-          }
+      } else if (t->subtype == task_subtype_do_bh_swallow) {
+        cost = 1.f * wscale * (bcount_i + bcount_j);
 
+      } else if (t->subtype == task_subtype_density ||
+                 t->subtype == task_subtype_gradient ||
+                 t->subtype == task_subtype_force ||
+                 t->subtype == task_subtype_limiter) {
+        if (t->ci->nodeID != nodeID || t->cj->nodeID != nodeID) {
+          cost = 3.f * (wscale * count_i) * count_j * sid_scale[t->flags];
         } else {
-          error("Untreated sub-type for sub-pairs: %s",
-                subtaskID_names[t->subtype]);
+          cost = 2.f * (wscale * count_i) * count_j * sid_scale[t->flags];
         }
-        break;
 
-      case task_type_sub_self:
-        if (t->subtype == task_subtype_stars_density ||
-            t->subtype == task_subtype_stars_feedback) {
-          cost = 1.f * (wscale * scount_i) * count_i;
-        } else if (t->subtype == task_subtype_bh_density ||
-                   t->subtype == task_subtype_bh_swallow ||
-                   t->subtype == task_subtype_bh_feedback) {
-          cost = 1.f * (wscale * bcount_i) * count_i;
-        } else if (t->subtype == task_subtype_do_gas_swallow) {
-          cost = 1.f * wscale * count_i;
-        } else if (t->subtype == task_subtype_do_bh_swallow) {
-          cost = 1.f * wscale * bcount_i;
-        } else if (t->subtype == task_subtype_density ||
-                   t->subtype == task_subtype_gradient ||
-                   t->subtype == task_subtype_force ||
-                   t->subtype == task_subtype_limiter) {
-          cost = 1.f * (wscale * count_i) * count_i;
-        } else {
-          error("Untreated sub-type for sub-selfs: %s",
-                subtaskID_names[t->subtype]);
-        }
-        break;
-      case task_type_ghost:
-        if (t->ci == t->ci->hydro.super) cost = wscale * count_i;
-        break;
-      case task_type_extra_ghost:
-        if (t->ci == t->ci->hydro.super) cost = wscale * count_i;
-        break;
-      case task_type_stars_ghost:
-        if (t->ci == t->ci->hydro.super) cost = wscale * scount_i;
-        break;
-      case task_type_bh_density_ghost:
-        if (t->ci == t->ci->hydro.super) cost = wscale * bcount_i;
-        break;
-      case task_type_bh_swallow_ghost2:
-        if (t->ci == t->ci->hydro.super) cost = wscale * bcount_i;
-        break;
-      case task_type_drift_part:
-        cost = wscale * count_i;
-        break;
-      case task_type_drift_gpart:
-        cost = wscale * gcount_i;
-        break;
-      case task_type_drift_spart:
-        cost = wscale * scount_i;
-        break;
-      case task_type_drift_bpart:
-        cost = wscale * bcount_i;
-        break;
-      case task_type_init_grav:
-        cost = wscale * gcount_i;
-        break;
-      case task_type_grav_down:
-        cost = wscale * gcount_i;
-        break;
-      case task_type_grav_long_range:
-        cost = wscale * gcount_i;
-        break;
-      case task_type_grav_mesh:
-        cost = wscale * gcount_i;
-        break;
-      case task_type_grav_mm:
-        cost = wscale * (gcount_i + gcount_j);
-        break;
-      case task_type_end_hydro_force:
-        cost = wscale * count_i;
-        break;
-      case task_type_end_grav_force:
-        cost = wscale * gcount_i;
-        break;
-      case task_type_cooling:
-        cost = wscale * count_i;
-        break;
-      case task_type_star_formation:
-        cost = wscale * (count_i + scount_i);
-        break;
-      case task_type_kick1:
-        cost = wscale * (count_i + gcount_i + scount_i + bcount_i);
-        break;
-      case task_type_kick2:
-        cost = wscale * (count_i + gcount_i + scount_i + bcount_i);
-        break;
-      case task_type_timestep:
-        cost = wscale * (count_i + gcount_i + scount_i + bcount_i);
-        break;
-      case task_type_timestep_limiter:
-        cost = wscale * count_i;
-        break;
-      case task_type_timestep_sync:
-        cost = wscale * count_i;
-        break;
-      case task_type_send:
-        if (count_i < 1e5)
-          cost = 10.f * (wscale * count_i) * count_i;
-        else
-          cost = 2e9;
-        break;
-      case task_type_recv:
-        if (count_i < 1e5)
-          cost = 5.f * (wscale * count_i) * count_i;
-        else
-          cost = 1e9;
-        break;
-      default:
-        cost = 0;
-        break;
+      } else {
+        error("Untreated sub-type for sub-pairs: %s",
+              subtaskID_names[t->subtype]);
+      }
+      break;
+
+    case task_type_sub_self:
+      if (t->subtype == task_subtype_stars_density ||
+          t->subtype == task_subtype_stars_feedback) {
+        cost = 1.f * (wscale * scount_i) * count_i;
+      } else if (t->subtype == task_subtype_bh_density ||
+                 t->subtype == task_subtype_bh_swallow ||
+                 t->subtype == task_subtype_bh_feedback) {
+        cost = 1.f * (wscale * bcount_i) * count_i;
+      } else if (t->subtype == task_subtype_do_gas_swallow) {
+        cost = 1.f * wscale * count_i;
+      } else if (t->subtype == task_subtype_do_bh_swallow) {
+        cost = 1.f * wscale * bcount_i;
+      } else if (t->subtype == task_subtype_density ||
+                 t->subtype == task_subtype_gradient ||
+                 t->subtype == task_subtype_force ||
+                 t->subtype == task_subtype_limiter) {
+        cost = 1.f * (wscale * count_i) * count_i;
+      } else {
+        error("Untreated sub-type for sub-selfs: %s",
+              subtaskID_names[t->subtype]);
+      }
+      break;
+    case task_type_ghost:
+      if (t->ci == t->ci->hydro.super) cost = wscale * count_i;
+      break;
+    case task_type_extra_ghost:
+      if (t->ci == t->ci->hydro.super) cost = wscale * count_i;
+      break;
+    case task_type_stars_ghost:
+      if (t->ci == t->ci->hydro.super) cost = wscale * scount_i;
+      break;
+    case task_type_bh_density_ghost:
+      if (t->ci == t->ci->hydro.super) cost = wscale * bcount_i;
+      break;
+    case task_type_bh_swallow_ghost2:
+      if (t->ci == t->ci->hydro.super) cost = wscale * bcount_i;
+      break;
+    case task_type_drift_part:
+      cost = wscale * count_i;
+      break;
+    case task_type_drift_gpart:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_drift_spart:
+      cost = wscale * scount_i;
+      break;
+    case task_type_drift_bpart:
+      cost = wscale * bcount_i;
+      break;
+    case task_type_init_grav:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_grav_down:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_grav_long_range:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_grav_mesh:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_grav_mm:
+      cost = wscale * (gcount_i + gcount_j);
+      break;
+    case task_type_end_hydro_force:
+      cost = wscale * count_i;
+      break;
+    case task_type_end_grav_force:
+      cost = wscale * gcount_i;
+      break;
+    case task_type_cooling:
+      cost = wscale * count_i;
+      break;
+    case task_type_star_formation:
+      cost = wscale * (count_i + scount_i);
+      break;
+    case task_type_kick1:
+      cost = wscale * (count_i + gcount_i + scount_i + bcount_i);
+      break;
+    case task_type_kick2:
+      cost = wscale * (count_i + gcount_i + scount_i + bcount_i);
+      /* Also computing the time-steps? */
+      if (t == t->ci->timestep) cost *= 2;
+      break;
+    case task_type_timestep:
+      cost = wscale * (count_i + gcount_i + scount_i + bcount_i);
+      break;
+    case task_type_timestep_limiter:
+      cost = wscale * count_i;
+      break;
+    case task_type_timestep_sync:
+      cost = wscale * count_i;
+      break;
+    case task_type_send:
+      if (count_i < 1e5)
+        cost = 10.f * (wscale * count_i) * count_i;
+      else
+        cost = 2e9;
+      break;
+    case task_type_recv:
+      if (count_i < 1e5)
+        cost = 5.f * (wscale * count_i) * count_i;
+      else
+        cost = 1e9;
+      break;
+    default:
+      cost = 0;
+      break;
+  }
+
+  return cost;
+}
+
+/**
+ * @brief Fit the correction factors of the task cost model to the measured
+ * run times of the tasks.
+ *
+ * For each task type and sub-type, we compare the time the tasks that ran
+ * since the last fit took to their analytic cost. The ratio, normalised by the
+ * ratio over all the tasks, is the correction factor that brings the
+ * analytic cost in line with reality. The new factors are blended with the
+ * previous ones to damp the noise of individual steps.
+ *
+ * Communication tasks are not fitted as their run time is dominated by
+ * waiting for the other ranks. Tasks that were skipped since the last fit
+ * still carry the timings of their last run and are ignored.
+ *
+ * @param s The #scheduler.
+ * @param verbose Are we talkative? The factors are reported if > 1.
+ */
+void scheduler_fit_cost_model(struct scheduler *s, int verbose) {
+
+  const ticks tic = getticks();
+  const int nr_tasks = s->nr_tasks;
+  const struct task *tasks = s->tasks;
+  const int nodeID = s->nodeID;
+  const ticks last_fit_tic = s->cost_model_tic;
+  const int nr_bins = task_type_count * task_subtype_count;
+
+  double *measured = (double *)calloc(nr_bins, sizeof(double));
+  double *model = (double *)calloc(nr_bins, sizeof(double));
+  int *counts = (int *)calloc(nr_bins, sizeof(int));
+  if (measured == NULL || model == NULL || counts == NULL)
+    error("Failed to allocate memory for the cost model fit.");
+
+  /* Collect the measured and analytic costs of all the tasks that ran */
+  double total_measured = 0., total_model = 0.;
+  for (int k = 0; k < nr_tasks; k++) {
+    const struct task *t = &tasks[k];
+
+    /* Did this task run since the last fit? */
+    if (t->implicit || t->toc <= t->tic || t->tic < last_fit_tic) continue;
+    if (t->type == task_type_send || t->type == task_type_recv) continue;
+
+    const float cost = scheduler_task_cost(t, nodeID);
+    if (cost <= 0.f) continue;
+
+    const int bin = t->type * task_subtype_count + t->subtype;
+    const double time = (double)(t->toc - t->tic);
+    measured[bin] += time;
+    model[bin] += cost;
+    counts[bin]++;
+    total_measured += time;
+    total_model += cost;
+  }
+
+  if (total_measured > 0. && total_model > 0.) {
+
+    const double norm = total_model / total_measured;
+
+    for (int i = 0; i < task_type_count; ++i) {
+      for (int j = 0; j < task_subtype_count; ++j) {
+        const int bin = i * task_subtype_count + j;
+
+        /* Not enough tasks to say anything meaningful? */
+        if (counts[bin] < scheduler_cost_model_min_tasks) continue;
+
+        float ratio = norm * measured[bin] / model[bin];
+        ratio = max(ratio, scheduler_cost_model_min_factor);
+        ratio = min(ratio, scheduler_cost_model_max_factor);
+
+        s->cost_model[i][j] =
+            (1.f - scheduler_cost_model_relaxation) * s->cost_model[i][j] +
+            scheduler_cost_model_relaxation * ratio;
+
+        if (verbose > 1)
+          message("Cost factor for %s/%s: %.3f (%d tasks)", taskID_names[i],
+                  subtaskID_names[j], s->cost_model[i][j], counts[bin]);
+      }
+    }
+  }
+
+  free(measured);
+  free(model);
+  free(counts);
+
+  /* The next fit only uses the tasks that start from now on. */
+  s->cost_model_tic = tic;
+
+  if (verbose)
+    message("took %.3f %s.", clocks_from_ticks(getticks() - tic),
+            clocks_getunit());
+}
+
+/**
+ * @brief Read the correction factors of the task cost model from a file.
+ *
+ * Used to seed the model with the factors fitted during a previous run.
+ * Unknown task types are silently ignored.
+ *
+ * @param s The #scheduler.
+ * @param filename The name of the file written by
+ * scheduler_write_cost_model().
+ */
+void scheduler_read_cost_model(struct scheduler *s, const char *filename) {
+
+  FILE *file = fopen(filename, "r");
+  if (file == NULL)
+    error("Could not open the task cost model file '%s'.", filename);
+
+  char line[PARSER_MAX_LINE_SIZE];
+  char type[PARSER_MAX_LINE_SIZE], subtype[PARSER_MAX_LINE_SIZE];
+  float factor;
+  int count = 0;
+  while (fgets(line, PARSER_MAX_LINE_SIZE, file) != NULL) {
+
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%s %s %f", type, subtype, &factor) != 3) continue;
+
+    for (int i = 0; i < task_type_count; ++i) {
+      if (strcmp(type, taskID_names[i]) != 0) continue;
+      for (int j = 0; j < task_subtype_count; ++j) {
+        if (strcmp(subtype, subtaskID_names[j]) != 0) continue;
+        s->cost_model[i][j] = factor;
+        count++;
+      }
     }
+  }
+  fclose(file);
+
+  message("Read %d task cost factors from '%s'.", count, filename);
+}
+
+/**
+ * @brief Write the correction factors of the task cost model to a file.
+ *
+ * Only the factors that differ from the analytic model are written.
+ *
+ * @param s The #scheduler.
+ * @param filename The name of the file to write to.
+ */
+void scheduler_write_cost_model(const struct scheduler *s,
+                                const char *filename) {
+
+  FILE *file = fopen(filename, "w");
+  if (file == NULL)
+    error("Could not create the task cost model file '%s'.", filename);
+
+  fprintf(file, "# task_type task_subtype cost_factor\n");
+  for (int i = 0; i < task_type_count; ++i)
+    for (int j = 0; j < task_subtype_count; ++j)
+      if (s->cost_model[i][j] != 1.f)
+        fprintf(file, "%s %s %f\n", taskID_names[i], subtaskID_names[j],
+                s->cost_model[i][j]);
+
+  fclose(file);
+}
+
+/**
+ * @brief Compute the task weights
+ *
+ * The weight of a task is its own cost plus the largest weight of the tasks
+ * it unlocks, i.e. the length of the critical path starting at this task.
+ * If adaptive weights are used, the analytic costs are corrected by the
+ * factors fitted to the measured run times (see scheduler_fit_cost_model()).
+ *
+ * @param s The #scheduler.
+ * @param verbose Are we talkative?
+ */
+void scheduler_reweight(struct scheduler *s, int verbose) {
+  const int nr_tasks = s->nr_tasks;
+  int *tid = s->tasks_ind;
+  struct task *tasks = s->tasks;
+  const int nodeID = s->nodeID;
+  const int adaptive_weights = s->adaptive_weights;
+  const ticks tic = getticks();
+
+  /* Run through the tasks backwards and set their weights. */
+  for (int k = nr_tasks - 1; k >= 0; k--) {
+    struct task *t = &tasks[tid[k]];
+    t->weight = 0.f;
+
+    for (int j = 0; j < t->nr_unlock_tasks; j++)
+      if (t->unlock_tasks[j]->weight > t->weight)
+        t->weight = t->unlock_tasks[j]->weight;
+
+    float cost = scheduler_task_cost(t, nodeID);
+    if (adaptive_weights) cost *= s->cost_model[t->type][t->subtype];
+
     t->weight += cost;
   }
 
@@ -1702,6 +1884,155 @@ void scheduler_start(struct scheduler *s) {
   pthread_mutex_unlock(&s->sleep_mutex);
 }
 
+#ifdef WITH_MPI
+/**
+ * @brief Hand a communication task whose request has been posted over to
+ * the MPI progress thread.
+ *
+ * @param s The #scheduler.
+ * @param t The send or recv #task.
+ */
+static void scheduler_mpi_handover(struct scheduler *s, struct task *t) {
+
+  pthread_mutex_lock(&s->mpi_inbox_mutex);
+
+  if (s->mpi_inbox_count == s->mpi_inbox_size) {
+    s->mpi_inbox_size *= 2;
+    struct task **temp = (struct task **)swift_malloc(
+        "mpi_inbox", sizeof(struct task *) * s->mpi_inbox_size);
+    if (temp == NULL) error("Failed to grow the MPI progress inbox.");
+    memcpy(temp, s->mpi_inbox, sizeof(struct task *) * s->mpi_inbox_count);
+    swift_free("mpi_inbox", s->mpi_inbox);
+    s->mpi_inbox = temp;
+  }
+  s->mpi_inbox[s->mpi_inbox_count++] = t;
+
+  pthread_cond_signal(&s->mpi_inbox_cond);
+  pthread_mutex_unlock(&s->mpi_inbox_mutex);
+}
+
+/**
+ * @brief Body of the MPI progress thread.
+ *
+ * Owns all the outstanding send and recv requests of this rank and drives
+ * them with MPI_Testsome(). Completed tasks are put on the queues the
+ * runners would have polled them from, so they are only picked up once they
+ * can run.
+ *
+ * @param data The #scheduler.
+ */
+static void *scheduler_mpi_progress(void *data) {
+
+  struct scheduler *s = (struct scheduler *)data;
+
+  int size = scheduler_init_mpi_requests;
+  int count = 0;
+  struct task **tasks = (struct task **)malloc(sizeof(struct task *) * size);
+  MPI_Request *reqs = (MPI_Request *)malloc(sizeof(MPI_Request) * size);
+  int *indices = (int *)malloc(sizeof(int) * size);
+  if (tasks == NULL || reqs == NULL || indices == NULL)
+    error("Failed to allocate MPI progress requests.");
+
+  while (1) {
+
+    /* Collect the newly posted requests, sleeping if there is nothing to
+     * do. */
+    pthread_mutex_lock(&s->mpi_inbox_mutex);
+    while (count == 0 && s->mpi_inbox_count == 0 && !s->mpi_progress_stop)
+      pthread_cond_wait(&s->mpi_inbox_cond, &s->mpi_inbox_mutex);
+    if (count == 0 && s->mpi_inbox_count == 0) {
+      pthread_mutex_unlock(&s->mpi_inbox_mutex);
+      break;
+    }
+    if (count + s->mpi_inbox_count > size) {
+      while (count + s->mpi_inbox_count > size) size *= 2;
+      if ((tasks = (struct task **)realloc(
+               tasks, sizeof(struct task *) * size)) == NULL ||
+          (reqs = (MPI_Request *)realloc(reqs, sizeof(MPI_Request) * size)) ==
+              NULL ||
+          (indices = (int *)realloc(indices, sizeof(int) * size)) == NULL)
+        error("Failed to grow MPI progress requests.");
+    }
+    for (int k = 0; k < s->mpi_inbox_count; k++) {
+      tasks[count] = s->mpi_inbox[k];
+      reqs[count] = s->mpi_inbox[k]->req;
+      count++;
+    }
+    s->mpi_inbox_count = 0;
+    pthread_mutex_unlock(&s->mpi_inbox_mutex);
+
+    /* Test all the requests we own in one go. */
+    int done = 0;
+    int err = MPI_Testsome(count, reqs, &done, indices, MPI_STATUSES_IGNORE);
+    if (err != MPI_SUCCESS)
+      mpi_error(err, "Failed to test the outstanding MPI requests.");
+    if (done == MPI_UNDEFINED) done = 0;
+
+    /* Release the completed tasks to the runners. */
+    for (int k = 0; k < done; k++) {
+      struct task *t = tasks[indices[k]];
+      t->req = MPI_REQUEST_NULL;
+      mpiuse_log_allocation(t->type, t->subtype, &t->req, 0, 0, 0, 0);
+      const int qid = (t->type == task_type_recv) ? 1 % s->nr_queues : 0;
+      queue_insert(&s->queues[qid], t);
+      tasks[indices[k]] = NULL;
+    }
+
+    if (done > 0) {
+
+      /* Remove the completed requests, keeping the others in order. */
+      int j = 0;
+      for (int k = 0; k < count; k++) {
+        if (tasks[k] == NULL) continue;
+        tasks[j] = tasks[k];
+        reqs[j] = reqs[k];
+        j++;
+      }
+      count = j;
+
+      /* Wake up the runners. */
+      pthread_mutex_lock(&s->sleep_mutex);
+      pthread_cond_broadcast(&s->sleep_cond);
+      pthread_mutex_unlock(&s->sleep_mutex);
+
+    } else {
+      sched_yield();
+    }
+  }
+
+  free(tasks);
+  free(reqs);
+  free(indices);
+  return NULL;
+}
+
+/**
+ * @brief Start the thread driving the MPI requests of this #scheduler, if
+ * requested.
+ *
+ * @param s The #scheduler.
+ */
+void scheduler_start_mpi_progress(struct scheduler *s) {
+
+  if (!s->mpi_progress_thread) return;
+
+  s->mpi_inbox_size = scheduler_init_mpi_requests;
+  s->mpi_inbox_count = 0;
+  if ((s->mpi_inbox = (struct task **)swift_malloc(
+           "mpi_inbox", sizeof(struct task *) * s->mpi_inbox_size)) == NULL)
+    error("Failed to allocate the MPI progress inbox.");
+
+  if (pthread_mutex_init(&s->mpi_inbox_mutex, NULL) != 0 ||
+      pthread_cond_init(&s->mpi_inbox_cond, NULL) != 0)
+    error("Failed to initialize the MPI progress inbox lock.");
+
+  s->mpi_progress_stop = 0;
+  if (pthread_create(&s->mpi_progress_pthread, NULL, &scheduler_mpi_progress,
+                     s) != 0)
+    error("Failed to create the MPI progress thread.");
+}
+#endif
+
 /**
  * @brief Put a task on one of the queues.
  *
@@ -2012,6 +2343,16 @@ void scheduler_enqueue(struct scheduler *s, struct task *t) {
     /* Increase the waiting counter. */
     atomic_inc(&s->waiting);
 
+#ifdef WITH_MPI
+    /* Communications are handed to the progress thread, which queues them
+     * once their request has completed. */
+    if (s->mpi_progress_thread &&
+        (t->type == task_type_send || t->type == task_type_recv)) {
+      scheduler_mpi_handover(s, t);
+      return;
+    }
+#endif
+
     /* Insert the task into that queue. */
     queue_insert(&s->queues[qid], t);
   }
@@ -2144,9 +2485,12 @@ struct task *scheduler_gettask(struct scheduler *s, int qid,
           TIMER_TIC
           res = queue_gettask(&s->queues[qids[ind]], prev, 0);
           TIMER_TOC(timer_qsteal);
-          if (res != NULL)
+          if (res != NULL) {
+            if (task_trace_active)
+              task_trace_log_local(task_trace_event_steal, res->type,
+                                   res->subtype, qids[ind]);
             break;
-          else
+          } else
             qids[ind] = qids[--count];
         }
         if (res != NULL) break;
@@ -2155,7 +2499,7 @@ struct task *scheduler_gettask(struct scheduler *s, int qid,
 
 /* If we failed, take a short nap. */
 #ifdef WITH_MPI
-    if (res == NULL && qid > 1)
+    if (res == NULL && (qid > 1 || s->mpi_progress_thread))
 #else
     if (res == NULL)
 #endif
@@ -2227,6 +2571,15 @@ void scheduler_init(struct scheduler *s, struct space *space, int nr_tasks,
   s->space = space;
   s->nodeID = nodeID;
   s->threadpool = tp;
+#ifdef WITH_MPI
+  s->mpi_progress_thread = 0;
+#endif
+
+  /* Start with the analytic task costs. */
+  s->adaptive_weights = 0;
+  for (int i = 0; i < task_type_count; ++i)
+    for (int j = 0; j < task_subtype_count; ++j) s->cost_model[i][j] = 1.f;
+  s->cost_model_tic = 0;
 
   /* Init the tasks array. */
   s->size = 0;
@@ -2264,6 +2617,18 @@ void scheduler_print_tasks(const struct scheduler *s, const char *fileName) {
  * @brief Frees up the memory allocated for this #scheduler
  */
 void scheduler_clean(struct scheduler *s) {
+#ifdef WITH_MPI
+  if (s->mpi_progress_thread) {
+    pthread_mutex_lock(&s->mpi_inbox_mutex);
+    s->mpi_progress_stop = 1;
+    pthread_cond_signal(&s->mpi_inbox_cond);
+    pthread_mutex_unlock(&s->mpi_inbox_mutex);
+    if (pthread_join(s->mpi_progress_pthread, NULL) != 0)
+      error("Failed to join the MPI progress thread.");
+    swift_free("mpi_inbox", s->mpi_inbox);
+    s->mpi_progress_thread = 0;
+  }
+#endif
   scheduler_free_tasks(s);
   swift_free("unlocks", s->unlocks);
   swift_free("unlock_ind", s->unlock_ind);
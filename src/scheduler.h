@@ -42,9 +42,14 @@
 /* Some constants. */
 #define scheduler_maxwait 3
 #define scheduler_init_nr_unlocks 10000
+#define scheduler_init_mpi_requests 1024
 #define scheduler_dosub 1
 #define scheduler_maxsteal 10
 #define scheduler_maxtries 2
+#define scheduler_cost_model_min_tasks 8
+#define scheduler_cost_model_relaxation 0.5f
+#define scheduler_cost_model_min_factor 1e-3f
+#define scheduler_cost_model_max_factor 1e3f
 #define scheduler_doforcesplit            \
   0 /* Beware: switching this on can/will \
        break engine_addlink as it assumes \
@@ -106,11 +111,39 @@ struct scheduler {
    * MPI. */
   size_t mpi_message_limit;
 
+#ifdef WITH_MPI
+  /* Is a dedicated thread driving the progress of the MPI requests? */
+  int mpi_progress_thread;
+
+  /* Communication tasks handed over to the progress thread. */
+  struct task **mpi_inbox;
+  int mpi_inbox_count, mpi_inbox_size;
+
+  /* Lock and condition protecting the hand-over. */
+  pthread_mutex_t mpi_inbox_mutex;
+  pthread_cond_t mpi_inbox_cond;
+
+  /* The progress thread and the flag telling it to stop. */
+  pthread_t mpi_progress_pthread;
+  volatile int mpi_progress_stop;
+#endif
+
   /* 'Pointer' to the seed for the random number generator */
   pthread_key_t local_seed_pointer;
 
   /* Total ticks spent running the tasks */
   ticks total_ticks;
+
+  /* Are we correcting the analytic task costs with measured run times? */
+  int adaptive_weights;
+
+  /* Correction factors to the analytic cost of each task type and sub-type
+   * fitted from the measured run times. */
+  float cost_model[task_type_count][task_subtype_count];
+
+  /* Time of the last fit of the cost model. Only the tasks that started after
+   * it are used in the next fit. */
+  ticks cost_model_tic;
 };
 
 /* Inlined functions (for speed). */
@@ -190,6 +223,10 @@ void scheduler_start(struct scheduler *s);
 void scheduler_reset(struct scheduler *s, int nr_tasks);
 void scheduler_ranktasks(struct scheduler *s);
 void scheduler_reweight(struct scheduler *s, int verbose);
+void scheduler_fit_cost_model(struct scheduler *s, int verbose);
+void scheduler_read_cost_model(struct scheduler *s, const char *filename);
+void scheduler_write_cost_model(const struct scheduler *s,
+                                const char *filename);
 struct task *scheduler_addtask(struct scheduler *s, enum task_types type,
                                enum task_subtypes subtype, int flags,
                                int implicit, struct cell *ci, struct cell *cj);
@@ -202,6 +239,7 @@ void scheduler_set_unlocks(struct scheduler *s);
 void scheduler_dump_queue(struct scheduler *s);
 void scheduler_print_tasks(const struct scheduler *s, const char *fileName);
 void scheduler_clean(struct scheduler *s);
+void scheduler_start_mpi_progress(struct scheduler *s);
 void scheduler_free_tasks(struct scheduler *s);
 void scheduler_write_dependencies(struct scheduler *s, int verbose);
 void scheduler_write_task_level(const struct scheduler *s);
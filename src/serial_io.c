@@ -66,7 +66,11 @@
 /**
  * @brief Reads a data array from a given HDF5 group.
  *
+ * The data set is read in slabs, which are converted and copied into the
+ * particles by the threads of the #threadpool whilst the next slab is read.
+ *
  * @param grp The group from which to read.
+ * @param tp The #threadpool used to convert the data.
  * @param props The #io_props of the field to read
  * @param N The number of particles to read on this rank.
  * @param N_total The total number of particles on all ranks.
@@ -78,11 +82,9 @@
  * IC velocities?
  * @param h The value of the reduced Hubble constant to use for cleaning.
  * @param a The current value of the scale-factor.
- *
- * @todo A better version using HDF5 hyper-slabs to read the file directly into
- * the part array will be written once the structures have been stabilized.
  */
-void read_array_serial(hid_t grp, const struct io_props props, size_t N,
+void read_array_serial(hid_t grp, struct threadpool* tp,
+                       const struct io_props props, size_t N,
                        long long N_total, long long offset,
                        const struct unit_system* internal_units,
                        const struct unit_system* ic_units, int cleanup_h,
@@ -90,7 +92,6 @@ void read_array_serial(hid_t grp, const struct io_props props, size_t N,
 
   const size_t typeSize = io_sizeof_type(props.type);
   const size_t copySize = typeSize * props.dimension;
-  const size_t num_elements = N * props.dimension;
 
   /* Check whether the dataspace exists or not */
   const htri_t exist = H5Lexists(grp, props.name, 0);
@@ -114,128 +115,11 @@ void read_array_serial(hid_t grp, const struct io_props props, size_t N,
   const hid_t h_data = H5Dopen(grp, props.name, H5P_DEFAULT);
   if (h_data < 0) error("Error while opening data space '%s'.", props.name);
 
-  /* Allocate temporary buffer */
-  void* temp = malloc(num_elements * typeSize);
-  if (temp == NULL) error("Unable to allocate memory for temporary buffer");
+  /* Read, convert and copy this rank's data slab by slab */
+  io_read_array_slabs(tp, h_data, props, N, offset, internal_units, ic_units,
+                      cleanup_h, cleanup_sqrt_a, h, a);
 
-  /* Prepare information for hyper-slab */
-  hsize_t shape[2], offsets[2];
-  int rank;
-  if (props.dimension > 1) {
-    rank = 2;
-    shape[0] = N;
-    shape[1] = props.dimension;
-    offsets[0] = offset;
-    offsets[1] = 0;
-  } else {
-    rank = 2;
-    shape[0] = N;
-    shape[1] = 1;
-    offsets[0] = offset;
-    offsets[1] = 0;
-  }
-
-  /* Create data space in memory */
-  const hid_t h_memspace = H5Screate_simple(rank, shape, NULL);
-
-  /* Select hyper-slab in file */
-  const hid_t h_filespace = H5Dget_space(h_data);
-  H5Sselect_hyperslab(h_filespace, H5S_SELECT_SET, offsets, NULL, shape, NULL);
-
-  /* Read HDF5 dataspace in temporary buffer */
-  /* Dirty version that happens to work for vectors but should be improved */
-  /* Using HDF5 dataspaces would be better */
-  const hid_t h_err = H5Dread(h_data, io_hdf5_type(props.type), h_memspace,
-                              h_filespace, H5P_DEFAULT, temp);
-  if (h_err < 0) error("Error while reading data array '%s'.", props.name);
-
-  /* Unit conversion if necessary */
-  const double factor =
-      units_conversion_factor(ic_units, internal_units, props.units);
-  if (factor != 1. && exist != 0) {
-
-    /* message("Converting ! factor=%e", factor); */
-
-    if (io_is_double_precision(props.type)) {
-      double* temp_d = (double*)temp;
-      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= factor;
-    } else {
-      float* temp_f = (float*)temp;
-
-#ifdef SWIFT_DEBUG_CHECKS
-      float maximum = 0.f;
-      float minimum = FLT_MAX;
-#endif
-
-      /* Loop that converts the Units */
-      for (size_t i = 0; i < num_elements; ++i) {
-
-#ifdef SWIFT_DEBUG_CHECKS
-        /* Find the absolute minimum and maximum values */
-        const float abstemp_f = fabsf(temp_f[i]);
-        if (abstemp_f != 0.f) {
-          maximum = max(maximum, abstemp_f);
-          minimum = min(minimum, abstemp_f);
-        }
-#endif
-
-        /* Convert the float units */
-        temp_f[i] *= factor;
-      }
-
-#ifdef SWIFT_DEBUG_CHECKS
-      /* The two possible errors: larger than float or smaller
-       * than float precision. */
-      if (factor * maximum > FLT_MAX) {
-        error("Unit conversion results in numbers larger than floats");
-      } else if (factor * minimum < FLT_MIN) {
-        error("Numbers smaller than float precision");
-      }
-#endif
-    }
-  }
-
-  /* Clean-up h if necessary */
-  const float h_factor_exp = units_h_factor(internal_units, props.units);
-  if (cleanup_h && h_factor_exp != 0.f && exist != 0) {
-
-    /* message("Multipltying '%s' by h^%f=%f", props.name, h_factor_exp,
-     * h_factor); */
-
-    if (io_is_double_precision(props.type)) {
-      double* temp_d = (double*)temp;
-      const double h_factor = pow(h, h_factor_exp);
-      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= h_factor;
-    } else {
-      float* temp_f = (float*)temp;
-      const float h_factor = pow(h, h_factor_exp);
-      for (size_t i = 0; i < num_elements; ++i) temp_f[i] *= h_factor;
-    }
-  }
-
-  /* Clean-up a if necessary */
-  if (cleanup_sqrt_a && a != 1. && (strcmp(props.name, "Velocities") == 0)) {
-
-    if (io_is_double_precision(props.type)) {
-      double* temp_d = (double*)temp;
-      const double vel_factor = sqrt(a);
-      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= vel_factor;
-    } else {
-      float* temp_f = (float*)temp;
-      const float vel_factor = sqrt(a);
-      for (size_t i = 0; i < num_elements; ++i) temp_f[i] *= vel_factor;
-    }
-  }
-
-  /* Copy temporary buffer to particle data */
-  char* temp_c = (char*)temp;
-  for (size_t i = 0; i < N; ++i)
-    memcpy(props.field + i * props.partSize, &temp_c[i * copySize], copySize);
-
-  /* Free and close everything */
-  free(temp);
-  H5Sclose(h_filespace);
-  H5Sclose(h_memspace);
+  /* Close everything */
   H5Dclose(h_data);
 }
 
@@ -243,6 +127,7 @@ void prepare_array_serial(const struct engine* e, hid_t grp, char* fileName,
                           FILE* xmfFile, char* partTypeGroupName,
                           const struct io_props props,
                           unsigned long long N_total,
+                          const enum compression_levels lossy_level,
                           const struct unit_system* internal_units,
                           const struct unit_system* snapshot_units) {
 
@@ -251,8 +136,12 @@ void prepare_array_serial(const struct engine* e, hid_t grp, char* fileName,
   if (h_space < 0)
     error("Error while creating data space for field '%s'.", props.name);
 
+  /* Lossy fields are always compressed */
+  const int deflate_level = io_compression_deflate_level(
+      e->output_options, &props, lossy_level, e->snapshot_compression);
+
   /* Decide what chunk size to use based on compression */
-  int log2_chunk_size = e->snapshot_compression > 0 ? 12 : 18;
+  int log2_chunk_size = deflate_level > 0 ? 12 : 18;
 
   int rank = 0;
   hsize_t shape[2];
@@ -294,13 +183,13 @@ void prepare_array_serial(const struct engine* e, hid_t grp, char* fileName,
     error("Error while setting checksum options for field '%s'.", props.name);
 
   /* Impose data compression */
-  if (e->snapshot_compression > 0) {
+  if (deflate_level > 0) {
     h_err = H5Pset_shuffle(h_prop);
     if (h_err < 0)
       error("Error while setting shuffling options for field '%s'.",
             props.name);
 
-    h_err = H5Pset_deflate(h_prop, e->snapshot_compression);
+    h_err = H5Pset_deflate(h_prop, deflate_level);
     if (h_err < 0)
       error("Error while setting compression options for field '%s'.",
             props.name);
@@ -351,6 +240,10 @@ void prepare_array_serial(const struct engine* e, hid_t grp, char* fileName,
   /* Write the full description */
   io_write_attribute_s(h_data, "Description", props.description);
 
+  /* Write the lossy compression applied, if any */
+  io_compression_write_attributes(e->output_options, h_data, &props,
+                                  lossy_level);
+
   /* Close everything */
   H5Pclose(h_prop);
   H5Dclose(h_data);
@@ -371,6 +264,7 @@ void prepare_array_serial(const struct engine* e, hid_t grp, char* fileName,
  * @param N_total The total number of particles on all ranks.
  * @param offset The offset position where this rank starts writing.
  * @param mpi_rank The MPI rank of this node
+ * @param lossy_level The #compression_levels to apply to this field.
  * @param internal_units The #unit_system used internally
  * @param snapshot_units The #unit_system used in the snapshots
  *
@@ -381,6 +275,7 @@ void write_array_serial(const struct engine* e, hid_t grp, char* fileName,
                         FILE* xmfFile, char* partTypeGroupName,
                         const struct io_props props, size_t N,
                         long long N_total, int mpi_rank, long long offset,
+                        const enum compression_levels lossy_level,
                         const struct unit_system* internal_units,
                         const struct unit_system* snapshot_units) {
 
@@ -392,7 +287,7 @@ void write_array_serial(const struct engine* e, hid_t grp, char* fileName,
   /* Prepare the arrays in the file */
   if (mpi_rank == 0)
     prepare_array_serial(e, grp, fileName, xmfFile, partTypeGroupName, props,
-                         N_total, internal_units, snapshot_units);
+                         N_total, lossy_level, internal_units, snapshot_units);
 
   /* Allocate temporary buffer */
   void* temp = NULL;
@@ -402,6 +297,7 @@ void write_array_serial(const struct engine* e, hid_t grp, char* fileName,
 
   /* Copy the particle data to the temporary buffer */
   io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
+  io_compression_apply(e->output_options, temp, &props, N, lossy_level);
 
   /* Construct information for the hyper-slab */
   int rank;
@@ -729,6 +625,10 @@ void read_ic_serial(char* fileName, const struct unit_system* internal_units,
   /* For dry runs, only need to do this on rank 0 */
   if (dry_run) mpi_size = 1;
 
+  /* Let's initialise a bit of thread parallelism here */
+  struct threadpool tp;
+  threadpool_init(&tp, n_threads);
+
   /* Now loop over ranks and read the data */
   for (int rank = 0; rank < mpi_size; ++rank) {
 
@@ -817,9 +717,9 @@ void read_ic_serial(char* fileName, const struct unit_system* internal_units,
             if (remap_ids && strcmp(list[i].name, "ParticleIDs") == 0) continue;
 
             /* Read array. */
-            read_array_serial(h_grp, list[i], Nparticles, N_total[ptype],
-                              offset[ptype], internal_units, ic_units,
-                              cleanup_h, cleanup_sqrt_a, h, a);
+            read_array_serial(h_grp, &tp, list[i], Nparticles,
+                              N_total[ptype], offset[ptype], internal_units,
+                              ic_units, cleanup_h, cleanup_sqrt_a, h, a);
           }
 
         /* Close particle group */
@@ -840,10 +740,6 @@ void read_ic_serial(char* fileName, const struct unit_system* internal_units,
   /* Duplicate the parts for gravity */
   if (!dry_run && with_gravity) {
 
-    /* Let's initialise a bit of thread parallelism here */
-    struct threadpool tp;
-    threadpool_init(&tp, n_threads);
-
     /* Prepare the DM particles */
     io_prepare_dm_gparts(&tp, *gparts, Ndm);
 
@@ -870,10 +766,10 @@ void read_ic_serial(char* fileName, const struct unit_system* internal_units,
       io_duplicate_black_holes_gparts(
           &tp, *bparts, *gparts, *Nblackholes,
           Ndm + Ndm_background + *Ngas + *Nsinks + *Nstars);
-
-    threadpool_clean(&tp);
   }
 
+  threadpool_clean(&tp);
+
   /* message("Done Reading particles..."); */
 
   /* Clean up */
@@ -1130,11 +1026,17 @@ void write_output_serial(struct engine* e,
     if (h_grp_cells < 0) error("Error while creating cells group");
   }
 
+  /* Name of the stand-alone cell index file, if requested */
+  char indexFileName[1024];
+  if (e->snapshot_cell_index_file)
+    io_get_cell_index_filename(indexFileName, fileName);
+
   /* Write the location of the particles in the arrays */
   io_write_cell_offsets(h_grp_cells, e->s->cdim, e->s->dim, e->s->pos_dithering,
                         e->s->cells_top, e->s->nr_cells, e->s->width, mpi_rank,
                         /*distributed=*/0, N_total, offset, numFields,
-                        internal_units, snapshot_units);
+                        internal_units, snapshot_units,
+                        e->snapshot_cell_index_file ? indexFileName : NULL);
 
   /* Close everything */
   if (mpi_rank == 0) {
@@ -1494,14 +1396,16 @@ void write_output_serial(struct engine* e,
         for (int i = 0; i < num_fields; ++i) {
 
           /* Did the user cancel this field? */
-          const int should_write = output_options_should_write_field(
-              output_options, current_selection_name, list[i].name,
-              (enum part_type)ptype, compression_level_current_default);
+          const enum compression_levels compression_level =
+              output_options_should_write_field(
+                  output_options, current_selection_name, list[i].name,
+                  (enum part_type)ptype, compression_level_current_default);
 
-          if (should_write) {
+          if (compression_level != compression_do_not_write) {
             write_array_serial(e, h_grp, fileName, xmfFile, partTypeGroupName,
                                list[i], Nparticles, N_total[ptype], mpi_rank,
-                               offset[ptype], internal_units, snapshot_units);
+                               offset[ptype], compression_level, internal_units,
+                               snapshot_units);
             num_fields_written++;
           }
         }
@@ -1519,7 +1423,7 @@ void write_output_serial(struct engine* e,
         if (gpart_group_data_written)
           swift_free("gpart_group_written", gpart_group_data_written);
         if (sparts_written) swift_free("sparts_written", sparts_written);
-        if (bparts_written) swift_free("bparts_written", sparts_written);
+        if (bparts_written) swift_free("bparts_written", bparts_written);
         if (sinks_written) swift_free("sinks_written", sinks_written);
 
         /* Close particle group */
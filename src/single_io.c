@@ -65,7 +65,11 @@
 /**
  * @brief Reads a data array from a given HDF5 group.
  *
+ * The data set is read in slabs, which are converted and copied into the
+ * particles by the threads of the #threadpool whilst the next slab is read.
+ *
  * @param h_grp The group from which to read.
+ * @param tp The #threadpool used to convert the data.
  * @param prop The #io_props of the field to read
  * @param N The number of particles.
  * @param internal_units The #unit_system used internally
@@ -75,18 +79,15 @@
  * IC velocities?
  * @param h The value of the reduced Hubble constant.
  * @param a The current value of the scale-factor.
- *
- * @todo A better version using HDF5 hyper-slabs to read the file directly into
- * the part array will be written once the structures have been stabilized.
  */
-void read_array_single(hid_t h_grp, const struct io_props props, size_t N,
+void read_array_single(hid_t h_grp, struct threadpool* tp,
+                       const struct io_props props, size_t N,
                        const struct unit_system* internal_units,
                        const struct unit_system* ic_units, int cleanup_h,
                        int cleanup_sqrt_a, double h, double a) {
 
   const size_t typeSize = io_sizeof_type(props.type);
   const size_t copySize = typeSize * props.dimension;
-  const size_t num_elements = N * props.dimension;
 
   /* Check whether the dataspace exists or not */
   const htri_t exist = H5Lexists(h_grp, props.name, 0);
@@ -114,103 +115,11 @@ void read_array_single(hid_t h_grp, const struct io_props props, size_t N,
   const hid_t h_data = H5Dopen(h_grp, props.name, H5P_DEFAULT);
   if (h_data < 0) error("Error while opening data space '%s'.", props.name);
 
-  /* Allocate temporary buffer */
-  void* temp = malloc(num_elements * typeSize);
-  if (temp == NULL) error("Unable to allocate memory for temporary buffer");
-
-  /* Read HDF5 dataspace in temporary buffer */
-  /* Dirty version that happens to work for vectors but should be improved */
-  /* Using HDF5 dataspaces would be better */
-  const hid_t h_err = H5Dread(h_data, io_hdf5_type(props.type), H5S_ALL,
-                              H5S_ALL, H5P_DEFAULT, temp);
-  if (h_err < 0) error("Error while reading data array '%s'.", props.name);
-
-  /* Unit conversion if necessary */
-  const double unit_factor =
-      units_conversion_factor(ic_units, internal_units, props.units);
-  if (unit_factor != 1. && exist != 0) {
-
-    /* message("Converting ! factor=%e", factor); */
-
-    if (io_is_double_precision(props.type)) {
-      double* temp_d = (double*)temp;
-      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= unit_factor;
-
-    } else {
-      float* temp_f = (float*)temp;
-
-#ifdef SWIFT_DEBUG_CHECKS
-      float maximum = 0.f;
-      float minimum = FLT_MAX;
-#endif
-
-      /* Loop that converts the Units */
-      for (size_t i = 0; i < num_elements; ++i) {
-
-#ifdef SWIFT_DEBUG_CHECKS
-        /* Find the absolute minimum and maximum values */
-        const float abstemp_f = fabsf(temp_f[i]);
-        if (abstemp_f != 0.f) {
-          maximum = max(maximum, abstemp_f);
-          minimum = min(minimum, abstemp_f);
-        }
-#endif
-
-        /* Convert the float units */
-        temp_f[i] *= unit_factor;
-      }
-
-#ifdef SWIFT_DEBUG_CHECKS
-      /* The two possible errors: larger than float or smaller
-       * than float precision. */
-      if (unit_factor * maximum > FLT_MAX) {
-        error("Unit conversion results in numbers larger than floats");
-      } else if (unit_factor * minimum < FLT_MIN) {
-        error("Numbers smaller than float precision");
-      }
-#endif
-    }
-  }
+  /* Read, convert and copy the data slab by slab */
+  io_read_array_slabs(tp, h_data, props, N, /*offset=*/0, internal_units,
+                      ic_units, cleanup_h, cleanup_sqrt_a, h, a);
 
-  /* Clean-up h if necessary */
-  const float h_factor_exp = units_h_factor(internal_units, props.units);
-  if (cleanup_h && h_factor_exp != 0.f && exist != 0) {
-
-    /* message("Multipltying '%s' by h^%f=%f", props.name, h_factor_exp,
-     * h_factor); */
-
-    if (io_is_double_precision(props.type)) {
-      double* temp_d = (double*)temp;
-      const double h_factor = pow(h, h_factor_exp);
-      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= h_factor;
-    } else {
-      float* temp_f = (float*)temp;
-      const float h_factor = pow(h, h_factor_exp);
-      for (size_t i = 0; i < num_elements; ++i) temp_f[i] *= h_factor;
-    }
-  }
-
-  /* Clean-up a if necessary */
-  if (cleanup_sqrt_a && a != 1. && (strcmp(props.name, "Velocities") == 0)) {
-
-    if (io_is_double_precision(props.type)) {
-      double* temp_d = (double*)temp;
-      const double vel_factor = sqrt(a);
-      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= vel_factor;
-    } else {
-      float* temp_f = (float*)temp;
-      const float vel_factor = sqrt(a);
-      for (size_t i = 0; i < num_elements; ++i) temp_f[i] *= vel_factor;
-    }
-  }
-
-  /* Copy temporary buffer to particle data */
-  char* temp_c = (char*)temp;
-  for (size_t i = 0; i < N; ++i)
-    memcpy(props.field + i * props.partSize, &temp_c[i * copySize], copySize);
-
-  /* Free and close everything */
-  free(temp);
+  /* Close everything */
   H5Dclose(h_data);
 }
 
@@ -225,6 +134,7 @@ void read_array_single(hid_t h_grp, const struct io_props props, size_t N,
  * the HDF5 file.
  * @param props The #io_props of the field to read
  * @param N The number of particles to write.
+ * @param lossy_level The #compression_levels to apply to this field.
  * @param internal_units The #unit_system used internally
  * @param snapshot_units The #unit_system used in the snapshots
  *
@@ -234,30 +144,23 @@ void read_array_single(hid_t h_grp, const struct io_props props, size_t N,
 void write_array_single(const struct engine* e, hid_t grp, char* fileName,
                         FILE* xmfFile, char* partTypeGroupName,
                         const struct io_props props, size_t N,
+                        const enum compression_levels lossy_level,
                         const struct unit_system* internal_units,
                         const struct unit_system* snapshot_units) {
 
-  const size_t typeSize = io_sizeof_type(props.type);
-  const size_t num_elements = N * props.dimension;
-
   /* message("Writing '%s' array...", props.name); */
 
-  /* Allocate temporary buffer */
-  void* temp = NULL;
-  if (swift_memalign("writebuff", (void**)&temp, IO_BUFFER_ALIGNMENT,
-                     num_elements * typeSize) != 0)
-    error("Unable to allocate temporary i/o buffer");
-
-  /* Copy the particle data to the temporary buffer */
-  io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
-
   /* Create data space */
   const hid_t h_space = H5Screate(H5S_SIMPLE);
   if (h_space < 0)
     error("Error while creating data space for field '%s'.", props.name);
 
+  /* Lossy fields are always compressed */
+  const int deflate_level = io_compression_deflate_level(
+      e->output_options, &props, lossy_level, e->snapshot_compression);
+
   /* Decide what chunk size to use based on compression */
-  int log2_chunk_size = e->snapshot_compression > 0 ? 12 : 18;
+  int log2_chunk_size = deflate_level > 0 ? 12 : 18;
 
   int rank;
   hsize_t shape[2];
@@ -300,13 +203,13 @@ void write_array_single(const struct engine* e, hid_t grp, char* fileName,
     error("Error while setting checksum options for field '%s'.", props.name);
 
   /* Impose data compression */
-  if (e->snapshot_compression > 0) {
+  if (deflate_level > 0) {
     h_err = H5Pset_shuffle(h_prop);
     if (h_err < 0)
       error("Error while setting shuffling options for field '%s'.",
             props.name);
 
-    h_err = H5Pset_deflate(h_prop, e->snapshot_compression);
+    h_err = H5Pset_deflate(h_prop, deflate_level);
     if (h_err < 0)
       error("Error while setting compression options for field '%s'.",
             props.name);
@@ -317,10 +220,9 @@ void write_array_single(const struct engine* e, hid_t grp, char* fileName,
                                  h_space, H5P_DEFAULT, h_prop, H5P_DEFAULT);
   if (h_data < 0) error("Error while creating dataspace '%s'.", props.name);
 
-  /* Write temporary buffer to HDF5 dataspace */
-  h_err = H5Dwrite(h_data, io_hdf5_type(props.type), h_space, H5S_ALL,
-                   H5P_DEFAULT, temp);
-  if (h_err < 0) error("Error while writing data array '%s'.", props.name);
+  /* Convert the particle data and write them to the dataset */
+  io_write_array_buffered(e, h_data, h_space, props, N, lossy_level,
+                          internal_units, snapshot_units);
 
   /* Write XMF description for this data set */
   if (xmfFile != NULL)
@@ -362,8 +264,11 @@ void write_array_single(const struct engine* e, hid_t grp, char* fileName,
   /* Write the full description */
   io_write_attribute_s(h_data, "Description", props.description);
 
+  /* Write the lossy compression applied, if any */
+  io_compression_write_attributes(e->output_options, h_data, &props,
+                                  lossy_level);
+
   /* Free and close everything */
-  swift_free("writebuff", temp);
   H5Pclose(h_prop);
   H5Dclose(h_data);
   H5Sclose(h_space);
@@ -611,6 +516,10 @@ void read_ic_single(const char* fileName,
   /* message("BoxSize = %lf", dim[0]); */
   /* message("NumPart = [%zd, %zd] Total = %zd", *Ngas, Ndm, *Ngparts); */
 
+  /* Let's initialise a bit of thread parallelism here */
+  struct threadpool tp;
+  threadpool_init(&tp, n_threads);
+
   /* Loop over all particle types */
   for (int ptype = 0; ptype < swift_type_count; ptype++) {
 
@@ -686,8 +595,8 @@ void read_ic_single(const char* fileName,
         if (remap_ids && strcmp(list[i].name, "ParticleIDs") == 0) continue;
 
         /* Read array. */
-        read_array_single(h_grp, list[i], Nparticles, internal_units, ic_units,
-                          cleanup_h, cleanup_sqrt_a, h, a);
+        read_array_single(h_grp, &tp, list[i], Nparticles, internal_units,
+                          ic_units, cleanup_h, cleanup_sqrt_a, h, a);
       }
 
     /* Close particle group */
@@ -700,10 +609,6 @@ void read_ic_single(const char* fileName,
   /* Duplicate the parts for gravity */
   if (!dry_run && with_gravity) {
 
-    /* Let's initialise a bit of thread parallelism here */
-    struct threadpool tp;
-    threadpool_init(&tp, n_threads);
-
     /* Prepare the DM particles */
     io_prepare_dm_gparts(&tp, *gparts, Ndm);
 
@@ -730,10 +635,10 @@ void read_ic_single(const char* fileName,
       io_duplicate_black_holes_gparts(
           &tp, *bparts, *gparts, *Nblackholes,
           Ndm + Ndm_background + *Ngas + *Nsinks + *Nstars);
-
-    threadpool_clean(&tp);
   }
 
+  threadpool_clean(&tp);
+
   /* message("Done Reading particles..."); */
 
   /* Clean up */
@@ -929,11 +834,17 @@ void write_output_single(struct engine* e,
   h_grp = H5Gcreate(h_file, "/Cells", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
   if (h_grp < 0) error("Error while creating cells group");
 
+  /* Name of the stand-alone cell index file, if requested */
+  char indexFileName[1024];
+  if (e->snapshot_cell_index_file)
+    io_get_cell_index_filename(indexFileName, fileName);
+
   /* Write the location of the particles in the arrays */
   io_write_cell_offsets(h_grp, e->s->cdim, e->s->dim, e->s->pos_dithering,
                         e->s->cells_top, e->s->nr_cells, e->s->width, e->nodeID,
                         /*distributed=*/0, N_total, global_offsets, numFields,
-                        internal_units, snapshot_units);
+                        internal_units, snapshot_units,
+                        e->snapshot_cell_index_file ? indexFileName : NULL);
   H5Gclose(h_grp);
 
   /* Loop over all particle types */
@@ -1274,13 +1185,15 @@ void write_output_single(struct engine* e,
     for (int i = 0; i < num_fields; ++i) {
 
       /* Did the user cancel this field? */
-      const int should_write = output_options_should_write_field(
-          output_options, current_selection_name, list[i].name,
-          (enum part_type)ptype, compression_level_current_default);
+      const enum compression_levels compression_level =
+          output_options_should_write_field(
+              output_options, current_selection_name, list[i].name,
+              (enum part_type)ptype, compression_level_current_default);
 
-      if (should_write) {
+      if (compression_level != compression_do_not_write) {
         write_array_single(e, h_grp, fileName, xmfFile, partTypeGroupName,
-                           list[i], N, internal_units, snapshot_units);
+                           list[i], N, compression_level, internal_units,
+                           snapshot_units);
         num_fields_written++;
       }
     }
@@ -712,6 +712,24 @@ void space_regrid(struct space *s, int verbose) {
             clocks_getunit());
 }
 
+/**
+ * @brief Size to give to a particle array that must be re-allocated to hold
+ * a given number of particles.
+ *
+ * Leaves the usual margin for future growth unless the new array would then
+ * not fit in the memory budget.
+ *
+ * @param required The number of particles the array must hold.
+ * @param particle_size The memory needed per particle in bytes.
+ */
+static size_t space_extras_alloc_size(const size_t required,
+                                      const size_t particle_size) {
+
+  const size_t size = required * engine_redistribute_alloc_margin;
+  if (memuse_budget_allows(size * particle_size)) return size;
+  return required;
+}
+
 /**
  * @brief Allocate memory for the extra particles used for on-the-fly creation.
  *
@@ -814,8 +832,8 @@ void space_allocate_extras(struct space *s, int verbose) {
     /* Do we need to reallocate? */
     if (nr_actual_gparts + expected_num_extra_gparts > size_gparts) {
 
-      size_gparts = (nr_actual_gparts + expected_num_extra_gparts) *
-                    engine_redistribute_alloc_margin;
+      size_gparts = space_extras_alloc_size(
+          nr_actual_gparts + expected_num_extra_gparts, sizeof(struct gpart));
 
       if (verbose)
         message("Re-allocating gparts array from %zd to %zd", s->size_gparts,
@@ -912,8 +930,9 @@ void space_allocate_extras(struct space *s, int verbose) {
     /* Do we need to reallocate? */
     if (nr_actual_parts + expected_num_extra_parts > size_parts) {
 
-      size_parts = (nr_actual_parts + expected_num_extra_parts) *
-                   engine_redistribute_alloc_margin;
+      size_parts = space_extras_alloc_size(
+          nr_actual_parts + expected_num_extra_parts,
+          sizeof(struct part) + sizeof(struct xpart));
 
       if (verbose)
         message("Re-allocating parts array from %zd to %zd", s->size_parts,
@@ -1010,8 +1029,8 @@ void space_allocate_extras(struct space *s, int verbose) {
     /* Do we need to reallocate? */
     if (nr_actual_sparts + expected_num_extra_sparts > size_sparts) {
 
-      size_sparts = (nr_actual_sparts + expected_num_extra_sparts) *
-                    engine_redistribute_alloc_margin;
+      size_sparts = space_extras_alloc_size(
+          nr_actual_sparts + expected_num_extra_sparts, sizeof(struct spart));
 
       if (verbose)
         message("Re-allocating sparts array from %zd to %zd", s->size_sparts,
@@ -1092,8 +1111,8 @@ void space_allocate_extras(struct space *s, int verbose) {
     /* Do we need to reallocate? */
     if (nr_actual_bparts + expected_num_extra_bparts > size_bparts) {
 
-      size_bparts = (nr_actual_bparts + expected_num_extra_bparts) *
-                    engine_redistribute_alloc_margin;
+      size_bparts = space_extras_alloc_size(
+          nr_actual_bparts + expected_num_extra_bparts, sizeof(struct bpart));
 
       if (verbose)
         message("Re-allocating bparts array from %zd to %zd", s->size_bparts,
@@ -1606,7 +1625,7 @@ void space_rebuild(struct space *s, int repartitioned, int verbose) {
         nr_gparts -= 1;
 
         /* Swap the particle */
-        memswap(&s->gparts[k], &s->gparts[nr_gparts], sizeof(struct gpart));
+        memswap_gpart(&s->gparts[k], &s->gparts[nr_gparts]);
 
         /* Swap the link with part/spart */
         if (s->gparts[k].type == swift_type_gas) {
@@ -3535,7 +3554,7 @@ void space_gparts_sort(struct gpart *gparts, struct part *parts,
         while (ind[j] == target_cid) {
           j = offsets[target_cid] + counts[target_cid]++;
         }
-        memswap(&gparts[j], &temp_gpart, sizeof(struct gpart));
+        memswap_gpart(&gparts[j], &temp_gpart);
         memswap(&ind[j], &target_cid, sizeof(int));
         if (gparts[j].type == swift_type_gas) {
           parts[-gparts[j].id_or_neg_offset].gpart = &gparts[j];
@@ -4729,25 +4748,37 @@ void space_synchronize_particle_positions(struct space *s) {
 
   const ticks tic = getticks();
 
+  /* The different particle types write to different #gpart so all the maps
+   * can run concurrently. */
   if (s->nr_gparts > 0 && s->nr_parts > 0)
-    threadpool_map(&s->e->threadpool, space_synchronize_part_positions_mapper,
-                   s->parts, s->nr_parts, sizeof(struct part),
-                   threadpool_auto_chunk_size, (void *)s);
+    threadpool_map_async(&s->e->threadpool,
+                         space_synchronize_part_positions_mapper, s->parts,
+                         s->nr_parts, sizeof(struct part),
+                         threadpool_auto_chunk_size, (void *)s,
+                         /*after=*/NULL);
 
   if (s->nr_gparts > 0 && s->nr_sparts > 0)
-    threadpool_map(&s->e->threadpool, space_synchronize_spart_positions_mapper,
-                   s->sparts, s->nr_sparts, sizeof(struct spart),
-                   threadpool_auto_chunk_size, /*extra_data=*/NULL);
+    threadpool_map_async(&s->e->threadpool,
+                         space_synchronize_spart_positions_mapper, s->sparts,
+                         s->nr_sparts, sizeof(struct spart),
+                         threadpool_auto_chunk_size, /*extra_data=*/NULL,
+                         /*after=*/NULL);
 
   if (s->nr_gparts > 0 && s->nr_bparts > 0)
-    threadpool_map(&s->e->threadpool, space_synchronize_bpart_positions_mapper,
-                   s->bparts, s->nr_bparts, sizeof(struct bpart),
-                   threadpool_auto_chunk_size, /*extra_data=*/NULL);
+    threadpool_map_async(&s->e->threadpool,
+                         space_synchronize_bpart_positions_mapper, s->bparts,
+                         s->nr_bparts, sizeof(struct bpart),
+                         threadpool_auto_chunk_size, /*extra_data=*/NULL,
+                         /*after=*/NULL);
 
   if (s->nr_gparts > 0 && s->nr_sinks > 0)
-    threadpool_map(&s->e->threadpool, space_synchronize_sink_positions_mapper,
-                   s->sinks, s->nr_sinks, sizeof(struct sink),
-                   threadpool_auto_chunk_size, /*extra_data=*/NULL);
+    threadpool_map_async(&s->e->threadpool,
+                         space_synchronize_sink_positions_mapper, s->sinks,
+                         s->nr_sinks, sizeof(struct sink),
+                         threadpool_auto_chunk_size, /*extra_data=*/NULL,
+                         /*after=*/NULL);
+
+  threadpool_wait(&s->e->threadpool, NULL);
 
   if (s->e->verbose)
     message("took %.3f %s.", clocks_from_ticks(getticks() - tic),
@@ -5402,6 +5433,7 @@ void space_convert_quantities(struct space *s, int verbose) {
  * @param verbose Print messages to stdout or not.
  * @param dry_run If 1, just initialise stuff, don't do anything with the parts.
  * @param nr_nodes The number of MPI rank.
+ * @param nr_threads The number of threads to use for the initialisation.
  *
  * Makes a grid of edge length > r_max and fills the particles
  * into the respective cells. Cells containing more than #space_splitsize
@@ -5416,7 +5448,7 @@ void space_init(struct space *s, struct swift_params *params,
                 size_t Nspart, size_t Nbpart, int periodic, int replicate,
                 int remap_ids, int generate_gas_in_ics, int hydro,
                 int self_gravity, int star_formation, int DM_background,
-                int verbose, int dry_run, int nr_nodes) {
+                int verbose, int dry_run, int nr_nodes, int nr_threads) {
 
   /* Clean-up everything */
   bzero(s, sizeof(struct space));
@@ -5476,7 +5508,7 @@ void space_init(struct space *s, struct swift_params *params,
   /* Are we generating gas from the DM-only ICs? */
   if (generate_gas_in_ics) {
     space_generate_gas(s, cosmo, hydro_properties, periodic, DM_background, dim,
-                       verbose);
+                       nr_threads, verbose);
     parts = s->parts;
     gparts = s->gparts;
     Npart = s->nr_parts;
@@ -5497,7 +5529,7 @@ void space_init(struct space *s, struct swift_params *params,
     if (DM_background)
       error("Can't replicate the space if background DM particles are in use.");
 
-    space_replicate(s, replicate, verbose);
+    space_replicate(s, replicate, nr_threads, verbose);
     parts = s->parts;
     gparts = s->gparts;
     sparts = s->sparts;
@@ -5757,22 +5789,244 @@ void space_init(struct space *s, struct swift_params *params,
   }
 }
 
+/**
+ * @brief Information required to replicate the particles in parallel.
+ */
+struct space_replicate_data {
+
+  /*! The original particles */
+  const struct part *old_parts;
+  const struct gpart *old_gparts;
+  const struct spart *old_sparts;
+  const struct bpart *old_bparts;
+  const struct sink *old_sinks;
+
+  /*! The replicated particles */
+  struct part *parts;
+  struct gpart *gparts;
+  struct spart *sparts;
+  struct bpart *bparts;
+  struct sink *sinks;
+
+  /*! The original number of particles */
+  size_t nr_parts, nr_gparts, nr_sparts, nr_bparts, nr_sinks;
+
+  /*! The original size of the domain */
+  double dim[3];
+
+  /*! The number of copies along each axis */
+  int replicate;
+};
+
+/**
+ * @brief Compute the position shift of a given copy of the space.
+ *
+ * @param rep The index of the copy.
+ * @param data The #space_replicate_data.
+ * @param shift (return) The shift to apply to the positions.
+ */
+static void space_replicate_shift(const size_t rep,
+                                  const struct space_replicate_data *data,
+                                  double shift[3]) {
+
+  const size_t replicate = data->replicate;
+  const size_t i = rep / (replicate * replicate);
+  const size_t j = (rep / replicate) % replicate;
+  const size_t k = rep % replicate;
+
+  shift[0] = i * data->dim[0];
+  shift[1] = j * data->dim[1];
+  shift[2] = k * data->dim[2];
+}
+
+/**
+ * @brief Return the position of a #gpart in the replicated array given its
+ * position in the original one.
+ *
+ * @param gp The original #gpart.
+ * @param rep The index of the copy.
+ * @param data The #space_replicate_data.
+ */
+static struct gpart *space_replicate_gpart_link(
+    const struct gpart *gp, const size_t rep,
+    const struct space_replicate_data *data) {
+
+  return &data->gparts[rep * data->nr_gparts + (gp - data->old_gparts)];
+}
+
+void space_replicate_parts_mapper(void *map_data, int count,
+                                  void *extra_data) {
+
+  struct part *restrict parts = (struct part *)map_data;
+  const struct space_replicate_data *data =
+      (const struct space_replicate_data *)extra_data;
+  const size_t first = parts - data->parts;
+
+  for (int n = 0; n < count; ++n) {
+
+    const size_t rep = (first + n) / data->nr_parts;
+    const struct part *p = &data->old_parts[first + n - rep * data->nr_parts];
+
+    double shift[3];
+    space_replicate_shift(rep, data, shift);
+
+    memcpy(&parts[n], p, sizeof(struct part));
+    parts[n].x[0] += shift[0];
+    parts[n].x[1] += shift[1];
+    parts[n].x[2] += shift[2];
+
+    if (p->gpart != NULL)
+      parts[n].gpart = space_replicate_gpart_link(p->gpart, rep, data);
+  }
+}
+
+void space_replicate_gparts_mapper(void *map_data, int count,
+                                   void *extra_data) {
+
+  struct gpart *restrict gparts = (struct gpart *)map_data;
+  const struct space_replicate_data *data =
+      (const struct space_replicate_data *)extra_data;
+  const size_t first = gparts - data->gparts;
+
+  for (int n = 0; n < count; ++n) {
+
+    const size_t rep = (first + n) / data->nr_gparts;
+    const struct gpart *gp =
+        &data->old_gparts[first + n - rep * data->nr_gparts];
+
+    double shift[3];
+    space_replicate_shift(rep, data, shift);
+
+    memcpy(&gparts[n], gp, sizeof(struct gpart));
+    gparts[n].x[0] += shift[0];
+    gparts[n].x[1] += shift[1];
+    gparts[n].x[2] += shift[2];
+
+    /* Point to the copy of the linked particle in the same replica */
+    switch (gp->type) {
+      case swift_type_gas:
+        gparts[n].id_or_neg_offset -= rep * data->nr_parts;
+        break;
+      case swift_type_sink:
+        gparts[n].id_or_neg_offset -= rep * data->nr_sinks;
+        break;
+      case swift_type_stars:
+        gparts[n].id_or_neg_offset -= rep * data->nr_sparts;
+        break;
+      case swift_type_black_hole:
+        gparts[n].id_or_neg_offset -= rep * data->nr_bparts;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void space_replicate_sparts_mapper(void *map_data, int count,
+                                   void *extra_data) {
+
+  struct spart *restrict sparts = (struct spart *)map_data;
+  const struct space_replicate_data *data =
+      (const struct space_replicate_data *)extra_data;
+  const size_t first = sparts - data->sparts;
+
+  for (int n = 0; n < count; ++n) {
+
+    const size_t rep = (first + n) / data->nr_sparts;
+    const struct spart *sp =
+        &data->old_sparts[first + n - rep * data->nr_sparts];
+
+    double shift[3];
+    space_replicate_shift(rep, data, shift);
+
+    memcpy(&sparts[n], sp, sizeof(struct spart));
+    sparts[n].x[0] += shift[0];
+    sparts[n].x[1] += shift[1];
+    sparts[n].x[2] += shift[2];
+
+    if (sp->gpart != NULL)
+      sparts[n].gpart = space_replicate_gpart_link(sp->gpart, rep, data);
+  }
+}
+
+void space_replicate_bparts_mapper(void *map_data, int count,
+                                   void *extra_data) {
+
+  struct bpart *restrict bparts = (struct bpart *)map_data;
+  const struct space_replicate_data *data =
+      (const struct space_replicate_data *)extra_data;
+  const size_t first = bparts - data->bparts;
+
+  for (int n = 0; n < count; ++n) {
+
+    const size_t rep = (first + n) / data->nr_bparts;
+    const struct bpart *bp =
+        &data->old_bparts[first + n - rep * data->nr_bparts];
+
+    double shift[3];
+    space_replicate_shift(rep, data, shift);
+
+    memcpy(&bparts[n], bp, sizeof(struct bpart));
+    bparts[n].x[0] += shift[0];
+    bparts[n].x[1] += shift[1];
+    bparts[n].x[2] += shift[2];
+
+    if (bp->gpart != NULL)
+      bparts[n].gpart = space_replicate_gpart_link(bp->gpart, rep, data);
+  }
+}
+
+void space_replicate_sinks_mapper(void *map_data, int count,
+                                  void *extra_data) {
+
+  struct sink *restrict sinks = (struct sink *)map_data;
+  const struct space_replicate_data *data =
+      (const struct space_replicate_data *)extra_data;
+  const size_t first = sinks - data->sinks;
+
+  for (int n = 0; n < count; ++n) {
+
+    const size_t rep = (first + n) / data->nr_sinks;
+    const struct sink *sink =
+        &data->old_sinks[first + n - rep * data->nr_sinks];
+
+    double shift[3];
+    space_replicate_shift(rep, data, shift);
+
+    memcpy(&sinks[n], sink, sizeof(struct sink));
+    sinks[n].x[0] += shift[0];
+    sinks[n].x[1] += shift[1];
+    sinks[n].x[2] += shift[2];
+
+    if (sink->gpart != NULL)
+      sinks[n].gpart = space_replicate_gpart_link(sink->gpart, rep, data);
+  }
+}
+
 /**
  * @brief Replicate the content of a space along each axis.
  *
  * Should only be called during initialisation.
  *
+ * Every particle of the new arrays is generated independently from its index
+ * (replica and position in the original arrays), so the copies are made in
+ * parallel by a temporary #threadpool.
+ *
  * @param s The #space to replicate.
  * @param replicate The number of copies along each axis.
+ * @param nr_threads The number of threads to use.
  * @param verbose Are we talkative ?
  */
-void space_replicate(struct space *s, int replicate, int verbose) {
+void space_replicate(struct space *s, int replicate, int nr_threads,
+                     int verbose) {
 
   if (replicate < 1) error("Invalid replicate value: %d", replicate);
 
   if (verbose)
     message("Replicating space %d times along each axis.", replicate);
 
+  const ticks tic = getticks();
+
   const int factor = replicate * replicate * replicate;
 
   /* Store the current values */
@@ -5781,7 +6035,6 @@ void space_replicate(struct space *s, int replicate, int verbose) {
   const size_t nr_sparts = s->nr_sparts;
   const size_t nr_bparts = s->nr_bparts;
   const size_t nr_sinks = s->nr_sinks;
-  const size_t nr_dm = nr_gparts - nr_parts - nr_sparts - nr_bparts;
 
   s->size_parts = s->nr_parts = nr_parts * factor;
   s->size_gparts = s->nr_gparts = nr_gparts * factor;
@@ -5816,96 +6069,48 @@ void space_replicate(struct space *s, int replicate, int verbose) {
                      s->nr_bparts * sizeof(struct bpart)) != 0)
     error("Failed to allocate new bpart array.");
 
-  /* Replicate everything */
-  for (int i = 0; i < replicate; ++i) {
-    for (int j = 0; j < replicate; ++j) {
-      for (int k = 0; k < replicate; ++k) {
-        const size_t offset = i * replicate * replicate + j * replicate + k;
-
-        /* First copy the data */
-        memcpy(parts + offset * nr_parts, s->parts,
-               nr_parts * sizeof(struct part));
-        memcpy(sparts + offset * nr_sparts, s->sparts,
-               nr_sparts * sizeof(struct spart));
-        memcpy(bparts + offset * nr_bparts, s->bparts,
-               nr_bparts * sizeof(struct bpart));
-        memcpy(gparts + offset * nr_gparts, s->gparts,
-               nr_gparts * sizeof(struct gpart));
-        memcpy(sinks + offset * nr_sinks, s->sinks,
-               nr_sinks * sizeof(struct sink));
-
-        /* Shift the positions */
-        const double shift[3] = {i * s->dim[0], j * s->dim[1], k * s->dim[2]};
-
-        for (size_t n = offset * nr_parts; n < (offset + 1) * nr_parts; ++n) {
-          parts[n].x[0] += shift[0];
-          parts[n].x[1] += shift[1];
-          parts[n].x[2] += shift[2];
-        }
-        for (size_t n = offset * nr_gparts; n < (offset + 1) * nr_gparts; ++n) {
-          gparts[n].x[0] += shift[0];
-          gparts[n].x[1] += shift[1];
-          gparts[n].x[2] += shift[2];
-        }
-        for (size_t n = offset * nr_sparts; n < (offset + 1) * nr_sparts; ++n) {
-          sparts[n].x[0] += shift[0];
-          sparts[n].x[1] += shift[1];
-          sparts[n].x[2] += shift[2];
-        }
-        for (size_t n = offset * nr_bparts; n < (offset + 1) * nr_bparts; ++n) {
-          bparts[n].x[0] += shift[0];
-          bparts[n].x[1] += shift[1];
-          bparts[n].x[2] += shift[2];
-        }
-        for (size_t n = offset * nr_sinks; n < (offset + 1) * nr_sinks; ++n) {
-          sinks[n].x[0] += shift[0];
-          sinks[n].x[1] += shift[1];
-          sinks[n].x[2] += shift[2];
-        }
-
-        /* Set the correct links (recall gpart are sorted by type at start-up):
-           first DM (unassociated gpart), then gas, then sinks, then stars */
-        if (nr_parts > 0 && nr_gparts > 0) {
-          const size_t offset_part = offset * nr_parts;
-          const size_t offset_gpart = offset * nr_gparts + nr_dm;
-
-          for (size_t n = 0; n < nr_parts; ++n) {
-            parts[offset_part + n].gpart = &gparts[offset_gpart + n];
-            gparts[offset_gpart + n].id_or_neg_offset = -(offset_part + n);
-          }
-        }
-        if (nr_sinks > 0 && nr_gparts > 0) {
-          const size_t offset_sink = offset * nr_sinks;
-          const size_t offset_gpart = offset * nr_gparts + nr_dm + nr_parts;
-
-          for (size_t n = 0; n < nr_sinks; ++n) {
-            sinks[offset_sink + n].gpart = &gparts[offset_gpart + n];
-            gparts[offset_gpart + n].id_or_neg_offset = -(offset_sink + n);
-          }
-        }
-        if (nr_sparts > 0 && nr_gparts > 0) {
-          const size_t offset_spart = offset * nr_sparts;
-          const size_t offset_gpart =
-              offset * nr_gparts + nr_dm + nr_parts + nr_sinks;
-
-          for (size_t n = 0; n < nr_sparts; ++n) {
-            sparts[offset_spart + n].gpart = &gparts[offset_gpart + n];
-            gparts[offset_gpart + n].id_or_neg_offset = -(offset_spart + n);
-          }
-        }
-        if (nr_bparts > 0 && nr_gparts > 0) {
-          const size_t offset_bpart = offset * nr_bparts;
-          const size_t offset_gpart =
-              offset * nr_gparts + nr_dm + nr_parts + nr_sinks + nr_sparts;
-
-          for (size_t n = 0; n < nr_bparts; ++n) {
-            bparts[offset_bpart + n].gpart = &gparts[offset_gpart + n];
-            gparts[offset_gpart + n].id_or_neg_offset = -(offset_bpart + n);
-          }
-        }
-      }
-    }
-  }
+  /* Pack the information needed by the mappers */
+  struct space_replicate_data data;
+  data.old_parts = s->parts;
+  data.old_gparts = s->gparts;
+  data.old_sparts = s->sparts;
+  data.old_bparts = s->bparts;
+  data.old_sinks = s->sinks;
+  data.parts = parts;
+  data.gparts = gparts;
+  data.sparts = sparts;
+  data.bparts = bparts;
+  data.sinks = sinks;
+  data.nr_parts = nr_parts;
+  data.nr_gparts = nr_gparts;
+  data.nr_sparts = nr_sparts;
+  data.nr_bparts = nr_bparts;
+  data.nr_sinks = nr_sinks;
+  data.dim[0] = s->dim[0];
+  data.dim[1] = s->dim[1];
+  data.dim[2] = s->dim[2];
+  data.replicate = replicate;
+
+  /* Replicate everything. All the copies are independent. */
+  struct threadpool tp;
+  threadpool_init(&tp, nr_threads);
+  threadpool_map_async(&tp, space_replicate_parts_mapper, parts, s->nr_parts,
+                       sizeof(struct part), threadpool_auto_chunk_size, &data,
+                       /*after=*/NULL);
+  threadpool_map_async(&tp, space_replicate_gparts_mapper, gparts,
+                       s->nr_gparts, sizeof(struct gpart),
+                       threadpool_auto_chunk_size, &data, /*after=*/NULL);
+  threadpool_map_async(&tp, space_replicate_sparts_mapper, sparts,
+                       s->nr_sparts, sizeof(struct spart),
+                       threadpool_auto_chunk_size, &data, /*after=*/NULL);
+  threadpool_map_async(&tp, space_replicate_bparts_mapper, bparts,
+                       s->nr_bparts, sizeof(struct bpart),
+                       threadpool_auto_chunk_size, &data, /*after=*/NULL);
+  threadpool_map_async(&tp, space_replicate_sinks_mapper, sinks, s->nr_sinks,
+                       sizeof(struct sink), threadpool_auto_chunk_size, &data,
+                       /*after=*/NULL);
+  threadpool_wait(&tp, NULL);
+  threadpool_clean(&tp);
 
   /* Replace the content of the space */
   swift_free("parts", s->parts);
@@ -5924,6 +6129,10 @@ void space_replicate(struct space *s, int replicate, int verbose) {
   s->dim[1] *= replicate;
   s->dim[2] *= replicate;
 
+  if (verbose)
+    message("took %.3f %s.", clocks_from_ticks(getticks() - tic),
+            clocks_getunit());
+
 #ifdef SWIFT_DEBUG_CHECKS
   /* Verify that everything is correct */
   part_verify_links(s->parts, s->gparts, s->sinks, s->sparts, s->bparts,
@@ -6021,6 +6230,186 @@ void space_remap_ids(struct space *s, int nr_nodes, int verbose) {
   }
 }
 
+/**
+ * @brief Information required to generate the gas particles in parallel.
+ */
+struct space_generate_gas_data {
+
+  /*! The original gparts */
+  const struct gpart *old_gparts;
+
+  /*! The new particles */
+  struct part *parts;
+  struct gpart *gparts;
+
+  /*! The original number of gparts */
+  size_t nr_old_gparts;
+
+  /*! Number of gas particles created before each block of gparts */
+  size_t *block_offsets;
+
+  /*! The number of gparts in each block */
+  size_t block_size;
+
+  /*! Cosmology-derived constants */
+  double mass_ratio, bg_density_inv;
+
+  /*! Particle splitting information */
+  int particle_splitting;
+  float splitting_mass_threshold;
+
+  /*! Box-wrapping information */
+  int periodic;
+  double dim[3];
+};
+
+/**
+ * @brief Count the number of gparts turned into a DM + gas pair in each block.
+ */
+void space_generate_gas_count_mapper(void *map_data, int num_blocks,
+                                     void *extra_data) {
+
+  size_t *restrict block_counts = (size_t *)map_data;
+  const struct space_generate_gas_data *data =
+      (const struct space_generate_gas_data *)extra_data;
+  const size_t first_block = block_counts - data->block_offsets;
+
+  for (int b = 0; b < num_blocks; ++b) {
+
+    const size_t start = (first_block + b) * data->block_size;
+    const size_t end = min(start + data->block_size, data->nr_old_gparts);
+
+    size_t count = 0;
+    for (size_t i = start; i < end; ++i)
+      if (data->old_gparts[i].type != swift_type_dark_matter_background)
+        ++count;
+
+    block_counts[b] = count;
+  }
+}
+
+/**
+ * @brief Split the zoom DM particles of each block into DM + gas pairs.
+ */
+void space_generate_gas_mapper(void *map_data, int num_blocks,
+                               void *extra_data) {
+
+  const size_t *restrict block_offsets = (const size_t *)map_data;
+  const struct space_generate_gas_data *data =
+      (const struct space_generate_gas_data *)extra_data;
+  const size_t first_block = block_offsets - data->block_offsets;
+
+  const struct gpart *old_gparts = data->old_gparts;
+  struct part *parts = data->parts;
+  struct gpart *gparts = data->gparts;
+  const size_t current_nr_gparts = data->nr_old_gparts;
+  const double mass_ratio = data->mass_ratio;
+  const double bg_density_inv = data->bg_density_inv;
+  const int periodic = data->periodic;
+  const double *dim = data->dim;
+
+  for (int b = 0; b < num_blocks; ++b) {
+
+    const size_t start = (first_block + b) * data->block_size;
+    const size_t end = min(start + data->block_size, current_nr_gparts);
+
+    /* Index of the first gas particle created in this block */
+    size_t j = block_offsets[b];
+
+    for (size_t i = start; i < end; ++i) {
+
+      /* For the background DM particles, just copy the data */
+      if (old_gparts[i].type == swift_type_dark_matter_background) {
+
+        memcpy(&gparts[i], &old_gparts[i], sizeof(struct gpart));
+
+      } else {
+
+        /* For the zoom DM particles, there is a lot of work to do */
+
+        struct part *p = &parts[j];
+        struct gpart *gp_gas = &gparts[current_nr_gparts + j];
+        struct gpart *gp_dm = &gparts[i];
+
+        /* Start by copying over the gpart */
+        memcpy(gp_gas, &old_gparts[i], sizeof(struct gpart));
+        memcpy(gp_dm, &old_gparts[i], sizeof(struct gpart));
+
+        /* Set the IDs */
+        p->id = gp_gas->id_or_neg_offset * 2 + 1;
+        gp_dm->id_or_neg_offset *= 2;
+
+        if (gp_dm->id_or_neg_offset < 0)
+          error("DM particle ID overflowd (DM id=%lld gas id=%lld)",
+                gp_dm->id_or_neg_offset, p->id);
+
+        if (p->id < 0) error("gas particle ID overflowd (id=%lld)", p->id);
+
+        /* Set the links correctly */
+        p->gpart = gp_gas;
+        gp_gas->id_or_neg_offset = -j;
+        gp_gas->type = swift_type_gas;
+
+        /* Compute positions shift */
+        const double d = cbrt(gp_dm->mass * bg_density_inv);
+        const double shift_dm = 0.5 * d * mass_ratio;
+        const double shift_gas = 0.5 * d * (1. - mass_ratio);
+
+        /* Set the masses */
+        gp_dm->mass *= (1. - mass_ratio);
+        gp_gas->mass *= mass_ratio;
+        hydro_set_mass(p, gp_gas->mass);
+
+        /* Verify that we are not generating a gas particle larger than the
+           threashold for particle splitting */
+        if (data->particle_splitting &&
+            gp_gas->mass > data->splitting_mass_threshold)
+          error("Generating a gas particle above the threshold for splitting");
+
+        /* Set the new positions */
+        gp_dm->x[0] += shift_dm;
+        gp_dm->x[1] += shift_dm;
+        gp_dm->x[2] += shift_dm;
+        gp_gas->x[0] -= shift_gas;
+        gp_gas->x[1] -= shift_gas;
+        gp_gas->x[2] -= shift_gas;
+
+        /* Make sure the positions are identical between linked particles */
+        p->x[0] = gp_gas->x[0];
+        p->x[1] = gp_gas->x[1];
+        p->x[2] = gp_gas->x[2];
+
+        /* Box-wrap the whole thing to be safe */
+        if (periodic) {
+          gp_dm->x[0] = box_wrap(gp_dm->x[0], 0., dim[0]);
+          gp_dm->x[1] = box_wrap(gp_dm->x[1], 0., dim[1]);
+          gp_dm->x[2] = box_wrap(gp_dm->x[2], 0., dim[2]);
+          gp_gas->x[0] = box_wrap(gp_gas->x[0], 0., dim[0]);
+          gp_gas->x[1] = box_wrap(gp_gas->x[1], 0., dim[1]);
+          gp_gas->x[2] = box_wrap(gp_gas->x[2], 0., dim[2]);
+          p->x[0] = box_wrap(p->x[0], 0., dim[0]);
+          p->x[1] = box_wrap(p->x[1], 0., dim[1]);
+          p->x[2] = box_wrap(p->x[2], 0., dim[2]);
+        }
+
+        /* Also copy the velocities */
+        p->v[0] = gp_gas->v_full[0];
+        p->v[1] = gp_gas->v_full[1];
+        p->v[2] = gp_gas->v_full[2];
+
+        /* Set the smoothing length to the mean inter-particle separation */
+        p->h = d;
+
+        /* Note that the thermodynamic properties (u, S, ...) will be set
+         * later */
+
+        /* Move on to the next free gas slot */
+        ++j;
+      }
+    }
+  }
+}
+
 /**
  * @brief Duplicate all the dark matter particles to create the same number
  * of gas particles with mass ratios given by the cosmology.
@@ -6032,18 +6421,24 @@ void space_remap_ids(struct space *s, int nr_nodes, int verbose) {
  *
  * Background DM particles are not duplicated.
  *
+ * The gparts are processed in fixed-size blocks by a temporary #threadpool.
+ * The position of the gas particles created by each block is obtained from a
+ * prefix sum of the number of zoom DM particles per block.
+ *
  * @param s The #space to create the particles in.
  * @param cosmo The current #cosmology model.
  * @param hydro_properties The properties of the hydro scheme.
  * @param periodic Are we using periodic boundary conditions?
  * @param with_background Are we using background DM particles?
  * @param dim The size of the box (for periodic wrapping).
+ * @param nr_threads The number of threads to use.
  * @param verbose Are we talkative?
  */
 void space_generate_gas(struct space *s, const struct cosmology *cosmo,
                         const struct hydro_props *hydro_properties,
                         const int periodic, const int with_background,
-                        const double dim[3], const int verbose) {
+                        const double dim[3], const int nr_threads,
+                        const int verbose) {
 
   /* Check that this is a sensible ting to do */
   if (!s->with_hydro)
@@ -6054,6 +6449,8 @@ void space_generate_gas(struct space *s, const struct cosmology *cosmo,
 
   if (verbose) message("Generating gas particles from gparts");
 
+  const ticks tic = getticks();
+
   /* Store the current values */
   const size_t current_nr_parts = s->nr_parts;
   const size_t current_nr_gparts = s->nr_gparts;
@@ -6070,19 +6467,48 @@ void space_generate_gas(struct space *s, const struct cosmology *cosmo,
   if (s->nr_sinks != 0)
     error("Generating gas particles from DM but sink already exists!");
 
-  /* Pull out information about particle splitting */
-  const int particle_splitting = hydro_properties->particle_splitting;
-  const float splitting_mass_threshold =
+  /* Pack the information needed by the mappers */
+  struct space_generate_gas_data data;
+  data.old_gparts = s->gparts;
+  data.nr_old_gparts = current_nr_gparts;
+  data.block_size = space_generate_gas_block_size;
+  data.mass_ratio = cosmo->Omega_b / cosmo->Omega_m;
+  data.bg_density_inv = 1. / (cosmo->Omega_m * cosmo->critical_density_0);
+  data.particle_splitting = hydro_properties->particle_splitting;
+  data.splitting_mass_threshold =
       hydro_properties->particle_splitting_mass_threshold;
-
-  /* Start by counting the number of background and zoom DM particles */
-  size_t nr_background_gparts = 0;
+  data.periodic = periodic;
+  data.dim[0] = dim[0];
+  data.dim[1] = dim[1];
+  data.dim[2] = dim[2];
+
+  const size_t nr_blocks =
+      (current_nr_gparts + data.block_size - 1) / data.block_size;
+  if ((data.block_offsets = (size_t *)malloc(nr_blocks * sizeof(size_t))) ==
+      NULL)
+    error("Failed to allocate block offsets.");
+
+  struct threadpool tp;
+  threadpool_init(&tp, nr_threads);
+
+  /* Start by counting the number of zoom DM particles in each block and
+   * turn this into the index of the first gas particle of each block */
+  size_t nr_zoom_gparts = 0;
   if (with_background) {
-    for (size_t i = 0; i < current_nr_gparts; ++i)
-      if (s->gparts[i].type == swift_type_dark_matter_background)
-        ++nr_background_gparts;
+    threadpool_map(&tp, space_generate_gas_count_mapper, data.block_offsets,
+                   nr_blocks, sizeof(size_t), threadpool_auto_chunk_size,
+                   &data);
+    for (size_t b = 0; b < nr_blocks; ++b) {
+      const size_t count = data.block_offsets[b];
+      data.block_offsets[b] = nr_zoom_gparts;
+      nr_zoom_gparts += count;
+    }
+  } else {
+    for (size_t b = 0; b < nr_blocks; ++b)
+      data.block_offsets[b] = b * data.block_size;
+    nr_zoom_gparts = current_nr_gparts;
   }
-  const size_t nr_zoom_gparts = current_nr_gparts - nr_background_gparts;
+  const size_t nr_background_gparts = current_nr_gparts - nr_zoom_gparts;
 
   if (nr_zoom_gparts == 0)
     error("Can't generate gas from ICs if there are no high res. particles");
@@ -6107,109 +6533,23 @@ void space_generate_gas(struct space *s, const struct cosmology *cosmo,
   bzero(gparts, s->nr_gparts * sizeof(struct gpart));
   bzero(parts, s->nr_parts * sizeof(struct part));
 
-  /* Compute some constants */
-  const double mass_ratio = cosmo->Omega_b / cosmo->Omega_m;
-  const double bg_density = cosmo->Omega_m * cosmo->critical_density_0;
-  const double bg_density_inv = 1. / bg_density;
-
-  message("%zd", current_nr_gparts);
-
   /* Update the particle properties */
-  size_t j = 0;
-  for (size_t i = 0; i < current_nr_gparts; ++i) {
-
-    /* For the background DM particles, just copy the data */
-    if (s->gparts[i].type == swift_type_dark_matter_background) {
-
-      memcpy(&gparts[i], &s->gparts[i], sizeof(struct gpart));
-
-    } else {
-
-      /* For the zoom DM particles, there is a lot of work to do */
-
-      struct part *p = &parts[j];
-      struct gpart *gp_gas = &gparts[current_nr_gparts + j];
-      struct gpart *gp_dm = &gparts[i];
-
-      /* Start by copying over the gpart */
-      memcpy(gp_gas, &s->gparts[i], sizeof(struct gpart));
-      memcpy(gp_dm, &s->gparts[i], sizeof(struct gpart));
-
-      /* Set the IDs */
-      p->id = gp_gas->id_or_neg_offset * 2 + 1;
-      gp_dm->id_or_neg_offset *= 2;
-
-      if (gp_dm->id_or_neg_offset < 0)
-        error("DM particle ID overflowd (DM id=%lld gas id=%lld)",
-              gp_dm->id_or_neg_offset, p->id);
-
-      if (p->id < 0) error("gas particle ID overflowd (id=%lld)", p->id);
-
-      /* Set the links correctly */
-      p->gpart = gp_gas;
-      gp_gas->id_or_neg_offset = -j;
-      gp_gas->type = swift_type_gas;
-
-      /* Compute positions shift */
-      const double d = cbrt(gp_dm->mass * bg_density_inv);
-      const double shift_dm = 0.5 * d * mass_ratio;
-      const double shift_gas = 0.5 * d * (1. - mass_ratio);
-
-      /* Set the masses */
-      gp_dm->mass *= (1. - mass_ratio);
-      gp_gas->mass *= mass_ratio;
-      hydro_set_mass(p, gp_gas->mass);
-
-      /* Verify that we are not generating a gas particle larger than the
-         threashold for particle splitting */
-      if (particle_splitting && gp_gas->mass > splitting_mass_threshold)
-        error("Generating a gas particle above the threshold for splitting");
-
-      /* Set the new positions */
-      gp_dm->x[0] += shift_dm;
-      gp_dm->x[1] += shift_dm;
-      gp_dm->x[2] += shift_dm;
-      gp_gas->x[0] -= shift_gas;
-      gp_gas->x[1] -= shift_gas;
-      gp_gas->x[2] -= shift_gas;
-
-      /* Make sure the positions are identical between linked particles */
-      p->x[0] = gp_gas->x[0];
-      p->x[1] = gp_gas->x[1];
-      p->x[2] = gp_gas->x[2];
-
-      /* Box-wrap the whole thing to be safe */
-      if (periodic) {
-        gp_dm->x[0] = box_wrap(gp_dm->x[0], 0., dim[0]);
-        gp_dm->x[1] = box_wrap(gp_dm->x[1], 0., dim[1]);
-        gp_dm->x[2] = box_wrap(gp_dm->x[2], 0., dim[2]);
-        gp_gas->x[0] = box_wrap(gp_gas->x[0], 0., dim[0]);
-        gp_gas->x[1] = box_wrap(gp_gas->x[1], 0., dim[1]);
-        gp_gas->x[2] = box_wrap(gp_gas->x[2], 0., dim[2]);
-        p->x[0] = box_wrap(p->x[0], 0., dim[0]);
-        p->x[1] = box_wrap(p->x[1], 0., dim[1]);
-        p->x[2] = box_wrap(p->x[2], 0., dim[2]);
-      }
-
-      /* Also copy the velocities */
-      p->v[0] = gp_gas->v_full[0];
-      p->v[1] = gp_gas->v_full[1];
-      p->v[2] = gp_gas->v_full[2];
-
-      /* Set the smoothing length to the mean inter-particle separation */
-      p->h = d;
+  data.parts = parts;
+  data.gparts = gparts;
+  threadpool_map(&tp, space_generate_gas_mapper, data.block_offsets, nr_blocks,
+                 sizeof(size_t), threadpool_auto_chunk_size, &data);
 
-      /* Note that the thermodynamic properties (u, S, ...) will be set later */
-
-      /* Move on to the next free gas slot */
-      ++j;
-    }
-  }
+  threadpool_clean(&tp);
+  free(data.block_offsets);
 
   /* Replace the content of the space */
   swift_free("gparts", s->gparts);
   s->parts = parts;
   s->gparts = gparts;
+
+  if (verbose)
+    message("took %.3f %s.", clocks_from_ticks(getticks() - tic),
+            clocks_getunit());
 }
 
 /**
@@ -68,6 +68,9 @@ struct hydro_props;
 /* Maximum allowed depth of cell splits. */
 #define space_cell_maxdepth 52
 
+/* Number of gparts processed together when generating gas from the ICs. */
+#define space_generate_gas_block_size 16384
+
 /* Globals needed in contexts without a space struct. Remember to dump and
  * restore these. */
 extern int space_splitsize;
@@ -342,7 +345,7 @@ void space_init(struct space *s, struct swift_params *params,
                 size_t Nspart, size_t Nbpart, int periodic, int replicate,
                 int remap_ids, int generate_gas_in_ics, int hydro, int gravity,
                 int star_formation, int DM_background, int verbose, int dry_run,
-                int nr_nodes);
+                int nr_nodes, int nr_threads);
 void space_sanitize(struct space *s);
 void space_map_cells_pre(struct space *s, int full,
                          void (*fun)(struct cell *c, void *data), void *data);
@@ -402,11 +405,13 @@ void space_check_swallow(struct space *s);
 void space_check_sort_flags(struct space *s);
 void space_remap_ids(struct space *s, int nr_nodes, int verbose);
 long long space_get_max_parts_id(struct space *s);
-void space_replicate(struct space *s, int replicate, int verbose);
+void space_replicate(struct space *s, int replicate, int nr_threads,
+                     int verbose);
 void space_generate_gas(struct space *s, const struct cosmology *cosmo,
                         const struct hydro_props *hydro_properties,
                         const int periodic, const int with_DM_background,
-                        const double dim[3], const int verbose);
+                        const double dim[3], const int nr_threads,
+                        const int verbose);
 void space_check_cosmology(struct space *s, const struct cosmology *cosmo,
                            int rank);
 void space_reset_task_counters(struct space *s);
@@ -47,6 +47,7 @@
 #include "gravity.h"
 #include "gravity_derivatives.h"
 #include "gravity_properties.h"
+#include "hardware_counters.h"
 #include "hashmap.h"
 #include "hydro.h"
 #include "hydro_properties.h"
@@ -86,6 +87,7 @@
 #include "stars.h"
 #include "stars_io.h"
 #include "task.h"
+#include "task_trace.h"
 #include "threadpool.h"
 #include "timeline.h"
 #include "timers.h"
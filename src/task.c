@@ -47,6 +47,7 @@
 #include "inline.h"
 #include "lock.h"
 #include "mpiuse.h"
+#include "task_trace.h"
 
 /* Task type names. */
 const char *taskID_names[task_type_count] = {"none",
@@ -577,6 +578,9 @@ int task_lock(struct task *t) {
     case task_type_recv:
     case task_type_send:
 #ifdef WITH_MPI
+      /* Already completed by the MPI progress thread? */
+      if (t->req == MPI_REQUEST_NULL) return 1;
+
       /* Check the status of the MPI request. */
       if ((err = MPI_Test(&t->req, &res, &stat)) != MPI_SUCCESS) {
         char buff[MPI_MAX_ERROR_STRING];
@@ -593,6 +597,12 @@ int task_lock(struct task *t) {
         mpiuse_log_allocation(t->type, t->subtype, &t->req, 0, 0, 0, 0);
       }
 
+      /* Record the outcome in the trace of the runner, if tracing. */
+      if (task_trace_active)
+        task_trace_log_local(
+            res ? task_trace_event_mpi_done : task_trace_event_mpi_test,
+            t->type, t->subtype, 0);
+
       return res;
 #else
       error("SWIFT was not compiled with MPI support.");
@@ -0,0 +1,232 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2020 The SWIFT collaboration
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file task_trace.c
+ *  @brief Low-overhead recording of the task execution of each runner and
+ *  export to the Chrome/Perfetto JSON trace format.
+ */
+
+/* Config parameters. */
+#include "../config.h"
+
+/* Standard headers. */
+#include <stdio.h>
+#include <stdlib.h>
+
+/* This object's header. */
+#include "task_trace.h"
+
+/* Local headers. */
+#include "align.h"
+#include "clocks.h"
+#include "engine.h"
+#include "error.h"
+#include "memuse.h"
+#include "minmax.h"
+#include "task.h"
+
+/* Are the runners currently recording events? */
+volatile int task_trace_active = 0;
+
+/* Number of events per runner buffer, 0 if tracing is not used. */
+size_t task_trace_size = 0;
+
+/* Key to access the trace of the current thread. */
+pthread_key_t task_trace_local;
+
+/**
+ * @brief Switch on the tracing capabilities.
+ *
+ * Must be called before the runners are created.
+ *
+ * @param size The number of events in each runner's buffer. Rounded up to the
+ * next power of 2.
+ */
+void task_trace_enable(size_t size) {
+
+  task_trace_size = 1;
+  while (task_trace_size < size) task_trace_size <<= 1;
+
+  if (pthread_key_create(&task_trace_local, NULL) != 0)
+    error("Failed to create the task trace key.");
+}
+
+/**
+ * @brief Allocate the buffer of a runner's #task_trace.
+ *
+ * Does nothing if tracing has not been enabled.
+ *
+ * @param trace The #task_trace to initialise.
+ */
+void task_trace_init(struct task_trace *trace) {
+
+  trace->events = NULL;
+  trace->size = 0;
+  trace->head = 0;
+
+  if (task_trace_size == 0) return;
+
+  if (swift_memalign("task_trace", (void **)&trace->events,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     task_trace_size * sizeof(struct task_trace_event)) != 0)
+    error("Failed to allocate the task trace buffer.");
+  trace->size = task_trace_size;
+}
+
+/**
+ * @brief Make a #task_trace the one of the calling thread.
+ *
+ * @param trace The #task_trace.
+ */
+void task_trace_set_local(struct task_trace *trace) {
+  if (trace->events != NULL) pthread_setspecific(task_trace_local, trace);
+}
+
+/**
+ * @brief Free the buffer of a #task_trace.
+ *
+ * @param trace The #task_trace.
+ */
+void task_trace_clean(struct task_trace *trace) {
+  if (trace->events != NULL) swift_free("task_trace", trace->events);
+  trace->events = NULL;
+  trace->size = 0;
+  trace->head = 0;
+}
+
+/**
+ * @brief Write the events recorded by all the runners of this rank to a file
+ * in the Chrome/Perfetto JSON trace format and reset the buffers.
+ *
+ * Each rank is a process and each runner a thread of the trace. Times are
+ * given in micro-seconds since the start of the run such that the traces of
+ * different ranks can be loaded together.
+ *
+ * Must not be called while the runners are executing tasks.
+ *
+ * @param filename The name of the file to write to.
+ * @param e The #engine.
+ * @param step_first The first step covered by the trace.
+ * @param step_last The last step covered by the trace.
+ */
+void task_trace_dump(const char *filename, struct engine *e, int step_first,
+                     int step_last) {
+
+  if (task_trace_size == 0) return;
+
+  const ticks tic = getticks();
+  const int rank = e->nodeID;
+
+  /* Conversion factor from ticks to micro-seconds. */
+  const double us_per_tick = clocks_from_ticks(1 << 20) * 1000. / (1 << 20);
+
+  FILE *file = fopen(filename, "w");
+  if (file == NULL) error("Could not create task trace file '%s'.", filename);
+
+  fprintf(file, "{\"traceEvents\":[\n");
+  fprintf(file,
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+          "\"args\":{\"name\":\"rank %d\"}}",
+          rank, rank);
+
+  size_t dropped = 0, written = 0;
+  for (int k = 0; k < e->nr_threads; k++) {
+
+    struct task_trace *trace = &e->runners[k].trace;
+    if (trace->events == NULL) continue;
+
+    fprintf(file,
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"runner %d\"}}",
+            rank, k, k);
+
+    /* Only the last trace->size events survived in the ring. */
+    const size_t count = min(trace->head, trace->size);
+    dropped += trace->head - count;
+
+    for (size_t i = trace->head - count; i < trace->head; i++) {
+      const struct task_trace_event *ev =
+          &trace->events[i & (trace->size - 1)];
+
+      const double ts = (ev->tic - clocks_start_ticks) * us_per_tick;
+      const double dur = (ev->toc - ev->tic) * us_per_tick;
+      const char *type_name = taskID_names[ev->type];
+      const char *subtype_name = subtaskID_names[ev->subtype];
+
+      switch (ev->event) {
+        case task_trace_event_task:
+          fprintf(file,
+                  ",\n{\"name\":\"%s/%s\",\"cat\":\"task\",\"ph\":\"X\","
+                  "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                  type_name, subtype_name, ts, dur, rank, k);
+          break;
+        case task_trace_event_wait:
+          fprintf(file,
+                  ",\n{\"name\":\"wait\",\"cat\":\"queue\",\"ph\":\"X\","
+                  "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                  ts, dur, rank, k);
+          break;
+        case task_trace_event_steal:
+          fprintf(file,
+                  ",\n{\"name\":\"steal\",\"cat\":\"queue\",\"ph\":\"i\","
+                  "\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,"
+                  "\"args\":{\"task\":\"%s/%s\",\"queue\":%d}}",
+                  ts, rank, k, type_name, subtype_name, ev->data);
+          break;
+        case task_trace_event_mpi_test:
+          fprintf(file,
+                  ",\n{\"name\":\"MPI_Test\",\"cat\":\"mpi\",\"ph\":\"X\","
+                  "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,"
+                  "\"args\":{\"task\":\"%s/%s\",\"tests\":%d}}",
+                  ts, dur, rank, k, type_name, subtype_name, ev->data);
+          break;
+        case task_trace_event_mpi_done:
+          fprintf(file,
+                  ",\n{\"name\":\"MPI complete\",\"cat\":\"mpi\",\"ph\":\"i\","
+                  "\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,"
+                  "\"args\":{\"task\":\"%s/%s\"}}",
+                  ts, rank, k, type_name, subtype_name);
+          break;
+        default:
+          error("Invalid task trace event type (%d).", ev->event);
+      }
+    }
+    written += count;
+
+    /* Start afresh. */
+    trace->head = 0;
+  }
+
+  fprintf(file,
+          "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"rank\":%d,"
+          "\"first_step\":%d,\"last_step\":%d,\"dropped_events\":%zu}}\n",
+          rank, step_first, step_last, dropped);
+  fclose(file);
+
+  if (dropped > 0)
+    message(
+        "WARNING: %zu events did not fit in the task trace buffers and were "
+        "lost.",
+        dropped);
+
+  if (e->verbose)
+    message("Writing %zu events took %.3f %s.", written,
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+}
@@ -0,0 +1,166 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2020 The SWIFT collaboration
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_TASK_TRACE_H
+#define SWIFT_TASK_TRACE_H
+
+/* Config parameters. */
+#include "../config.h"
+
+/* Standard headers. */
+#include <pthread.h>
+#include <stddef.h>
+
+/* Local headers. */
+#include "cycle.h"
+#include "inline.h"
+
+struct engine;
+
+/* Default number of events in each runner's ring buffer (power of 2). */
+#define task_trace_default_size (1 << 16)
+
+/**
+ * @brief The different kinds of events recorded in a trace.
+ */
+enum task_trace_event_types {
+  task_trace_event_task,     /* Execution of a task. */
+  task_trace_event_wait,     /* Time spent waiting for a task in the queues. */
+  task_trace_event_steal,    /* A task was stolen from another queue. */
+  task_trace_event_mpi_test, /* Unsuccessful test(s) of an MPI request. */
+  task_trace_event_mpi_done, /* Successful test of an MPI request. */
+  task_trace_event_count
+};
+
+/**
+ * @brief A single event in a trace.
+ */
+struct task_trace_event {
+
+  /*! Start and end of the event. */
+  ticks tic, toc;
+
+  /*! Queue a task was stolen from or number of coalesced MPI tests. */
+  int data;
+
+  /*! Type and sub-type of the task involved. */
+  short int type, subtype;
+
+  /*! The kind of event (see #task_trace_event_types). */
+  char event;
+};
+
+/**
+ * @brief The ring buffer of events recorded by a single runner.
+ *
+ * Only the owning runner writes to it and it is only read between two
+ * launches of the tasks, hence no locking is required.
+ */
+struct task_trace {
+
+  /*! The events. */
+  struct task_trace_event *events;
+
+  /*! Size of the buffer. Always a power of 2. */
+  size_t size;
+
+  /*! Total number of events written since the last dump. */
+  size_t head;
+};
+
+/* Are the runners currently recording events? */
+extern volatile int task_trace_active;
+
+/* Number of events per runner buffer, 0 if tracing is not used. */
+extern size_t task_trace_size;
+
+/* Key to access the trace of the current thread. */
+extern pthread_key_t task_trace_local;
+
+/**
+ * @brief Record an event in a trace.
+ *
+ * Consecutive unsuccessful tests of MPI requests for the same kind of task
+ * are coalesced into a single event to avoid flooding the buffer with the
+ * polling of the runners.
+ *
+ * @param trace The #task_trace to write to.
+ * @param event The kind of event (see #task_trace_event_types).
+ * @param type The type of the task involved.
+ * @param subtype The sub-type of the task involved.
+ * @param tic The start of the event.
+ * @param toc The end of the event.
+ * @param data Queue ID for steals, unused otherwise.
+ */
+__attribute__((always_inline)) INLINE static void task_trace_log(
+    struct task_trace *trace, const enum task_trace_event_types event,
+    const int type, const int subtype, const ticks tic, const ticks toc,
+    const int data) {
+
+  const size_t mask = trace->size - 1;
+
+  /* Coalesce with the last MPI test if possible. */
+  if (event == task_trace_event_mpi_test && trace->head > 0) {
+    struct task_trace_event *last = &trace->events[(trace->head - 1) & mask];
+    if (last->event == task_trace_event_mpi_test && last->type == type &&
+        last->subtype == subtype) {
+      last->toc = toc;
+      last->data++;
+      return;
+    }
+  }
+
+  struct task_trace_event *ev = &trace->events[trace->head & mask];
+  ev->tic = tic;
+  ev->toc = toc;
+  ev->data = (event == task_trace_event_mpi_test) ? 1 : data;
+  ev->type = type;
+  ev->subtype = subtype;
+  ev->event = event;
+  trace->head++;
+}
+
+/**
+ * @brief Record an event in the trace of the calling thread, if it has one.
+ *
+ * @param event The kind of event (see #task_trace_event_types).
+ * @param type The type of the task involved.
+ * @param subtype The sub-type of the task involved.
+ * @param data Queue ID for steals, unused otherwise.
+ */
+__attribute__((always_inline)) INLINE static void task_trace_log_local(
+    const enum task_trace_event_types event, const int type,
+    const int subtype, const int data) {
+
+  struct task_trace *trace =
+      (struct task_trace *)pthread_getspecific(task_trace_local);
+  if (trace == NULL) return;
+
+  const ticks now = getticks();
+  task_trace_log(trace, event, type, subtype, now, now, data);
+}
+
+/* Function prototypes. */
+void task_trace_enable(size_t size);
+void task_trace_init(struct task_trace *trace);
+void task_trace_set_local(struct task_trace *trace);
+void task_trace_clean(struct task_trace *trace);
+void task_trace_dump(const char *filename, struct engine *e, int step_first,
+                     int step_last);
+
+#endif /* SWIFT_TASK_TRACE_H */
@@ -24,6 +24,7 @@
 #include <float.h>
 #include <limits.h>
 #include <math.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <string.h>
 #ifdef SWIFT_DEBUG_THREADPOOL
@@ -44,7 +45,8 @@
  * @brief Store a log entry of the given chunk.
  */
 void threadpool_log(struct threadpool *tp, int tid, size_t chunk_size,
-                    ticks tic, ticks toc) {
+                    threadpool_map_function map_function, ticks tic,
+                    ticks toc) {
   struct mapper_log *log = &tp->logs[tid > 0 ? tid : 0];
 
   /* Check if we need to re-allocate the log buffer. */
@@ -65,7 +67,7 @@ void threadpool_log(struct threadpool *tp, int tid, size_t chunk_size,
   entry->chunk_size = chunk_size;
   entry->tic = tic;
   entry->toc = toc;
-  entry->map_function = tp->map_function;
+  entry->map_function = map_function;
   log->count++;
 }
 
@@ -130,48 +132,121 @@ void threadpool_dump_log(struct threadpool *tp, const char *filename,
 #endif  // SWIFT_DEBUG_THREADPOOL
 
 /**
- * @brief Runner main loop, get a chunk and call the mapper function.
+ * @brief Can a map be worked on?
+ *
+ * @param f The #threadpool_future of the map.
  */
-void threadpool_chomp(struct threadpool *tp, int tid) {
+static int threadpool_map_is_ready(const struct threadpool_future *f) {
+  return f->after == NULL ||
+         f->after->map_data_done == f->after->map_data_size;
+}
+
+/**
+ * @brief Get a chunk of any of the ready maps and call the mapper functions
+ * on it.
+ *
+ * @param tp The #threadpool.
+ * @param tid The ID of the calling thread.
+ *
+ * @return 1 if a chunk was processed, 0 if no chunk is available right now.
+ */
+static int threadpool_chomp_chunk(struct threadpool *tp, int tid) {
+
+  const int num_maps = tp->num_maps;
+  for (int k = tp->first_map; k < num_maps; k++) {
+    struct threadpool_future *f = &tp->maps[k];
+
+    /* All the chunks of this map have been handed out? */
+    if (f->map_data_count >= f->map_data_size) {
+      if (k == tp->first_map) atomic_cas(&tp->first_map, k, k + 1);
+      continue;
+    }
+
+    /* Still waiting for another map? Later maps may be ready though. */
+    if (!threadpool_map_is_ready(f)) continue;
 
-  /* Loop until we can't get a chunk. */
-  while (1) {
     /* Compute the desired chunk size. */
     ptrdiff_t chunk_size;
-    if (tp->map_data_chunk == threadpool_uniform_chunk_size) {
-      chunk_size = (int)((tid + 1) * tp->map_data_size / tp->num_threads) -
-                   (int)(tid * tp->map_data_size / tp->num_threads);
+    if (f->map_data_chunk == threadpool_uniform_chunk_size) {
+      chunk_size = (int)((tid + 1) * f->map_data_size / tp->num_threads) -
+                   (int)(tid * f->map_data_size / tp->num_threads);
     } else {
       chunk_size =
-          (tp->map_data_size - tp->map_data_count) / (2 * tp->num_threads);
-      if (chunk_size > tp->map_data_chunk) chunk_size = tp->map_data_chunk;
+          (f->map_data_size - f->map_data_count) / (2 * tp->num_threads);
+      if (chunk_size > f->map_data_chunk) chunk_size = f->map_data_chunk;
     }
     if (chunk_size < 1) chunk_size = 1;
 
     /* Get a chunk and check its size. */
-    size_t task_ind = atomic_add(&tp->map_data_count, chunk_size);
-    if (task_ind >= tp->map_data_size) break;
-    if (task_ind + chunk_size > tp->map_data_size)
-      chunk_size = tp->map_data_size - task_ind;
-
-/* Call the mapper function. */
+    size_t task_ind = atomic_add(&f->map_data_count, chunk_size);
+    if (task_ind >= f->map_data_size) continue;
+    if (task_ind + chunk_size > f->map_data_size)
+      chunk_size = f->map_data_size - task_ind;
+
+    /* Call the mapper functions, one after the other on the same chunk. */
+    char *data = (char *)f->map_data + (f->map_data_stride * task_ind);
+    for (int i = 0; i < f->num_functions; i++) {
 #ifdef SWIFT_DEBUG_THREADPOOL
-    ticks tic = getticks();
+      ticks tic = getticks();
 #endif
-    tp->map_function((char *)tp->map_data + (tp->map_data_stride * task_ind),
-                     chunk_size, tp->map_extra_data);
+      f->map_functions[i](data, chunk_size, f->map_extra_data[i]);
 #ifdef SWIFT_DEBUG_THREADPOOL
-    threadpool_log(tp, tid, chunk_size, tic, getticks());
+      threadpool_log(tp, tid, chunk_size, f->map_functions[i], tic,
+                     getticks());
 #endif
+    }
+
+    /* Let the waiting maps know about our progress. */
+    atomic_add(&f->map_data_done, chunk_size);
+    return 1;
   }
+
+  return 0;
 }
 
-void *threadpool_runner(void *data) {
+/**
+ * @brief Have all the chunks of all the submitted maps been handed out?
+ *
+ * @param tp The #threadpool.
+ */
+static int threadpool_all_handed_out(struct threadpool *tp) {
+  const int num_maps = tp->num_maps;
+  for (int k = tp->first_map; k < num_maps; k++)
+    if (tp->maps[k].map_data_count < tp->maps[k].map_data_size) return 0;
+  return 1;
+}
 
-  /* Our threadpool. */
-  struct threadpool *tp = (struct threadpool *)data;
+/**
+ * @brief Runner main loop, get chunks and call the mapper functions until
+ * all the maps have been submitted and handed out.
+ */
+void threadpool_chomp(struct threadpool *tp, int tid) {
+
+  while (1) {
+    if (threadpool_chomp_chunk(tp, tid)) continue;
+
+    /* Nothing left to do and nothing more to come? */
+    if (tp->closing && threadpool_all_handed_out(tp)) break;
+
+    /* Let the maps we depend on or the caller make progress. */
+    sched_yield();
+  }
+}
+
+/**
+ * @brief Work on the maps submitted to the #threadpool until the thread is
+ * released for something else or the pool is shut down.
+ *
+ * This is the main loop of the threads owned by the pool. The threads of a
+ * shared pool (see threadpool_init_shared()) call it whenever they are idle.
+ *
+ * @param tp The #threadpool.
+ *
+ * @return 1 if the thread was released by threadpool_release_threads(), 0 if
+ * the pool is shutting down.
+ */
+int threadpool_serve(struct threadpool *tp) {
 
-  /* Main loop. */
   while (1) {
 
     /* Let the controller know that this thread is waiting. */
@@ -180,25 +255,50 @@ void *threadpool_runner(void *data) {
     /* Wait for the controller. */
     swift_barrier_wait(&tp->run_barrier);
 
-    /* If no map function is specified, just die. We use this as a mechanism
+    /* If we are shutting down, just leave. We use this as a mechanism
        to shut down threads without leaving the barriers in an invalid state. */
-    if (tp->map_function == NULL) pthread_exit(NULL);
+    if (tp->shutdown) return 0;
+
+    /* Released for something else than maps? */
+    if (!tp->running) return 1;
 
     /* Do actual work. */
     threadpool_chomp(tp, atomic_inc(&tp->num_threads_running));
   }
 }
 
+void *threadpool_runner(void *data) {
+
+  /* Our threadpool. */
+  struct threadpool *tp = (struct threadpool *)data;
+
+  /* Main loop, only returns when shutting down. */
+  threadpool_serve(tp);
+  pthread_exit(NULL);
+}
+
 /**
- * @brief Initialises the #threadpool with a given number of threads.
+ * @brief Common initialisation of the state and logs of a #threadpool.
  *
  * @param tp The #threadpool.
- * @param num_threads The number of threads.
+ * @param num_threads The number of threads working on the maps.
+ * @param shared Are the threads provided by the caller?
  */
-void threadpool_init(struct threadpool *tp, int num_threads) {
+static void threadpool_init_common(struct threadpool *tp, int num_threads,
+                                   int shared) {
 
   /* Initialize the thread counters. */
   tp->num_threads = num_threads;
+  tp->shared = shared;
+  tp->threads = NULL;
+
+  /* No maps yet. */
+  tp->num_maps = 0;
+  tp->first_map = 0;
+  tp->running = 0;
+  tp->closing = 0;
+  tp->shutdown = 0;
+  tp->released = 0;
 
 #ifdef SWIFT_DEBUG_THREADPOOL
   if ((tp->logs = (struct mapper_log *)malloc(sizeof(struct mapper_log) *
@@ -212,6 +312,17 @@ void threadpool_init(struct threadpool *tp, int num_threads) {
       error("Failed to allocate mapper log.");
   }
 #endif
+}
+
+/**
+ * @brief Initialises the #threadpool with a given number of threads.
+ *
+ * @param tp The #threadpool.
+ * @param num_threads The number of threads.
+ */
+void threadpool_init(struct threadpool *tp, int num_threads) {
+
+  threadpool_init_common(tp, num_threads, /*shared=*/0);
 
   /* If there is only a single thread, do nothing more as of here as
      we will just do work in the (blocked) calling thread. */
@@ -222,13 +333,6 @@ void threadpool_init(struct threadpool *tp, int num_threads) {
       swift_barrier_init(&tp->run_barrier, NULL, num_threads) != 0)
     error("Failed to initialize barriers.");
 
-  /* Set the task counter to zero. */
-  tp->map_data_size = 0;
-  tp->map_data_count = 0;
-  tp->map_data_stride = 0;
-  tp->map_data_chunk = 0;
-  tp->map_function = NULL;
-
   /* Allocate the threads, one less than requested since the calling thread
      works as well. */
   if ((tp->threads = (pthread_t *)malloc(sizeof(pthread_t) *
@@ -246,11 +350,272 @@ void threadpool_init(struct threadpool *tp, int num_threads) {
   swift_barrier_wait(&tp->wait_barrier);
 }
 
+/**
+ * @brief Initialises a #threadpool working with threads created by the caller.
+ *
+ * The pool does not create any thread. Instead, @c num_threads threads
+ * created by the caller serve the maps by calling threadpool_serve() whenever
+ * they are idle. The caller can release them with threadpool_release_threads()
+ * to do some other work and wait for them with threadpool_gather_threads().
+ * The calling thread does not work on the maps itself.
+ *
+ * The threads are considered released until the first call to
+ * threadpool_gather_threads().
+ *
+ * @param tp The #threadpool.
+ * @param num_threads The number of threads that will serve the pool.
+ */
+void threadpool_init_shared(struct threadpool *tp, int num_threads) {
+
+  threadpool_init_common(tp, num_threads, /*shared=*/1);
+
+  /* Not there yet. */
+  tp->released = 1;
+
+  /* The barriers also include the calling thread. */
+  if (swift_barrier_init(&tp->wait_barrier, NULL, num_threads + 1) != 0 ||
+      swift_barrier_init(&tp->run_barrier, NULL, num_threads + 1) != 0)
+    error("Failed to initialize barriers.");
+}
+
+/**
+ * @brief Release the threads of a shared #threadpool such that they return
+ * from threadpool_serve() with a value of 1.
+ *
+ * Completes all the pending maps first. No map can be submitted until the
+ * threads are gathered again.
+ *
+ * @param tp The #threadpool.
+ */
+void threadpool_release_threads(struct threadpool *tp) {
+
+  if (!tp->shared) error("Cannot release the threads of a non-shared pool.");
+  if (tp->released) error("The threads have already been released.");
+
+  threadpool_wait(tp, NULL);
+
+  tp->released = 1;
+  swift_barrier_wait(&tp->run_barrier);
+}
+
+/**
+ * @brief Wait for all the threads of a shared #threadpool to be back in
+ * threadpool_serve().
+ *
+ * @param tp The #threadpool.
+ */
+void threadpool_gather_threads(struct threadpool *tp) {
+
+  if (!tp->shared) error("Cannot gather the threads of a non-shared pool.");
+  if (!tp->released) error("The threads have not been released.");
+
+  swift_barrier_wait(&tp->wait_barrier);
+  tp->released = 0;
+}
+
+/**
+ * @brief Submit a set of fused functions to be mapped to an array of data in
+ * parallel using a #threadpool and return without waiting for them.
+ *
+ * Each function is called on a chunk of @c map_data right after the previous
+ * one, by the same thread, while the chunk is still in cache. This is only
+ * correct if the result of each function on a given element only depends on
+ * the result of the previous functions on that same element.
+ *
+ * The threads start working on the map right away, in parallel with the
+ * caller and with the other pending maps. Use threadpool_wait() before
+ * using the results.
+ *
+ * @param tp The #threadpool on which to run.
+ * @param map_functions The functions that will be applied to the map data.
+ * @param extra_data The additional pointer passed to each function.
+ * @param num_functions The number of functions, at most
+ *        #threadpool_max_fused_maps.
+ * @param map_data The data on which the mapping functions will be called.
+ * @param N Number of elements in @c map_data.
+ * @param stride Size, in bytes, of each element of @c map_data.
+ * @param chunk Number of map data elements to pass to the functions at a
+ *        time, see threadpool_map().
+ * @param after A pending map that must be complete before this one starts,
+ *        or NULL.
+ *
+ * @return The #threadpool_future of this map, valid until the next wait on
+ * all the maps.
+ */
+struct threadpool_future *threadpool_map_fused_async(
+    struct threadpool *tp, const threadpool_map_function *map_functions,
+    void **extra_data, int num_functions, void *map_data, size_t N,
+    int stride, int chunk, const struct threadpool_future *after) {
+
+  if (num_functions < 1 || num_functions > threadpool_max_fused_maps)
+    error("Invalid number of fused map functions (%d).", num_functions);
+  if (tp->released && tp->num_threads > 1)
+    error("Cannot submit a map while the threads are released.");
+
+  /* No more room? Complete everything first, which also satisfies the
+   * dependency. */
+  if (tp->num_maps == threadpool_max_pending_maps) {
+    threadpool_wait(tp, NULL);
+    after = NULL;
+  }
+
+  struct threadpool_future *f = &tp->maps[tp->num_maps];
+  for (int i = 0; i < num_functions; i++) {
+    f->map_functions[i] = map_functions[i];
+    f->map_extra_data[i] = extra_data[i];
+  }
+  f->num_functions = num_functions;
+  f->map_data = map_data;
+  f->map_data_size = N;
+  f->map_data_stride = stride;
+  if (chunk == threadpool_auto_chunk_size) {
+    f->map_data_chunk =
+        max((int)(N / (tp->num_threads * threadpool_default_chunk_ratio)), 1);
+  } else if (chunk == threadpool_uniform_chunk_size) {
+    f->map_data_chunk = threadpool_uniform_chunk_size;
+  } else {
+    f->map_data_chunk = chunk;
+  }
+  f->map_data_count = 0;
+  f->map_data_done = 0;
+  f->after = after;
+
+  /* If we just have a single thread, call the map functions directly. */
+  if (tp->num_threads == 1) {
+    for (int i = 0; i < num_functions; i++) {
+#ifdef SWIFT_DEBUG_THREADPOOL
+      ticks tic = getticks();
+#endif
+      map_functions[i](map_data, N, extra_data[i]);
+#ifdef SWIFT_DEBUG_THREADPOOL
+      threadpool_log(tp, 0, N, map_functions[i], tic, getticks());
+#endif
+    }
+    f->map_data_count = N;
+    f->map_data_done = N;
+    tp->num_maps++;
+    return f;
+  }
+
+  /* Publish the map. The atomic makes sure it is complete when seen. */
+  atomic_inc(&tp->num_maps);
+
+  /* Get the threads going if they are still resting. */
+  if (!tp->running) {
+    tp->running = 1;
+    tp->num_threads_running = 0;
+    swift_barrier_wait(&tp->run_barrier);
+  }
+
+  return f;
+}
+
+/**
+ * @brief Submit a function to be mapped to an array of data in parallel
+ * using a #threadpool and return without waiting for it.
+ *
+ * See threadpool_map_fused_async().
+ *
+ * @param tp The #threadpool on which to run.
+ * @param map_function The function that will be applied to the map data.
+ * @param map_data The data on which the mapping function will be called.
+ * @param N Number of elements in @c map_data.
+ * @param stride Size, in bytes, of each element of @c map_data.
+ * @param chunk Number of map data elements to pass to the function at a time,
+ *        see threadpool_map().
+ * @param extra_data Addtitional pointer that will be passed to the mapping
+ *        function, may contain additional data.
+ * @param after A pending map that must be complete before this one starts,
+ *        or NULL.
+ *
+ * @return The #threadpool_future of this map.
+ */
+struct threadpool_future *threadpool_map_async(
+    struct threadpool *tp, threadpool_map_function map_function,
+    void *map_data, size_t N, int stride, int chunk, void *extra_data,
+    const struct threadpool_future *after) {
+
+  return threadpool_map_fused_async(tp, &map_function, &extra_data, 1,
+                                    map_data, N, stride, chunk, after);
+}
+
+/**
+ * @brief Wait for a map submitted to the #threadpool to complete, helping
+ * with the pending maps in the meantime.
+ *
+ * @param tp The #threadpool.
+ * @param future The #threadpool_future of the map to wait for, or NULL to wait
+ *        for all the pending maps. The latter sends the threads back to rest
+ *        and invalidates all the futures.
+ */
+void threadpool_wait(struct threadpool *tp, struct threadpool_future *future) {
+
+  /* Nothing to wait for on a single thread. */
+  if (tp->num_threads == 1) {
+    if (future == NULL) tp->num_maps = 0;
+    return;
+  }
+
+  /* Wait for a single map, helping unless the threads are all shared. */
+  if (future != NULL) {
+    while (future->map_data_done < future->map_data_size)
+      if (tp->shared || !threadpool_chomp_chunk(tp, tp->num_threads - 1))
+        sched_yield();
+    return;
+  }
+
+  if (!tp->running) {
+    tp->num_maps = 0;
+    tp->first_map = 0;
+    return;
+  }
+
+  /* No more maps are coming. Do some work while I'm at it. */
+  tp->closing = 1;
+  if (!tp->shared) threadpool_chomp(tp, tp->num_threads - 1);
+
+  /* Wait for all threads to be done. */
+  swift_barrier_wait(&tp->wait_barrier);
+
+  /* Start afresh. */
+  tp->num_maps = 0;
+  tp->first_map = 0;
+  tp->closing = 0;
+  tp->running = 0;
+}
+
+/**
+ * @brief Map a set of fused functions to an array of data in parallel using
+ * a #threadpool and wait for all the pending maps to complete.
+ *
+ * See threadpool_map_fused_async().
+ *
+ * @param tp The #threadpool on which to run.
+ * @param map_functions The functions that will be applied to the map data.
+ * @param extra_data The additional pointer passed to each function.
+ * @param num_functions The number of functions.
+ * @param map_data The data on which the mapping functions will be called.
+ * @param N Number of elements in @c map_data.
+ * @param stride Size, in bytes, of each element of @c map_data.
+ * @param chunk Number of map data elements to pass to the functions at a
+ *        time, see threadpool_map().
+ */
+void threadpool_map_fused(struct threadpool *tp,
+                          const threadpool_map_function *map_functions,
+                          void **extra_data, int num_functions, void *map_data,
+                          size_t N, int stride, int chunk) {
+
+  threadpool_map_fused_async(tp, map_functions, extra_data, num_functions,
+                             map_data, N, stride, chunk, /*after=*/NULL);
+  threadpool_wait(tp, NULL);
+}
+
 /**
  * @brief Map a function to an array of data in parallel using a #threadpool.
  *
  * The function @c map_function is called on each element of @c map_data
- * in parallel.
+ * in parallel. Returns once this map and all the other pending maps are
+ * complete.
  *
  * @param tp The #threadpool on which to run.
  * @param map_function The function that will be applied to the map data.
@@ -273,45 +638,14 @@ void threadpool_map(struct threadpool *tp, threadpool_map_function map_function,
   ticks tic = getticks();
 #endif
 
-  /* If we just have a single thread, call the map function directly. */
-  if (tp->num_threads == 1) {
-    map_function(map_data, N, extra_data);
-#ifdef SWIFT_DEBUG_THREADPOOL
-    tp->map_function = map_function;
-    threadpool_log(tp, 0, N, tic, getticks());
-#endif
-    return;
-  }
-
-  /* Set the map data and signal the threads. */
-  tp->map_data_stride = stride;
-  tp->map_data_size = N;
-  tp->map_data_count = 0;
-  if (chunk == threadpool_auto_chunk_size) {
-    tp->map_data_chunk =
-        max((int)(N / (tp->num_threads * threadpool_default_chunk_ratio)), 1);
-  } else if (chunk == threadpool_uniform_chunk_size) {
-    tp->map_data_chunk = threadpool_uniform_chunk_size;
-  } else {
-    tp->map_data_chunk = chunk;
-  }
-  tp->map_function = map_function;
-  tp->map_data = map_data;
-  tp->map_extra_data = extra_data;
-  tp->num_threads_running = 0;
-
-  /* Wait for all the threads to be up and running. */
-  swift_barrier_wait(&tp->run_barrier);
-
-  /* Do some work while I'm at it. */
-  threadpool_chomp(tp, tp->num_threads - 1);
-
-  /* Wait for all threads to be done. */
-  swift_barrier_wait(&tp->wait_barrier);
+  threadpool_map_async(tp, map_function, map_data, N, stride, chunk,
+                       extra_data, /*after=*/NULL);
+  threadpool_wait(tp, NULL);
 
 #ifdef SWIFT_DEBUG_THREADPOOL
   /* Log the total call time to thread id -1. */
-  threadpool_log(tp, -1, N, tic, getticks());
+  if (tp->num_threads > 1)
+    threadpool_log(tp, -1, N, map_function, tic, getticks());
 #endif
 }
 
@@ -329,11 +663,20 @@ void threadpool_reset_log(struct threadpool *tp) {
  */
 void threadpool_clean(struct threadpool *tp) {
 
-  if (tp->num_threads > 1) {
-    /* Destroy the runner threads by calling them with a NULL mapper function
-     * and waiting for all the threads to terminate. This ensures that no
+  /* The threads of a shared pool are stopped by their owner. */
+  if (tp->shared) {
+    if (swift_barrier_destroy(&tp->wait_barrier) != 0 ||
+        swift_barrier_destroy(&tp->run_barrier) != 0)
+      error("Failed to destroy threadpool barriers.");
+
+  } else if (tp->num_threads > 1) {
+    /* Complete any pending work. */
+    threadpool_wait(tp, NULL);
+
+    /* Destroy the runner threads by releasing them with the shutdown flag
+     * set and waiting for all the threads to terminate. This ensures that no
      * thread is still waiting at a barrier. */
-    tp->map_function = NULL;
+    tp->shutdown = 1;
     swift_barrier_wait(&tp->run_barrier);
     for (int k = 0; k < tp->num_threads - 1; k++) {
       void *retval;
@@ -35,6 +35,8 @@
 #define threadpool_default_chunk_ratio 7
 #define threadpool_auto_chunk_size 0
 #define threadpool_uniform_chunk_size -1
+#define threadpool_max_pending_maps 32
+#define threadpool_max_fused_maps 8
 
 /* Function type for mappings. */
 typedef void (*threadpool_map_function)(void *map_data, int num_elements,
@@ -67,6 +69,40 @@ struct mapper_log {
   int count;
 };
 
+/**
+ * @brief A map submitted to a #threadpool, and the handle used to wait for
+ * its completion.
+ *
+ * Only valid until the next call to threadpool_wait() on all the maps.
+ */
+struct threadpool_future {
+
+  /* The functions applied, in that order, to each chunk of the data. */
+  threadpool_map_function map_functions[threadpool_max_fused_maps];
+
+  /* The extra data of each function. */
+  void *map_extra_data[threadpool_max_fused_maps];
+
+  /* Number of fused functions. */
+  int num_functions;
+
+  /* Map data, its size and stride. */
+  void *map_data;
+  size_t map_data_size, map_data_stride;
+
+  /* Requested chunk size. */
+  ptrdiff_t map_data_chunk;
+
+  /* Number of elements handed out to the threads. */
+  volatile size_t map_data_count;
+
+  /* Number of elements processed. */
+  volatile size_t map_data_done;
+
+  /* Map that must be complete before this one can start, if any. */
+  const struct threadpool_future *after;
+};
+
 /* Data of a threadpool. */
 struct threadpool {
 
@@ -77,11 +113,26 @@ struct threadpool {
   swift_barrier_t wait_barrier;
   swift_barrier_t run_barrier;
 
-  /* Current map data and count. */
-  void *map_data, *map_extra_data;
-  volatile size_t map_data_count, map_data_size, map_data_stride;
-  volatile ptrdiff_t map_data_chunk;
-  volatile threadpool_map_function map_function;
+  /* The maps submitted since the last wait. */
+  struct threadpool_future maps[threadpool_max_pending_maps];
+
+  /* Number of maps submitted and index of the first one with chunks left. */
+  volatile int num_maps, first_map;
+
+  /* Are the threads out of the barriers? */
+  volatile int running;
+
+  /* Have all the maps been submitted? */
+  volatile int closing;
+
+  /* Are we shutting the threads down? */
+  volatile int shutdown;
+
+  /* Are the threads provided by the caller? */
+  int shared;
+
+  /* Have the threads been released for something else than maps? */
+  volatile int released;
 
   /* Number of threads in this pool. */
   int num_threads;
@@ -96,9 +147,26 @@ struct threadpool {
 
 /* Function prototypes. */
 void threadpool_init(struct threadpool *tp, int num_threads);
+void threadpool_init_shared(struct threadpool *tp, int num_threads);
+int threadpool_serve(struct threadpool *tp);
+void threadpool_release_threads(struct threadpool *tp);
+void threadpool_gather_threads(struct threadpool *tp);
 void threadpool_map(struct threadpool *tp, threadpool_map_function map_function,
                     void *map_data, size_t N, int stride, int chunk,
                     void *extra_data);
+void threadpool_map_fused(struct threadpool *tp,
+                          const threadpool_map_function *map_functions,
+                          void **extra_data, int num_functions, void *map_data,
+                          size_t N, int stride, int chunk);
+struct threadpool_future *threadpool_map_async(
+    struct threadpool *tp, threadpool_map_function map_function,
+    void *map_data, size_t N, int stride, int chunk, void *extra_data,
+    const struct threadpool_future *after);
+struct threadpool_future *threadpool_map_fused_async(
+    struct threadpool *tp, const threadpool_map_function *map_functions,
+    void **extra_data, int num_functions, void *map_data, size_t N,
+    int stride, int chunk, const struct threadpool_future *after);
+void threadpool_wait(struct threadpool *tp, struct threadpool_future *future);
 void threadpool_clean(struct threadpool *tp);
 #ifdef SWIFT_DEBUG_THREADPOOL
 void threadpool_reset_log(struct threadpool *tp);
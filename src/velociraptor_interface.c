@@ -33,6 +33,7 @@
 /* Local includes. */
 #include "cooling.h"
 #include "engine.h"
+#include "fof.h"
 #include "hydro.h"
 #include "swift_velociraptor_part.h"
 #include "threadpool.h"
@@ -207,34 +208,28 @@ struct groupinfo *InvokeVelociraptor(
 #endif /* HAVE_VELOCIRAPTOR */
 
 /**
- * @brief Temporary structure used for the data copy mapper.
- */
-struct velociraptor_copy_data {
-  const struct engine *e;
-  struct swift_vel_part *swift_parts;
-};
-
-/**
- * @brief Mapper function to conver the #gpart into VELOCIraptor Particles.
+ * @brief Convert a chunk of #gpart into VELOCIraptor particles.
+ *
+ * The particles are read directly from the #space arrays, so any sub-set of
+ * them can be converted in chunks of arbitrary size without ever holding the
+ * full list of VELOCIraptor particles.
  *
- * @param map_data The array of #gpart.
- * @param nr_gparts The number of #gpart.
- * @param extra_data Pointer to the #engine and to the array to fill.
+ * @param e The #engine.
+ * @param gpart_indices Indices of the #gpart to convert in the #space array
+ * (NULL to convert a contiguous range of #gpart).
+ * @param offset Index of the first particle of the chunk in the list of
+ * particles to convert.
+ * @param count The number of particles in the chunk.
+ * @param swift_parts (return) The converted particles.
  */
-void velociraptor_convert_particles_mapper(void *map_data, int nr_gparts,
-                                           void *extra_data) {
+void velociraptor_convert_particles(const struct engine *e,
+                                    const size_t *gpart_indices,
+                                    const size_t offset, const size_t count,
+                                    struct swift_vel_part *swift_parts) {
 
-  /* Unpack the data */
-  struct gpart *restrict gparts = (struct gpart *)map_data;
-  struct velociraptor_copy_data *data =
-      (struct velociraptor_copy_data *)extra_data;
-  const struct engine *e = data->e;
+  /* Handle on the particles */
   const struct space *s = e->s;
-  struct swift_vel_part *swift_parts =
-      data->swift_parts + (ptrdiff_t)(gparts - s->gparts);
-  const ptrdiff_t index_offset = gparts - s->gparts;
-
-  /* Handle on the other particle types */
+  const struct gpart *gparts = s->gparts;
   const struct part *parts = s->parts;
   const struct xpart *xparts = s->xparts;
   const struct spart *sparts = s->sparts;
@@ -261,34 +256,35 @@ void velociraptor_convert_particles_mapper(void *map_data, int nr_gparts,
    * - Physical internal energy (for the gas),
    * - Temperatures (for the gas).
    */
-  for (int i = 0; i < nr_gparts; i++) {
+  for (size_t i = 0; i < count; i++) {
+
+    const size_t ind =
+        gpart_indices != NULL ? gpart_indices[offset + i] : offset + i;
+    const struct gpart *gp = &gparts[ind];
 
     if (periodic) {
-      swift_parts[i].x[0] =
-          box_wrap(gparts[i].x[0] - pos_dithering[0], 0.0, dim[0]);
-      swift_parts[i].x[1] =
-          box_wrap(gparts[i].x[1] - pos_dithering[1], 0.0, dim[1]);
-      swift_parts[i].x[2] =
-          box_wrap(gparts[i].x[2] - pos_dithering[2], 0.0, dim[2]);
+      swift_parts[i].x[0] = box_wrap(gp->x[0] - pos_dithering[0], 0.0, dim[0]);
+      swift_parts[i].x[1] = box_wrap(gp->x[1] - pos_dithering[1], 0.0, dim[1]);
+      swift_parts[i].x[2] = box_wrap(gp->x[2] - pos_dithering[2], 0.0, dim[2]);
     } else {
-      swift_parts[i].x[0] = gparts[i].x[0];
-      swift_parts[i].x[1] = gparts[i].x[1];
-      swift_parts[i].x[2] = gparts[i].x[2];
+      swift_parts[i].x[0] = gp->x[0];
+      swift_parts[i].x[1] = gp->x[1];
+      swift_parts[i].x[2] = gp->x[2];
     }
 
-    swift_parts[i].v[0] = gparts[i].v_full[0] * a_inv;
-    swift_parts[i].v[1] = gparts[i].v_full[1] * a_inv;
-    swift_parts[i].v[2] = gparts[i].v_full[2] * a_inv;
+    swift_parts[i].v[0] = gp->v_full[0] * a_inv;
+    swift_parts[i].v[1] = gp->v_full[1] * a_inv;
+    swift_parts[i].v[2] = gp->v_full[2] * a_inv;
 
 #ifndef HAVE_VELOCIRAPTOR_WITH_NOMASS
-    swift_parts[i].mass = gravity_get_mass(&gparts[i]);
+    swift_parts[i].mass = gravity_get_mass(gp);
 #endif
 
-    swift_parts[i].potential = gravity_get_comoving_potential(&gparts[i]);
+    swift_parts[i].potential = gravity_get_comoving_potential(gp);
 
-    swift_parts[i].type = gparts[i].type;
+    swift_parts[i].type = gp->type;
 
-    swift_parts[i].index = i + index_offset;
+    swift_parts[i].index = ind;
 #ifdef WITH_MPI
     swift_parts[i].task = e->nodeID;
 #else
@@ -297,13 +293,13 @@ void velociraptor_convert_particles_mapper(void *map_data, int nr_gparts,
 
     /* Set gas particle IDs from their hydro counterparts and set internal
      * energies. */
-    switch (gparts[i].type) {
+    switch (gp->type) {
 
       case swift_type_gas: {
-        const struct part *p = &parts[-gparts[i].id_or_neg_offset];
-        const struct xpart *xp = &xparts[-gparts[i].id_or_neg_offset];
+        const struct part *p = &parts[-gp->id_or_neg_offset];
+        const struct xpart *xp = &xparts[-gp->id_or_neg_offset];
 
-        swift_parts[i].id = parts[-gparts[i].id_or_neg_offset].id;
+        swift_parts[i].id = p->id;
         swift_parts[i].u = hydro_get_drifted_physical_internal_energy(p, cosmo);
         swift_parts[i].T = cooling_get_temperature(phys_const, hydro_props, us,
                                                    cosmo, cool_func, p, xp);
@@ -311,28 +307,28 @@ void velociraptor_convert_particles_mapper(void *map_data, int nr_gparts,
 
       case swift_type_stars:
 
-        swift_parts[i].id = sparts[-gparts[i].id_or_neg_offset].id;
+        swift_parts[i].id = sparts[-gp->id_or_neg_offset].id;
         swift_parts[i].u = 0.f;
         swift_parts[i].T = 0.f;
         break;
 
       case swift_type_black_hole:
 
-        swift_parts[i].id = bparts[-gparts[i].id_or_neg_offset].id;
+        swift_parts[i].id = bparts[-gp->id_or_neg_offset].id;
         swift_parts[i].u = 0.f;
         swift_parts[i].T = 0.f;
         break;
 
       case swift_type_dark_matter:
 
-        swift_parts[i].id = gparts[i].id_or_neg_offset;
+        swift_parts[i].id = gp->id_or_neg_offset;
         swift_parts[i].u = 0.f;
         swift_parts[i].T = 0.f;
         break;
 
       case swift_type_dark_matter_background:
 
-        swift_parts[i].id = gparts[i].id_or_neg_offset;
+        swift_parts[i].id = gp->id_or_neg_offset;
         swift_parts[i].u = 0.f;
         swift_parts[i].T = 0.f;
         break;
@@ -343,6 +339,37 @@ void velociraptor_convert_particles_mapper(void *map_data, int nr_gparts,
   }
 }
 
+/**
+ * @brief Temporary structure used for the data copy mapper.
+ */
+struct velociraptor_copy_data {
+  const struct engine *e;
+  struct swift_vel_part *swift_parts;
+  const size_t *gpart_indices;
+};
+
+/**
+ * @brief Mapper function to conver the #gpart into VELOCIraptor Particles.
+ *
+ * @param map_data The array of VELOCIraptor particles to fill.
+ * @param nr_parts The number of VELOCIraptor particles.
+ * @param extra_data Pointer to the #engine, to the start of the array to fill
+ * and to the list of #gpart to convert.
+ */
+void velociraptor_convert_particles_mapper(void *map_data, int nr_parts,
+                                           void *extra_data) {
+
+  /* Unpack the data */
+  struct swift_vel_part *restrict swift_parts =
+      (struct swift_vel_part *)map_data;
+  const struct velociraptor_copy_data *data =
+      (struct velociraptor_copy_data *)extra_data;
+  const size_t offset = swift_parts - data->swift_parts;
+
+  velociraptor_convert_particles(data->e, data->gpart_indices, offset,
+                                 nr_parts, swift_parts);
+}
+
 /**
  * @brief Initialise VELOCIraptor with configuration, units,
  * simulation info needed to run.
@@ -451,6 +478,21 @@ void velociraptor_invoke(struct engine *e, const int linked_with_snap) {
   const int nr_cells = s->nr_cells;
   const struct cell *cells_top = s->cells_top;
 
+  /* Do we only hand the particles in FOF groups over to VELOCIraptor? */
+  if (e->stf_only_fof_groups) {
+#ifdef WITH_FOF
+    /* Find the groups at the current time. This replaces the tasks by the FOF
+     * ones so the next step must rebuild. Any pending black hole seeding FOF
+     * is left untouched. */
+    const int run_fof = e->run_fof;
+    engine_fof(e, /*dump_results=*/0, /*seed_black_holes=*/0);
+    e->run_fof = run_fof;
+    e->forcerebuild = 1;
+#else
+    error("SWIFT was not compiled with FOF enabled!");
+#endif
+  }
+
   /* Start by freeing some of the unnecessary memory to give VR some breathing
      space */
 #ifdef WITH_MPI
@@ -640,12 +682,6 @@ void velociraptor_invoke(struct engine *e, const int linked_with_snap) {
     message("VR Collecting top-level cell info took %.3f %s.",
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
-  /* Mention the number of particles being sent */
-  if (e->verbose)
-    message(
-        "VELOCIraptor conf: MPI rank %d sending %zu gparts to VELOCIraptor.",
-        engine_rank, nr_gparts);
-
   /* Generate directory name for this output - start with snapshot directory, if
    * specified */
   char outputDirName[FILENAME_BUFFER_SIZE] = "";
@@ -689,18 +725,63 @@ void velociraptor_invoke(struct engine *e, const int linked_with_snap) {
 
   tic = getticks();
 
+  /* Collect the particles in FOF groups, if that is all VELOCIraptor gets */
+  size_t nr_vr_gparts = nr_gparts;
+  size_t nr_vr_parts = nr_parts;
+  size_t nr_vr_sparts = nr_sparts;
+  size_t *gpart_indices = NULL;
+  if (e->stf_only_fof_groups) {
+#ifdef WITH_FOF
+    const size_t group_id_default = e->fof_properties->group_id_default;
+
+    nr_vr_gparts = 0;
+    for (size_t i = 0; i < nr_gparts; i++)
+      if (s->gparts[i].fof_data.group_id != group_id_default) nr_vr_gparts++;
+
+    if (swift_memalign("VR.gpart_indices", (void **)&gpart_indices,
+                       SWIFT_STRUCT_ALIGNMENT,
+                       nr_vr_gparts * sizeof(size_t)) != 0)
+      error("Failed to allocate list of gparts in groups for VELOCIraptor.");
+
+    nr_vr_gparts = 0;
+    nr_vr_parts = 0;
+    nr_vr_sparts = 0;
+    for (size_t i = 0; i < nr_gparts; i++) {
+      const struct gpart *gp = &s->gparts[i];
+      if (gp->fof_data.group_id == group_id_default) continue;
+
+      gpart_indices[nr_vr_gparts++] = i;
+      if (gp->type == swift_type_gas) nr_vr_parts++;
+      if (gp->type == swift_type_stars) nr_vr_sparts++;
+    }
+#endif
+
+    if (e->verbose)
+      message("VELOCIraptor conf: %zu out of %zu gparts are in FOF groups.",
+              nr_vr_gparts, nr_gparts);
+  }
+
   /* Allocate and populate an array of swift_vel_parts to be passed to
    * VELOCIraptor. */
   struct swift_vel_part *swift_parts = NULL;
   if (swift_memalign("VR.parts", (void **)&swift_parts, part_align,
-                     nr_gparts * sizeof(struct swift_vel_part)) != 0)
+                     nr_vr_gparts * sizeof(struct swift_vel_part)) != 0)
     error("Failed to allocate array of particles for VELOCIraptor.");
 
-  struct velociraptor_copy_data copy_data = {e, swift_parts};
+  struct velociraptor_copy_data copy_data = {e, swift_parts, gpart_indices};
   threadpool_map(&e->threadpool, velociraptor_convert_particles_mapper,
-                 s->gparts, nr_gparts, sizeof(struct gpart),
+                 swift_parts, nr_vr_gparts, sizeof(struct swift_vel_part),
                  threadpool_auto_chunk_size, &copy_data);
 
+  /* The particles know their index in the gpart array, we can drop the list */
+  if (gpart_indices != NULL) swift_free("VR.gpart_indices", gpart_indices);
+
+  /* Mention the number of particles being sent */
+  if (e->verbose)
+    message(
+        "VELOCIraptor conf: MPI rank %d sending %zu gparts to VELOCIraptor.",
+        engine_rank, nr_vr_gparts);
+
   /* Report timing */
   if (e->verbose)
     message("VR Collecting particle info took %.3f %s.",
@@ -721,8 +802,8 @@ void velociraptor_invoke(struct engine *e, const int linked_with_snap) {
 
   /* Call VELOCIraptor. */
   group_info = (struct groupinfo *)InvokeVelociraptor(
-      e->stf_output_count, outputFileName, cosmo_info, sim_info, nr_gparts,
-      nr_parts, nr_sparts, swift_parts, cell_node_ids, e->nr_threads,
+      e->stf_output_count, outputFileName, cosmo_info, sim_info, nr_vr_gparts,
+      nr_vr_parts, nr_vr_sparts, swift_parts, cell_node_ids, e->nr_threads,
       linked_with_snap, &num_gparts_in_groups);
 
   /* Report that the memory was freed */
@@ -22,11 +22,19 @@
 /* Config parameters. */
 #include "../config.h"
 
+/* Standard headers */
+#include <stddef.h>
+
 /* Forward declaration */
 struct engine;
+struct swift_vel_part;
 
 /* VELOCIraptor wrapper functions. */
 void velociraptor_init(struct engine *e);
 void velociraptor_invoke(struct engine *e, const int linked_with_snap);
+void velociraptor_convert_particles(const struct engine *e,
+                                    const size_t *gpart_indices,
+                                    const size_t offset, const size_t count,
+                                    struct swift_vel_part *swift_parts);
 
 #endif /* SWIFT_VELOCIRAPTOR_INTERFACE_H */
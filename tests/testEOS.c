@@ -87,6 +87,169 @@
  */
 
 #ifdef EOS_PLANETARY
+
+/* Size of the synthetic SESAME-style table. */
+#define testEOS_SESAME_num_rho 80
+#define testEOS_SESAME_num_T 60
+
+/* Number of random look-ups in the SESAME-style table checks. */
+#define testEOS_SESAME_num_tests 1000000
+
+/**
+ * @brief Write a synthetic SESAME-style table with irregularly spaced
+ * densities and temperatures, a sp. int. energy that is not monotonic at low
+ * temperatures, and some non-positive pressures.
+ *
+ * @param filename The name of the file to write.
+ */
+void write_synthetic_SESAME_table(const char *filename) {
+
+  const int num_rho = testEOS_SESAME_num_rho, num_T = testEOS_SESAME_num_T;
+
+  FILE *f = fopen(filename, "w");
+  if (f == NULL) error("Could not create the table file '%s'.", filename);
+
+  for (int i = 0; i < 5; i++) fprintf(f, "# Synthetic SESAME-style table\n");
+  fprintf(f, "%d %d\n", num_rho + 1, num_T + 1);
+
+  /* Densities and temperatures, with an extra 0 first. */
+  double rho[testEOS_SESAME_num_rho + 1], T[testEOS_SESAME_num_T + 1];
+  rho[0] = 0.;
+  for (int i = 1; i <= num_rho; i++)
+    rho[i] = 1e-3 * pow(1.25, i) * (1. + 0.1 * sin(i));
+  T[0] = 0.;
+  for (int j = 1; j <= num_T; j++)
+    T[j] = 100. * pow(1.2, j) * (1. + 0.05 * cos(j));
+  for (int i = 0; i <= num_rho; i++) fprintf(f, "%.8e ", rho[i]);
+  fprintf(f, "\n");
+  for (int j = 0; j <= num_T; j++) fprintf(f, "%.8e ", T[j]);
+  fprintf(f, "\n");
+
+  for (int j = 0; j <= num_T; j++) {
+    for (int i = 0; i <= num_rho; i++) {
+      const double u = 1e3 * T[j] + 1e5 * rho[i] / (1. + j);
+      const double P = 0.5 * rho[i] * u - 1e4 * rho[i] * rho[i];
+      const double c = sqrt(fabs(P) / (rho[i] + 1e-10)) + 1.;
+      fprintf(f, "%.8e %.8e %.8e %.8e\n", u, P, c, log(T[j] + 1.));
+    }
+  }
+  fclose(f);
+}
+
+/**
+ * @brief Check the SESAME-style tables against the plain bisection searches
+ * and between their text and memory-mapped binary versions, and time the
+ * look-ups.
+ */
+void check_SESAME_tables(void) {
+
+  const char *table_file = "testEOS_SESAME_table.txt";
+  char binary_file[64];
+  sprintf(binary_file, "%s.bin", table_file);
+
+  struct unit_system us;
+  units_init_si(&us);
+
+  /* Read the text table and write its binary version. */
+  write_synthetic_SESAME_table(table_file);
+  struct SESAME_params text, binary;
+  bzero(&text, sizeof(struct SESAME_params));
+  bzero(&binary, sizeof(struct SESAME_params));
+  set_SESAME_iron(&text, eos_planetary_id_SESAME_iron);
+  set_SESAME_iron(&binary, eos_planetary_id_SESAME_iron);
+  load_table_SESAME(&text, (char *)table_file);
+  prepare_table_SESAME(&text);
+  convert_units_SESAME(&text, &us);
+  write_table_binary_SESAME(&text, table_file);
+
+  /* Map the binary table. */
+  load_table_SESAME(&binary, binary_file);
+  prepare_table_SESAME(&binary);
+  convert_units_SESAME(&binary, &us);
+  if (binary.mapped_size == 0) error("The binary table was not mapped.");
+
+  const int num_rho = text.num_rho, num_T = text.num_T;
+  const float log_rho_min = text.table_log_rho[0] - 1.f;
+  const float log_rho_max = text.table_log_rho[num_rho - 1] + 1.f;
+  const float log_u_min = text.table_log_u_rho_T[0] - 1.f;
+  const float log_u_max = text.table_log_u_rho_T[num_rho * num_T - 1] + 1.f;
+
+  /* Random densities and energies, covering the outside of the table too. */
+  float *rho = (float *)malloc(testEOS_SESAME_num_tests * sizeof(float));
+  float *u = (float *)malloc(testEOS_SESAME_num_tests * sizeof(float));
+  if (rho == NULL || u == NULL) error("Failed to allocate the test values.");
+  for (int k = 0; k < testEOS_SESAME_num_tests; k++) {
+    rho[k] = expf(log_rho_min + random_uniform(0., 1.) *
+                                    (log_rho_max - log_rho_min));
+    u[k] = expf(log_u_min + random_uniform(0., 1.) * (log_u_max - log_u_min));
+  }
+
+  /* The grid searches must give the same indices as the bisections. */
+  for (int k = 0; k < testEOS_SESAME_num_tests; k++) {
+    const float log_rho = logf(rho[k]), log_u = logf(u[k]);
+    int i_rho, i_u_1, i_u_2;
+    find_indices_SESAME(log_rho, log_u, &text, &i_rho, &i_u_1, &i_u_2);
+
+    int ref_rho =
+        find_value_in_monot_incr_array(log_rho, text.table_log_rho, num_rho);
+    if (ref_rho <= -1)
+      ref_rho = 0;
+    else if (ref_rho >= num_rho)
+      ref_rho = num_rho - 2;
+    int ref_u_1 = find_value_in_monot_incr_array(
+        log_u, text.table_log_u_rho_T + ref_rho * num_T, num_T);
+    if (ref_u_1 <= -1)
+      ref_u_1 = 0;
+    else if (ref_u_1 >= num_T)
+      ref_u_1 = num_T - 2;
+
+    int ref_u_2 = find_value_in_monot_incr_array(
+        log_u, text.table_log_u_rho_T + (ref_rho + 1) * num_T, num_T);
+    if (ref_u_2 <= -1)
+      ref_u_2 = 0;
+    else if (ref_u_2 >= num_T)
+      ref_u_2 = num_T - 2;
+
+    if (i_rho != ref_rho || i_u_1 != ref_u_1 || i_u_2 != ref_u_2)
+      error(
+          "Wrong table indices for rho=%e u=%e: (%d, %d, %d) instead of "
+          "(%d, %d, %d)",
+          rho[k], u[k], i_rho, i_u_1, i_u_2, ref_rho, ref_u_1, ref_u_2);
+
+    /* Inside the table, i_u_2 must bracket u at the next density. */
+    const float *log_u_2 = text.table_log_u_rho_T + (i_rho + 1) * num_T;
+    if (log_u >= log_u_2[0] && log_u < log_u_2[num_T - 1] &&
+        !(log_u_2[i_u_2] <= log_u && log_u < log_u_2[i_u_2 + 1]))
+      error("i_u_2=%d does not bracket log(u)=%e at i_rho+1=%d: [%e, %e)",
+            i_u_2, log_u, i_rho + 1, log_u_2[i_u_2], log_u_2[i_u_2 + 1]);
+  }
+
+  /* The text and binary tables must give identical results. */
+  ticks tic = getticks();
+  for (int k = 0; k < testEOS_SESAME_num_tests; k++) {
+    const float P = SESAME_pressure_from_internal_energy(rho[k], u[k], &text);
+    const float c =
+        SESAME_soundspeed_from_internal_energy(rho[k], u[k], &text);
+    const float P_bin =
+        SESAME_pressure_from_internal_energy(rho[k], u[k], &binary);
+    const float c_bin =
+        SESAME_soundspeed_from_internal_energy(rho[k], u[k], &binary);
+    if (memcmp(&P, &P_bin, sizeof(float)) != 0 ||
+        memcmp(&c, &c_bin, sizeof(float)) != 0)
+      error("Different text and binary results for rho=%e u=%e", rho[k], u[k]);
+  }
+  message("%d look-ups of P and c in the text and binary tables took %.3f %s.",
+          testEOS_SESAME_num_tests, clocks_from_ticks(getticks() - tic),
+          clocks_getunit());
+
+  clean_table_SESAME(&text);
+  clean_table_SESAME(&binary);
+  free(rho);
+  free(u);
+  unlink(table_file);
+  unlink(binary_file);
+}
+
 int main(int argc, char *argv[]) {
   float rho, u, log_rho, log_u, P, c;
   struct unit_system us;
@@ -142,6 +305,10 @@ int main(int argc, char *argv[]) {
   /* Greeting message */
   printf("This is %s\n", package_description());
 
+  /* Check the SESAME-style tables and their look-ups */
+  clocks_set_cpufreq(0);
+  check_SESAME_tables();
+
   // Check material ID
   const enum eos_planetary_type_id type =
       (enum eos_planetary_type_id)(mat_id / eos_planetary_type_factor);
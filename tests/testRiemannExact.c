@@ -392,6 +392,87 @@ void check_riemann_symmetry(void) {
   }
 }
 
+/**
+ * @brief Check that the batched solver agrees with the scalar solver, for a
+ * batch of random problems that contains vacuum generating cases
+ */
+void check_riemann_batch(void) {
+
+  static struct riemann_batch b;
+  b.count = 0;
+
+  for (int i = 0; i < RIEMANN_BATCH_SIZE; i++) {
+    float WL[5], WR[5], n_unit[3], vij[3];
+
+    n_unit[0] = random_uniform(-1.0f, 1.0f);
+    n_unit[1] = random_uniform(-1.0f, 1.0f);
+    n_unit[2] = random_uniform(-1.0f, 1.0f);
+    const float n_norm = sqrtf(n_unit[0] * n_unit[0] + n_unit[1] * n_unit[1] +
+                               n_unit[2] * n_unit[2]);
+    n_unit[0] /= n_norm;
+    n_unit[1] /= n_norm;
+    n_unit[2] /= n_norm;
+
+    WL[0] = random_uniform(0.1f, 1.0f);
+    WL[1] = random_uniform(-10.0f, 10.0f);
+    WL[2] = random_uniform(-10.0f, 10.0f);
+    WL[3] = random_uniform(-10.0f, 10.0f);
+    WL[4] = random_uniform(0.1f, 1.0f);
+    WR[0] = random_uniform(0.1f, 1.0f);
+    WR[1] = random_uniform(-10.0f, 10.0f);
+    WR[2] = random_uniform(-10.0f, 10.0f);
+    WR[3] = random_uniform(-10.0f, 10.0f);
+    WR[4] = random_uniform(0.1f, 1.0f);
+
+    if (i % 13 == 0) {
+      /* States moving apart fast enough to generate vacuum */
+      for (int k = 0; k < 3; k++) {
+        WL[k + 1] = -10.0f * n_unit[k];
+        WR[k + 1] = 10.0f * n_unit[k];
+      }
+    }
+
+    vij[0] = random_uniform(-10.0f, 10.0f);
+    vij[1] = random_uniform(-10.0f, 10.0f);
+    vij[2] = random_uniform(-10.0f, 10.0f);
+
+    riemann_batch_add(&b, WL, WR, n_unit, vij);
+  }
+
+  for (int middle_state = 0; middle_state < 2; middle_state++) {
+
+    if (middle_state)
+      riemann_solve_for_middle_state_flux_batch(&b);
+    else
+      riemann_solve_for_flux_batch(&b);
+
+    for (int i = 0; i < b.count; i++) {
+      float WL[5], WR[5], n_unit[3], vij[3], totflux[5];
+      riemann_batch_get(&b, i, WL, WR, n_unit, vij);
+      if (middle_state)
+        riemann_solve_for_middle_state_flux(WL, WR, n_unit, vij, totflux);
+      else
+        riemann_solve_for_flux(WL, WR, n_unit, vij, totflux);
+
+      float scale = 0.0f;
+      for (int k = 0; k < 5; k++) scale = max(scale, fabsf(totflux[k]));
+
+      for (int k = 0; k < 5; k++) {
+        if (fabsf(b.flux[k][i] - totflux[k]) >
+            max_abs_error + max_rel_error * scale) {
+          message("WL=[%.8e, %.8e, %.8e, %.8e, %.8e]", WL[0], WL[1], WL[2],
+                  WL[3], WL[4]);
+          message("WR=[%.8e, %.8e, %.8e, %.8e, %.8e]", WR[0], WR[1], WR[2],
+                  WR[3], WR[4]);
+          error("Batched %s flux differs: %.8e != %.8e (component %d)",
+                middle_state ? "middle state" : "full", b.flux[k][i],
+                totflux[k], k);
+        }
+      }
+    }
+  }
+}
+
 /**
  * @brief Check the exact Riemann solver
  */
@@ -419,5 +500,10 @@ int main(int argc, char* argv[]) {
     check_riemann_symmetry();
   }
 
+  /* batched solver test */
+  for (int i = 0; i < 100; ++i) {
+    check_riemann_batch();
+  }
+
   return 0;
 }
@@ -70,6 +70,72 @@ void map_function_check_uniform(void *map_data, int num_elements,
   printf("    map_function_check_uniform handled %d elements\n", num_elements);
 }
 
+void map_function_set_index(void *map_data, int num_elements,
+                            void *extra_data) {
+  int *inputs = (int *)map_data;
+  const int *base = (const int *)extra_data;
+  usleep(rand() % 1000);
+  for (int ind = 0; ind < num_elements; ind++)
+    inputs[ind] = (int)(&inputs[ind] - base);
+}
+
+void map_function_check_reversed(void *map_data, int num_elements,
+                                 void *extra_data) {
+  const int *inputs = (const int *)map_data;
+  const int *others = (const int *)extra_data;
+  const int N = 1000;
+  for (int ind = 0; ind < num_elements; ind++) {
+    const int i = (int)(&inputs[ind] - others);
+    if (others[N - 1 - i] != N - 1 - i) {
+      printf("  chained map started before its dependency completed\n");
+      fflush(stdout);
+      exit(1);
+    }
+  }
+}
+
+void map_function_increment(void *map_data, int num_elements,
+                            void *extra_data) {
+  int *inputs = (int *)map_data;
+  for (int ind = 0; ind < num_elements; ind++) inputs[ind] += 1;
+}
+
+void map_function_double(void *map_data, int num_elements, void *extra_data) {
+  int *inputs = (int *)map_data;
+  for (int ind = 0; ind < num_elements; ind++) inputs[ind] *= 2;
+}
+
+void map_function_count_hits(void *map_data, int num_elements,
+                             void *extra_data) {
+  const int *inputs = (const int *)map_data;
+  int *hits = (int *)extra_data;
+  usleep(rand() % 1000);
+  for (int ind = 0; ind < num_elements; ind++) atomic_inc(&hits[inputs[ind]]);
+}
+
+void map_function_slow_done(void *map_data, int num_elements,
+                            void *extra_data) {
+  usleep(rand() % 1000);
+  atomic_add((int *)extra_data, num_elements);
+}
+
+/* State of the threads owned by the test in the shared pool checks. */
+struct shared_state {
+  struct threadpool *tp;
+  volatile int done;
+  int released;
+};
+
+void *shared_thread(void *data) {
+  struct shared_state *state = (struct shared_state *)data;
+  while (1) {
+    threadpool_serve(state->tp);
+    if (state->done) break;
+    atomic_inc(&state->released);
+  }
+  return NULL;
+}
+
 int main(int argc, char *argv[]) {
 
   // Some constants for this test.
@@ -169,5 +235,131 @@ int main(int argc, char *argv[]) {
 
   printf("# passed uniform checks\n");
 
+  printf("# asynchronous map checks\n");
+
+  /* Chained and fused maps running asynchronously */
+  for (int num_thread = 1; num_thread <= 16; num_thread *= 4) {
+    struct threadpool atp;
+    threadpool_init(&atp, num_thread);
+
+    const int M = 1000;
+    int first[M], second[M];
+
+    for (int run = 0; run < 10; run++) {
+
+      /* Fill the first array and check it in reverse order once complete. */
+      struct threadpool_future *fill = threadpool_map_async(
+          &atp, map_function_set_index, first, M, sizeof(int),
+          threadpool_auto_chunk_size, first, /*after=*/NULL);
+      threadpool_map_async(&atp, map_function_check_reversed, first, M,
+                           sizeof(int), threadpool_auto_chunk_size, first,
+                           /*after=*/fill);
+
+      /* An independent fused map running alongside. */
+      for (int k = 0; k < M; k++) second[k] = k;
+      threadpool_map_function functions[2] = {map_function_increment,
+                                              map_function_double};
+      void *extra_data[2] = {NULL, NULL};
+      struct threadpool_future *fused = threadpool_map_fused_async(
+          &atp, functions, extra_data, 2, second, M, sizeof(int), 7,
+          /*after=*/NULL);
+
+      threadpool_wait(&atp, fused);
+      for (int k = 0; k < M; k++) {
+        if (second[k] != 2 * (k + 1)) {
+          printf("  fused map not correct (%d != %d)\n", second[k],
+                 2 * (k + 1));
+          fflush(stdout);
+          exit(1);
+        }
+      }
+
+      threadpool_wait(&atp, NULL);
+
+      /* Every element is mapped exactly once and waiting on the future only
+       * returns once all of them are done. */
+      int indices[M], hits[M];
+      for (int k = 0; k < M; k++) {
+        indices[k] = k;
+        hits[k] = 0;
+      }
+      int done = 0;
+      struct threadpool_future *count = threadpool_map_async(
+          &atp, map_function_count_hits, indices, M, sizeof(int),
+          threadpool_auto_chunk_size, hits, /*after=*/NULL);
+      struct threadpool_future *slow = threadpool_map_async(
+          &atp, map_function_slow_done, indices, M, sizeof(int), 3, &done,
+          /*after=*/count);
+      threadpool_wait(&atp, slow);
+      if (done != M) {
+        printf("  wait returned before the map completed (%d != %d)\n", done,
+               M);
+        fflush(stdout);
+        exit(1);
+      }
+      for (int k = 0; k < M; k++) {
+        if (hits[k] != 1) {
+          printf("  element %d mapped %d times\n", k, hits[k]);
+          fflush(stdout);
+          exit(1);
+        }
+      }
+    }
+
+    threadpool_clean(&atp);
+  }
+
+  printf("# passed asynchronous map checks\n");
+
+  printf("# shared pool checks\n");
+
+  /* A pool served by threads we own, alternating maps and other work. */
+  {
+    const int num_shared = 4;
+    struct threadpool stp;
+    threadpool_init_shared(&stp, num_shared);
+
+    struct shared_state state = {&stp, 0, 0};
+    pthread_t threads[num_shared];
+    for (int k = 0; k < num_shared; k++)
+      pthread_create(&threads[k], NULL, shared_thread, &state);
+    threadpool_gather_threads(&stp);
+
+    const int M = 1000;
+    int values[M];
+    for (int run = 0; run < 10; run++) {
+      for (int k = 0; k < M; k++) values[k] = k;
+      threadpool_map(&stp, map_function_increment, values, M, sizeof(int),
+                     threadpool_auto_chunk_size, NULL);
+      for (int k = 0; k < M; k++) {
+        if (values[k] != k + 1) {
+          printf("  shared pool map not correct (%d != %d)\n", values[k],
+                 k + 1);
+          fflush(stdout);
+          exit(1);
+        }
+      }
+
+      /* Let the threads do their own work. */
+      threadpool_release_threads(&stp);
+      threadpool_gather_threads(&stp);
+    }
+
+    if (state.released != 10 * num_shared) {
+      printf("  shared pool threads released %d times instead of %d\n",
+             state.released, 10 * num_shared);
+      fflush(stdout);
+      exit(1);
+    }
+
+    /* Send the threads home. */
+    state.done = 1;
+    threadpool_release_threads(&stp);
+    for (int k = 0; k < num_shared; k++) pthread_join(threads[k], NULL);
+    threadpool_clean(&stp);
+  }
+
+  printf("# passed shared pool checks\n");
+
   return 0;
 }
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 
 /* Local headers. */
+#include "clocks.h"
 #include "error.h"
 #include "hydro/Shadowswift/voronoi3d_algorithm.h"
 #include "part.h"
@@ -30,6 +31,13 @@
 /* Number of random generators to use in the first grid build test */
 #define TESTVORONOI3D_NUMCELL_RANDOM 100
 
+/* Number of random generators to use in the construction benchmark */
+#define TESTVORONOI3D_NUMCELL_BENCHMARK 1000
+
+/* Radius within which generators are neighbours in the construction
+   benchmark */
+#define TESTVORONOI3D_BENCHMARK_RADIUS 0.3
+
 /* Number of cartesian generators to use (in one coordinate direction) for the
    second grid build test. The total number of generators is the third power of
    this number (so be careful with large numbers) */
@@ -1240,6 +1248,7 @@ void set_coordinates(struct part *p, double x, double y, double z,
   p->x[1] = y;
   p->x[2] = z;
   p->id = id;
+  voronoi_cell_reset(&p->cell);
   voronoi_cell_init(&p->cell, p->x, box_anchor, box_side);
 }
 #endif
@@ -1314,6 +1323,10 @@ void test_degeneracies(void) {
 
 int main(int argc, char *argv[]) {
 
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
   /* Set the all enclosing simulation box dimensions */
   double box_anchor[3] = {VORONOI3D_BOX_ANCHOR_X, VORONOI3D_BOX_ANCHOR_Y,
                           VORONOI3D_BOX_ANCHOR_Z};
@@ -1333,6 +1346,7 @@ int main(int argc, char *argv[]) {
     /* Create a Voronoi cell */
     double x[3] = {0.5f, 0.5f, 0.5f};
     struct voronoi_cell cell;
+    voronoi_cell_reset(&cell);
     voronoi_cell_init(&cell, x, box_anchor, box_side);
 
     /* Interact with neighbours */
@@ -1428,6 +1442,9 @@ int main(int argc, char *argv[]) {
     float Vtot;
     struct voronoi_cell cells[TESTVORONOI3D_NUMCELL_RANDOM];
     struct voronoi_cell *cell_i, *cell_j;
+    for (i = 0; i < TESTVORONOI3D_NUMCELL_RANDOM; ++i) {
+      voronoi_cell_reset(&cells[i]);
+    }
 
     /* initialize cells with random generator locations */
     for (i = 0; i < TESTVORONOI3D_NUMCELL_RANDOM; ++i) {
@@ -1474,6 +1491,9 @@ int main(int argc, char *argv[]) {
     float Vtot;
     struct voronoi_cell cells[TESTVORONOI3D_NUMCELL_CARTESIAN_3D];
     struct voronoi_cell *cell_i, *cell_j;
+    for (i = 0; i < TESTVORONOI3D_NUMCELL_CARTESIAN_3D; ++i) {
+      voronoi_cell_reset(&cells[i]);
+    }
 
     /* initialize cells with Cartesian generator locations */
     for (i = 0; i < TESTVORONOI3D_NUMCELL_CARTESIAN_1D; ++i) {
@@ -1518,5 +1538,90 @@ int main(int argc, char *argv[]) {
     message("Done.");
   }
 
+  /* Benchmark the construction against cutting every neighbour directly */
+  {
+    message("Benchmarking the cell construction...");
+
+    const int N = TESTVORONOI3D_NUMCELL_BENCHMARK;
+    const double radius2 = TESTVORONOI3D_BENCHMARK_RADIUS *
+                           TESTVORONOI3D_BENCHMARK_RADIUS;
+    double *x = (double *)malloc(3 * N * sizeof(double));
+    float *volumes = (float *)malloc(N * sizeof(float));
+    struct voronoi_cell *cells =
+        (struct voronoi_cell *)malloc((N + 1) * sizeof(struct voronoi_cell));
+    if (x == NULL || volumes == NULL || cells == NULL)
+      error("Failed to allocate benchmark memory");
+    struct voronoi_cell *cell = &cells[N];
+    for (int i = 0; i < 3 * N; ++i) {
+      x[i] = random_uniform(0.05, 0.95);
+    }
+    for (int i = 0; i <= N; ++i) {
+      voronoi_cell_reset(&cells[i]);
+    }
+
+    /* Build the grid twice, moving the generators a bit in between so that
+       the second construction can use the previous one as a warm start */
+    for (int step = 0; step < 2; ++step) {
+
+      if (step) {
+        for (int i = 0; i < 3 * N; ++i) {
+          x[i] += random_uniform(-0.005, 0.005);
+        }
+      }
+
+      /* Reference: cut every neighbour as soon as we see it */
+      ticks tic = getticks();
+      for (int i = 0; i < N; ++i) {
+        voronoi_cell_init(cell, &x[3 * i], box_anchor, box_side);
+        for (int j = 0; j < N; ++j) {
+          const float dx[3] = {x[3 * i] - x[3 * j], x[3 * i + 1] - x[3 * j + 1],
+                               x[3 * i + 2] - x[3 * j + 2]};
+          if (i != j && dx[0] * dx[0] + dx[1] * dx[1] + dx[2] * dx[2] < radius2)
+            voronoi_intersect(cell, dx, j);
+        }
+        voronoi_calculate_cell(cell);
+        voronoi_calculate_faces(cell);
+        volumes[i] = cell->volume;
+      }
+      const ticks toc_direct = getticks() - tic;
+
+      /* Batched cuts sorted on distance */
+      float Vtot = 0.0f;
+      tic = getticks();
+      for (int i = 0; i < N; ++i) {
+        voronoi_cell_init(&cells[i], &x[3 * i], box_anchor, box_side);
+        for (int j = 0; j < N; ++j) {
+          const float dx[3] = {x[3 * i] - x[3 * j], x[3 * i + 1] - x[3 * j + 1],
+                               x[3 * i + 2] - x[3 * j + 2]};
+          if (i != j && dx[0] * dx[0] + dx[1] * dx[1] + dx[2] * dx[2] < radius2)
+            voronoi_cell_interact(&cells[i], dx, j);
+        }
+        voronoi_cell_finalize(&cells[i]);
+      }
+      const ticks toc_batched = getticks() - tic;
+
+      /* The order of the cuts only changes the round-off error */
+      for (int i = 0; i < N; ++i) {
+        if (fabs(cells[i].volume - volumes[i]) > 1.e-2 * volumes[i]) {
+          error("Wrong volume for cell %i: %g (should be %g)!", i,
+                cells[i].volume, volumes[i]);
+        }
+        Vtot += cells[i].volume;
+      }
+      message("Vtot: %g (Vtot-1.0f: %g)", Vtot, (Vtot - 1.0f));
+      assert(fabs(Vtot - 1.0f) < 1.e-5);
+
+      message("Step %i: direct cuts took %9.3f %s, batched cuts took %9.3f %s.",
+              step, clocks_from_ticks(toc_direct), clocks_getunit(),
+              clocks_from_ticks(toc_batched), clocks_getunit());
+    }
+
+    free(x);
+    free(volumes);
+    free(cells);
+
+    message("Done.");
+  }
+
   return 0;
 }